@@ -98,6 +98,11 @@
  *  221 Goodbye.
  * \endcode
  *
+ * With `ETP.cache_ttl` > 0 in `envtool.cfg`, the results of a query are saved
+ * in the file `ETP.cache_file` for that many seconds. The same query to the same host
+ * then prints the saved results without connecting. Use `--refresh` to query
+ * the host anyway.
+ *
  * This file is part of envtool.
  *
  * By Gisle Vanem <gvanem@yahoo.no>
@@ -139,12 +144,33 @@
 
 /**
  * \def MAX_RECV_BUF
- * size of receive buffer
+ * size of the trace buffer and the `SO_RCVBUF` size with `opt.use_buffered_io == 0`.
  */
 #ifndef MAX_RECV_BUF
 #define MAX_RECV_BUF (16*1024)
 #endif
 
+/**
+ * \def RX_BUF_SIZE
+ * size of the receive buffer in `struct RX_buf`.
+ * Also the longest line `recv_line()` can return.
+ */
+#ifndef RX_BUF_SIZE
+#define RX_BUF_SIZE (256*1024)
+#endif
+
+/**
+ * \def ETP_CACHE_MAGIC
+ * The first bytes of the ETP result cache-file. Followed by a `ETP_CACHE_VERSION` byte.
+ */
+#define ETP_CACHE_MAGIC    "ETPC"
+
+/**
+ * \def ETP_CACHE_VERSION
+ * The version of the ETP result cache-file. If we read another version, ignore the file.
+ */
+#define ETP_CACHE_VERSION  2
+
 DWORD ETP_total_rcv;
 DWORD ETP_num_evry_dups;
 
@@ -163,14 +189,89 @@ typedef bool (*ETP_state) (struct state_CTX *ctx);
  * Buffered I/O stream
  */
 struct IO_buf {
-       char   buffer [MAX_RECV_BUF];   /**< the input/trace buffer */
+       char   buffer [MAX_RECV_BUF];   /**< the trace buffer */
        char  *buffer_pos;              /**< current position in the buffer */
        size_t buffer_left;             /**< number of bytes left in the buffer: <br>
                                         * `buffer_left = buffer_end - buffer_pos`
                                         */
-       int    buffer_read;             /**< used by `rbuf_read_char()` */
      };
 
+/**
+ * \struct RX_buf
+ * The receive buffer. Filled by `rbuf_fill()` with as much as one `recv()` returns.
+ *
+ * The lines between `head` and `tail` are returned by `recv_line()` as views
+ * into the buffer. Only a partial last line is moved to the start of the
+ * buffer before the next `recv()`. Hence a line is always contiguous.
+ */
+struct RX_buf {
+       char  *buffer;       /**< the `RX_BUF_SIZE` bytes allocated in `do_check_evry_ept()` */
+       size_t size;         /**< the size of `buffer` */
+       size_t head;         /**< the start of the data not yet returned by `recv_line()` */
+       size_t tail;         /**< the end of the received data */
+       int    buffer_read;  /**< the size of the last `recv()` */
+       bool   eof;          /**< the last `recv()` failed, timed out or the peer closed */
+     };
+
+/**
+ * \struct TX_buf
+ * The commands to send in one `send()`. Built by `tx_add()`.
+ */
+struct TX_buf {
+       char  *buffer;      /**< the `"\r\n"` terminated commands */
+       size_t len;         /**< the length of the commands */
+       size_t size;        /**< the size of `buffer` */
+     };
+
+/**
+ * \struct ETP_result
+ * A result saved by `report_file_ept()` when the host is queried together
+ * with other hosts. Reported when it's this host's turn. Allocated from the
+ * arena-backed `ctx->results`.
+ *
+ * Also saved for the ETP result cache. Then a file ignored by `opt.dir_mode`
+ * is saved too; a cache hit could be for another `opt.dir_mode`.
+ */
+struct ETP_result {
+       time_t  mtime;      /**< The `time_t` value of `file` */
+       UINT64  fsize;      /**< The file-size value of `file` */
+       bool    is_dir;     /**< `file` is a folder */
+       int     query;      /**< The query it's a result of */
+       char   *file;       /**< The full name of file or folder */
+     };
+
+/**
+ * \struct ETP_host_time
+ * The timing of one host. Printed in `ETP_report_hosts()`.
+ */
+struct ETP_host_time {
+       char    *host;      /**< The host-spec from `opt.evry_host` */
+       double   time;      /**< Seconds from `state_init()` to `state_exit()` */
+       unsigned results;   /**< The number of results reported */
+       int      ws_err;    /**< The last error (if any) */
+     };
+
+static smartlist_t *host_times;
+
+/**
+ * \struct ETP_cache_entry
+ * The results of a session in the ETP result cache.
+ * Keyed by the host and the queries. Encoded by `ETP_cache_put()`.
+ */
+struct ETP_cache_entry {
+       char   *key;        /**< From `ETP_cache_key()` */
+       time_t  created;    /**< When the results were received */
+       BYTE   *data;       /**< The encoded results */
+       size_t  len;        /**< The length of `data` */
+     };
+
+/**
+ * The ETP result cache. Read from `opt.evry_cache_file` on the first lookup.
+ * Written back in `ETP_exit()` if changed.
+ */
+static smartlist_t *cache_entries;
+static bool         cache_dirty;
+
 /**
  * \struct state_CTX
  * The context used throughout the ETP transfer.
@@ -194,8 +295,21 @@ struct state_CTX {
        unsigned           results_expected; /**< The number of matches we're expecting */
        unsigned           results_got;      /**< The number of matches we actually got */
        unsigned           results_ignore;   /**< The number of matches we ignored */
-       struct IO_buf      recv;             /**< The `IO_buf` for reception */
+       struct RX_buf      recv;             /**< The `RX_buf` for reception */
        struct IO_buf      trace;            /**< The `IO_buf` for tracing the protocol */
+       bool               async;            /**< Run by `run_state_machines()` together with other hosts */
+       bool               done;             /**< `state_exit()` was reached */
+       double             start_time;       /**< `bench_time()` in `ETP_ctx_init()` */
+       double             end_time;         /**< `bench_time()` when `state_exit()` was entered */
+       double             io_time;          /**< `bench_time()` at the last `connect()` or `recv()`; for the timeouts */
+       smartlist_t       *results;          /**< The `ETP_result`s saved until this host is reported */
+       int                query;            /**< The query in progress; 0 is for `opt.file_spec`, 1.. for `opt.evry_specs` */
+       int                num_queries;      /**< The number of queries in this session */
+       unsigned           query_got;        /**< The `results_got` when this query started */
+       bool               short_results;    /**< A query got fewer results than it's `"RESULT_COUNT N"` */
+       char              *cache_key;        /**< The key in the ETP result cache. `NULL` if it's not used */
+       bool               cached;           /**< The results came from the ETP result cache */
+       bool               resolved;         /**< `hostname` was resolved by `gethostbyname()` */
 
        /* These are set in state_PATH().
         */
@@ -211,7 +325,7 @@ static int         parse_host_spec      (struct state_CTX *ctx, const char *patt
 static void        connect_common_init  (struct state_CTX *ctx, const char *which_state);
 static void        connect_common_final (struct state_CTX *ctx, int err);
 static void        set_nonblock         (SOCKET sock, DWORD non_block);
-static int         rbuf_read_char  (struct state_CTX *ctx, char *store);
+static bool        rbuf_fill       (struct state_CTX *ctx);
 static const char *ETP_tracef      (struct state_CTX *ctx, _Printf_format_string_ const char *fmt, ...) ATTR_PRINTF(2, 3);
 static const char *ETP_state_name  (ETP_state f);
 
@@ -221,10 +335,12 @@ static bool state_parse_url            (struct state_CTX *ctx);
 static bool state_netrc_lookup         (struct state_CTX *ctx);
 static bool state_authinfo_lookup      (struct state_CTX *ctx);
 static bool state_send_login           (struct state_CTX *ctx);
+static bool state_await_welcome        (struct state_CTX *ctx);
 static bool state_send_pass            (struct state_CTX *ctx);
 static bool state_await_login          (struct state_CTX *ctx);
 static bool state_await_features       (struct state_CTX *ctx);
 static bool state_send_query           (struct state_CTX *ctx);
+static bool state_query_done           (struct state_CTX *ctx);
 static bool state_200                  (struct state_CTX *ctx);
 static bool state_RESULT_COUNT         (struct state_CTX *ctx);
 static bool state_PATH                 (struct state_CTX *ctx);
@@ -232,67 +348,72 @@ static bool state_closing              (struct state_CTX *ctx);
 static bool state_resolve              (struct state_CTX *ctx);
 static bool state_blocking_connect     (struct state_CTX *ctx);
 static bool state_non_blocking_connect (struct state_CTX *ctx);
+static void ETP_cache_put              (struct state_CTX *ctx);
 
 /**
  * Receive a response with timeout.
  * Stop when we get an `"\r\n"` terminated ASCII-line.
  *
- * * `opt.use_buffered_io == 1`:
- *    Use the buffered I/O setup in rbuf_read_char().
+ * The line is not copied; it is returned as a view into `ctx->recv.buffer`
+ * with the `"\r\n"` replaced by a `NUL` and leading spaces skipped.
+ * It is valid until the next call. `memchr()` finds the end of the line
+ * in the buffered data. Only if there is no complete line, `rbuf_fill()`
+ * receives more:
+ *
+ * * `opt.use_buffered_io == 1` (the default):
+ *    Receive as much as there is room for in the buffer in one `recv()`.
  *
  * * `opt.use_buffered_io == 0`:
  *   Call `recv()` for 1 character at a time! <br>
- *   This is to keep it simple; avoid the need for (a non-blocking socket and)
- *   `select()`. <br>
- *   But the `recv()` will hang if used against a non "line oriented"
- *   protocol. But only for max 2 seconds since `setsockopt()` with `SO_RCVTIMEO`
- *   was set to 2 sec.
- *
- *   Practice shows this is just a bit slower than the rbuf_read_char() method since
- *   Winsock2 provides good buffering with the above `setsockopt()` call. <br>
- *   The question is if this causes a higher number of kernel switches. And thus
- *   lower performance on slower CPUs.
- *
- * \param[in] ctx      the context we work with.
- * \param[in] out_buf  the location of the buffer to save too.
- * \param[in] out_len  the length of the buffer for saving.
+ *   The `recv()` will hang if used against a non "line oriented" protocol.
+ *   But only for max 2 seconds since `setsockopt()` with `SO_RCVTIMEO`
+ *   was set to 2 sec. <br>
+ *   This is many times slower for a large result; there is one `recv()`
+ *   per byte. Kept for testing only.
+ *
+ * \param[in]  ctx  the context we work with.
+ * \param[out] len  if not `NULL`, set to the length of the returned line.
+ * \retval     the received line. Empty or partial on a timeout or error.
  */
-static char *recv_line (struct state_CTX *ctx, char *out_buf, size_t out_len)
+static char *recv_line (struct state_CTX *ctx, size_t *len)
 {
-  int    rc, num;
-  size_t i;
-  char   ch, *start = out_buf;
+  struct RX_buf *rx = &ctx->recv;
+  char          *start, *end;
+  size_t         scanned = 0;
 
-  for (i = num = 0; i < out_len; i++)
+  while (1)
   {
-    if (opt.use_buffered_io)
-         rc = rbuf_read_char (ctx, &ch);
-    else rc = recv (ctx->sock, &ch, 1, 0);
-    if (rc == 1)
+    start = rx->buffer + rx->head;
+    end = memchr (start + scanned, '\n', rx->tail - rx->head - scanned);
+    if (end)
     {
-      num++;
-      *out_buf++ = ch;
-      if (ch == '\n')    /* Assumes `\r` already was received */
-         break;
+      rx->head = end - rx->buffer + 1;
+      break;
     }
-    if (rc <= 0)
+    scanned = rx->tail - rx->head;
+    if (!rbuf_fill(ctx))
     {
-      ctx->ws_err = WSAGetLastError();
+      start = rx->buffer + rx->head;
+      end = rx->buffer + rx->tail;   /* `rbuf_fill()` keeps room for the NUL here */
+      rx->head = rx->tail;
       break;
     }
   }
 
-  ETP_total_rcv += num;
-  *out_buf = '\0';
-  str_strip_nl (start);
-  start = str_ltrim (start);
+  if (end > start && end[-1] == '\r')
+     end--;
+  *end = '\0';
+
+  while (*start == ' ' || *start == '\t')
+     start++;
+  if (len)
+     *len = end - start;
 
-  ETP_tracef (ctx, "Rx: \"%s\", len: %d\n", start, num);
+  ETP_tracef (ctx, "Rx: \"%s\", len: %d\n", start, (int)(end - start));
 
-  if (opt.use_buffered_io && opt.debug >= 3)
-     ETP_tracef (ctx, "recv.buffer_left: %zu: recv.buffer_pos: %zd, recv.buffer_read: %d, ws_err: %d\n",
-                 ctx->recv.buffer_left, ctx->recv.buffer_pos - ctx->recv.buffer,
-                 ctx->recv.buffer_read, ctx->ws_err);
+  if (opt.debug >= 3)
+     ETP_tracef (ctx, "recv.head: %zu: recv.tail: %zu, recv.buffer_read: %d, ws_err: %d\n",
+                 rx->head, rx->tail, rx->buffer_read, ctx->ws_err);
   return (start);
 }
 
@@ -326,8 +447,61 @@ static int send_cmd (struct state_CTX *ctx, const char *fmt, ...)
   return (rc < 0 ? -1 : 0);
 }
 
+/**
+ * Print a resulting match unless it's a duplicate of the previous one.
+ *
+ * \param[in] full_name  the full name of the file or folder.
+ * \param[in] mtime      the `time_t` value of `full_name`.
+ * \param[in] fsize      the file-size value of `full_name`.
+ * \param[in] is_dir     if `true`, `full_name` is a folder-name.
+ */
+static void report_result (const char *full_name, time_t mtime, UINT64 fsize, bool is_dir)
+{
+  static char prev_name [_MAX_PATH];
+
+  if (!opt.dir_mode && prev_name[0] && str_equal(prev_name, full_name))
+     ETP_num_evry_dups++;
+  else
+  {
+    report r;
+
+    memset (&r, '\0', sizeof(r));
+    r.file   = full_name;
+    r.mtime  = mtime;
+    r.fsize  = fsize;
+    r.is_dir = is_dir;
+    r.key    = HKEY_EVERYTHING_ETP;
+    report_file (&r);
+  }
+  _strlcpy (prev_name, full_name, sizeof(prev_name));
+}
+
+/**
+ * Save a result in `ctx->results`.
+ *
+ * \param[in] ctx        the context we work with.
+ * \param[in] full_name  the full name of the file or folder.
+ * \param[in] mtime      the `time_t` value of `full_name`.
+ * \param[in] fsize      the file-size value of `full_name`.
+ * \param[in] is_dir     if `true`, `full_name` is a folder-name.
+ * \param[in] query      the query it's a result of.
+ */
+static void save_result (struct state_CTX *ctx, const char *full_name, time_t mtime, UINT64 fsize, bool is_dir, int query)
+{
+  struct ETP_result *res = smartlist_alloc (ctx->results, sizeof(*res));
+
+  res->mtime  = mtime;
+  res->fsize  = fsize;
+  res->is_dir = is_dir;
+  res->query  = query;
+  res->file   = smartlist_strdup (ctx->results, full_name);
+  smartlist_add (ctx->results, res);
+}
+
 /**
  * Print the resulting match.
+ * Or save it in `ctx->results` if the host is queried together with other hosts.
+ * Also save it if the results are to be cached.
  *
  * \param[in] ctx    the context we work with.
  * \param[in] name   Either a file-name or a folder-name within a `ctx->path`
@@ -336,35 +510,52 @@ static int send_cmd (struct state_CTX *ctx, const char *fmt, ...)
  */
 static void report_file_ept (struct state_CTX *ctx, const char *name, bool is_dir)
 {
-  if (opt.dir_mode && !is_dir)
+  bool ignore = (opt.dir_mode && !is_dir);
+
+  if (ignore)
      ctx->results_ignore++;
-  else
+
+  if (!ignore || ctx->cache_key)
   {
-    static char prev_name [_MAX_PATH];
-    char   full_name [_MAX_PATH+2];
+    char full_name [_MAX_PATH+2];
 
     snprintf (full_name, sizeof(full_name), "%s%c%s", ctx->path, DIR_SEP, name);
 
-    if (!opt.dir_mode && prev_name[0] && str_equal(prev_name, full_name))
-       ETP_num_evry_dups++;
-    else
-    {
-      report r;
-
-      memset (&r, '\0', sizeof(r));
-      r.file   = full_name;
-      r.mtime  = ctx->mtime;
-      r.fsize  = ctx->fsize;
-      r.is_dir = is_dir;
-      r.key    = HKEY_EVERYTHING_ETP;
-      report_file (&r);
-    }
-    _strlcpy (prev_name, full_name, sizeof(prev_name));
+    if (ctx->async || ctx->cache_key)
+       save_result (ctx, full_name, ctx->mtime, ctx->fsize, is_dir, ctx->query);
+    if (!ignore && !ctx->async)
+       report_result (full_name, ctx->mtime, ctx->fsize, is_dir);
   }
   ctx->mtime = 0;
   ctx->fsize = 0;
 }
 
+/**
+ * Return the file-spec of a query.
+ *
+ * \param[in] query  0 for `opt.file_spec`, 1.. for the file-specs in `opt.evry_specs`.
+ */
+static const char *query_spec (int query)
+{
+  if (query == 0)
+     return (opt.file_spec);
+  return smartlist_get (opt.evry_specs, query - 1);
+}
+
+/**
+ * Set the header for the results of a query.
+ * The file-spec is shown only if there are several queries in this session.
+ *
+ * \param[in] ctx    the context we work with.
+ * \param[in] query  the query the results are for.
+ */
+static void query_header (const struct state_CTX *ctx, int query)
+{
+  if (ctx->num_queries == 1)
+       report_header_set ("Matches from %s:\n", ctx->raw_url);
+  else report_header_set ("Matches from %s for \"%s\":\n", ctx->raw_url, query_spec(query));
+}
+
 /**
  * Print a warning for a failed login.
  * Optionally print what action it will take next.
@@ -413,8 +604,7 @@ static void login_warning (struct state_CTX *ctx, bool is_authinfo)
 static bool state_PATH (struct state_CTX *ctx)
 {
   FILETIME ft;
-  char     buf [500];
-  char    *rx = recv_line (ctx, buf, sizeof(buf));
+  char    *rx = recv_line (ctx, NULL);
 
   if (!strncmp(rx, "PATH ", 5))
   {
@@ -423,16 +613,21 @@ static bool state_PATH (struct state_CTX *ctx)
     return (true);
   }
 
-  if (sscanf(rx, "SIZE %" U64_FMT, &ctx->fsize) == 1)
+  /* Check the prefix before the `sscanf()`; most lines are not a `SIZE` line.
+   * And do not format the trace unless it is used.
+   */
+  if (!strncmp(rx, "SIZE ", 5) && sscanf(rx+5, "%" U64_FMT, &ctx->fsize) == 1)
   {
-    ETP_tracef (ctx, "size: %s", str_trim((char*)get_file_size_str(ctx->fsize)));
+    if (opt.debug >= 2)
+       ETP_tracef (ctx, "size: %s", str_trim((char*)get_file_size_str(ctx->fsize)));
     return (true);
   }
 
-  if (sscanf(rx, "DATE_MODIFIED %" U64_FMT, (UINT64*)&ft) == 1)
+  if (!strncmp(rx, "DATE_MODIFIED ", 14) && sscanf(rx+14, "%" U64_FMT, (UINT64*)&ft) == 1)
   {
     ctx->mtime = FILETIME_to_time_t (&ft);
-    ETP_tracef (ctx, "mtime: %.24s", ctime(&ctx->mtime));
+    if (opt.debug >= 2)
+       ETP_tracef (ctx, "mtime: %.24s", ctime(&ctx->mtime));
     return (true);
   }
 
@@ -461,13 +656,14 @@ static bool state_PATH (struct state_CTX *ctx)
   }
 #endif
 
-  if (strncmp(rx, "200 End", 7) != 0)
+  if (!strncmp(rx, "200 End", 7))
+     ctx->state = state_query_done;
+  else
   {
     ETP_tracef (ctx, "results_got: %u", ctx->results_got);
     WARN ("Unexpected response: \"%s\", err: %s\n", rx, ws_strerror(ctx->ws_err));
+    ctx->state = state_closing;
   }
-
-  ctx->state = state_closing;
   return (true);
 }
 
@@ -481,17 +677,18 @@ static bool state_PATH (struct state_CTX *ctx)
  */
 static bool state_RESULT_COUNT (struct state_CTX *ctx)
 {
-  char  buf [200];
-  char *rx = recv_line (ctx, buf, sizeof(buf));
+  char *rx = recv_line (ctx, NULL);
 
   if (sscanf(rx, "RESULT_COUNT %u", &ctx->results_expected) == 1)
   {
+    if (!ctx->async)
+       query_header (ctx, ctx->query);
     ctx->state = state_PATH;
     return (true);
   }
   if (!strncmp(rx, "200 End", 7))  /* Premature "200 End". No results? */
   {
-    ctx->state = state_closing;
+    ctx->state = state_query_done;
     return (true);
   }
   WARN ("Unexpected response: \"%s\"\n", rx);
@@ -509,9 +706,8 @@ static bool state_RESULT_COUNT (struct state_CTX *ctx)
  */
 static bool state_200 (struct state_CTX *ctx)
 {
-  char   buf [200];
-  char  *rx = recv_line (ctx, buf, sizeof(buf));
-  size_t len = strlen (rx);
+  size_t len;
+  char  *rx = recv_line (ctx, &len);
 
   if (!strncmp(rx, "200-", 4))
      ctx->state = state_RESULT_COUNT;
@@ -523,6 +719,25 @@ static bool state_200 (struct state_CTX *ctx)
   return (true);
 }
 
+/**
+ * Warn if the query in progress got fewer results than the `"RESULT_COUNT N"`.
+ *
+ * \param[in] ctx  the context we work with.
+ * \retval    false if some results are missing.
+ */
+static bool check_results (struct state_CTX *ctx)
+{
+  unsigned got = ctx->results_got - ctx->query_got;
+
+  if (ctx->results_expected > 0 && got < ctx->results_expected)
+  {
+    WARN ("Expected %u results, but received only %u. Received %s bytes.\n",
+          ctx->results_expected, got, str_dword(ETP_total_rcv));
+    return (false);
+  }
+  return (true);
+}
+
 /**
  * Close the socket and enter `state_exit()`.
  *
@@ -533,26 +748,154 @@ static bool state_closing (struct state_CTX *ctx)
   ETP_tracef (ctx, "closesocket (%zd)", ctx->sock);
   closesocket (ctx->sock);
 
-  if (ctx->results_expected > 0 && ctx->results_got < ctx->results_expected)
-     WARN ("Expected %u results, but received only %u. Received %s bytes.\n",
-           ctx->results_expected, ctx->results_got, str_dword(ETP_total_rcv));
-
+  check_results (ctx);
   ctx->state = state_exit;
   return (true);
 }
 
 /**
- * Send the search parameters and the `"QUERY x"` command.
+ * A query is done; the `"200 End"` was received.
  *
- * If the `send()` call fails, enter `state_closing()`.
- * Otherwise, enter `state_200()`.
+ * If there are more queries in this session, enter `state_200()` to await
+ * the results of the next query. It was already sent if `opt.use_pipelining == 1`.
+ * Otherwise enter `state_send_query()` to send it. <br>
+ * After the last query, enter `state_closing()`.
  *
- * \todo Maybe sending all these commands in one `send()` is better?
+ * \param[in] ctx  the context we work with.
+ */
+static bool state_query_done (struct state_CTX *ctx)
+{
+  if (!check_results(ctx))
+     ctx->short_results = true;
+  ctx->results_expected = 0;
+  ctx->query_got = ctx->results_got;
+
+  if (++ctx->query >= ctx->num_queries)
+       ctx->state = state_closing;
+  else if (opt.use_pipelining)
+       ctx->state = state_200;
+  else ctx->state = state_send_query;
+  return (true);
+}
+
+/**
+ * Add a single-line command to `tx`.
+ * Do not use a `"\r\n"` termination; it will be added here.
  *
  * \param[in] ctx  the context we work with.
+ * \param[in] tx   the `TX_buf` to add to.
+ * \param[in] fmt  the var-arg format of the command.
  */
-static bool state_send_query (struct state_CTX *ctx)
+static void tx_add (struct state_CTX *ctx, struct TX_buf *tx, const char *fmt, ...)
+{
+  va_list args;
+  int     len;
+
+  va_start (args, fmt);
+  len = vsnprintf (tx->buffer ? tx->buffer + tx->len : NULL, tx->size - tx->len, fmt, args);
+  va_end (args);
+
+  if (len < 0)
+     return;
+
+  if (tx->len + len + 3 > tx->size)
+  {
+    tx->size   = 2 * tx->size + len + 3;
+    tx->buffer = REALLOC (tx->buffer, tx->size);
+    va_start (args, fmt);
+    vsnprintf (tx->buffer + tx->len, tx->size - tx->len, fmt, args);
+    va_end (args);
+  }
+
+  ETP_tracef (ctx, "Tx: \"%s\\r\\n\"\n", tx->buffer + tx->len);
+  tx->len += len;
+  tx->buffer [tx->len++] = '\r';
+  tx->buffer [tx->len++] = '\n';
+  tx->buffer [tx->len] = '\0';
+}
+
+/**
+ * Send all of `buf` to the server side.
+ * On a non-blocking socket, wait up to `ctx->timeout` msec until it's writable.
+ *
+ * \param[in] ctx  the context we work with.
+ * \param[in] buf  the data to send.
+ * \param[in] len  the length of `buf`.
+ * \retval    0 on success, -1 on error.
+ */
+static int send_all (struct state_CTX *ctx, const char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    int rc = send (ctx->sock, buf, (int)len, 0);
+
+    if (rc < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+    {
+      struct timeval tv;
+      fd_set wr_fds;
+
+      FD_ZERO (&wr_fds);
+      FD_SET (ctx->sock, &wr_fds);
+      tv.tv_sec  = ctx->timeout / 1000;
+      tv.tv_usec = 1000 * (ctx->timeout % 1000);
+      if (select((int)(ctx->sock+1), NULL, &wr_fds, NULL, &tv) > 0)
+         continue;
+    }
+    if (rc <= 0)
+    {
+      ctx->ws_err = WSAGetLastError();
+      return (-1);
+    }
+    buf += rc;
+    len -= rc;
+  }
+  return (0);
+}
+
+/**
+ * Send the commands in `tx`.
+ *
+ * With `opt.use_pipelining == 1`, send them all in one `send()`. <br>
+ * Otherwise, one `send()` per command. With Nagle's algorithm, the next `send()`
+ * could then wait for the server's delayed ACK of the previous one.
+ *
+ * \param[in] ctx  the context we work with.
+ * \param[in] tx   the commands to send.
+ * \retval    0 on success, -1 on error.
+ */
+static int tx_send (struct state_CTX *ctx, const struct TX_buf *tx)
+{
+  const char *cmd, *end;
+  int         rc = 0;
+
+  if (opt.use_pipelining)
+  {
+    rc = send_all (ctx, tx->buffer, tx->len);
+    ETP_tracef (ctx, "Tx: %u bytes in one send(), rc: %d\n", (unsigned)tx->len, rc);
+    return (rc);
+  }
+
+  for (cmd = tx->buffer; rc == 0 && cmd < tx->buffer + tx->len; cmd = end + 1)
+  {
+    end = strchr (cmd, '\n');
+    rc = send_all (ctx, cmd, end - cmd + 1);
+  }
+  return (rc);
+}
+
+/**
+ * Add the search parameters and the `"EVERYTHING QUERY"` command of a query to `tx`.
+ *
+ * The parameters that are the same for all queries in a session are sent only
+ * for the first query. The following queries needs only a new `"EVERYTHING SEARCH"`.
+ *
+ * \param[in] ctx    the context we work with.
+ * \param[in] tx     the `TX_buf` to add to.
+ * \param[in] query  the query to add.
+ */
+static void add_query (struct state_CTX *ctx, struct TX_buf *tx, int query)
 {
+  const char *spec = query_spec (query);
   const char *sort = NULL;  /* No sorting by default */
 
   /**
@@ -561,27 +904,34 @@ static bool state_send_query (struct state_CTX *ctx)
    * But as for 'Everything_SetSearchA()', a 'content:foo bar' string MUST be quoted.
    */
   if (opt.evry_raw)
-     send_cmd (ctx, "EVERYTHING SEARCH %s", evry_raw_query());
+     tx_add (ctx, tx, "EVERYTHING SEARCH %s", query == 0 ? evry_raw_query() : spec);
   else
   {
     /**
      * Always send a "REGEX 1", but translate from a shell-pattern if
      * `opt.use_regex == 0`.
      */
-    send_cmd (ctx, "EVERYTHING REGEX 1");
+    if (query == 0)
+       tx_add (ctx, tx, "EVERYTHING REGEX 1");
     if (opt.use_regex)
-         send_cmd (ctx, "EVERYTHING SEARCH %s", opt.file_spec);
-    else send_cmd (ctx, "EVERYTHING SEARCH ^%s$", translate_shell_pattern(opt.file_spec));
+         tx_add (ctx, tx, "EVERYTHING SEARCH %s", spec);
+    else tx_add (ctx, tx, "EVERYTHING SEARCH ^%s$", translate_shell_pattern(spec));
+  }
+
+  if (query > 0)
+  {
+    tx_add (ctx, tx, "EVERYTHING QUERY");
+    return;
   }
 
   if (opt.case_sensitive)
-     send_cmd (ctx, "EVERYTHING CASE 1");
+     tx_add (ctx, tx, "EVERYTHING CASE 1");
 
   if (opt.show_size)
-     send_cmd (ctx, "EVERYTHING SIZE_COLUMN 1");
+     tx_add (ctx, tx, "EVERYTHING SIZE_COLUMN 1");
 
-  send_cmd (ctx, "EVERYTHING PATH_COLUMN 1");
-  send_cmd (ctx, "EVERYTHING DATE_MODIFIED_COLUMN 1");
+  tx_add (ctx, tx, "EVERYTHING PATH_COLUMN 1");
+  tx_add (ctx, tx, "EVERYTHING DATE_MODIFIED_COLUMN 1");
 
   switch (opt.sort_methods[0])
   {
@@ -603,11 +953,37 @@ static bool state_send_query (struct state_CTX *ctx)
   }
 
   if (sort)
-     send_cmd (ctx, "EVERYTHING SORT %s", sort);
+     tx_add (ctx, tx, "EVERYTHING SORT %s", sort);
+
+  tx_add (ctx, tx, "EVERYTHING QUERY");
+}
+
+/**
+ * Send the search parameters and the `"EVERYTHING QUERY"` command.
+ *
+ * With `opt.use_pipelining == 1`, all the queries of this session are sent
+ * at once. The results of each are delimited by the `"200 End"`.
+ * Otherwise only the query in progress is sent.
+ *
+ * If the `send()` call fails, enter `state_closing()`.
+ * Otherwise, enter `state_200()`.
+ *
+ * \param[in] ctx  the context we work with.
+ */
+static bool state_send_query (struct state_CTX *ctx)
+{
+  struct TX_buf tx;
+  int    query, last;
+
+  memset (&tx, '\0', sizeof(tx));
+  last = opt.use_pipelining ? ctx->num_queries - 1 : ctx->query;
+  for (query = ctx->query; query <= last; query++)
+      add_query (ctx, &tx, query);
 
-  if (send_cmd(ctx, "EVERYTHING QUERY") < 0)
+  if (tx_send(ctx, &tx) < 0)
        ctx->state = state_closing;
   else ctx->state = state_200;
+  FREE (tx.buffer);
   return (true);
 }
 
@@ -632,32 +1008,47 @@ static bool state_send_query (struct state_CTX *ctx)
  */
 static bool state_send_login (struct state_CTX *ctx)
 {
-  char buf[200], *rx;
-  int  rc;
+  int rc;
 
   if (ctx->username[0] && ctx->password[0])
+       rc = send_cmd (ctx, "USER %s", ctx->username);
+  else rc = send_cmd (ctx, "USER");
+
+  if (rc < 0)   /* Tx failed! */
   {
-    rc = send_cmd (ctx, "USER %s", ctx->username);
-    ctx->state = state_send_pass;
+    WARN ("Failure in protococl.\n");
+    ETP_tracef (ctx, "Failure in protococl.\n");
+    ctx->state = state_closing;
   }
   else
-  {
-    rc = send_cmd (ctx, "USER");
-    ctx->state = state_await_login;
-  }
+    ctx->state = state_await_welcome;
+  return (true);
+}
 
-  /* Ignore the "220 Welcome to Everything..." message.
-   */
-  buf[0] = '\0';
-  rx = recv_line (ctx, buf, sizeof(buf));
+/**
+ * We sent the `USER` command. Ignore the `"220 Welcome to Everything..."` message.
+ *
+ * Enter `state_send_pass()` if we have a `ctx->password`. <br>
+ * Otherwise enter `state_await_login()`.
+ *
+ * This is a separate state since every state may receive only one line.
+ * Hence `run_state_machines()` can enter it when a line is received.
+ *
+ * \param[in] ctx  the context we work with.
+ */
+static bool state_await_welcome (struct state_CTX *ctx)
+{
+  char *rx = recv_line (ctx, NULL);
 
-  if (*rx == '\0' || rc < 0)   /* Empty response or Tx failed! */
+  if (*rx == '\0')   /* Empty response! */
   {
-    _strlcpy (buf, "Failure in protococl.\n", sizeof(buf));
-    WARN (buf);
-    ETP_tracef (ctx, buf);
+    WARN ("Failure in protococl.\n");
+    ETP_tracef (ctx, "Failure in protococl.\n");
     ctx->state = state_closing;
   }
+  else if (ctx->username[0] && ctx->password[0])
+       ctx->state = state_send_pass;
+  else ctx->state = state_await_login;
   return (true);
 }
 
@@ -673,7 +1064,7 @@ static bool state_send_login (struct state_CTX *ctx)
 static bool state_await_login (struct state_CTX *ctx)
 {
   char  buf [200];
-  char *rx = recv_line (ctx, buf, sizeof(buf));
+  char *rx = recv_line (ctx, NULL);
 
   /* "230": Server accepted our login.
    * If opt.verbose >= 1, get the ETP server features.
@@ -718,8 +1109,7 @@ static bool state_await_login (struct state_CTX *ctx)
  */
 static bool state_await_features (struct state_CTX *ctx)
 {
-  char  buf [200];
-  char *rx = recv_line (ctx, buf, sizeof(buf));
+  char *rx = recv_line (ctx, NULL);
 
   C_printf ("~2feature~0: '%s'\n", rx);
 
@@ -738,8 +1128,7 @@ static bool state_await_features (struct state_CTX *ctx)
  */
 static bool state_send_pass (struct state_CTX *ctx)
 {
-  char  buf [200];
-  char *rx = recv_line (ctx, buf, sizeof(buf));
+  char *rx = recv_line (ctx, NULL);
 
   if (!strcmp(rx, "230 Logged on.")) /* ETP server ignores passwords */
   {
@@ -803,14 +1192,16 @@ static bool state_resolve (struct state_CTX *ctx)
       goto fail;
     }
     ctx->sa.sin_addr.s_addr = *(u_long*) he->h_addr_list[0];
+    ctx->resolved = true;
     C_putc ('\r');
   }
 
-  if (opt.use_nonblock_io)
+  if (opt.use_nonblock_io || ctx->async)
   {
     connect_common_init (ctx, "state_non_blocking_connect");
     set_nonblock (ctx->sock, 1);
     connect (ctx->sock, (const struct sockaddr*)&ctx->sa, sizeof(ctx->sa));
+    ctx->io_time = bench_time();
     ctx->state = state_non_blocking_connect;
   }
   else
@@ -1126,9 +1517,40 @@ static bool state_exit (struct state_CTX *ctx)
 {
   ETP_tracef (ctx, "WSACleanup()");
   WSACleanup();
+  ctx->end_time = bench_time();
+  ctx->done = true;
   return (false);
 }
 
+/**
+ * Run the state-function `ctx->state` once.
+ *
+ * \param[in] ctx  the context we work with.
+ * \retval    the return value of the state-function.
+ */
+static bool run_state (struct state_CTX *ctx)
+{
+  ETP_state old_state = ctx->state;
+  bool      rc = (*ctx->state) (ctx);
+
+  if (opt.debug >= 2)
+  {
+    int save;
+
+    if (ctx->async)
+       C_printf ("~3%s~0: ", ctx->raw_url);
+    C_printf ("~2%s~0 -> ~2%s\n~6", ETP_state_name(old_state), ETP_state_name(ctx->state));
+
+    /* Set raw mode in case 'ctx->trace.buffer' contains a "~".
+     */
+    save = C_setraw (1);
+    C_puts (ETP_tracef(ctx, NULL));
+    C_setraw (save);
+    C_puts ("~0\n");
+  }
+  return (rc);
+}
+
 /**
  * Run the state-machine until a state-function returns false. <br>
  * Or the SIGINT handler detects user pressing `^C` (i.e `halt_flag` becomes non-zero). <br>
@@ -1140,23 +1562,7 @@ static void run_state_machine (struct state_CTX *ctx)
 {
   while (1)
   {
-    ETP_state old_state = ctx->state;
-    bool      rc = (*ctx->state) (ctx);
-
-    if (opt.debug >= 2)
-    {
-      int save;
-
-      C_printf ("~2%s~0 -> ~2%s\n~6", ETP_state_name(old_state), ETP_state_name(ctx->state));
-
-      /* Set raw mode in case 'ctx->trace.buffer' contains a "~".
-       */
-      save = C_setraw (1);
-      C_puts (ETP_tracef(ctx, NULL));
-      C_setraw (save);
-      C_puts ("~0\n");
-    }
-    if (!rc)
+    if (!run_state(ctx))
        break;
 
     if (halt_flag > 0)  /* SIGINT caught */
@@ -1168,47 +1574,236 @@ static void run_state_machine (struct state_CTX *ctx)
 }
 
 /**
- * Common stuff done before both a blocking and non-blocking `connect()`.
- *
- * \param[in] ctx          the context we work with.
- * \param[in] which_state  the name of the state we're about to enter after this call
- *                         (for ETP_tracef() only).
+ * Return `true` if the state-function `state` receives a line.
  */
-static void connect_common_init (struct state_CTX *ctx, const char *which_state)
+static bool state_receives (ETP_state state)
 {
-  int  rx_size;
+  return (state == state_await_welcome  || state == state_send_pass ||
+          state == state_await_login    || state == state_await_features ||
+          state == state_200            || state == state_RESULT_COUNT ||
+          state == state_PATH);
+}
 
-  ETP_tracef (ctx, "In %s(). use_netrc: %d, use_authinfo: %d, opt.use_nonblock_io: %d\n",
-              which_state, ctx->use_netrc, ctx->use_authinfo, opt.use_nonblock_io);
+/**
+ * Run the state-machine of `ctx` until it must wait for the network. <br>
+ * That is until it's connecting or it will receive a line that has not
+ * arrived yet. Hence `recv_line()` will never block in here.
+ *
+ * \param[in] ctx  the context we work with.
+ * \retval    false when `state_exit()` was reached.
+ */
+static bool run_until_wait (struct state_CTX *ctx)
+{
+  while (!ctx->done)
+  {
+    struct RX_buf *rx = &ctx->recv;
+    ETP_state      old_state = ctx->state;
 
-  if (opt.use_buffered_io)
-       rx_size = sizeof(ctx->recv.buffer);
-  else rx_size = MAX_RECV_BUF;  /* 16 kByte. Should currently be the same for both cases. */
+    if (old_state == state_non_blocking_connect)
+       return (true);
 
-  ctx->sa.sin_family = AF_INET;
-  ctx->sa.sin_port   = htons (ctx->port);
-  setsockopt (ctx->sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&ctx->timeout, sizeof(ctx->timeout));
-  setsockopt (ctx->sock, SOL_SOCKET, SO_RCVBUF, (const char*)&rx_size, sizeof(rx_size));
+    if (state_receives(old_state) && !rx->eof &&
+        !memchr(rx->buffer + rx->head, '\n', rx->tail - rx->head))
+       return (true);
 
-  if (!opt.quiet)
-     C_printf ("Connecting to %s/%u...", inet_ntoa(ctx->sa.sin_addr), ctx->port);
+    if (!run_state(ctx))
+       ctx->done = true;
 
-  C_flush();
+    /* Nothing more will arrive. Do not let a state like state_200() wait for it.
+     */
+    else if (rx->eof && rx->head == rx->tail && ctx->state == old_state && state_receives(old_state))
+       ctx->state = state_closing;
+  }
+  return (false);
 }
 
 /**
- * Common stuff done after both state_blocking_connect() and
- * state_non_blocking_connect().
+ * Called from `run_state_machines()` when `ctx->sock` is ready.
  *
- * \param[in] ctx  the context we work with.
- * \param[in] err  If `!0`, this is the error-code from the last Winsock called prior to entering here.<br>
- *                 If `0`, the last Winsock called prior to entering here, succeeded (we got connected).
+ * Complete a non-blocking `connect()` or receive more data into `ctx->recv`.
+ *
+ * \param[in] ctx      the context we work with.
+ * \param[in] revents  the `WSAPoll()` events for `ctx->sock`.
  */
-static void connect_common_final (struct state_CTX *ctx, int err)
+static void handle_ready (struct state_CTX *ctx, short revents)
 {
-  if (err)  /* The connection failed */
+  if (ctx->state == state_non_blocking_connect)
   {
-    char buf [500];
+    int opt_val = 0;
+    int opt_len = sizeof(opt_val);
+
+    if (revents & (POLLERR | POLLHUP))
+    {
+      getsockopt (ctx->sock, SOL_SOCKET, SO_ERROR, (char*)&opt_val, &opt_len);
+      if (opt_val == 0)
+         opt_val = WSAECONNREFUSED;
+    }
+    connect_common_final (ctx, opt_val);
+  }
+  else if (rbuf_fill(ctx))
+    ctx->io_time = bench_time();
+}
+
+/**
+ * Check a host that is waiting for the network for a timeout:
+ *  \li `CONN_TIMEOUT` for a `connect()`.
+ *  \li `ctx->timeout` for a line.
+ *
+ * \param[in] ctx  the context we work with.
+ * \param[in] now  the current `bench_time()`.
+ */
+static void check_timeout (struct state_CTX *ctx, double now)
+{
+  if (ctx->state == state_non_blocking_connect)
+  {
+    if (now - ctx->io_time >= CONN_TIMEOUT / 1000.0)
+       connect_common_final (ctx, WSAETIMEDOUT);
+  }
+  else if (now - ctx->io_time >= ctx->timeout / 1000.0)
+  {
+    ctx->ws_err = WSAETIMEDOUT;
+    ctx->recv.eof = true;   /* so 'recv_line()' returns what it has */
+  }
+}
+
+/**
+ * Report the results of host `ctx` as one block under it's own header.
+ * But first save them in the ETP result cache.
+ *
+ * \param[in] ctx  the context we work with.
+ */
+static void report_results (struct state_CTX *ctx)
+{
+  int i, query = -1, max = smartlist_len (ctx->results);
+
+  ETP_cache_put (ctx);
+
+  for (i = 0; i < max; i++)
+  {
+    struct ETP_result *res = smartlist_get (ctx->results, i);
+
+    if (opt.dir_mode && !res->is_dir)  /* Saved for the cache only */
+       continue;
+
+    if (res->query != query)
+    {
+      query = res->query;
+      query_header (ctx, query);
+    }
+    report_result (res->file, res->mtime, res->fsize, res->is_dir);
+  }
+  smartlist_free (ctx->results);
+  ctx->results = NULL;
+}
+
+/**
+ * Run the state-machines of `num` hosts together. <br>
+ * A `WSAPoll()` loop waits for any socket that is connecting or receiving.
+ * The total time is then close to the time of the slowest host instead of
+ * the sum for all hosts.
+ *
+ * The results of a host are saved in `ctx->results`. They are reported as
+ * one block when this host and all hosts before it are done. Hence the
+ * order is the same as for `run_state_machine()` on one host at a time.
+ *
+ * \param[in] ctx  the array of contexts.
+ * \param[in] num  the number of contexts.
+ *
+ * \note The `state_resolve()` in `gethostbyname()` and the `send_cmd()`
+ *       calls still block. But these are done before or between the waits.
+ *       <br>
+ *       Older Winsock versions does not report a failed non-blocking
+ *       `connect()` in `WSAPoll()`. The `CONN_TIMEOUT` handles that.
+ */
+static void run_state_machines (struct state_CTX *ctx, int num)
+{
+  WSAPOLLFD *fds = CALLOC (num, sizeof(*fds));
+  int       *idx = CALLOC (num, sizeof(*idx));
+  int        i, n, rc, reported = 0;
+
+  while (reported < num)
+  {
+    n = 0;
+    for (i = 0; i < num; i++)
+    {
+      if (!run_until_wait(&ctx[i]))
+         continue;
+      fds[n].fd      = ctx[i].sock;
+      fds[n].events  = (ctx[i].state == state_non_blocking_connect) ? POLLOUT : POLLIN;
+      fds[n].revents = 0;
+      idx[n++] = i;
+    }
+
+    while (reported < num && ctx[reported].done)
+       report_results (&ctx[reported++]);
+
+    if (n == 0 || halt_flag > 0)
+       break;
+
+    rc = WSAPoll (fds, n, 100);
+    if (rc < 0)
+    {
+      WARN ("WSAPoll() failed: %s.\n", ws_strerror(WSAGetLastError()));
+      break;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      if (fds[i].revents)
+           handle_ready (&ctx[idx[i]], fds[i].revents);
+      else check_timeout (&ctx[idx[i]], bench_time());
+    }
+  }
+
+  if (halt_flag > 0)  /* SIGINT caught */
+     C_puts ("~0");
+
+  FREE (fds);
+  FREE (idx);
+}
+
+/**
+ * Common stuff done before both a blocking and non-blocking `connect()`.
+ *
+ * \param[in] ctx          the context we work with.
+ * \param[in] which_state  the name of the state we're about to enter after this call
+ *                         (for ETP_tracef() only).
+ */
+static void connect_common_init (struct state_CTX *ctx, const char *which_state)
+{
+  int  rx_size;
+
+  ETP_tracef (ctx, "In %s(). use_netrc: %d, use_authinfo: %d, opt.use_nonblock_io: %d\n",
+              which_state, ctx->use_netrc, ctx->use_authinfo, opt.use_nonblock_io);
+
+  if (opt.use_buffered_io)
+       rx_size = (int) ctx->recv.size;
+  else rx_size = MAX_RECV_BUF;
+
+  ctx->sa.sin_family = AF_INET;
+  ctx->sa.sin_port   = htons (ctx->port);
+  setsockopt (ctx->sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&ctx->timeout, sizeof(ctx->timeout));
+  setsockopt (ctx->sock, SOL_SOCKET, SO_RCVBUF, (const char*)&rx_size, sizeof(rx_size));
+
+  if (!opt.quiet && !ctx->async)
+     C_printf ("Connecting to %s/%u...", inet_ntoa(ctx->sa.sin_addr), ctx->port);
+
+  C_flush();
+}
+
+/**
+ * Common stuff done after both state_blocking_connect() and
+ * state_non_blocking_connect().
+ *
+ * \param[in] ctx  the context we work with.
+ * \param[in] err  If `!0`, this is the error-code from the last Winsock called prior to entering here.<br>
+ *                 If `0`, the last Winsock called prior to entering here, succeeded (we got connected).
+ */
+static void connect_common_final (struct state_CTX *ctx, int err)
+{
+  if (err)  /* The connection failed */
+  {
+    char buf [500];
 
     ctx->ws_err = err;
     snprintf (buf, sizeof(buf), "Failed to connect: %s.\n", ws_strerror(ctx->ws_err));
@@ -1218,7 +1813,7 @@ static void connect_common_final (struct state_CTX *ctx, int err)
   }
   else
   {
-    if (!opt.quiet)
+    if (!opt.quiet && !ctx->async)
        C_putc ('\n');
     ctx->state = state_send_login;
   }
@@ -1288,11 +1883,13 @@ static const char *ETP_state_name (ETP_state f)
   IF_VALUE (state_blocking_connect);
   IF_VALUE (state_non_blocking_connect);
   IF_VALUE (state_send_login);
+  IF_VALUE (state_await_welcome);
   IF_VALUE (state_send_pass);
   IF_VALUE (state_await_features);
   IF_VALUE (state_await_login);
   IF_VALUE (state_200);
   IF_VALUE (state_send_query);
+  IF_VALUE (state_query_done);
   IF_VALUE (state_RESULT_COUNT);
   IF_VALUE (state_PATH);
   IF_VALUE (state_closing);
@@ -1300,31 +1897,659 @@ static const char *ETP_state_name (ETP_state f)
   return ("?");
 }
 
+/**
+ * Append `len` bytes to `buf`.
+ *
+ * \param[in] buf   the buffer to append to.
+ * \param[in] data  the bytes to append.
+ * \param[in] len   the number of bytes.
+ */
+static void buf_add (struct TX_buf *buf, const void *data, size_t len)
+{
+  if (buf->len + len > buf->size)
+  {
+    buf->size   = 2 * buf->size + len;
+    buf->buffer = REALLOC (buf->buffer, buf->size);
+  }
+  memcpy (buf->buffer + buf->len, data, len);
+  buf->len += len;
+}
+
+/**
+ * Append `val` to `buf` as a variable length number; 7 bits in each byte.
+ * Most numbers in the ETP result cache needs only 1 or 2 bytes.
+ *
+ * \param[in] buf  the buffer to append to.
+ * \param[in] val  the number to append.
+ */
+static void buf_add_varint (struct TX_buf *buf, UINT64 val)
+{
+  BYTE   tmp [10];
+  size_t len = 0;
+
+  while (val >= 0x80)
+  {
+    tmp [len++] = (BYTE) (val | 0x80);
+    val >>= 7;
+  }
+  tmp [len++] = (BYTE) val;
+  buf_add (buf, tmp, len);
+}
+
+/**
+ * Get a number added by `buf_add_varint()`.
+ *
+ * \param[in,out] p    the position to get it from. Set to the next position.
+ * \param[in]     end  the end of the data.
+ * \param[out]    val  the number.
+ * \retval        false if the number is truncated.
+ */
+static bool get_varint (const BYTE **p, const BYTE *end, UINT64 *val)
+{
+  int shift;
+
+  *val = 0;
+  for (shift = 0; *p < end && shift < 64; shift += 7)
+  {
+    BYTE b = *(*p)++;
+
+    *val |= (UINT64) (b & 0x7F) << shift;
+    if (!(b & 0x80))
+       return (true);
+  }
+  return (false);
+}
+
+/**
+ * Return the search-string sent for a query.
+ *
+ * \param[in] query  0 for `opt.file_spec`, 1.. for the file-specs in `opt.evry_specs`.
+ */
+static const char *query_search (int query)
+{
+  if (opt.evry_raw && query == 0)
+     return evry_raw_query();
+  return query_spec (query);
+}
+
+/**
+ * Make the key of `ctx` in the ETP result cache.
+ *
+ * It's the host-spec (with the user-name, but never the password), the options
+ * that change the results from the host and the search-string of each query.
+ * The host may filter the results by account; hence `user@host` and `host` are
+ * different keys.
+ *
+ * \param[in] ctx  the context we work with.
+ * \retval    the allocated key.
+ */
+static char *ETP_cache_key (const struct state_CTX *ctx)
+{
+  const char *host = strrchr (ctx->raw_url, '@');
+  char        user [sizeof(ctx->username)] = "";
+  char       *key, *p;
+  size_t      size;
+  int         query;
+
+  if (host)
+  {
+    size_t len = strcspn (ctx->raw_url, ":@");
+
+    _strlcpy (user, ctx->raw_url, min(len + 1, sizeof(user)));
+    host++;
+  }
+  else
+    host = ctx->raw_url;
+
+  size = strlen (user) + strlen (host) + 100;
+  for (query = 0; query < ctx->num_queries; query++)
+      size += strlen (query_search(query)) + 1;
+
+  key = MALLOC (size);
+  p = key + snprintf (key, size, "%s%s%s\nraw=%d,regex=%d,case=%d,size=%d,sort=%d",
+                      user, user[0] ? "@" : "", host, opt.evry_raw, opt.use_regex,
+                      opt.case_sensitive, opt.show_size, opt.sort_methods[0]);
+
+  for (query = 0; query < ctx->num_queries; query++)
+      p += snprintf (p, size - (p - key), "\n%s", query_search(query));
+  return (key);
+}
+
+/**
+ * Return the name of the ETP result cache-file.
+ * `ETP.cache_file` in the config-file or `%TEMP%\envtool-etp.cache`.
+ */
+static const char *ETP_cache_file (void)
+{
+  if (!opt.evry_cache_file)
+     opt.evry_cache_file = getenv_expand2 ("%TEMP%\\envtool-etp.cache");
+  return (opt.evry_cache_file);
+}
+
+/**
+ * Read the ETP result cache-file into `cache_entries`.
+ *
+ * The file starts with `ETP_CACHE_MAGIC` and a `ETP_CACHE_VERSION` byte.
+ * Then each entry is:
+ * \code
+ *   varint: length of key, the key
+ *   varint: time_t created
+ *   varint: length of data, the data (see ETP_cache_put())
+ * \endcode
+ *
+ * The reading stops at a truncated entry.
+ */
+static void ETP_cache_load (void)
+{
+  const char *file = ETP_cache_file();
+  const BYTE *p, *end;
+  char       *buf;
+  size_t      size = 0;
+
+  cache_entries = smartlist_new();
+  buf = file ? fopen_mem (file, &size) : NULL;
+  if (!buf)
+     return;
+
+  p   = (const BYTE*) buf;
+  end = p + size;
+  if (size < sizeof(ETP_CACHE_MAGIC) || memcmp(p, ETP_CACHE_MAGIC, 4) || p[4] != ETP_CACHE_VERSION)
+  {
+    TRACE (1, "%s is not a version %d ETP result cache-file.\n", file, ETP_CACHE_VERSION);
+    FREE (buf);
+    return;
+  }
+
+  p += sizeof(ETP_CACHE_MAGIC);
+  while (p < end)
+  {
+    struct ETP_cache_entry *ce;
+    const BYTE *key;
+    UINT64      key_len, created, len;
+
+    if (!get_varint(&p, end, &key_len) || key_len > (UINT64)(end - p))
+       break;
+
+    key = p;
+    p += key_len;
+    if (!get_varint(&p, end, &created) || !get_varint(&p, end, &len) || len > (UINT64)(end - p))
+       break;
+
+    ce = MALLOC (sizeof(*ce));
+    ce->key = MALLOC ((size_t)key_len + 1);
+    memcpy (ce->key, key, (size_t)key_len);
+    ce->key [key_len] = '\0';
+    ce->created = (time_t) created;
+    ce->len  = (size_t) len;
+    ce->data = MALLOC (ce->len + 1);
+    memcpy (ce->data, p, ce->len);
+    smartlist_add (cache_entries, ce);
+    p += len;
+  }
+  TRACE (1, "Read %d entries from %s.\n", smartlist_len(cache_entries), file);
+  FREE (buf);
+}
+
+/**
+ * Write `cache_entries` to the ETP result cache-file. Skip the expired entries.
+ *
+ * Write to `<file>.tmp` first and rename it when all is written.
+ * So a crash while writing cannot leave a truncated cache-file.
+ */
+static void ETP_cache_write (void)
+{
+  const char *file = ETP_cache_file();
+  char        tmp [_MAX_PATH];
+  time_t      now = time (NULL);
+  FILE       *f = NULL;
+  bool        okay;
+  int         i, max, num = 0;
+
+  if (file)
+  {
+    snprintf (tmp, sizeof(tmp), "%s.tmp", file);
+    f = fopen (tmp, "wb");
+  }
+  if (!f)
+  {
+    TRACE (1, "Failed to write %s.\n", file ? tmp : "the ETP result cache-file");
+    return;
+  }
+
+  fwrite (ETP_CACHE_MAGIC, 1, sizeof(ETP_CACHE_MAGIC) - 1, f);
+  fputc (ETP_CACHE_VERSION, f);
+
+  max = smartlist_len (cache_entries);
+  for (i = 0; i < max; i++)
+  {
+    const struct ETP_cache_entry *ce = smartlist_get (cache_entries, i);
+    struct TX_buf hdr;
+
+    if (now - ce->created >= (time_t)opt.evry_cache_ttl)
+       continue;
+
+    memset (&hdr, '\0', sizeof(hdr));
+    buf_add_varint (&hdr, strlen(ce->key));
+    buf_add (&hdr, ce->key, strlen(ce->key));
+    buf_add_varint (&hdr, (UINT64) ce->created);
+    buf_add_varint (&hdr, ce->len);
+    fwrite (hdr.buffer, 1, hdr.len, f);
+    fwrite (ce->data, 1, ce->len, f);
+    FREE (hdr.buffer);
+    num++;
+  }
+
+  okay = !ferror (f);
+  if (fclose(f) != 0)
+     okay = false;
+
+  if (!okay)
+  {
+    TRACE (1, "Failed to write %s.\n", tmp);
+    DeleteFile (tmp);
+    return;
+  }
+  if (!MoveFileEx(tmp, file, MOVEFILE_REPLACE_EXISTING))
+  {
+    TRACE (1, "Failed to rename %s -> %s; %s.\n", tmp, file, win_strerror(GetLastError()));
+    DeleteFile (tmp);
+    return;
+  }
+  TRACE (1, "Wrote %d entries to %s.\n", num, file);
+}
+
+/**
+ * Find the entry for `key` in the ETP result cache.
+ * Read the cache-file on the first call.
+ *
+ * \param[in] key  the key from `ETP_cache_key()`.
+ * \retval    the entry or `NULL`.
+ */
+static struct ETP_cache_entry *ETP_cache_find (const char *key)
+{
+  int i, max;
+
+  if (!cache_entries)
+     ETP_cache_load();
+
+  max = smartlist_len (cache_entries);
+  for (i = 0; i < max; i++)
+  {
+    struct ETP_cache_entry *ce = smartlist_get (cache_entries, i);
+
+    if (!strcmp(ce->key, key))
+       return (ce);
+  }
+  return (NULL);
+}
+
+/**
+ * Print what a live query prints before the results. On a hit in the
+ * ETP result cache there is no session to print it.
+ *
+ * The host-spec is cracked and the `~/.netrc` or `~/.authinfo` lookups are
+ * done as in a live query; they may print a warning. The other lines are
+ * printed from what the live query saved in the cache.
+ *
+ * \param[in] ctx       the context we work with.
+ * \param[in] resolved  the live query resolved `ctx->hostname`.
+ * \param[in] addr      the IPv4-address the live query connected to.
+ * \param[in] port      the port the live query connected to.
+ */
+static void ETP_cache_progress (struct state_CTX *ctx, bool resolved, DWORD addr, uint16_t port)
+{
+  const BYTE *a = (const BYTE*) &addr;
+  ETP_state   state = ctx->state;
+
+  if (opt.quiet)
+     return;
+
+  state_parse_url (ctx);
+  while (ctx->state == state_netrc_lookup || ctx->state == state_authinfo_lookup)
+     (*ctx->state) (ctx);
+  ctx->state = state;
+
+  if (resolved)
+     C_printf ("Resolving %s...\r", ctx->hostname);
+  if (!ctx->async)
+     C_printf ("Connecting to %u.%u.%u.%u/%u...\n", a[0], a[1], a[2], a[3], port);
+  C_flush();
+}
+
+/**
+ * Look for the results of `ctx` in the ETP result cache.
+ * On a hit, save them in `ctx->results` as if they were just received. <br>
+ * Not used with option `--refresh`.
+ *
+ * \param[in] ctx  the context we work with.
+ * \retval    true on a hit. `ctx` is then done and the results can be
+ *            printed by `report_results()`.
+ */
+static bool ETP_cache_get (struct state_CTX *ctx)
+{
+  const struct ETP_cache_entry *ce;
+  const BYTE *p, *end;
+  char        file [_MAX_PATH+2];
+  size_t      file_len = 0;
+  UINT64      i, num, query, fsize, mtime, prefix, len, addr, port;
+  time_t      now = time (NULL);
+  bool        resolved;
+
+  if (!ctx->cache_key || opt.evry_refresh)
+     return (false);
+
+  ce = ETP_cache_find (ctx->cache_key);
+  if (!ce || ce->created > now || now - ce->created >= (time_t)opt.evry_cache_ttl)
+     return (false);
+
+  p   = ce->data;
+  end = p + ce->len;
+  if (p >= end)
+     return (false);
+
+  resolved = (*p++ != 0);
+  if (!get_varint(&p, end, &addr) || !get_varint(&p, end, &port) || !get_varint(&p, end, &num))
+     return (false);
+
+  for (i = 0; i < num; i++)
+  {
+    bool is_dir;
+
+    if (!get_varint(&p, end, &query) || query >= (UINT64)ctx->num_queries || p >= end)
+       break;
+
+    is_dir = (*p++ != 0);
+    if (!get_varint(&p, end, &fsize) || !get_varint(&p, end, &mtime) ||
+        !get_varint(&p, end, &prefix) || !get_varint(&p, end, &len) ||
+        prefix > file_len || prefix + len >= sizeof(file) || len > (UINT64)(end - p))
+       break;
+
+    memcpy (file + prefix, p, (size_t)len);
+    file_len = (size_t) (prefix + len);
+    file [file_len] = '\0';
+    p += len;
+
+    save_result (ctx, file, (time_t)mtime, fsize, is_dir, (int)query);
+    if (opt.dir_mode && !is_dir)
+       ctx->results_ignore++;
+  }
+
+  if (i < num)
+  {
+    TRACE (1, "Corrupt ETP result cache entry for %s.\n", ctx->raw_url);
+    smartlist_free (ctx->results);
+    ctx->results = smartlist_new_arena();
+    ctx->results_ignore = 0;
+    return (false);
+  }
+
+  TRACE (1, "%s: %u results from the ETP result cache; %d sec old.\n",
+         ctx->raw_url, (unsigned)num, (int)(now - ce->created));
+
+  ETP_cache_progress (ctx, resolved, (DWORD)addr, (uint16_t)port);
+
+  ctx->results_got = (unsigned) num;
+  ctx->query    = ctx->num_queries;
+  ctx->cached   = true;
+  ctx->done     = true;
+  ctx->end_time = bench_time();
+  return (true);
+}
+
+/**
+ * Save the results of `ctx` in the ETP result cache.
+ * Only if every query got all it's results.
+ *
+ * The results are encoded as:
+ * \code
+ *   byte:   ctx->resolved
+ *   varint: the IPv4-address connected to
+ *   varint: the port connected to
+ *   varint: the number of results
+ * \endcode
+ *
+ * Followed by these for each result:
+ * \code
+ *   varint: query
+ *   byte:   is_dir
+ *   varint: fsize
+ *   varint: mtime
+ *   varint: length of the prefix shared with the previous name
+ *   varint: length of the rest of the name, the rest of the name
+ * \endcode
+ *
+ * The results of a query mostly share the folder of the previous result.
+ * Hence the names takes little room.
+ *
+ * \param[in] ctx  the context we work with.
+ */
+static void ETP_cache_put (struct state_CTX *ctx)
+{
+  struct ETP_cache_entry *ce;
+  struct TX_buf buf;
+  const char   *prev = "";
+  BYTE          resolved;
+  int           i, max;
+
+  if (!ctx->cache_key || ctx->cached || ctx->short_results ||
+      ctx->query < ctx->num_queries || halt_flag > 0)
+     return;
+
+  memset (&buf, '\0', sizeof(buf));
+  resolved = ctx->resolved;
+  buf_add (&buf, &resolved, 1);
+  buf_add_varint (&buf, ctx->sa.sin_addr.s_addr);
+  buf_add_varint (&buf, ctx->port);
+
+  max = smartlist_len (ctx->results);
+  buf_add_varint (&buf, max);
+
+  for (i = 0; i < max; i++)
+  {
+    const struct ETP_result *res = smartlist_get (ctx->results, i);
+    BYTE   is_dir = res->is_dir;
+    size_t prefix = 0, len;
+
+    while (prev[prefix] && prev[prefix] == res->file[prefix])
+       prefix++;
+    len = strlen (res->file + prefix);
+
+    buf_add_varint (&buf, res->query);
+    buf_add (&buf, &is_dir, 1);
+    buf_add_varint (&buf, res->fsize);
+    buf_add_varint (&buf, (UINT64) res->mtime);
+    buf_add_varint (&buf, prefix);
+    buf_add_varint (&buf, len);
+    buf_add (&buf, res->file + prefix, len);
+    prev = res->file;
+  }
+
+  ce = ETP_cache_find (ctx->cache_key);
+  if (ce)
+     FREE (ce->data);
+  else
+  {
+    ce = MALLOC (sizeof(*ce));
+    ce->key = STRDUP (ctx->cache_key);
+    smartlist_add (cache_entries, ce);
+  }
+  ce->created = time (NULL);
+  ce->data    = (BYTE*) buf.buffer;
+  ce->len     = buf.len;
+  cache_dirty = true;
+  TRACE (1, "%s: %d results saved in the ETP result cache; %u bytes.\n",
+         ctx->raw_url, max, (unsigned)buf.len);
+}
+
+/**
+ * Write the ETP result cache-file if it was changed. And free `cache_entries`.
+ */
+static void ETP_cache_exit (void)
+{
+  int i, max = cache_entries ? smartlist_len (cache_entries) : 0;
+
+  if (cache_dirty)
+     ETP_cache_write();
+
+  for (i = 0; i < max; i++)
+  {
+    struct ETP_cache_entry *ce = smartlist_get (cache_entries, i);
+
+    FREE (ce->key);
+    FREE (ce->data);
+    FREE (ce);
+  }
+  smartlist_free (cache_entries);
+  cache_entries = NULL;
+  cache_dirty = false;
+}
+
+/**
+ * Initialise the context for a query to `host`.
+ *
+ * \param[in] ctx    the context to initialise.
+ * \param[in] host   the host-spec. E.g. `"user:passwd@host:port"`.
+ * \param[in] async  if `true`, it will run in `run_state_machines()`.
+ */
+static void ETP_ctx_init (struct state_CTX *ctx, const char *host, bool async)
+{
+  memset (ctx, 0, sizeof(*ctx));
+  ctx->state             = state_init;
+  ctx->sock              = INVALID_SOCKET;
+  ctx->timeout           = RECV_TIMEOUT;
+  ctx->raw_url           = STRDUP (host);
+  ctx->port              = 0;
+  ctx->trace.buffer[0]   = '?';
+  ctx->trace.buffer[1]   = '\0';
+  ctx->trace.buffer_pos  = ctx->trace.buffer;
+  ctx->trace.buffer_left = sizeof(ctx->trace.buffer);
+  ctx->recv.buffer       = MALLOC (RX_BUF_SIZE);
+  ctx->recv.size         = RX_BUF_SIZE;
+  ctx->async             = async;
+  ctx->start_time        = bench_time();
+  ctx->num_queries       = 1 + (opt.evry_specs ? smartlist_len (opt.evry_specs) : 0);
+  if (opt.evry_cache_ttl > 0)
+     ctx->cache_key = ETP_cache_key (ctx);
+  if (async || ctx->cache_key)
+     ctx->results = smartlist_new_arena();
+}
+
+/**
+ * Save the timing of the host in `host_times` and free the context.
+ *
+ * \param[in] ctx  the context we're done with.
+ * \retval    the number of results for this host.
+ */
+static int ETP_ctx_done (struct state_CTX *ctx)
+{
+  struct ETP_host_time *ht = MALLOC (sizeof(*ht));
+
+  ht->host    = ctx->raw_url;
+  ht->time    = (ctx->done ? ctx->end_time : bench_time()) - ctx->start_time;
+  ht->results = ctx->results_got - ctx->results_ignore;
+  ht->ws_err  = ctx->ws_err;
+
+  if (!host_times)
+     host_times = smartlist_new();
+  smartlist_add (host_times, ht);
+
+  smartlist_free (ctx->results);
+  FREE (ctx->recv.buffer);
+  FREE (ctx->cache_key);
+  return (ht->results);
+}
+
+/**
+ * Query one ETP-host.
+ */
+int do_check_evry_ept (const char *host)
+{
+  struct state_CTX ctx;  /* Uses approx. 17300 bytes of stack */
+
+  ETP_ctx_init (&ctx, host, false);
+  if (ETP_cache_get(&ctx))
+     report_results (&ctx);
+  else
+  {
+    run_state_machine (&ctx);
+    ETP_cache_put (&ctx);
+  }
+  return ETP_ctx_done (&ctx);
+}
+
 /**
  * Called from `envtool.c`:
  *   if the `opt.evry_host` smartlist is not empty, this function gets called
- *   for each ETP-host in the smartlist.
+ *   to query all the ETP-hosts in the smartlist.
+ *
+ * A single host is queried by `run_state_machine()` as before.
+ * Several hosts are queried together by `run_state_machines()`.
+ * In both cases the results of each host are reported as a block
+ * under a `"Matches from host:"` header.
+ *
+ * \param[in] hosts  the smartlist of host-specs.
+ * \retval    the total number of results.
  */
-int do_check_evry_ept (const char *host)
+int do_check_evry_ept_hosts (const smartlist_t *hosts)
 {
-  struct state_CTX ctx;  /* Uses approx. 33750 bytes of stack */
-  char   host_buf [100];
+  struct state_CTX *ctx;
+  int    i, max = smartlist_len (hosts);
+  int    found = 0;
 
-  memset (&ctx, 0, sizeof(ctx));
-  ctx.state             = state_init;
-  ctx.sock              = INVALID_SOCKET;
-  ctx.timeout           = RECV_TIMEOUT;
-  ctx.raw_url           = _strlcpy (host_buf, host, sizeof(host_buf));
-  ctx.port              = 0;
-  ctx.trace.buffer[0]   = '?';
-  ctx.trace.buffer[1]   = '\0';
-  ctx.trace.buffer_pos  = ctx.trace.buffer;
-  ctx.trace.buffer_left = sizeof(ctx.trace.buffer);
-  ctx.recv.buffer_pos   = ctx.recv.buffer;
-  ctx.recv.buffer_left  = 0;    /* Gets set in `rbuf_read_char()' */
+  if (max == 1)
+     return do_check_evry_ept (smartlist_get(hosts, 0));
 
-  run_state_machine (&ctx);
-  return (ctx.results_got - ctx.results_ignore);
+  ctx = CALLOC (max, sizeof(*ctx));  /* Approx. 17300 bytes for each host */
+  for (i = 0; i < max; i++)
+  {
+    ETP_ctx_init (&ctx[i], smartlist_get(hosts, i), true);
+    ETP_cache_get (&ctx[i]);
+  }
+
+  run_state_machines (ctx, max);
+
+  for (i = 0; i < max; i++)
+      found += ETP_ctx_done (&ctx[i]);
+  FREE (ctx);
+  return (found);
+}
+
+/**
+ * Print the time spent on each ETP-host in `report_final()`.
+ */
+void ETP_report_hosts (void)
+{
+  int i, max = host_times ? smartlist_len (host_times) : 0;
+
+  for (i = 0; i < max; i++)
+  {
+    const struct ETP_host_time *ht = smartlist_get (host_times, i);
+
+    C_printf ("\n  %s: %s %s in %.3f sec.", ht->host, str_dword(ht->results),
+              str_plural(ht->results, "match", "matches"), ht->time);
+    if (ht->ws_err)
+       C_printf (" (%s)", ws_strerror(ht->ws_err));
+  }
+}
+
+/**
+ * Free the memory allocated for the `host_times`.
+ * And write the ETP result cache-file.
+ */
+void ETP_exit (void)
+{
+  int i, max = host_times ? smartlist_len (host_times) : 0;
+
+  for (i = 0; i < max; i++)
+  {
+    struct ETP_host_time *ht = smartlist_get (host_times, i);
+
+    FREE (ht->host);
+    FREE (ht);
+  }
+  smartlist_free (host_times);
+  host_times = NULL;
+  ETP_cache_exit();
 }
 
 static int parse_host_spec (struct state_CTX *ctx, const char *pattern, ...)
@@ -1347,16 +2572,17 @@ static int parse_host_spec (struct state_CTX *ctx, const char *pattern, ...)
 }
 
 /**
- * Read at most `sizeof(ctx->recv.buffer)` bytes from `ctx->sock`,
- * storing them to `ctx->recv.buffer`. This uses `select()` to timeout
- * a stale connection.
+ * Read at most `len` bytes from `ctx->sock` into `buf`.
+ * This uses `select()` to timeout a stale connection.
  *
  * \param[in] ctx  the context we work with.
+ * \param[in] buf  where to store the data.
+ * \param[in] len  the size of `buf`.
  *
  * \note Winsock ignores the first argument in `select()`.
  *       All needed information is really in the `fd_set`s. <br>
  */
-static int rbuf_read_sock (struct state_CTX *ctx)
+static int rbuf_read_sock (struct state_CTX *ctx, char *buf, size_t len)
 {
   if (ctx->timeout)
   {
@@ -1369,42 +2595,65 @@ static int rbuf_read_sock (struct state_CTX *ctx)
     FD_SET (ctx->sock, &rd_fds);
     FD_SET (ctx->sock, &ex_fds);
     tv.tv_sec  = ctx->timeout / 1000;
-    tv.tv_usec = ctx->timeout % 1000;
+    tv.tv_usec = 1000 * (ctx->timeout % 1000);
     rc = (int) select ((int)(ctx->sock+1), &rd_fds, NULL, &ex_fds, &tv);
     if (rc <= 0)
        return (rc);
   }
-  return recv (ctx->sock, ctx->recv.buffer, sizeof(ctx->recv.buffer), 0);
+  return recv (ctx->sock, buf, (int)len, 0);
 }
 
 /**
- * Read a character from `ctx->recv.buffer`.
+ * Receive more data into `ctx->recv.buffer`.
  *
- * \param[in] ctx    the context we work with.
- * \param[in] store  the location to store the buffered or first received character to.
+ * First move a partial line (if any) to the start of the buffer.
+ * Always keep 1 byte free for the `NUL` that `recv_line()` adds.
+ *
+ * For a `ctx->async` host, the socket is non-blocking and `run_state_machines()`
+ * knows there is something to receive. So simply call `recv()`.
+ *
+ * \param[in] ctx  the context we work with.
+ * \retval    false on a timeout, an error, a closed connection or if
+ *            the buffer is full with one partial line.
  */
-static int rbuf_read_char (struct state_CTX *ctx, char *store)
+static bool rbuf_fill (struct state_CTX *ctx)
 {
-  if (ctx->recv.buffer_left == 0)
+  struct RX_buf *rx = &ctx->recv;
+  int            num;
+
+  if (rx->head > 0)
   {
-    /**
-     * If nothing left in 'ctx->recv.buffer', refill the buffer
-     *  calling `rbuf_read_sock()`.
+    memmove (rx->buffer, rx->buffer + rx->head, rx->tail - rx->head);
+    rx->tail -= rx->head;
+    rx->head  = 0;
+  }
+  if (rx->tail >= rx->size - 1)
+  {
+    rx->eof = true;
+    return (false);
+  }
+
+  if (ctx->async)
+       num = recv (ctx->sock, rx->buffer + rx->tail, (int)(rx->size - 1 - rx->tail), 0);
+  else if (opt.use_buffered_io)
+       num = rbuf_read_sock (ctx, rx->buffer + rx->tail, rx->size - 1 - rx->tail);
+  else num = recv (ctx->sock, rx->buffer + rx->tail, 1, 0);
+
+  if (num <= 0)
+  {
+    int err = WSAGetLastError();
+
+    /* Nothing to receive yet. Keep any 'ws_err' set in 'check_timeout()'.
      */
-    int num;
+    if (ctx->async && num < 0 && err == WSAEWOULDBLOCK)
+       return (false);
 
-    ctx->recv.buffer_pos = ctx->recv.buffer;
-    num = rbuf_read_sock (ctx);
-    if (num <= 0)
-       return (num);
-    ctx->recv.buffer_read = num;
-    ctx->recv.buffer_left = num;
+    ctx->ws_err = err;
+    rx->eof = true;
+    return (false);
   }
-
-  /**
-   * Otherwise, the character is returned from `ctx->recv.buffer_pos`.
-   */
-  *store = *ctx->recv.buffer_pos++;
-  ctx->recv.buffer_left--;
-  return (1);
+  rx->buffer_read = num;
+  rx->tail += num;
+  ETP_total_rcv += num;
+  return (true);
 }
@@ -3,7 +3,12 @@
  */
 #pragma once
 
+#include "smartlist.h"
+
 extern DWORD ETP_total_rcv;
 extern DWORD ETP_num_evry_dups;
 
-extern int do_check_evry_ept (const char *host);
+extern int  do_check_evry_ept (const char *host);
+extern int  do_check_evry_ept_hosts (const smartlist_t *hosts);
+extern void ETP_report_hosts (void);
+extern void ETP_exit (void);
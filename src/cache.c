@@ -11,6 +11,8 @@
 #include "color.h"
 #include "cache.h"
 
+#include <process.h>
+
 #ifdef USE_UBSAN
   #include <sanitizer/ubsan_interface.h>
 
@@ -33,6 +35,23 @@
 #define CACHE_HEADER_VER   "# ver. "
 #define CACHE_VERSION_NUM  1
 
+/** \def CACHE_BIN_MAGIC
+ * The first bytes of a binary cache-file. Followed by the rest of `cache_bin_header`.
+ * This is how `cache_load()` tells a binary cache-file from a text cache-file.
+ */
+#define CACHE_BIN_MAGIC    "ETCB"
+
+/** \def CACHE_BIN_VERSION
+ * The version of the binary cache-file. If we read another version, ignore the file.
+ */
+#define CACHE_BIN_VERSION  1
+
+/** \def CACHE_JOURNAL_MAX
+ * The default size of the journal-file before it is compacted into `cache.filename`.
+ * Can be changed by `cache.journal_max = N` in `envtool.cfg`.
+ */
+#define CACHE_JOURNAL_MAX  100000
+
 /** \def CACHE_MAX_KEY
  * The maximum length of a key.
  */
@@ -43,6 +62,11 @@
  */
 #define CACHE_MAX_VALUE  10000
 
+/** \def CACHE_ARENA_CHUNK
+ * The size of each chunk in `cache.arena`. A larger allocation gets a chunk of it's own.
+ */
+#define CACHE_ARENA_CHUNK  (64*1024)
+
 /** \def CACHE_MAX_ARGS
  * The number of arguments supported in `cache_vgetf()`
  */
@@ -73,13 +97,46 @@ static const search_list sections[] = {
  *
  * Each cache-node have a section number and a key/value pair.
  * If the value is a comma-string, use `_strtok_r()` to parse it.
+ *
+ * The node, the key and the value are allocated from `cache.arena`.
+ * The key is interned; all nodes with the same key share it.
  */
 typedef struct cache_node {
         CacheSections section;
-        char          key [CACHE_MAX_KEY];
+        const char   *key;       /**< from `cache_intern()` */
         char         *value;
+        bool          mapped;    /**< `value` points into the read-only `cache.mmap_buf` */
+        DWORD         hash;      /**< `cache_hash()` of `section` and `key` */
+        int           idx;       /**< the index of this node in `cache.entries` */
       } cache_node;
 
+/**
+ * \typedef cache_bin_header
+ *
+ * The header of a binary cache-file. The layout of the file is:
+ *  \li this header.
+ *  \li an index of `num_entries` `cache_bin_entry` sorted on section and key.
+ *  \li a blob of `blob_size` bytes with the 0-terminated keys and values.
+ */
+typedef struct cache_bin_header {
+        char     magic [4];      /**< `CACHE_BIN_MAGIC` */
+        DWORD    version;        /**< `CACHE_BIN_VERSION` */
+        DWORD    num_entries;    /**< number of `cache_bin_entry` following this header */
+        DWORD    blob_size;      /**< size of the string blob following the index */
+        FILETIME written;        /**< when the file was written */
+      } cache_bin_header;
+
+/**
+ * \typedef cache_bin_entry
+ *
+ * One index-entry in a binary cache-file.
+ */
+typedef struct cache_bin_entry {
+        DWORD section;           /**< the `CacheSections` of this entry */
+        DWORD key_ofs;           /**< offset of the key in the blob */
+        DWORD value_ofs;         /**< offset of the value in the blob */
+      } cache_bin_entry;
+
 /**
  * \typedef vgetf_state
  *
@@ -100,10 +157,41 @@ typedef struct vgetf_state {
 typedef struct CACHE {
         char        *filename;               /**< File-name to write `cache.entries` to in `cache_write()`. */
         char        *filename_prev;          /**< Copy current `cache.filename` to this before writing out the cache. */
-        smartlist_t *entries;                /**< Actual cache content; smartlist of `struct cache_node`. */
+        char         filename_tmp [_MAX_PATH]; /**< `cache_write()` writes to this file. Renamed to `cache.filename` in `cache_exit()`. */
+        CacheFormat  format;                 /**< The format to write in `cache_write()`. */
+        CacheFormat  loaded_format;          /**< The format of the file read in `cache_load()`. */
+        HANDLE       mmap_hnd;               /**< The mapping-handle of a binary cache-file. */
+        const char  *mmap_buf;               /**< The read-only view of a binary cache-file. */
+        bool         journal;                /**< Append changes to `cache.journal_name` instead of rewriting `cache.filename`. */
+        char         journal_name [_MAX_PATH]; /**< The journal-file; `<cache.filename>.journal`. */
+        smartlist_t *changes;                /**< The `cache_put()` and `cache_del()` done in this run. A `cache_node` with no `value` is a delete. */
+        char         lock_name [_MAX_PATH];  /**< The lock-file; `<cache.filename>.lock`. */
+        HANDLE       lock_hnd;               /**< The handle of `cache.lock_name` while locked. */
+        bool         locked;                 /**< `cache_lock()` succeeded. */
+        bool         merged;                 /**< `cache_merge()` was called. */
+        DWORD        journal_max;            /**< Compact the journal into `cache.filename` when it grows above this size. */
+        DWORD        journal_size;           /**< The size of the journal-file. Including what was appended in this run. */
+        DWORD        replayed;               /**< Number of journal-records applied in `cache_journal_replay()`. */
+        bool         replaying;              /**< Do not journal the changes done while replaying. */
+        smartlist_t *entries;                /**< Actual cache content; smartlist of `struct cache_node`. Sorted only in `cache_sort()`. */
+        cache_node **hash_table;             /**< The hash-index of `cache.entries`. Open addressing with linear probing. */
+        DWORD        hash_size;              /**< Size of `cache.hash_table`; a power of 2. */
+        DWORD        hash_used;              /**< Number of nodes in `cache.hash_table`. */
         DWORD        hits, misses;           /**< Simple cache statistics. */
-        DWORD        bsearches;
-        DWORD        bsearches_per_key;
+        DWORD        lookups;                /**< Number of calls to `cache_lookup()` with a `cache.hash_table`. */
+        DWORD        probes;                 /**< Total number of hash-slots looked at in these. */
+        DWORD        max_probes;             /**< The longest probe-sequence in these. */
+        DWORD        resizes;                /**< Number of times `cache.hash_table` has grown. */
+        smartlist_t *arena;                  /**< The chunks holding all nodes, keys and values. Freed in `cache_arena_free()`. */
+        char        *arena_ptr;              /**< The next free byte in the last chunk. */
+        size_t       arena_left;             /**< Bytes left in the last chunk. */
+        size_t       arena_size;             /**< Total size of all chunks. */
+        size_t       arena_used;             /**< Total bytes allocated from the chunks. */
+        const char **intern_table;           /**< The set of interned keys. Open addressing with linear probing. */
+        DWORD        intern_size;            /**< Size of `cache.intern_table`; a power of 2. */
+        DWORD        intern_used;            /**< Number of keys in `cache.intern_table`. */
+        DWORD        intern_hits;            /**< Number of times `cache_intern()` found a key already there. */
+        smartlist_t *free_nodes;             /**< Nodes deleted in `cache_del()`; reused in `cache_alloc_node()`. */
         DWORD        appended;               /**< Number of calls to `cache_append()`. */
         DWORD        inserted;               /**< Number of calls to `cache_insert()`. */
         DWORD        deleted;                /**< Number of calls to `cache_del()`. */
@@ -116,10 +204,19 @@ static CACHE cache;
 
 static void cache_sort (void);
 static void cache_free_node (void *_c);
-static void cache_append (CacheSections section, const char *key, const char *value);
-static bool cache_parse (FILE *f);
-static void cache_write (void);
+static void cache_append (CacheSections section, const char *key, const char *value, bool mapped);
+static bool cache_load (const char *file);
+static bool cache_write (void);
+static void cache_unmap (void);
 static void cache_report (int num);
+static void cache_journal_replay (void);
+static bool cache_journal_flush (void);
+static bool cache_journal_close (void);
+static void cache_hash_free (void);
+static void cache_arena_free (void);
+static void cache_lock (bool exclusive);
+static void cache_unlock (void);
+static void cache_merge (void);
 
 /**
  * Initialise the cache-functions:
@@ -130,8 +227,7 @@ static void cache_report (int num);
  */
 void cache_init (void)
 {
-  FILE *f;
-  int   n;
+  int n;
 
   if (cache.entries ||    /* Already done this */
       !cache.filename)    /* cache_config() not called or key/value was missing */
@@ -145,15 +241,19 @@ void cache_init (void)
      FATAL ("'DIM(sections) == %d' too small. Should be: %d.\n", DIM(sections), SECTION_LAST);
 
   cache.entries = smartlist_new();
+  cache.loaded_format = cache.format;
 
-  f = fopen (cache.filename, "rt");
-  if (!f)
-  {
-    TRACE (1, "Failed to open %s; %s.\n", cache.filename, strerror(errno));
-    return;
-  }
-  cache_parse (f);
-  fclose (f);
+  snprintf (cache.journal_name, sizeof(cache.journal_name), "%s.journal", cache.filename);
+  snprintf (cache.lock_name, sizeof(cache.lock_name), "%s.lock", cache.filename);
+  if (cache.journal_max == 0)
+     cache.journal_max = CACHE_JOURNAL_MAX;
+
+  /* Another process could be replacing `cache.filename` or appending to the journal-file.
+   */
+  cache_lock (false);
+  cache_load (cache.filename);
+  cache_journal_replay();
+  cache_unlock();
 }
 
 /**
@@ -161,30 +261,69 @@ void cache_init (void)
  *   \li Report cache statistics if `opt.debug >= 1`.
  *   \li Write the cache entries to file if the cached information has changed.
  *   \li Free all memory allocated here.
+ *
+ * All this is done while holding the exclusive lock. So other processes using the
+ * same `cache.filename` will not lose their changes or see a half-written journal.
  */
 void cache_exit (void)
 {
-  int i, num = 0;
+  bool written = false;
+  bool compact;
+  int  i, num = 0;
 
-  if (!cache.testing && cache.entries && cache.filename)
+  cache_lock (true);
+  compact = cache_journal_close();
+
+  if (!cache.testing && cache.entries && cache.filename && compact)
   {
+    if (cache.changes || cache.replayed > 0 || cache.format != cache.loaded_format)
+       cache_merge();
     cache_sort();
-    cache_write();
+    written = cache_write();
   }
 
   for (i = 0; i < DIM(cache.state); i++)
       FREE (cache.state[i].value);
-  FREE (cache.filename);
-  FREE (cache.filename_prev);
 
   if (cache.entries)
   {
     num = smartlist_len (cache.entries);
     cache_report (num);
-    smartlist_wipe (cache.entries, cache_free_node);
-    smartlist_free (cache.entries);
+    smartlist_free (cache.entries);   /* The nodes are freed in 'cache_arena_free()' */
     cache.entries = NULL;
   }
+  cache_hash_free();
+
+  /* The view of a binary `cache.filename` must be closed before it can be replaced.
+   */
+  cache_unmap();
+
+  if (written && !MoveFileEx(cache.filename_tmp, cache.filename, MOVEFILE_REPLACE_EXISTING))
+  {
+    TRACE (1, "Failed to rename %s -> %s; %s.\n",
+           cache.filename_tmp, cache.filename, win_strerror(GetLastError()));
+    DeleteFile (cache.filename_tmp);
+
+    /* E.g. another process has a view of a binary `cache.filename`.
+     * Do not lose the changes; the next process will replay them.
+     */
+    if (!cache.journal)
+       cache_journal_flush();
+  }
+  else if (written && cache.journal_name[0])
+  {
+    /* All the journal-records are now in `cache.filename`.
+     */
+    DeleteFile (cache.journal_name);
+  }
+  cache_unlock();
+
+  smartlist_free (cache.changes);
+  cache.changes = NULL;
+  cache_arena_free();
+
+  FREE (cache.filename);
+  FREE (cache.filename_prev);
 }
 
 /**
@@ -207,13 +346,32 @@ bool cache_config (const char *key, const char *value)
     opt.use_cache = atoi (value);
     return (true);
   }
+  if (!stricmp(key, "journal"))
+  {
+    cache.journal = atoi (value);
+    return (true);
+  }
+  if (!stricmp(key, "journal_max"))
+  {
+    cache.journal_max = atoi (value);
+    return (true);
+  }
+  if (!stricmp(key, "format"))
+  {
+    if (!stricmp(value, "binary"))
+       cache.format = CACHE_FORMAT_BINARY;
+    else if (!stricmp(value, "text"))
+       cache.format = CACHE_FORMAT_TEXT;
+    else WARN ("Unknown 'cache.format = %s'. Use 'binary' or 'text'.\n", value);
+    return (true);
+  }
   return (false);
 }
 
 /**
  * Parse the `cache.filename` file and add the section/key/value entries to `cache.entries`.
- * Assume the entries are already sorted on `section` and `key`
- * (since that was done in `cache_write()` on last `cache_exit()`.)
+ * The entries are sorted on `section` and `key` (since that was done in `cache_write()`
+ * on last `cache_exit()`), but `cache.hash_table` does not depend on that.
  */
 static bool cache_parse (FILE *f)
 {
@@ -277,12 +435,172 @@ static bool cache_parse (FILE *f)
     if (found_hdr && key && value)
     {
       TRACE (3, "key: '%s', value: '%s', is_quoted: %d.\n", key, value, str_isquoted(value));
-      cache_append (curr_section, key, value);
+      cache_append (curr_section, key, value, false);
     }
   }
   return (cache.appended > 0);
 }
 
+/**
+ * Map the binary cache-file `file` into memory.
+ * The view is kept open until `cache_unmap()` since the `cache_node::value`
+ * of all nodes read from it points into this view.
+ *
+ * \param[in]  file  the file to map.
+ * \param[out] size  the size of the file.
+ * \retval the start of the read-only view or `NULL` on failure.
+ */
+static const char *cache_mmap (const char *file, size_t *size)
+{
+  HANDLE        hnd_file;
+  LARGE_INTEGER fsize;
+
+  /* Let another process replace `file` while it is mapped here.
+   */
+  hnd_file = CreateFile (file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hnd_file == INVALID_HANDLE_VALUE)
+  {
+    TRACE (1, "Could not open file: %s.\n", win_strerror(GetLastError()));
+    return (NULL);
+  }
+
+  if (!GetFileSizeEx(hnd_file, &fsize) || fsize.HighPart != 0)
+  {
+    TRACE (1, "Could not get file-size or file is too large.\n");
+    CloseHandle (hnd_file);
+    return (NULL);
+  }
+
+  cache.mmap_hnd = CreateFileMapping (hnd_file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle (hnd_file);   /* The mapping keeps it's own reference */
+  if (!cache.mmap_hnd)
+  {
+    TRACE (1, "CreateFileMapping() failed: %s.\n", win_strerror(GetLastError()));
+    return (NULL);
+  }
+
+  cache.mmap_buf = MapViewOfFile (cache.mmap_hnd, FILE_MAP_READ, 0, 0, 0);
+  if (!cache.mmap_buf)
+  {
+    TRACE (1, "MapViewOfFile() failed: %s.\n", win_strerror(GetLastError()));
+    cache_unmap();
+    return (NULL);
+  }
+  *size = fsize.LowPart;
+  return (cache.mmap_buf);
+}
+
+/**
+ * Close the view and mapping-handle opened in `cache_mmap()`.
+ * No `cache_node::mapped` nodes must be in use after this.
+ */
+static void cache_unmap (void)
+{
+  if (cache.mmap_buf)
+     UnmapViewOfFile (cache.mmap_buf);
+  if (cache.mmap_hnd)
+     CloseHandle (cache.mmap_hnd);
+  cache.mmap_buf = NULL;
+  cache.mmap_hnd = NULL;
+}
+
+/**
+ * Map and parse a binary cache-file. Add the section/key/value entries to `cache.entries`.
+ *
+ * The index is already sorted on `section` and `key`. The keys are copied into
+ * the `cache_node`, but the values are used directly from the view.
+ * The whole file is checked before anything is added to `cache.entries`.
+ */
+static bool cache_parse_bin (const char *file)
+{
+  const cache_bin_header *hdr;
+  const cache_bin_entry  *be;
+  const char             *blob;
+  size_t                  size = 0;
+  DWORD                   i;
+
+  hdr = (const cache_bin_header*) cache_mmap (file, &size);
+  if (!hdr)
+     return (false);
+
+  if (size < sizeof(*hdr) || memcmp(hdr->magic, CACHE_BIN_MAGIC, sizeof(hdr->magic)))
+  {
+    TRACE (1, "%s is not a binary cache-file.\n", file);
+    goto fail;
+  }
+
+  TRACE (1, "Current binary cache version: %d, got version: %lu.\n", CACHE_BIN_VERSION, hdr->version);
+  if (hdr->version != CACHE_BIN_VERSION)
+     goto fail;
+
+  if (hdr->num_entries > (size - sizeof(*hdr)) / sizeof(*be) ||
+      size - sizeof(*hdr) - hdr->num_entries * sizeof(*be) != hdr->blob_size)
+  {
+    TRACE (1, "%s has a wrong size.\n", file);
+    goto fail;
+  }
+
+  be   = (const cache_bin_entry*) (hdr + 1);
+  blob = (const char*) (be + hdr->num_entries);
+
+  if (hdr->blob_size > 0 && blob [hdr->blob_size-1] != '\0')
+  {
+    TRACE (1, "%s has an unterminated blob.\n", file);
+    goto fail;
+  }
+
+  for (i = 0; i < hdr->num_entries; i++)
+  {
+    if (be[i].section <= SECTION_FIRST || be[i].section >= SECTION_LAST ||
+        be[i].key_ofs >= hdr->blob_size || be[i].value_ofs >= hdr->blob_size ||
+        strlen(blob + be[i].key_ofs) >= CACHE_MAX_KEY-1)
+    {
+      TRACE (1, "%s has a bad index-entry %lu.\n", file, i);
+      goto fail;
+    }
+  }
+
+  for (i = 0; i < hdr->num_entries; i++)
+      cache_append (be[i].section, blob + be[i].key_ofs, blob + be[i].value_ofs, true);
+  return (cache.appended > 0);
+
+fail:
+  cache_unmap();
+  return (false);
+}
+
+/**
+ * Load the cache-file `file` into `cache.entries`.
+ * The format is detected from the first bytes in the file.
+ */
+static bool cache_load (const char *file)
+{
+  FILE *f;
+  char  magic [sizeof(CACHE_BIN_MAGIC)-1];
+  bool  rc;
+
+  f = fopen (file, "rt");
+  if (!f)
+  {
+    TRACE (1, "Failed to open %s; %s.\n", file, strerror(errno));
+    return (false);
+  }
+
+  if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, CACHE_BIN_MAGIC, sizeof(magic)))
+  {
+    fclose (f);
+    cache.loaded_format = CACHE_FORMAT_BINARY;
+    return cache_parse_bin (file);
+  }
+
+  rewind (f);
+  cache.loaded_format = CACHE_FORMAT_TEXT;
+  rc = cache_parse (f);
+  fclose (f);
+  return (rc);
+}
+
 /**
  * `_MSC_VER <= 1800` (Visual Studio 2012 or older) does not have `log2()`.
  */
@@ -302,12 +620,26 @@ static void cache_report (int num)
   TRACE (1, "cache.inserted: %5lu, cache.deleted: %5lu, cache.changed: %5lu.\n",
          cache.inserted, cache.deleted, cache.changed);
 
-  if (cache.bsearches)
+  TRACE (1, "cache.journal:  %d, journal_size:  %5lu, replayed:      %5lu, merged: %d.\n",
+         cache.journal, cache.journal_size, cache.replayed, cache.merged);
+
+  TRACE (1, "cache.format:   %s, loaded format: %s.\n",
+         cache.format        == CACHE_FORMAT_BINARY ? "binary" : "text",
+         cache.loaded_format == CACHE_FORMAT_BINARY ? "binary" : "text");
+
+  TRACE (1, "cache.arena:    %lu chunks, %lu kB used of %lu kB, %lu interned keys (%lu re-used).\n",
+         cache.arena ? (unsigned long)smartlist_len(cache.arena) : 0UL,
+         (unsigned long)(cache.arena_used / 1024), (unsigned long)(cache.arena_size / 1024),
+         cache.intern_used, cache.intern_hits);
+
+  if (cache.lookups)
   {
-    double average = (double)cache.bsearches_per_key / (double)cache.bsearches;
-    double maximum = log2 ((double)num) / log2 (2.0);
-    TRACE (1, "On average, there were %.2f comparisions per key. Maximum comparision should be %.2f\n",
-           average, maximum);
+    double average = (double)cache.probes / (double)cache.lookups;
+    double binary  = num > 1 ? log2 ((double)num) : 1.0;
+    TRACE (1, "On average, there were %.2f hash-probes per key (max %lu). A binary search would need %.2f.\n",
+           average, cache.max_probes, binary);
+    TRACE (1, "cache.hash_size: %lu, hash_used: %lu (load %.2f), resizes: %lu.\n",
+           cache.hash_size, cache.hash_used, (double)cache.hash_used / (double)cache.hash_size, cache.resizes);
   }
 }
 
@@ -330,37 +662,155 @@ static int compare_on_section_key1 (const void **_a, const void **_b)
  */
 static void cache_sort (void)
 {
-  if (cache.entries)
-     smartlist_sort (cache.entries, compare_on_section_key1);
+  int i, max;
+
+  if (!cache.entries)
+     return;
+
+  smartlist_sort (cache.entries, compare_on_section_key1);
+
+  max = smartlist_len (cache.entries);
+  for (i = 0; i < max; i++)
+  {
+    cache_node *c = smartlist_get (cache.entries, i);
+    c->idx = i;
+  }
 }
 
 /**
- * Free one cache-node.
+ * Free one cache-node. Put it on `cache.free_nodes` for reuse.
+ * The key and value stays in `cache.arena` until `cache_arena_free()`.
  */
 static void cache_free_node (void *_c)
 {
-  cache_node *c = (cache_node *) _c;
-
-  FREE (c->value);
-  FREE (c);
+  if (!cache.free_nodes)
+     cache.free_nodes = smartlist_new();
+  smartlist_add (cache.free_nodes, _c);
 }
 
 /**
- * Write the `cache.entries` to `cache.filename`. <br>
- * Do it sorted on section, then on keys alpabetically.
+ * Write the `cache.entries` to `f` in text format.
  */
-static void cache_write (void)
+static bool cache_write_text (FILE *f)
 {
   const cache_node *c;
   FILETIME ft_now;
-  FILE    *f;
   int      last_section = -1;
   int      i, max;
 
-  if (cache.inserted + cache.deleted + cache.changed == 0)
+  GetSystemTimeAsFileTime (&ft_now);
+  fprintf (f, "#\n%s %s.\n", CACHE_HEADER, get_time_str_FILETIME(&ft_now));
+
+  fprintf (f, "%s%d\n#", CACHE_HEADER_VER, CACHE_VERSION_NUM);
+
+  max = smartlist_len (cache.entries);
+  for (i = 0; i < max; i++)
+  {
+    c = smartlist_get (cache.entries, i);
+    if (c->section == SECTION_TEST)
+       continue;
+
+    if (c->section != last_section)
+       fprintf (f, "\n%s # = %d\n", sections[c->section].name, c->section);
+
+    fprintf (f, "%s = %s\n", c->key, c->value);
+    last_section = c->section;
+  }
+  return (ferror(f) == 0);
+}
+
+/**
+ * Write the `cache.entries` to `f` in binary format. <br>
+ * First the header, then the index and then the blob with keys and values.
+ */
+static bool cache_write_bin (FILE *f)
+{
+  const cache_node *c;
+  cache_bin_header  hdr;
+  cache_bin_entry   be;
+  DWORD             ofs = 0;
+  int               i, max = smartlist_len (cache.entries);
+
+  memset (&hdr, '\0', sizeof(hdr));
+  memcpy (&hdr.magic, CACHE_BIN_MAGIC, sizeof(hdr.magic));
+  hdr.version = CACHE_BIN_VERSION;
+  GetSystemTimeAsFileTime (&hdr.written);
+
+  for (i = 0; i < max; i++)
+  {
+    c = smartlist_get (cache.entries, i);
+    if (c->section == SECTION_TEST)
+       continue;
+    hdr.num_entries++;
+    hdr.blob_size += (DWORD) (strlen(c->key) + strlen(c->value) + 2);
+  }
+  fwrite (&hdr, sizeof(hdr), 1, f);
+
+  for (i = 0; i < max; i++)
+  {
+    c = smartlist_get (cache.entries, i);
+    if (c->section == SECTION_TEST)
+       continue;
+    be.section   = c->section;
+    be.key_ofs   = ofs;
+    ofs += (DWORD) strlen (c->key) + 1;
+    be.value_ofs = ofs;
+    ofs += (DWORD) strlen (c->value) + 1;
+    fwrite (&be, sizeof(be), 1, f);
+  }
+
+  for (i = 0; i < max; i++)
+  {
+    c = smartlist_get (cache.entries, i);
+    if (c->section == SECTION_TEST)
+       continue;
+    fwrite (c->key, strlen(c->key) + 1, 1, f);
+    fwrite (c->value, strlen(c->value) + 1, 1, f);
+  }
+  return (ferror(f) == 0);
+}
+
+/**
+ * Write the `cache.entries` to `file` in `format`. <br>
+ * Do it sorted on section, then on keys alpabetically.
+ */
+static bool cache_write_file (const char *file, CacheFormat format)
+{
+  FILE *f;
+  bool  rc;
+
+  f = fopen (file, format == CACHE_FORMAT_BINARY ? "w+b" : "w+t");
+  if (!f)
+  {
+    TRACE (1, "Failed to open %s; %s.\n", file, strerror(errno));
+    return (false);
+  }
+  if (format == CACHE_FORMAT_BINARY)
+       rc = cache_write_bin (f);
+  else rc = cache_write_text (f);
+
+  if (fclose(f) != 0)
+     rc = false;
+  if (!rc)
+  {
+    TRACE (1, "Failed to write %s.\n", file);
+    DeleteFile (file);
+  }
+  return (rc);
+}
+
+/**
+ * Write the `cache.entries` to `cache.filename_tmp` if something has changed
+ * or if the format should change. `cache_exit()` will rename it to `cache.filename`.
+ * A binary `cache.filename` is still mapped here, so it can not be written directly.
+ */
+static bool cache_write (void)
+{
+  if (cache.inserted + cache.deleted + cache.changed + cache.replayed == 0 &&
+      cache.format == cache.loaded_format)
   {
     TRACE (1, "No change.\n");
-    return;
+    return (false);
   }
 
   /* Make a backup of current cache.filename.
@@ -368,95 +818,555 @@ static void cache_write (void)
   if (cache.filename_prev && FILE_EXISTS(cache.filename))
      CopyFile (cache.filename, cache.filename_prev, false);
 
-  f = fopen (cache.filename, "w+t");
-  if (!f)
+  snprintf (cache.filename_tmp, sizeof(cache.filename_tmp), "%s.tmp", cache.filename);
+  return cache_write_file (cache.filename_tmp, cache.format);
+}
+
+/**
+ * Convert the cache-file `from_file` to `to_file` in `format`.
+ * The format of `from_file` is detected in `cache_load()`.
+ *
+ * This uses the same functions as `cache_init()` and `cache_exit()`,
+ * but not the current cache. So the state of it is saved and restored around it.
+ */
+bool cache_convert (const char *from_file, const char *to_file, CacheFormat format)
+{
+  CACHE save = cache;
+  bool  rc = false;
+
+  memset (&cache, '\0', sizeof(cache));
+  cache.entries = smartlist_new();
+
+  if (cache_load(from_file))
   {
-    TRACE (1, "Failed to open %s; %s.\n", cache.filename, strerror(errno));
-    return;
+    cache_sort();
+    rc = cache_write_file (to_file, format);
   }
+  TRACE (1, "Converted %s (%d entries) to %s: %d.\n", from_file, smartlist_len(cache.entries), to_file, rc);
 
-  GetSystemTimeAsFileTime (&ft_now);
-  fprintf (f, "#\n%s %s.\n", CACHE_HEADER, get_time_str_FILETIME(&ft_now));
+  smartlist_free (cache.entries);
+  cache_hash_free();
+  cache_arena_free();
+  cache_unmap();
+  cache = save;
+  return (rc);
+}
 
-  fprintf (f, "%s%d\n#", CACHE_HEADER_VER, CACHE_VERSION_NUM);
+/**
+ * Return the hash-value for `section` and the `len` first characters of `key`.
+ * This is FNV-1a seeded with the section.
+ */
+static DWORD cache_hash (CacheSections section, const char *key, size_t len)
+{
+  DWORD h = 2166136261U ^ (DWORD) section;
 
-  max = smartlist_len (cache.entries);
-  for (i = 0; i < max; i++)
+  while (len--)
   {
-    c = smartlist_get (cache.entries, i);
-    if (c->section == SECTION_TEST)
+    h ^= (BYTE) *key++;
+    h *= 16777619U;
+  }
+  return (h);
+}
+
+/**
+ * Add the node `c` to `cache.hash_table`. There must be a free slot.
+ */
+static void cache_hash_add (cache_node *c)
+{
+  DWORD mask = cache.hash_size - 1;
+  DWORD i = c->hash & mask;
+
+  while (cache.hash_table[i])
+     i = (i + 1) & mask;
+  cache.hash_table [i] = c;
+  cache.hash_used++;
+}
+
+/**
+ * Make room for one more node in `cache.hash_table`.
+ * Double the size when it gets more than half full.
+ */
+static void cache_hash_grow (void)
+{
+  cache_node **old_table = cache.hash_table;
+  DWORD        old_size  = cache.hash_size;
+  DWORD        i;
+
+  if (2 * (cache.hash_used + 1) <= cache.hash_size)
+     return;
+
+  cache.hash_size  = old_size ? 2 * old_size : 512;
+  cache.hash_table = CALLOC (cache.hash_size, sizeof(cache_node*));
+  cache.hash_used  = 0;
+
+  for (i = 0; i < old_size; i++)
+      if (old_table[i])
+         cache_hash_add (old_table[i]);
+
+  if (old_table)
+     cache.resizes++;
+  FREE (old_table);
+}
+
+/**
+ * Remove the node `c` from `cache.hash_table`.
+ * Move the following nodes in the probe-sequence back so no tombstones are needed.
+ */
+static void cache_hash_del (const cache_node *c)
+{
+  DWORD mask = cache.hash_size - 1;
+  DWORD i = c->hash & mask;
+  DWORD j, home;
+
+  while (cache.hash_table[i] != c)
+     i = (i + 1) & mask;
+
+  for (j = (i + 1) & mask; cache.hash_table[j]; j = (j + 1) & mask)
+  {
+    home = cache.hash_table[j]->hash & mask;
+
+    /* If `home` is cyclically in `(i, j]`, this node must stay.
+     */
+    if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+       continue;
+    cache.hash_table [i] = cache.hash_table [j];
+    i = j;
+  }
+  cache.hash_table [i] = NULL;
+  cache.hash_used--;
+}
+
+/**
+ * Free `cache.hash_table`. But not the nodes in it.
+ */
+static void cache_hash_free (void)
+{
+  FREE (cache.hash_table);
+  cache.hash_size = cache.hash_used = 0;
+}
+
+/**
+ * Allocate `size` bytes from `cache.arena`. The memory is not zeroed.
+ * It is freed when the whole arena is freed in `cache_arena_free()`.
+ */
+static void *cache_arena_alloc (size_t size)
+{
+  void *p;
+
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  if (size > cache.arena_left)
+  {
+    size_t chunk = max (size, CACHE_ARENA_CHUNK);
+
+    if (!cache.arena)
+       cache.arena = smartlist_new();
+    cache.arena_ptr  = MALLOC (chunk);
+    cache.arena_left = chunk;
+    cache.arena_size += chunk;
+    smartlist_add (cache.arena, cache.arena_ptr);
+  }
+  p = cache.arena_ptr;
+  cache.arena_ptr  += size;
+  cache.arena_left -= size;
+  cache.arena_used += size;
+  return (p);
+}
+
+/**
+ * Copy the string `str` into `cache.arena`.
+ */
+static char *cache_arena_strdup (const char *str)
+{
+  size_t len = strlen (str) + 1;
+
+  return memcpy (cache_arena_alloc(len), str, len);
+}
+
+/**
+ * Grow (or create) `cache.intern_table` and re-insert all keys.
+ */
+static void cache_intern_grow (void)
+{
+  const char **old_table = cache.intern_table;
+  DWORD        i, old_size = cache.intern_size;
+
+  cache.intern_size  = old_size ? 2 * old_size : 512;
+  cache.intern_table = CALLOC (cache.intern_size, sizeof(const char*));
+
+  for (i = 0; i < old_size; i++)
+  {
+    const char *key = old_table [i];
+    DWORD       j;
+
+    if (!key)
        continue;
+    j = cache_hash (SECTION_FIRST, key, strlen(key)) & (cache.intern_size - 1);
+    while (cache.intern_table[j])
+       j = (j + 1) & (cache.intern_size - 1);
+    cache.intern_table [j] = key;
+  }
+  FREE (old_table);
+}
+
+/**
+ * Return the interned copy of `key` in `cache.arena`. Add it if not already there.
+ * Keys are never removed from `cache.intern_table`.
+ */
+static const char *cache_intern (const char *key)
+{
+  size_t len = strlen (key);
+  DWORD  i;
+
+  if (2 * (cache.intern_used + 1) > cache.intern_size)
+     cache_intern_grow();
+
+  i = cache_hash (SECTION_FIRST, key, len) & (cache.intern_size - 1);
+  while (cache.intern_table[i])
+  {
+    if (!strcmp(cache.intern_table[i], key))
+    {
+      cache.intern_hits++;
+      return (cache.intern_table[i]);
+    }
+    i = (i + 1) & (cache.intern_size - 1);
+  }
+  cache.intern_table [i] = memcpy (cache_arena_alloc(len+1), key, len+1);
+  cache.intern_used++;
+  return (cache.intern_table[i]);
+}
+
+/**
+ * Allocate a node from `cache.free_nodes` or `cache.arena`.
+ */
+static cache_node *cache_alloc_node (void)
+{
+  int num = cache.free_nodes ? smartlist_len (cache.free_nodes) : 0;
+
+  if (num > 0)
+  {
+    cache_node *c = smartlist_get (cache.free_nodes, num-1);
+
+    smartlist_del (cache.free_nodes, num-1);
+    return (c);
+  }
+  return cache_arena_alloc (sizeof(cache_node));
+}
+
+/**
+ * Free all the chunks in `cache.arena`. And with that, all the nodes, keys and values.
+ * Reset the arena statistics too.
+ */
+static void cache_arena_free (void)
+{
+  int i, max = cache.arena ? smartlist_len (cache.arena) : 0;
+
+  for (i = 0; i < max; i++)
+  {
+    char *chunk = smartlist_get (cache.arena, i);
+    FREE (chunk);
+  }
+  smartlist_free (cache.arena);
+  smartlist_free (cache.free_nodes);
+  FREE (cache.intern_table);
+  cache.arena      = cache.free_nodes = NULL;
+  cache.arena_ptr  = NULL;
+  cache.arena_left = 0;
+  cache.arena_size = cache.arena_used = 0;
+  cache.intern_size = cache.intern_used = cache.intern_hits = 0;
+}
+
+/**
+ * Lookup the `section` and `key` in `cache.hash_table` and return a `cache_node*` if found.
+ * Leading and trailing blanks in `key` are ignored.
+ */
+static cache_node *cache_lookup (CacheSections section, const char *key)
+{
+  cache_node *c;
+  size_t      len = strlen (key);
+  DWORD       h, i, mask, probes = 1;
+
+  if (!cache.hash_table || cache.hash_used == 0)
+  {
+    TRACE (1, "No cache.entries.\n");
+    return (NULL);
+  }
+
+  if (len > 0 && (isspace((int)key[0]) || isspace((int)key[len-1])))
+  {
+    key = str_trim (strdupa(key));
+    len = strlen (key);
+  }
+
+  h    = cache_hash (section, key, len);
+  mask = cache.hash_size - 1;
+
+  for (i = h & mask; (c = cache.hash_table[i]) != NULL; i = (i + 1) & mask, probes++)
+  {
+    if (c->hash == h && c->section == section && !strncmp(c->key, key, len) && c->key[len] == '\0')
+       break;
+  }
+
+  cache.lookups++;
+  cache.probes += probes;
+  if (probes > cache.max_probes)
+     cache.max_probes = probes;
+
+  if (c)
+       cache.hits++;
+  else cache.misses++;
+  return (c);
+}
+
+/**
+ * Add the node `c` to the end of `cache.entries` and to `cache.hash_table`.
+ */
+static void cache_add_node (cache_node *c)
+{
+  cache_hash_grow();
+  cache_hash_add (c);
+  c->idx = smartlist_len (cache.entries);
+  smartlist_add (cache.entries, c);
+}
+
+/**
+ * Record a `cache_put()` or `cache_del()` done in this run in `cache.changes`.
+ * In `cache_exit()`, these are appended to the journal-file by `cache_journal_flush()`
+ * or merged with the cache-file on disk by `cache_merge()`.
+ */
+static void cache_journal (int op, CacheSections section, const char *key, const char *value)
+{
+  cache_node *c;
+
+  if (cache.replaying || cache.testing || section == SECTION_TEST || !cache.journal_name[0])
+     return;
+
+  if (!cache.changes)
+     cache.changes = smartlist_new();
+
+  c = cache_alloc_node();
+  c->section = section;
+  c->key     = cache_intern (key);
+  c->value   = (op == 'P') ? cache_arena_strdup (value) : NULL;
+  c->mapped  = false;
+  c->hash    = 0;
+  c->idx     = -1;
+  smartlist_add (cache.changes, c);
+}
+
+/**
+ * Append the `cache.changes` to the journal-file.
+ * Called with the exclusive lock held. So the records from several
+ * processes are never mixed.
+ *
+ * The records are:
+ *  \li `P section key = value` for a `cache_put()`.
+ *  \li `D section key` for a `cache_del()`.
+ *
+ * Replaying a record twice gives the same result. So it does not matter
+ * if `cache_exit()` fails to delete the journal-file after a compaction.
+ */
+static bool cache_journal_flush (void)
+{
+  FILE *f;
+  int   i, len, max = cache.changes ? smartlist_len (cache.changes) : 0;
+
+  if (max == 0)
+     return (true);
+
+  f = fopen (cache.journal_name, "at");
+  if (!f)
+  {
+    TRACE (1, "Failed to open %s; %s.\n", cache.journal_name, strerror(errno));
+    return (false);
+  }
+
+  for (i = 0; i < max; i++)
+  {
+    const cache_node *c = smartlist_get (cache.changes, i);
+
+    if (c->value)
+         len = fprintf (f, "P %d %s = %s\n", c->section, c->key, c->value);
+    else len = fprintf (f, "D %d %s\n", c->section, c->key);
+    if (len > 0)
+       cache.journal_size += len;
+  }
+  return (fclose(f) == 0);
+}
+
+/**
+ * Apply the records in the journal-file to `cache.entries`.
+ * Called from `cache_init()` after `cache.filename` was loaded.
+ * A record without a newline (from a crashed program) is ignored.
+ */
+static void cache_journal_replay (void)
+{
+  FILE *f = fopen (cache.journal_name, "rt");
+  char  buf [CACHE_MAX_KEY + CACHE_MAX_VALUE + 10];
+
+  if (!f)
+     return;
+
+  cache.replaying = true;
+
+  while (fgets(buf, sizeof(buf), f))
+  {
+    char *key, *value = NULL, *end;
+    UINT  section;
+
+    cache.journal_size += (DWORD) strlen (buf);
+    end = strchr (buf, '\n');
+    if (!end || (buf[0] != 'P' && buf[0] != 'D') || buf[1] != ' ')
+    {
+      TRACE (1, "Bad journal record: '%s'.\n", buf);
+      continue;
+    }
+    *end = '\0';
+
+    section = strtoul (buf+2, &key, 10);
+    if (section <= SECTION_FIRST || section >= SECTION_LAST || *key != ' ')
+    {
+      TRACE (1, "Bad journal section: '%s'.\n", buf);
+      continue;
+    }
+    key++;
+
+    if (buf[0] == 'P')
+    {
+      value = strstr (key, " = ");
+      if (!value)
+      {
+        TRACE (1, "Bad journal record: '%s'.\n", buf);
+        continue;
+      }
+      *value = '\0';
+      value += 3;
+      cache_put (section, key, value);
+    }
+    else
+      cache_del (section, key);
+    cache.replayed++;
+  }
+  fclose (f);
+
+  /* These changes came from the journal and are not new.
+   */
+  cache.inserted = cache.deleted = cache.changed = 0;
+  cache.replaying = false;
+  TRACE (1, "Replayed %lu records from %s (%lu bytes).\n", cache.replayed, cache.journal_name, cache.journal_size);
+}
+
+/**
+ * Close the journal-file and decide if `cache.filename` should be written.
+ * Without a journal, `cache_write()` decides.
+ * With a journal, the journal is compacted into `cache.filename` when it
+ * has grown above `cache.journal_max` bytes or the format changes.
+ */
+static bool cache_journal_close (void)
+{
+  if (!cache.journal)
+     return (true);
+
+  if (!cache_journal_flush())
+  {
+    TRACE (1, "Failed to append to %s. Let 'cache_write()' do it.\n", cache.journal_name);
+    cache.journal = false;
+    return (true);
+  }
+
+  if (cache.journal_size >= cache.journal_max || cache.format != cache.loaded_format)
+  {
+    TRACE (1, "Compacting %s (%lu bytes).\n", cache.journal_name, cache.journal_size);
+    return (true);
+  }
+  TRACE (1, "Not compacting %s (%lu bytes).\n", cache.journal_name, cache.journal_size);
+  return (false);
+}
+
+/**
+ * Lock the `cache.lock_name` file. Shared for reading `cache.filename` and the
+ * journal-file in `cache_init()`. Exclusive for appending to the journal-file
+ * or replacing `cache.filename` in `cache_exit()`.
+ * Waits until another process calls `cache_unlock()`.
+ *
+ * A separate lock-file is used since `cache.filename` is replaced and the
+ * journal-file is deleted while the lock is held.
+ * If the lock-file can not be opened or locked, just continue without a lock.
+ */
+static void cache_lock (bool exclusive)
+{
+  OVERLAPPED ov;
 
-    if (c->section != last_section)
-       fprintf (f, "\n%s # = %d\n", sections[c->section].name, c->section);
+  if (cache.locked || !cache.lock_name[0])
+     return;
 
-    fprintf (f, "%s = %s\n", c->key, c->value);
-    last_section = c->section;
+  cache.lock_hnd = CreateFile (cache.lock_name, GENERIC_READ | GENERIC_WRITE,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (cache.lock_hnd == INVALID_HANDLE_VALUE)
+  {
+    TRACE (1, "Failed to open %s; %s.\n", cache.lock_name, win_strerror(GetLastError()));
+    return;
   }
-  fclose (f);
+  memset (&ov, '\0', sizeof(ov));
+  if (!LockFileEx(cache.lock_hnd, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &ov))
+  {
+    TRACE (1, "LockFileEx() failed; %s.\n", win_strerror(GetLastError()));
+    CloseHandle (cache.lock_hnd);
+    return;
+  }
+
+  TRACE (2, "Locked %s (%s).\n", cache.lock_name, exclusive ? "exclusive" : "shared");
+  cache.locked = true;
 }
 
 /**
- * `smartlist_bsearch_idx()` helper function.
- * Compare on `cache_node::section`, then on `cache_node::key`.
+ * Release the lock taken in `cache_lock()`. Closing the lock-file does that.
  */
-static int compare_on_section_key2 (const void *_key, const void **member)
+static void cache_unlock (void)
 {
-  const cache_node *key = (const cache_node *) _key;
-  const cache_node *node = *member;
-
-  /**< \todo make this into a ring-buffer to generate some more valuable statistics.
-   * E.g. a bucket of 20 last searches, then generate a std-deviation in `cache_report()`.
-   */
-  cache.bsearches_per_key++;
+  if (!cache.locked)
+     return;
 
-  if (key->section != node->section)
-     return (int)key->section - (int)node->section;
-  return strcmp (key->key, node->key);
+  CloseHandle (cache.lock_hnd);
+  cache.lock_hnd = NULL;
+  cache.locked = false;
 }
 
 /**
- * Do a binary search for `section` and `key` and return a `cache_node*` if found.
- * If `idx_p` is set and:
- *   if cache-node was found, set the index of the entry in `*idx_p`.
- *   if cache-node was not found, set the index of the first vacant (new) entry in `*idx_p`.
+ * Merge the cache-file and journal-file on disk with the changes done in this run.
+ * Called from `cache_exit()` with the exclusive lock held.
+ *
+ * Another process could have replaced `cache.filename` or appended to the journal-file
+ * since `cache_init()`. Hence load these files again and apply `cache.changes` on top.
+ * With a journal, these changes are already at the end of the journal-file.
  */
-static cache_node *cache_bsearch (CacheSections section, const char *_key, int *idx_p)
+static void cache_merge (void)
 {
-  cache_node c, *ret;
-  char *key = strdupa (_key);
-  int   idx = 0;
-  bool  found;
-
-  if (idx_p)
-     *idx_p = idx;
+  int i, max;
 
-  if (!cache.entries || smartlist_len(cache.entries) == 0)
-  {
-    TRACE (1, "No cache.entries.\n");
-    return (NULL);
-  }
+  smartlist_wipe (cache.entries, cache_free_node);
+  cache_hash_free();
+  cache_unmap();
 
-  /**< \todo make this into a ring-buffer to generate some more valuable statistics
-   */
-  cache.bsearches++;
-  c.section = section;
-  _strlcpy (c.key, str_trim(key), sizeof(c.key));
+  cache.appended = cache.replayed = cache.journal_size = 0;
+  cache_load (cache.filename);
+  cache_journal_replay();
 
-  idx = smartlist_bsearch_idx (cache.entries, &c, compare_on_section_key2, &found);
-  if (found)
-  {
-    ret = smartlist_get (cache.entries, idx);
-    cache.hits++;
-  }
-  else
+  max = (cache.changes && !cache.journal) ? smartlist_len (cache.changes) : 0;
+  cache.replaying = true;
+  for (i = 0; i < max; i++)
   {
-    ret = NULL;
-    cache.misses++;
+    const cache_node *c = smartlist_get (cache.changes, i);
+
+    if (c->value)
+         cache_put (c->section, c->key, c->value);
+    else cache_del (c->section, c->key);
   }
-  if (idx_p)
-     *idx_p = idx;
-  return (ret);
+  cache.replaying = false;
+  cache.merged = true;
+
+  TRACE (1, "Merged %d changes with %d entries from %s.\n",
+         max, smartlist_len(cache.entries), cache.filename);
 }
 
 /**
@@ -473,7 +1383,7 @@ void cache_del (CacheSections section, const char *key)
     return;
   }
 
-  c = cache_bsearch (section, key, &idx);
+  c = cache_lookup (section, key);
   if (!c)
   {
     TRACE (2, "entry with key: '%s' in section '%s' was not found.\n", key, sections[section].name);
@@ -481,8 +1391,19 @@ void cache_del (CacheSections section, const char *key)
   }
 
   TRACE (2, "deleting entry with key: '%s' in section '%s'.\n", key, sections[section].name);
+  cache_journal ('D', section, key, NULL);
+  cache_hash_del (c);
+
+  /* Move the last node into this place. `cache_sort()` will fix the order.
+   */
+  idx = c->idx;
+  smartlist_del (cache.entries, idx);
+  if (idx < smartlist_len(cache.entries))
+  {
+    cache_node *last = smartlist_get (cache.entries, idx);
+    last->idx = idx;
+  }
   cache_free_node (c);
-  smartlist_del_keeporder (cache.entries, idx);
   cache.deleted++;
 }
 
@@ -504,7 +1425,7 @@ void cache_delf (CacheSections section, _Printf_format_string_ const char *fmt,
 /**
  * Check the `section` and `key` values and allocate a new cache-node.
  */
-static cache_node *cache_new_node (CacheSections section, const char *key, const char *value)
+static cache_node *cache_new_node (CacheSections section, const char *key, const char *value, bool mapped)
 {
   cache_node *c;
 
@@ -514,47 +1435,51 @@ static cache_node *cache_new_node (CacheSections section, const char *key, const
   if (strlen(key) >= CACHE_MAX_KEY-1)
      FATAL ("'key' too large. Max %d bytes.\n", CACHE_MAX_KEY-1);
 
-  c = MALLOC (sizeof(*c));
+  c = cache_alloc_node();
   c->section = section;
-  c->value   = STRDUP (value);
-  _strlcpy (c->key, key, sizeof(c->key));
+  c->mapped  = mapped;
+  c->value   = mapped ? (char*) value : cache_arena_strdup (value);
+  c->key     = cache_intern (key);
+  c->hash    = cache_hash (section, c->key, strlen(c->key));
+  c->idx     = -1;
   return (c);
 }
 
 /**
  * Append the triplet `section`, `key` and `value` to the end of `cache.entries` smartlist.
- * Called from `cache_parse()` where the file-entries are assumed to already be sorted
- * on `section` and `key`.
+ * Called from `cache_parse()` and `cache_parse_bin()`.
+ * If `mapped == true`, the `value` points into the view of a binary cache-file.
  */
-static void cache_append (CacheSections section, const char *key, const char *value)
+static void cache_append (CacheSections section, const char *key, const char *value, bool mapped)
 {
-  cache_node *c = cache_new_node (section, key, value);
+  cache_node *c = cache_new_node (section, key, value, mapped);
 
   if (c)
   {
-    smartlist_add (cache.entries, c);
+    cache_add_node (c);
     cache.appended++;
     TRACE (3, "Appending key: '%s', value: '%s'.\n", c->key, c->value);
   }
 }
 
 /**
- * Insert the triplet `section`, `key` and `value` to the `cache.entries` smartlist at index `idx`.
+ * Insert the triplet `section`, `key` and `value` to the `cache.entries` smartlist.
+ * It is added at the end; `cache.entries` is sorted in `cache_sort()` before it is written.
  */
-static void cache_insert (CacheSections section, const char *key, const char *value, int idx)
+static void cache_insert (CacheSections section, const char *key, const char *value)
 {
   cache_node *c;
 
   if (!cache.entries)
      return;
 
-  c = cache_new_node (section, key, value);
+  c = cache_new_node (section, key, value, false);
   if (c)
   {
-    smartlist_insert (cache.entries, idx, c);
+    cache_add_node (c);
     cache.inserted++;
     TRACE (3, "Inserting key: '%s', value: '%s', section: '%s' at idx: %d.\n",
-           c->key, c->value, sections[section].name, idx);
+           c->key, c->value, sections[section].name, c->idx);
   }
 }
 
@@ -563,15 +1488,12 @@ static void cache_insert (CacheSections section, const char *key, const char *va
  */
 void cache_put (CacheSections section, const char *key, const char *value)
 {
-  int         idx;
-  cache_node *c = cache_bsearch (section, key, &idx);
+  cache_node *c = cache_lookup (section, key);
 
   if (!c)
   {
-    /* Not found, insert it at the `idx` which is the first member greater than `key`.
-     * This would hopefully keep the `cache.entries` still sorted.
-     */
-    cache_insert (section, key, value, idx);
+    cache_insert (section, key, value);
+    cache_journal ('P', section, key, value);
     return;
   }
 
@@ -583,13 +1505,14 @@ void cache_put (CacheSections section, const char *key, const char *value)
    */
   cache.changed++;
   TRACE (1, "key: '%s', current value: '%s', new value: '%s'.\n", c->key, c->value, value);
+  cache_journal ('P', section, key, value);
 
-  if (strlen(value) <= strlen(c->value))
+  if (!c->mapped && strlen(value) <= strlen(c->value))
      strcpy (c->value, value);
   else
   {
-    FREE (c->value);
-    c->value = STRDUP (value);
+    c->value  = cache_arena_strdup (value);   /* The old value stays in 'cache.arena' */
+    c->mapped = false;
   }
 }
 
@@ -631,7 +1554,7 @@ void cache_putf (CacheSections section, _Printf_format_string_ const char *fmt,
  */
 const char *cache_get (CacheSections section, const char *key)
 {
-  const cache_node *c = cache_bsearch (section, key, NULL);
+  const cache_node *c = cache_lookup (section, key);
 
   return (c ? c->value : NULL);
 }
@@ -640,13 +1563,15 @@ const char *cache_get (CacheSections section, const char *key)
 #define STATE_QUOTED 2  /** parse a "quoted" string (with >=1 ',') as one value. */
 #define STATE_ESCAPE 3  /** parse a ESCaped "\" string in 'STATE_QUOTED' */
 
+/**
+ * Split off the next value in a comma-string starting at `*start`.
+ * The value is 0-terminated in place. A `"quoted"` value can contain `,`.
+ */
 static int get_next_value (char **start, char *end)
 {
   char *c = *start;
   int   state = STATE_NORMAL;
   int   len = 0;
-  char  buf [CACHE_MAX_VALUE+1] = { '\0' };
-  char *p = buf;
 
   while (*c)
   {
@@ -669,7 +1594,6 @@ static int get_next_value (char **start, char *end)
       }
       else
       {
-        *p++ = *c;
         len++;
         c++;
       }
@@ -689,14 +1613,12 @@ static int get_next_value (char **start, char *end)
       }
       else if (*c == '\\')          /* left ESC char */
       {
-        *p++ = *c;
         len++;
         c++;
         state = STATE_ESCAPE;
       }
       else
       {
-        *p++ = *c;
         len++;
         c++;
       }
@@ -705,20 +1627,17 @@ static int get_next_value (char **start, char *end)
     {
       if (*c == '\\')       /* right ESC char */
       {
-        *p++ = *c;
         len++;
         c++;
       }
       else if (*c == '"')   /* right ESCaped '"' */
       {
-        *p++ = *c;
         len++;
         c++;
         state = STATE_QUOTED;
       }
       else
       {
-        *p++ = *c;
         c++;
         len++;
       }
@@ -728,13 +1647,8 @@ static int get_next_value (char **start, char *end)
   }
 
   *c = '\0';
-  *p = '\0';
-
-  TRACE (3, "len: %d, *start: '%.*s', buf: '%s'.\n", len, len, *start, buf);
 
-#if 0
-  strcpy (*start, buf);
-#endif
+  TRACE (3, "len: %d, *start: '%.*s'.\n", len, len, *start);
 
   return (len);
 }
@@ -938,6 +1852,140 @@ int cache_getf2 (CacheSections section, const char *fmt, ...)
   return (rc);
 }
 
+/**
+ * \typedef cache_getf_desc
+ *
+ * A value-format compiled once by `cache_getf_compile()` and used by
+ * `cache_getf_run()` for many keys. Like `port_node_0` ... `port_node_N`.
+ */
+struct cache_getf_desc {
+       int    num_fields;                 /**< number of `%d`, `%u` or `%s` fields in the format */
+       char   type [CACHE_MAX_ARGS];      /**< `'d'` for a `%d` or `%u` field, `'s'` for a `%s` field */
+       char  *s_val [CACHE_MAX_ARGS];     /**< the values split from `value` */
+       char   value [CACHE_MAX_VALUE+1];  /**< a copy of the last value looked up */
+     };
+
+/**
+ * Compile the value-part of a `cache_getf()` format. I.e. the part after `"key = "`.
+ * Only `"%d"`, `"%u"` and `"%s"` fields separated by `,` are allowed.
+ *
+ * \param[in] fmt  the format. E.g. `"%s,%d,%d,%s,%s,%s"`.
+ * \retval    the compiled descriptor. Free it using `cache_getf_free()`.
+ */
+cache_getf_desc *cache_getf_compile (const char *fmt)
+{
+  cache_getf_desc *desc = CALLOC (sizeof(*desc), 1);
+  const char      *f = fmt;
+
+  while (*f)
+  {
+    if (desc->num_fields >= CACHE_MAX_ARGS)
+       FATAL ("too many fields (%d) in 'fmt: \"%s\"'.\n", desc->num_fields+1, fmt);
+
+    if (!strncmp(f, "%d", 2) || !strncmp(f, "%u", 2))
+       desc->type [desc->num_fields++] = 'd';
+    else if (!strncmp(f, "%s", 2))
+       desc->type [desc->num_fields++] = 's';
+    else
+       FATAL ("Unsupported format '%s'.\n", f);
+
+    f += 2;
+    if (*f == ',')
+       f++;
+    else if (*f)
+       FATAL ("Unsupported format '%s'.\n", fmt);
+  }
+  return (desc);
+}
+
+/**
+ * Lookup `key` in `section` and store the values as compiled in `desc`.
+ * The same as `cache_getf (section, "key = fmt", ...)`, but with no parsing
+ * of the format and no memory allocated.
+ *
+ * \note The strings returned for a `%s` field points into `desc->value`.
+ *       They are valid until the next call with the same `desc`.
+ *
+ * \note A field missing in the value gives `NULL` for a `%s` field and 0 for
+ *       a `%d` or `%u` field.
+ *
+ * \param[in] desc     the descriptor from `cache_getf_compile()`.
+ * \param[in] section  the section to lookup `key` in.
+ * \param[in] key      the key.
+ * \param[in] ...      a `char**` for each `%s` field and an `int*` for each `%d` and `%u` field.
+ * \retval    0 if `key` was not found or it's value is longer than `CACHE_MAX_VALUE`.
+ *            Otherwise the number of fields in the format.
+ */
+int cache_getf_run (cache_getf_desc *desc, CacheSections section, const char *key, ...)
+{
+  const char *value;
+  char       *v, *v_end;
+  size_t      len;
+  va_list     args;
+  int         i, rc, num_values = 0;
+
+  if (!cache.entries || smartlist_len(cache.entries) == 0)
+     return (0);
+
+  value = cache_get (section, key);
+  if (!value)
+  {
+    TRACE (2, "No value for key: '%s' (end of list?).\n", key);
+    return (0);
+  }
+
+  len = strlen (value);
+  if (len > CACHE_MAX_VALUE)
+  {
+    TRACE (1, "Value for key: '%s' too long (%u bytes).\n", key, (unsigned)len);
+    return (0);
+  }
+  memcpy (desc->value, value, len);
+  desc->value [len] = '\0';
+
+  v     = desc->value;
+  v_end = desc->value + len;
+  while (num_values < desc->num_fields && (rc = get_next_value(&v, v_end)) > 0)
+  {
+    desc->s_val [num_values++] = v;
+    v += rc;
+    if (v >= v_end)
+       break;
+  }
+
+  va_start (args, key);
+  for (i = 0; i < desc->num_fields; i++)
+  {
+    void *arg = va_arg (args, void*);
+    char *s   = (i < num_values) ? desc->s_val[i] : NULL;
+
+    if (desc->type[i] == 's')
+       *(char**) arg = s;
+    else
+    {
+      char *end;
+      int   d = s ? (int) strtoul (s, &end, 10) : 0;
+
+      if (s && end == s)
+      {
+        TRACE (2, "EINVAL; s_val[%d]: '%s'.\n", i, s);
+        d = 0;
+      }
+      *(int*) arg = d;
+    }
+  }
+  va_end (args);
+  return (desc->num_fields);
+}
+
+/**
+ * Free the memory allocated by `cache_getf_compile()`.
+ */
+void cache_getf_free (cache_getf_desc *desc)
+{
+  FREE (desc);
+}
+
 /**
  * Dump cached nodes in `section == SECTION_TEST`.
  */
@@ -947,6 +1995,7 @@ static void cache_test_dump (void)
   int   i, max = cache.entries ? smartlist_len (cache.entries) : 0;
 
   C_printf ("~3%s():~0\n  section: %s\n", __FUNCTION__, sections[SECTION_TEST].name);
+  cache_sort();
 
   for (i = 0; i < max; i++)
   {
@@ -1127,6 +2176,503 @@ static size_t cache_test_getf (void)
   return (num_ok);
 }
 
+/**
+ * `smartlist_read_file()` parser for `cache_test_convert()`.
+ * Add all non-empty lines.
+ */
+static void cache_test_parse (smartlist_t *sl, const char *line)
+{
+  if (*line != '\n')
+     smartlist_add (sl, STRDUP(line));
+}
+
+/**
+ * Test the `cache_convert()` function:
+ *   text -> binary -> text.
+ *
+ * The entries in the 2 text-files must be equal.
+ */
+static void cache_test_convert (void)
+{
+  char        *text1 = create_temp_file();
+  char        *text2 = create_temp_file();
+  char        *bin   = create_temp_file();
+  smartlist_t *sl1 = NULL, *sl2 = NULL;
+  FILE        *f;
+  bool         ok = false;
+  int          i;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  f = (text1 && text2 && bin) ? fopen (text1, "w+t") : NULL;
+  if (f)
+  {
+    fprintf (f, "#\n%s now.\n%s%d\n#\n", CACHE_HEADER, CACHE_HEADER_VER, CACHE_VERSION_NUM);
+    fprintf (f, "%s # = %d\n", sections[SECTION_CMAKE].name, SECTION_CMAKE);
+    fprintf (f, "cmake_exe = c:\\cmake\\bin\\cmake.exe,3,22,1\n");
+    fprintf (f, "\n%s # = %d\n", sections[SECTION_VCPKG].name, SECTION_VCPKG);
+    fprintf (f, "port_node_0 = gts,0,1,0.7.6,https://github.com/finetjul/gts,\"A library, with commas\"\n");
+    fprintf (f, "port_node_1 = libsvm,0,1,3.25,https://www.csie.ntu.edu.tw/~cjlin/libsvm/\n");
+    fclose (f);
+
+    ok = (cache_convert(text1, bin, CACHE_FORMAT_BINARY) && cache_convert(bin, text2, CACHE_FORMAT_TEXT));
+    sl1 = smartlist_read_file (cache_test_parse, text1);
+    sl2 = smartlist_read_file (cache_test_parse, text2);
+  }
+
+  if (ok && sl1 && sl2 && smartlist_len(sl1) == smartlist_len(sl2))
+  {
+    for (i = 0; ok && i < smartlist_len(sl1); i++)
+        ok = (strcmp(smartlist_get(sl1, i), smartlist_get(sl2, i)) == 0);
+  }
+  else
+    ok = false;
+
+  C_printf ("  text -> binary -> text: %s~0.\n\n", ok ? "~2OKAY" : "~5FAILED");
+
+  smartlist_free_all (sl1);
+  smartlist_free_all (sl2);
+  if (text1)
+     DeleteFile (text1);
+  if (text2)
+     DeleteFile (text2);
+  if (bin)
+     DeleteFile (bin);
+  FREE (text1);
+  FREE (text2);
+  FREE (bin);
+}
+
+/**
+ * Test the journal:
+ *  \li A run with a few changes must only append to the journal-file.
+ *  \li The next run must see these changes.
+ *  \li A compaction must put them into the cache-file and delete the journal-file.
+ *
+ * Uses a temporary cache-file. The state of the current cache is saved and restored around it.
+ */
+static void cache_test_journal (void)
+{
+  CACHE       save = cache;
+  char       *file = create_temp_file();
+  char        journal [_MAX_PATH];
+  char        lock [_MAX_PATH];
+  const char *v1, *v2;
+  bool        ok1, ok2, ok3;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+  if (!file)
+     return;
+
+  snprintf (journal, sizeof(journal), "%s.journal", file);
+  snprintf (lock, sizeof(lock), "%s.lock", file);
+  DeleteFile (file);
+  DeleteFile (journal);
+
+  /* 1st run: put 2 keys and delete one. Only the journal is written.
+   */
+  memset (&cache, '\0', sizeof(cache));
+  cache.filename = STRDUP (file);
+  cache.journal  = true;
+  cache_init();
+  cache_put (SECTION_CMAKE, "journal_key1", "value1");
+  cache_put (SECTION_CMAKE, "journal_key2", "value2");
+  cache_del (SECTION_CMAKE, "journal_key1");
+  cache_exit();
+  ok1 = (FILE_EXISTS(journal) && !FILE_EXISTS(file));
+
+  /* 2nd run: the changes are replayed. Force a compaction.
+   */
+  memset (&cache, '\0', sizeof(cache));
+  cache.filename    = STRDUP (file);
+  cache.journal     = true;
+  cache.journal_max = 1;
+  cache_init();
+  v1  = cache_get (SECTION_CMAKE, "journal_key1");
+  v2  = cache_get (SECTION_CMAKE, "journal_key2");
+  ok2 = (!v1 && v2 && !strcmp(v2, "value2"));
+  cache_exit();
+
+  /* 3rd run: no journal. The value must be in the cache-file.
+   */
+  memset (&cache, '\0', sizeof(cache));
+  cache.filename = STRDUP (file);
+  cache_init();
+  v2  = cache_get (SECTION_CMAKE, "journal_key2");
+  ok3 = (!FILE_EXISTS(journal) && FILE_EXISTS(file) && v2 && !strcmp(v2, "value2"));
+  cache.testing = true;
+  cache_exit();
+
+  cache = save;
+  C_printf ("  journal only: %s~0, replayed: %s~0, compacted: %s~0.\n\n",
+            ok1 ? "~2OKAY" : "~5FAILED", ok2 ? "~2OKAY" : "~5FAILED", ok3 ? "~2OKAY" : "~5FAILED");
+
+  DeleteFile (file);
+  DeleteFile (journal);
+  DeleteFile (lock);
+  FREE (file);
+}
+
+/**
+ * Test `cache.hash_table` with random puts and deletes in `SECTION_TEST`.
+ * Check each `cache_get()` against a simple array of the expected values.
+ * And check that `cache_node::idx` matches the place in `cache.entries`.
+ */
+static void cache_test_hash (void)
+{
+  int   expect [1000];
+  DWORD seed = 1;
+  int   i, max, errors = 0;
+  const int num_keys = DIM(expect), num_ops = 50000;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  memset (&expect, '\0', sizeof(expect));
+  for (i = 0; i < num_ops; i++)
+  {
+    const char *value;
+    char  key [20], val [20];
+    int   k;
+
+    seed = 1103515245 * seed + 12345;
+    k = (seed >> 8) % num_keys;
+    snprintf (key, sizeof(key), "hash_%d", k);
+
+    if ((seed >> 20) % 3 == 0)
+    {
+      cache_del (SECTION_TEST, key);
+      expect [k] = 0;
+    }
+    else
+    {
+      snprintf (val, sizeof(val), "%d", i + 1);
+      cache_put (SECTION_TEST, key, val);
+      expect [k] = i + 1;
+    }
+
+    k = (seed >> 4) % num_keys;
+    snprintf (key, sizeof(key), "hash_%d", k);
+    value = cache_get (SECTION_TEST, key);
+    if (value ? (atoi(value) != expect[k]) : (expect[k] != 0))
+       errors++;
+  }
+
+  max = smartlist_len (cache.entries);
+  for (i = 0; i < max; i++)
+  {
+    const cache_node *c = smartlist_get (cache.entries, i);
+
+    if (c->idx != i)
+       errors++;
+  }
+  if (cache.hash_used != (DWORD)max)
+     errors++;
+
+  C_printf ("  %d random puts/deletes: %s~0. Average %.2f probes per lookup.\n\n",
+            num_ops, errors == 0 ? "~2OKAY" : "~5FAILED",
+            cache.lookups ? (double)cache.probes / (double)cache.lookups : 0.0);
+
+  for (i = 0; i < num_keys; i++)
+      cache_delf (SECTION_TEST, "hash_%d", i);
+}
+
+/**
+ * Show the memory used by `cache.arena` for many keys like `python_modules%d_%d`.
+ * Compare it to the old layout with a fixed `key [CACHE_MAX_KEY]` in each
+ * `MALLOC()`-ed node and a `STRDUP()` of each value.
+ */
+static void cache_test_arena (void)
+{
+  struct old_cache_node {
+         CacheSections section;
+         char          key [CACHE_MAX_KEY];
+         char         *value;
+         bool          mapped;
+         DWORD         hash;
+         int           idx;
+       };
+  CACHE  save = cache;
+  size_t old_bytes = 0;
+  int    i, j, num = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  memset (&cache, '\0', sizeof(cache));
+  cache.entries = smartlist_new();
+
+  C_puts ("  Before:\n");
+  mem_report();
+
+  for (i = 0; i < 10; i++)
+  {
+    for (j = 0; j < 5000; j++, num++)
+    {
+      char value [100];
+
+      snprintf (value, sizeof(value), "module_%d,1.%d.%d,0,c:\\Python3%d\\Lib\\site-packages,-", j, i, j, i);
+      cache_putf (SECTION_PYTHON, "python_modules%d_%d = %s", i, j, value);
+      old_bytes += sizeof(struct old_cache_node) + strlen(value) + 1;
+    }
+  }
+
+  C_printf ("  After %d keys:\n", num);
+  mem_report();
+
+  C_printf ("  cache.arena: %lu kB in %d allocations. Before: %lu kB in %d allocations.\n",
+            (unsigned long)(cache.arena_size / 1024), smartlist_len(cache.arena),
+            (unsigned long)(old_bytes / 1024), 2*num);
+
+  smartlist_free (cache.entries);
+  cache_hash_free();
+  cache_arena_free();
+
+  C_printf ("%s~0 cache_arena_free() reset the arena statistics.\n\n",
+            (cache.arena_size == 0 && cache.arena_used == 0 && cache.intern_hits == 0) ? "~2  OK  " : "~5  FAIL");
+  cache = save;
+}
+
+/**
+ * One writer-process in `cache_test_multi()`.
+ * Put `num` keys in `SECTION_CMAKE` into the cache-file `file` over `CACHE_TEST_RUNS`
+ * runs of `cache_init()` and `cache_exit()`. With `journal_max > 0`, use a journal.
+ */
+#define CACHE_TEST_RUNS     4
+#define CACHE_TEST_WRITERS  8
+
+static void cache_test_writer_run (const char *file, int id, int num, int journal_max)
+{
+  CACHE save = cache;
+  int   i, run;
+
+  for (run = 0; run < CACHE_TEST_RUNS; run++)
+  {
+    memset (&cache, '\0', sizeof(cache));
+    cache.filename    = STRDUP (file);
+    cache.journal     = (journal_max > 0);
+    cache.journal_max = journal_max;
+    cache_init();
+    for (i = run; i < num; i += CACHE_TEST_RUNS)
+        cache_putf (SECTION_CMAKE, "writer_%d_%d = %d", id, i, i);
+    cache_exit();
+  }
+  cache = save;
+}
+
+/**
+ * Called first in `do_tests()`. If this program was started as a writer by
+ * `cache_test_spawn()`, run it and return `true`.
+ */
+bool cache_test_writer (void)
+{
+  const char *env = getenv ("ENVTOOL_CACHE_WRITER");
+  char        file [_MAX_PATH];
+  int         id, num, journal_max;
+
+  if (!env || sscanf(env, "%d,%d,%d,%259[^\n]", &id, &num, &journal_max, file) != 4)
+     return (false);
+
+  cache_test_writer_run (file, id, num, journal_max);
+  return (true);
+}
+
+/**
+ * Start a writer-process for `cache_test_multi()`.
+ *
+ * Run this program again as `envtool --test` with the writer arguments
+ * in the environment. See `cache_test_writer()`.
+ */
+static intptr_t cache_test_spawn (const char *file, int id, int num, int journal_max)
+{
+  char     exe [_MAX_PATH];
+  char     env [_MAX_PATH + 50];
+  intptr_t child;
+
+  if (!GetModuleFileName(NULL, exe, sizeof(exe)))
+     return (-1);
+
+  snprintf (env, sizeof(env), "ENVTOOL_CACHE_WRITER=%d,%d,%d,%s", id, num, journal_max, file);
+  _putenv (env);
+  child = _spawnl (_P_NOWAIT, exe, exe, "--test", NULL);
+  _putenv ("ENVTOOL_CACHE_WRITER=");
+  return (child);
+}
+
+/**
+ * Wait for a writer-process started by `cache_test_spawn()`.
+ */
+static bool cache_test_wait (intptr_t child)
+{
+  int status = -1;
+
+  if (_cwait(&status, child, 0) == -1)
+     return (false);
+  return (status == 0);
+}
+
+/**
+ * A stress-test for several processes using the same cache-file.
+ *
+ * Start `CACHE_TEST_WRITERS` processes adding different keys to a temporary cache-file.
+ * Without a journal and with a small journal (to mix appends and compactions).
+ * Then check that no keys were lost.
+ */
+static void cache_test_multi (void)
+{
+  const int num_keys = 200;
+  int       pass;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    CACHE    save = cache;
+    char    *file = create_temp_file();
+    char     name [_MAX_PATH];
+    intptr_t child [CACHE_TEST_WRITERS];
+    int      i, j, journal_max = pass ? 2000 : 0;
+    int      spawned = 0, failed = 0, missing = 0;
+    double   start;
+
+    if (!file)
+       return;
+
+    start = bench_time();
+    for (i = 0; i < CACHE_TEST_WRITERS; i++)
+    {
+      child[i] = cache_test_spawn (file, i, num_keys, journal_max);
+      if (child[i] == -1)
+         TRACE (1, "Failed to start writer %d.\n", i);
+      else spawned++;
+    }
+    for (i = 0; i < CACHE_TEST_WRITERS; i++)
+    {
+      if (child[i] != -1 && !cache_test_wait(child[i]))
+         failed++;
+    }
+
+    memset (&cache, '\0', sizeof(cache));
+    cache.filename = STRDUP (file);
+    cache_init();
+    for (i = 0; i < CACHE_TEST_WRITERS; i++)
+    {
+      for (j = 0; j < num_keys; j++)
+      {
+        char        key [50];
+        const char *val;
+
+        snprintf (key, sizeof(key), "writer_%d_%d", i, j);
+        val = cache_get (SECTION_CMAKE, key);
+        if (!val || atoi(val) != j)
+           missing++;
+      }
+    }
+    cache.testing = true;
+    cache_exit();
+    cache = save;
+
+    C_printf ("  %d writers, %s: %d keys missing, %d writers failed: %s~0 (%.3f sec).\n",
+              spawned, journal_max ? "journal" : "no journal", missing, failed,
+              (spawned == CACHE_TEST_WRITERS && failed == 0 && missing == 0) ? "~2OKAY" : "~5FAILED",
+              bench_time() - start);
+
+    DeleteFile (file);
+    snprintf (name, sizeof(name), "%s.journal", file);
+    DeleteFile (name);
+    snprintf (name, sizeof(name), "%s.lock", file);
+    DeleteFile (name);
+    FREE (file);
+  }
+  C_putc ('\n');
+}
+
+/**
+ * Test `cache_getf_run()` with a value that is too long and a value
+ * with missing fields.
+ */
+static void cache_test_getf_run_limits (void)
+{
+  cache_getf_desc *desc = cache_getf_compile ("%s,%d,%d");
+  char            *long_value = MALLOC (CACHE_MAX_VALUE + 2);
+  char            *s = "x";
+  int              d1 = -1, d2 = -1, rc_long, rc_short;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  memset (long_value, 'x', CACHE_MAX_VALUE + 1);
+  long_value [CACHE_MAX_VALUE + 1] = '\0';
+  cache_put (SECTION_TEST, "long_value", long_value);
+  rc_long = cache_getf_run (desc, SECTION_TEST, "long_value", &s, &d1, &d2);
+
+  C_printf ("%s~0 too long value -> rc: %d.\n", rc_long == 0 ? "~2  OK  " : "~5  FAIL", rc_long);
+
+  cache_put (SECTION_TEST, "short_value", "abc,42");
+  rc_short = cache_getf_run (desc, SECTION_TEST, "short_value", &s, &d1, &d2);
+
+  C_printf ("%s~0 missing field -> rc: %d, s: '%s', d1: %d, d2: %d.\n\n",
+            (rc_short == 3 && s && !strcmp(s, "abc") && d1 == 42 && d2 == 0) ? "~2  OK  " : "~5  FAIL",
+            rc_short, s ? s : "<null>", d1, d2);
+
+  cache_del (SECTION_TEST, "long_value");
+  cache_del (SECTION_TEST, "short_value");
+  cache_getf_free (desc);
+  FREE (long_value);
+}
+
+/**
+ * Compare `cache_getf_run()` against `cache_getf()` for `num` keys in `SECTION_TEST`.
+ * Both must return the same values. Print the time for each.
+ */
+static void cache_test_getf_run (void)
+{
+  cache_getf_desc *desc;
+  double           t_getf, t_run;
+  int              i, rc1, rc2, loop, same = 1;
+  const int        num = 5000, loops = 10;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < num; i++)
+      cache_putf (SECTION_TEST, "bench_%d = pkg_%d,%d,1,0.7.%d,https://example.org/%d,\"A library, with a comma\"",
+                  i, i, i & 1, i, i);
+
+  desc = cache_getf_compile ("%s,%d,%d,%s,%s,%s");
+
+  t_getf = t_run = 0.0;
+  for (loop = 0; loop < loops; loop++)
+  {
+    for (i = 0; i < num; i++)
+    {
+      char   format [100], key [100];
+      char  *s1 [4], *s2 [4];
+      int    d1 [2], d2 [2], j;
+      double now;
+
+      snprintf (format, sizeof(format), "bench_%d = %%s,%%d,%%d,%%s,%%s,%%s", i);
+      now = bench_time();
+      rc1 = cache_getf (SECTION_TEST, format, &s1[0], &d1[0], &d1[1], &s1[1], &s1[2], &s1[3]);
+      t_getf += bench_time() - now;
+
+      snprintf (key, sizeof(key), "bench_%d", i);
+      now = bench_time();
+      rc2 = cache_getf_run (desc, SECTION_TEST, key, &s2[0], &d2[0], &d2[1], &s2[1], &s2[2], &s2[3]);
+      t_run += bench_time() - now;
+
+      if (rc1 != 6 || rc1 != rc2 || d1[0] != d2[0] || d1[1] != d2[1])
+         same = 0;
+      for (j = 0; same && j < DIM(s1); j++)
+          if (strcmp(s1[j], s2[j]))
+             same = 0;
+    }
+  }
+
+  C_printf ("%s~0 %d lookups. cache_getf(): %.3f sec, cache_getf_run(): %.3f sec (%.1f times faster).\n\n",
+            same ? "~2  OK  " : "~5  FAIL", num * loops, t_getf, t_run, t_run > 0.0 ? t_getf / t_run : 0.0);
+
+  cache_getf_free (desc);
+  for (i = 0; i < num; i++)
+      cache_delf (SECTION_TEST, "bench_%d", i);
+}
+
 /**
  * A simple test for all of the above.
  */
@@ -1141,6 +2687,19 @@ void cache_test (void)
 
   cache_test_getf();   /* Now, read them back */
   cache_test_dump();   /* and dump the entries in SECTION_TEST */
+  cache_test_convert();
+  cache_test_journal();
+  cache_test_hash();
+  cache_test_getf_run_limits();
+
+  /* Run the benchmarks on `envtool -tt`
+   */
+  if (opt.do_tests >= 2)
+  {
+    cache_test_getf_run();
+    cache_test_arena();
+    cache_test_multi();
+  }
 
   /*
    * Test overflow of 'CACHE_MAX_ARGS == 12':
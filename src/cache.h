@@ -27,9 +27,20 @@ typedef enum CacheSections {
              SECTION_LAST         /* Do not use this */
            } CacheSections;
 
+/**
+ * \typedef CacheFormat
+ *
+ * The formats of the cache-file. Selected by `cache.format = text|binary` in `envtool.cfg`.
+ */
+typedef enum CacheFormat {
+             CACHE_FORMAT_TEXT = 0,  /**< `key = value` lines in `[section]`s. The default. */
+             CACHE_FORMAT_BINARY     /**< A sorted index and a string blob. Memory-mapped when read. */
+           } CacheFormat;
+
 extern void        cache_init   (void);
 extern void        cache_exit   (void);
 extern void        cache_test   (void);
+extern bool        cache_test_writer (void);
 extern bool        cache_config (const char *key, const char *value);
 extern void        cache_put    (CacheSections section, const char *key, const char *value);
 extern void        cache_putf   (CacheSections section, _Printf_format_string_ const char *fmt, ...) ATTR_PRINTF(2, 3);
@@ -37,4 +48,16 @@ extern const char *cache_get    (CacheSections section, const char *key);
 extern int         cache_getf   (CacheSections section, const char *fmt, ...);
 extern void        cache_del    (CacheSections section, const char *key);
 extern void        cache_delf   (CacheSections section, _Printf_format_string_ const char *fmt, ...) ATTR_PRINTF(2, 3);
+extern bool        cache_convert (const char *from_file, const char *to_file, CacheFormat format);
+
+/**
+ * \typedef cache_getf_desc
+ *
+ * An opaque value-format compiled once by `cache_getf_compile()`.
+ */
+typedef struct cache_getf_desc cache_getf_desc;
+
+extern cache_getf_desc *cache_getf_compile (const char *fmt);
+extern int              cache_getf_run     (cache_getf_desc *desc, CacheSections section, const char *key, ...);
+extern void             cache_getf_free    (cache_getf_desc *desc);
 
@@ -552,6 +552,30 @@ size_t C_flush (void)
   return (len2);
 }
 
+/**
+ * Write `len` bytes as is. No "~n" interpretation and no buffering.
+ * Anything in the trace-buffer is written first.
+ */
+size_t C_write (const char *buf, size_t len)
+{
+  size_t rc;
+
+  if (!c_out)  /* before C_init() was called */
+  {
+    rc = fwrite (buf, 1, len, stdout);
+    fflush (stdout);
+    return (rc);
+  }
+
+  C_flush();
+  EnterCriticalSection (&crit);
+  if (C_use_fwrite)
+       rc = fwrite (buf, 1, len, c_out);
+  else rc = _write (_fileno(c_out), buf, (unsigned int)len);
+  LeaveCriticalSection (&crit);
+  return (rc);
+}
+
 /**
  * An printf() style console print function.
  */
@@ -61,6 +61,7 @@ extern int    C_putc_raw (int ch);
 extern int    C_setraw   (int raw);
 extern int    C_setbin   (int bin);
 extern size_t C_flush    (void);
+extern size_t C_write    (const char *buf, size_t len);
 extern void   C_reset    (void);
 extern void   C_init     (void);
 extern void   C_exit     (void);
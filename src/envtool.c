@@ -122,6 +122,7 @@ static void get_evry_bitness (HWND wnd);
 
 static void  usage (const char *fmt, ...) ATTR_PRINTF(1,2);
 static void  do_check (void);
+static int   process_dir_list (smartlist_t *list, const char *prefix, HKEY key);
 
 /**
  * \todo Add support for *kpathsea*-like path searches (which some TeX programs uses). <br>
@@ -527,7 +528,11 @@ static int show_help (void)
 
   C_puts ("  ~6[options]~0\n"
           "    ~6--descr~0        show 4NT/TCC file-description.\n"
-          "    ~6--grep~0=~3content~0 search found file(s) for ~3content~0 also.\n"
+          "    ~6--grep~0=~3content~0 search found file(s) for ~3content~0 also. Can be repeated.\n"
+          "    ~6--grep-file~0=~3file~0 search found file(s) for each line in ~3file~0.\n"
+          "    ~6--grep-regex~0=~3re~0 search found file(s) for the extended regular expression ~3re~0.\n"
+          "    ~6--json~0         print the found file(s) as a JSON array. One object per file.\n"
+          "    ~6--ndjson~0       print the found file(s) as newline-delimited JSON. One object per line.\n"
           "    ~6--no-ansi~0      don't print colours using ANSI sequences.\n"
           "    ~6--no-app~0       don't scan ~3HKCU\\" REG_APP_PATH "~0 and\n"
           "                              ~3HKLM\\" REG_APP_PATH "~0.\n"
@@ -552,6 +557,7 @@ static int show_help (void)
           "    ~6-c~0, ~6--case~0     be case-sensitive.\n"
           "    ~6-d~0, ~6--debug~0    set debug level (level 2, ~3-dd~0 sets ~3PYTHONVERBOSE=1~0 in ~6--python~0 mode).\n"
           "    ~6-D~0, ~6--dir~0      looks only for directories matching ~6<file-spec>~0.\n"
+          "    ~6-j~0, ~6--jobs~0 ~3N~0   scan the directories and grep the files using ~3N~0 threads (~30~0 = one per CPU, default ~31~0).\n"
           "    ~6-k~0, ~6--keep~0     keep temporary files used in ~6--python~0 mode.\n"
           "    ~6-o~0, ~6--only~0     show only files that matches the ~6--grep~0 ~3content~0 \n");
 
@@ -570,7 +576,10 @@ static int show_help (void)
 
   C_puts ("    ~6--evry~0 remote FTP options:\n"
           "      ~6-H~0, ~6--host~0    hostname/IPv4-address. Can be used multiple times.\n"
-          "                    alternative syntax is ~6--evry:<host>~0.\n");
+          "                    alternative syntax is ~6--evry:<host>~0.\n"
+          "      ~6--spec~0 ~3spec~0   another file-spec to search for in the same session(s).\n"
+          "                    Can be used multiple times.\n"
+          "      ~6--refresh~0     do not use cached results; query the host(s) again.\n");
 
   C_puts ("\n"
           "  ~2[1]~0 The ~6--evry~0 option requires that the Everything search engine is installed.\n"
@@ -641,6 +650,7 @@ static int show_help (void)
   C_puts ("\n"
           "  Notes:\n"
           "    Option ~6-c~0 applies both to the ~6<file-spec>~0 and the ~6--grep=content~0.\n"
+          "    Option ~6--grep~0 also searches inside ~6.gz~0 files and the members of ~6.egg~0, ~6.whl~0 and ~6.zip~0 files.\n"
           "    ~6<file-spec>~0 accepts Posix ranges. E.g. \"~6[a-f]*.txt~0\".\n"
           "    ~6<file-spec>~0 matches both files and directories. If ~6-D~0/~6--dir~0 is used, only\n"
           "                matching directories are reported.\n"
@@ -673,8 +683,14 @@ static directory_array *dir_array_add_or_insert (const char *dir, bool is_cwd, b
   bool   exists = false;
   bool   is_dir = false;
 
+  d->num_entries = -1;
+
   if (!opt.lua_mode && safe_stat(dir, &st, NULL) == 0)
-     is_dir = exists = _S_ISDIR (st.st_mode);
+  {
+    is_dir = exists = _S_ISDIR (st.st_mode);
+    d->mtime = st.st_mtime;
+    d->size  = (DWORD) st.st_size;
+  }
 
   d->cyg_dir  = NULL;
   d->dir      = STRDUP (dir);
@@ -758,6 +774,20 @@ static void _reg_array_free (void *_r)
   FREE (r);
 }
 
+/**
+ * `smartlist_wipe()` helper for a `directory_array::dirent2` smartlist.
+ * Not called for a smartlist from `get_matching_files()` since it is arena-backed.
+ *
+ * \param[in] _de  The item in the `dirent2` smartlist to free.
+ */
+static void dirent2_wiper (void *_de)
+{
+  struct dirent2 *de = (struct dirent2*) _de;
+
+  FREE (de->d_name);
+  FREE (de);
+}
+
 /**
  * `smartlist_wipe()` and `smartlist_make_uniq()` helper.
  *
@@ -766,16 +796,12 @@ static void _reg_array_free (void *_r)
 void dir_array_wiper (void *_d)
 {
   directory_array *d = (directory_array*) _d;
-  int i, max = d->dirent2 ? smartlist_len (d->dirent2) : 0;
 
-  for (i = 0; i < max; i++)
+  if (d->dirent2)
   {
-    struct dirent2 *de = smartlist_get (d->dirent2, i);
-
-    FREE (de->d_name);
-    FREE (de);
+    smartlist_wipe (d->dirent2, dirent2_wiper);
+    smartlist_free (d->dirent2);
   }
-  smartlist_free (d->dirent2);
 
   FREE (d->dir);
   FREE (d->cyg_dir);
@@ -1396,16 +1422,8 @@ static void scan_reg_environment (HKEY top_key, const char *sub_key,
 static int do_check_env2 (HKEY key, const char *env, const char *value)
 {
   smartlist_t *list = split_env_var (env, value);
-  int          found = 0;
-  int          i, max = list ? smartlist_len (list) : 0;
+  int          found = process_dir_list (list, env, key);
 
-  for (i = 0; i < max; i++)
-  {
-    const directory_array *arr = smartlist_get (list, i);
-
-    found += process_dir (arr->dir, arr->num_dup, arr->exist, arr->check_empty,
-                          arr->is_dir, arr->exp_ok, env, key);
-  }
   dir_array_free();
   return (found);
 }
@@ -1517,13 +1535,12 @@ static int do_check_registry (void)
 }
 
 /**
- * Check if directory is empty (no files or directories except
- * `"."` and `".."`).
+ * Count the entries in a directory (files or directories except
+ * `"."` and `".."`). Stop counting at `max_entries` if that is > 0.
  *
- * \note It is quite normal that e.g. `"%INCLUDE"` contain a directory with
- *       no .h-files but at least 1 subdirectory with .h-files.
+ * \retval -1 if the directory could not be read.
  */
-static bool dir_is_empty (const char *dir)
+static int dir_count_entries (const char *dir, int max_entries)
 {
   HANDLE          handle;
   WIN32_FIND_DATA ff_data;
@@ -1533,130 +1550,294 @@ static bool dir_is_empty (const char *dir)
   snprintf (path, sizeof(path), "%s\\*", dir);
   handle = FindFirstFile (path, &ff_data);
   if (handle == INVALID_HANDLE_VALUE)
-     return (false);    /* We really can't tell */
+     return (-1);       /* We really can't tell */
 
   do
   {
     if (strcmp(ff_data.cFileName, ".") && strcmp(ff_data.cFileName, ".."))
        num_entries++;
   }
-  while (num_entries == 0 && FindNextFile(handle, &ff_data));
+  while ((max_entries <= 0 || num_entries < max_entries) && FindNextFile(handle, &ff_data));
 
-  TRACE (3, "%s(): at least %d entries in '%s'.\n", __FUNCTION__, num_entries, dir);
   FindClose (handle);
-  return (num_entries == 0);
+  return (num_entries);
+}
+
+/**
+ * Check if directory is empty (no files or directories except
+ * `"."` and `".."`).
+ *
+ * \note It is quite normal that e.g. `"%INCLUDE"` contain a directory with
+ *       no .h-files but at least 1 subdirectory with .h-files.
+ */
+static bool dir_is_empty (const char *dir)
+{
+  return (dir_count_entries(dir, 1) == 0);
+}
+
+/**
+ * \typedef scan_match
+ * A file or directory found by `process_dir_scan()` that should be
+ * given to `report_file()` later.
+ */
+typedef struct scan_match {
+        char   *file;         /**< the fully qualified file-name */
+        time_t  mtime;        /**< it's modification time */
+        UINT64  fsize;        /**< and size */
+        bool    is_dir;       /**< it's a directory */
+        bool    is_junction;  /**< it's a junction (reparse-point) */
+      } scan_match;
+
+/**
+ * \typedef dir_scan
+ * The arguments and results of scanning one directory.
+ *
+ * The scanning is done by `process_dir_scan()` (possibly in a worker-thread).
+ * The warnings and results are printed by `process_dir_report()` in the main-thread.
+ */
+typedef struct dir_scan {
+        char         path [_MAX_PATH];  /**< copy of the directory without any trailing slash */
+        int          num_dup;           /**< the `process_dir()` arguments */
+        bool         exist;
+        bool         check_empty;
+        bool         is_dir;
+        bool         exp_ok;
+        const char  *prefix;
+        HKEY         key;
+        bool         is_empty;          /**< result of `dir_is_empty()` */
+        smartlist_t *matches;           /**< list of `scan_match*` */
+        smartlist_t *traces;            /**< the `DS_TRACE()` messages for `process_dir_report()` */
+        HANDLE       done;              /**< event set when the scan is complete (if parallel) */
+      } dir_scan;
+
+/**
+ * \def DS_TRACE(ds, level, ...)
+ * Like `TRACE()`, but save the message in `ds->traces`.
+ * The worker-threads must not print; `process_dir_report()` prints them in the main-thread.
+ */
+#define DS_TRACE(ds, level, ...)  do {                                             \
+                                    if (opt.debug >= level)                        \
+                                       process_dir_trace (ds, __LINE__, __VA_ARGS__); \
+                                  } while (0)
+
+/**
+ * \typedef dir_scan_pool
+ * The work-queue shared by the `process_dir_worker()` threads.
+ */
+typedef struct dir_scan_pool {
+        dir_scan     *scans;  /**< the directories to scan; in the original order */
+        LONG          num;    /**< number of elements in `scans` */
+        volatile LONG next;   /**< index of the next `scans[]` to take */
+      } dir_scan_pool;
+
+/*
+ * We need to set these only once; `opt.file_spec` is constant throughout the program.
+ * Set by the main-thread in `process_dir_spec()` before any worker-thread is started.
+ */
+static char         *file_fspec  = NULL;
+static char         *file_subdir = NULL;  /* Looking for a `opt.file_spec` with a sub-dir part in it. */
+static fnmatch_prog *file_match  = NULL;  /* `opt.file_spec` compiled for `fnmatch_exec()` */
+
+static void process_dir_spec (void)
+{
+  if (!file_fspec)
+     file_fspec = (opt.use_regex ? "*" : fix_filespec(&file_subdir));
+  if (!file_match && !opt.use_regex)
+     file_match = fnmatch_compile (opt.file_spec, fnmatch_case(0) | FNM_FLAG_NOESCAPE);
+}
+
+static void process_dir_init (dir_scan *ds, const char *path, int num_dup, bool exist, bool check_empty,
+                              bool is_dir, bool exp_ok, const char *prefix, HKEY key)
+{
+  char *end;
+
+  memset (ds, '\0', sizeof(*ds));
+  _strlcpy (ds->path, path, sizeof(ds->path));
+  end = strrchr (ds->path, '\0');
+  if (end > ds->path && IS_SLASH(end[-1]))
+     end[-1] = '\0';
+
+  ds->num_dup     = num_dup;
+  ds->exist       = exist;
+  ds->check_empty = check_empty;
+  ds->is_dir      = is_dir;
+  ds->exp_ok      = exp_ok;
+  ds->prefix      = prefix;
+  ds->key         = key;
+}
+
+/**
+ * Format a `DS_TRACE()` message with the same prefix as `TRACE()` and save it in `ds->traces`.
+ */
+static void process_dir_trace (dir_scan *ds, int line, const char *fmt, ...)
+{
+  char    buf [_MAX_PATH+200];
+  int     len;
+  va_list args;
+
+  len = snprintf (buf, sizeof(buf), "%s(%d): ", __FILE(), line);
+  va_start (args, fmt);
+  vsnprintf (buf + len, sizeof(buf) - len, fmt, args);
+  va_end (args);
+
+  if (!ds->traces)
+     ds->traces = smartlist_new();
+  smartlist_add_strdup (ds->traces, buf);
 }
 
 /**
  * Try to match `str` against the global regular expression in `opt.file_spec`.
+ *
+ * \note Called from the `process_dir_worker()` threads too. Hence use only
+ *       locals for the matches and error-code; `regexec()` is reentrant.
+ *       And save the traces in `ds`.
  */
-static bool regex_match (const char *str)
+static bool regex_match (dir_scan *ds, const char *str)
 {
-  memset (&re_matches, '\0', sizeof(re_matches));
-  re_err = regexec (&re_hnd, str, DIM(re_matches), re_matches, 0);
-  TRACE (3, "regex() pattern '%s' against '%s'. re_err: %d\n", opt.file_spec, str, re_err);
+  regmatch_t matches [DIM(re_matches)];
+  char       errbuf [sizeof(re_errbuf)];
+  int        err;
 
-  if (re_err == REG_NOMATCH)
+  memset (&matches, '\0', sizeof(matches));
+  err = regexec (&re_hnd, str, DIM(matches), matches, 0);
+  DS_TRACE (ds, 3, "regex() pattern '%s' against '%s'. re_err: %d\n", opt.file_spec, str, err);
+
+  if (err == REG_NOMATCH)
      return (false);
 
-  if (re_err == REG_NOERROR)
+  if (err == REG_NOERROR)
      return (true);
 
-  regerror (re_err, &re_hnd, re_errbuf, sizeof(re_errbuf));
-  TRACE (0, "Error while matching \"%s\": %d\n", str, re_err);
+  regerror (err, &re_hnd, errbuf, sizeof(errbuf));
+  DS_TRACE (ds, 0, "Error while matching \"%s\": %d (%s)\n", str, err, errbuf);
   return (false);
 }
 
 /**
- * Process directory specified by `path` and report any matches
- * to the global `opt.file_spec`.
+ * The `safe_stat()` for `process_dir_scan()`. Uses `safe_stat_quiet()`
+ * and saves the trace in `ds`.
  */
-int process_dir (const char *path, int num_dup, bool exist, bool check_empty,
-                 bool is_dir, bool exp_ok, const char *prefix, HKEY key)
+static int process_dir_stat (dir_scan *ds, const char *file, struct stat *st)
 {
-  HANDLE          handle;
-  WIN32_FIND_DATA ff_data;
-  bool            ff_more;
-  char            fqfn  [_MAX_PATH];  /* Fully qualified file-name */
-  char            _path [_MAX_PATH];  /* Copy of 'path' */
-  int             found = 0;
-  bool            ignore = false;
-  char           *end;
+  DWORD win_err;
+  int   rc = safe_stat_quiet (file, st, &win_err);
 
-  /* We need to set these only once; `opt.file_spec` is constant throughout the program.
-   */
-  static char *fspec  = NULL;
-  static char *subdir = NULL;  /* Looking for a `opt.file_spec` with a sub-dir part in it. */
-
-  _strlcpy (_path, path, sizeof(_path));
-  end = strrchr (_path, '\0');
-  if (end > _path && IS_SLASH(end[-1]))
-     end[-1] = '\0';
+  if (rc != 0)
+     DS_TRACE (ds, 1, "file: '%s', err: %lu.\n", file, (unsigned long)win_err);
+  return (rc);
+}
 
-  if (prefix && !stricmp(prefix, "PATH"))
-     ignore = cfg_ignore_lookup ("[Path]", _path);
+/**
+ * The `get_actual_filename()` for `process_dir_scan()`. Convert `fqfn` to
+ * it's true name in place and save the traces in `ds`.
+ * `get_actual_filename()` uses `TRACE()` and a static error-buffer.
+ *
+ * etval true  if `fqfn` was converted.
+ */
+static bool process_dir_actual_name (dir_scan *ds, char *fqfn, size_t size)
+{
+  char        sfn [_MAX_PATH];
+  char        lfn [_MAX_PATH];
+  const char *file = fqfn;
 
-  if (num_dup > 0)
+  if (!strchr(fqfn, '~'))
   {
-#if 0     /* \todo */
-    WARN2 ("%s: directory \"%s\" is duplicated at position %d. Skipping.\n", prefix, _path, dup_pos);
-#else
-    WARN2 ("%s: directory \"%s\" is duplicated. Skipping.\n", prefix, _path);
-#endif
-    return (0);
+    if (GetShortPathName(fqfn, sfn, sizeof(sfn)) == 0)
+    {
+      DS_TRACE (ds, 1, "fqfn: '%s' failed: %lu\n", fqfn, (unsigned long)GetLastError());
+      return (false);
+    }
+    file = sfn;
   }
 
-  if (!exp_ok)
+  if (GetLongPathName(file, lfn, sizeof(lfn)) == 0)
   {
-    WARN ("%s: directory \"%s\" has an unexpanded value.\n", prefix, _path);
-    return (0);
+    DS_TRACE (ds, 1, "file: '%s' failed: %lu\n", file, (unsigned long)GetLastError());
+    return (false);
   }
+  slashify2 (lfn, lfn, opt.show_unix_paths ? '/' : '\\');
+  _strlcpy (fqfn, lfn, size);
+  return (true);
+}
 
-  if (!exist)
-  {
-    WARN2 ("%s: directory \"%s\" does not exist.\n", prefix, _path);
-    return (0);
-  }
+static void process_dir_add_match (dir_scan *ds, const char *file, const struct stat *st,
+                                   bool is_dir, bool is_junction)
+{
+  scan_match *m = MALLOC (sizeof(*m));
+
+  m->file        = STRDUP (file);
+  m->mtime       = st->st_mtime;
+  m->fsize       = st->st_size;
+  m->is_dir      = is_dir;
+  m->is_junction = is_junction;
+  smartlist_add (ds->matches, m);
+}
 
-  if (!is_dir)
-     WARN2 ("%s: directory \"%s\" isn't a directory.\n", prefix, _path);
+static void process_dir_free (dir_scan *ds)
+{
+  int i, max = ds->matches ? smartlist_len (ds->matches) : 0;
 
-  if (!opt.file_spec)
+  for (i = 0; i < max; i++)
   {
-    TRACE (1, "\n");
-    return (0);
+    scan_match *m = smartlist_get (ds->matches, i);
+
+    FREE (m->file);
+    FREE (m);
   }
+  smartlist_free (ds->matches);
+  ds->matches = NULL;
+  smartlist_free_all (ds->traces);
+  ds->traces = NULL;
+}
 
-  if (check_empty && is_dir && dir_is_empty(_path))
-     WARN2 ("%s: directory \"%s\" is empty.\n", prefix, _path);
+/**
+ * Scan the directory in `ds->path` and collect any matches to the
+ * global `opt.file_spec` in `ds->matches`.
+ *
+ * Does no printing. The traces are saved by `DS_TRACE()`. Hence it can run in a worker-thread.
+ */
+static void process_dir_scan (dir_scan *ds)
+{
+  HANDLE          handle;
+  WIN32_FIND_DATA ff_data;
+  bool            ff_more;
+  char            fqfn [_MAX_PATH];  /* Fully qualified file-name */
+  const char     *_path = ds->path;
+
+  ds->matches = smartlist_new();
+
+  if (ds->num_dup > 0 || !ds->exp_ok || !ds->exist || !opt.file_spec)
+     return;
 
-  if (!fspec)
-     fspec = (opt.use_regex ? "*" : fix_filespec(&subdir));
+  if (ds->check_empty && ds->is_dir)
+  {
+    ds->is_empty = dir_is_empty (_path);
+    DS_TRACE (ds, 3, "'%s' is_empty: %d.\n", _path, ds->is_empty);
+  }
 
-  snprintf (fqfn, sizeof(fqfn), "%s%c%s%s", _path, DIR_SEP, subdir ? subdir : "", fspec);
+  snprintf (fqfn, sizeof(fqfn), "%s%c%s%s", _path, DIR_SEP, file_subdir ? file_subdir : "", file_fspec);
   handle = FindFirstFile (fqfn, &ff_data);
   if (handle == INVALID_HANDLE_VALUE)
   {
-    TRACE (1, "\"%s\" not found.\n", fqfn);
-    return (0);
+    DS_TRACE (ds, 1, "\"%s\" not found.\n", fqfn);
+    return;
   }
 
-  for (ff_more = true; ff_more; ff_more = FindNextFile(handle, &ff_data))
+  for (ff_more = true; ff_more && !halt_flag; ff_more = FindNextFile(handle, &ff_data))
   {
     struct stat   st;
     char  *base, *file = ff_data.cFileName;
-    char  *true_fname = NULL;
     char  *end_pos;
     int    match, len;
-    bool   is_junction;
+    bool   ignore, is_dir, is_junction;
 
     ignore = ((file[0] == '.' && file[1] == '\0') ||                   /* current dir entry */
               (file[0] == '.' && file[1] == '.' && file[2] == '\0'));  /* parent dir entry */
 
-    TRACE (1, "ff_data.cFileName \"%s\", ff_data.dwFileAttributes: 0x%08lX, ignore: %d.\n",
+    DS_TRACE (ds, 1, "ff_data.cFileName \"%s\", ff_data.dwFileAttributes: 0x%08lX, ignore: %d.\n",
             ff_data.cFileName, ff_data.dwFileAttributes, ignore);
 
-    if (key == HKEY_PYTHON_PATH && (ff_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    if (ds->key == HKEY_PYTHON_PATH && (ff_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
     {
       if (str_endswith(ff_data.cFileName, ".dist-info") ||
           str_endswith(ff_data.cFileName, ".egg-info"))
@@ -1671,52 +1852,38 @@ int process_dir (const char *path, int num_dup, bool exist, bool check_empty,
        continue;
 
     base = fqfn + len;
-    snprintf (base, sizeof(fqfn)-len, "%s%s", subdir ? subdir : "", file);
+    snprintf (base, sizeof(fqfn)-len, "%s%s", file_subdir ? file_subdir : "", file);
 
     is_dir      = ((ff_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
     is_junction = ((ff_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0);
 
     if (opt.use_regex)
     {
-      if (regex_match(fqfn) && safe_stat(fqfn, &st, NULL) == 0)
-      {
-        report r;
-
-        r.file        = fqfn;
-        r.content     = opt.grep.content;
-        r.mtime       = st.st_mtime;
-        r.fsize       = st.st_size;
-        r.is_dir      = is_dir;
-        r.is_junction = is_junction;
-        r.key         = key;
-        if (report_file(&r))
-        {
-          found++;
-       // regex_print (&re_hnd, re_matches, fqfn);
-        }
-      }
+      if (regex_match(ds, fqfn) && process_dir_stat(ds, fqfn, &st) == 0)
+         process_dir_add_match (ds, fqfn, &st, is_dir, is_junction);
       continue;
     }
 
-    if (opt.case_sensitive && subdir)
+    if (opt.case_sensitive && file_subdir)
     {
-      true_fname = fqfn;
-      if (get_actual_filename(&true_fname, false))
+      if (process_dir_actual_name(ds, fqfn, sizeof(fqfn)))
       {
-        _strlcpy (fqfn, true_fname, sizeof(fqfn));
-        FREE (true_fname);
-        end_pos = 1 + path_ltrim (fqfn, path);
-        TRACE (2, "subdir: '%s', end_pos: '%s'.\n", subdir, end_pos);
+        end_pos = 1 + path_ltrim (fqfn, ds->path);
+        DS_TRACE (ds, 2, "subdir: '%s', end_pos: '%s'.\n", file_subdir, end_pos);
       }
     }
 
+    /* If no match and `base` is a dotless file, `fnmatch()` doesn't work.
+     * I.e. if `opt.file_spec` == "ratio.*" and `base` == "ratio", we qualify
+     *      this as a match. `fnmatch_exec()` handles that with `FNM_FLAG_DOTLESS`.
+     */
     file  = slashify2 (fqfn, fqfn, DIR_SEP);
-    match = fnmatch (opt.file_spec, base, fnmatch_case(0) | FNM_FLAG_NOESCAPE);
+    match = fnmatch_exec (file_match, base, (!is_dir && !opt.dir_mode && !opt.man_mode) ? FNM_FLAG_DOTLESS : 0);
 
 #if 0
     if (opt.man_mode)
     {
-      TRACE (2, "opt.file_spec: \"%s\", base: \"%s\".\n", opt.file_spec, base);
+      DS_TRACE (ds, 2, "opt.file_spec: \"%s\", base: \"%s\".\n", opt.file_spec, base);
       if (match == FNM_NOMATCH)
          continue;
     }
@@ -1730,42 +1897,260 @@ int process_dir (const char *path, int num_dup, bool exist, bool check_empty,
     else
 #endif
 
-    if (match == FNM_NOMATCH)
-    {
-      /* The case where `base` is a dotless file, `fnmatch()` doesn't work.
-       * I.e. if `opt.file_spec` == "ratio.*" and `base` == "ratio", we qualify
-       *      this as a match.
-       */
-      if (!is_dir && !opt.dir_mode && !opt.man_mode)
-      {
-        if (str_equal_n(base, opt.file_spec, strlen(base)))
-           match = FNM_MATCH;
-      }
-    }
-
     if (is_dir && opt.do_lib)  /* A directory is never a match for a library */
        match = FNM_NOMATCH;
 
-    TRACE (2, "Testing \"%s\". is_dir: %d, is_junction: %d, %s\n",
+    DS_TRACE (ds, 2, "Testing \"%s\". is_dir: %d, is_junction: %d, %s\n",
            file, is_dir, is_junction, fnmatch_res(match));
 
-    if (match == FNM_MATCH && safe_stat(file, &st, NULL) == 0)
+    if (match == FNM_MATCH && process_dir_stat(ds, file, &st) == 0)
+       process_dir_add_match (ds, file, &st, is_dir, is_junction);
+  }
+
+  FindClose (handle);
+}
+
+/**
+ * Print the traces and any warnings for the directory in `ds` and report the
+ * matches found by `process_dir_scan()`.
+ * Must be called from the main-thread.
+ */
+static int process_dir_report (const dir_scan *ds)
+{
+  const char *prefix = ds->prefix;
+  const char *_path  = ds->path;
+  bool        ignore = false;
+  int         i, max, found = 0;
+
+  max = ds->traces ? smartlist_len (ds->traces) : 0;
+  for (i = 0; i < max; i++)
+      debug_printf ("%s", (const char*)smartlist_get(ds->traces, i));
+
+  if (prefix && !stricmp(prefix, "PATH"))
+     ignore = cfg_ignore_lookup ("[Path]", _path);
+
+  if (ds->num_dup > 0)
+  {
+#if 0     /* \todo */
+    WARN2 ("%s: directory \"%s\" is duplicated at position %d. Skipping.\n", prefix, _path, dup_pos);
+#else
+    WARN2 ("%s: directory \"%s\" is duplicated. Skipping.\n", prefix, _path);
+#endif
+    return (0);
+  }
+
+  if (!ds->exp_ok)
+  {
+    WARN ("%s: directory \"%s\" has an unexpanded value.\n", prefix, _path);
+    return (0);
+  }
+
+  if (!ds->exist)
+  {
+    WARN2 ("%s: directory \"%s\" does not exist.\n", prefix, _path);
+    return (0);
+  }
+
+  if (!ds->is_dir)
+     WARN2 ("%s: directory \"%s\" isn't a directory.\n", prefix, _path);
+
+  if (!opt.file_spec)
+  {
+    TRACE (1, "\n");
+    return (0);
+  }
+
+  if (ds->is_empty)
+     WARN2 ("%s: directory \"%s\" is empty.\n", prefix, _path);
+
+  max = smartlist_len (ds->matches);
+
+  /* With `--grep` and `--jobs N`, let the grep-workers search the files
+   * while the reporting below waits for each result in order.
+   */
+  if (opt.grep.content)
+  {
+    for (i = 0; i < max; i++)
     {
-      report r;
-
-      r.file        = file;
-      r.content     = opt.grep.content;
-      r.mtime       = st.st_mtime;
-      r.fsize       = st.st_size;
-      r.is_dir      = is_dir;
-      r.is_junction = is_junction;
-      r.key         = key;
-      if (report_file(&r))
-         found++;
+      const scan_match *m = smartlist_get (ds->matches, i);
+
+      if (!m->is_dir)
+         grep_queue_add (m->file);
     }
   }
 
-  FindClose (handle);
+  for (i = 0; i < max; i++)
+  {
+    const scan_match *m = smartlist_get (ds->matches, i);
+    report r;
+
+    memset (&r, '\0', sizeof(r));
+    r.file        = m->file;
+    r.content     = opt.grep.content;
+    r.mtime       = m->mtime;
+    r.fsize       = m->fsize;
+    r.is_dir      = m->is_dir;
+    r.is_junction = m->is_junction;
+    r.key         = ds->key;
+    if (report_file(&r))
+       found++;
+  }
+  return (found);
+}
+
+/**
+ * Process directory specified by `path` and report any matches
+ * to the global `opt.file_spec`.
+ */
+int process_dir (const char *path, int num_dup, bool exist, bool check_empty,
+                 bool is_dir, bool exp_ok, const char *prefix, HKEY key)
+{
+  dir_scan ds;
+  int      found;
+
+  process_dir_spec();
+  process_dir_init (&ds, path, num_dup, exist, check_empty, is_dir, exp_ok, prefix, key);
+  process_dir_scan (&ds);
+  found = process_dir_report (&ds);
+  process_dir_free (&ds);
+  return (found);
+}
+
+/**
+ * The thread-function for the `--jobs N` worker-pool.
+ * Take the next directory from the `pool` until all are done (or we're halted).
+ */
+static DWORD WINAPI process_dir_worker (void *arg)
+{
+  dir_scan_pool *pool = (dir_scan_pool*) arg;
+  LONG           idx;
+
+  while (!halt_flag && (idx = InterlockedIncrement(&pool->next) - 1) < pool->num)
+  {
+    dir_scan *ds = pool->scans + idx;
+
+    process_dir_scan (ds);
+    SetEvent (ds->done);
+  }
+  return (0);
+}
+
+/**
+ * Return the number of worker-threads to use for `num` directories.
+ * `--jobs 0` means use one thread per CPU.
+ */
+static int process_dir_jobs (int num)
+{
+  int jobs = opt.jobs;
+
+  if (jobs == 0)
+  {
+    SYSTEM_INFO si;
+
+    GetSystemInfo (&si);
+    jobs = (int) si.dwNumberOfProcessors;
+  }
+  if (jobs > num)
+     jobs = num;
+  if (jobs > MAXIMUM_WAIT_OBJECTS)
+     jobs = MAXIMUM_WAIT_OBJECTS;
+  return (jobs);
+}
+
+/**
+ * Process all directories in `list` not already done.
+ *
+ * With `--jobs N` (N != 1), the directories are scanned concurrently by a
+ * pool of worker-threads. Each directory is scanned into it's own `dir_scan`
+ * buffer. The results are reported in the original order as soon as each
+ * directory is done. Hence the output is the same as with `--jobs 1`.
+ *
+ * \param[in] list    the `directory_array` list from `split_env_var()`.
+ * \param[in] prefix  the name of the env-var for the warnings.
+ * \param[in] key     the `HKEY_x` to pass on in `report::key`.
+ */
+static int process_dir_list (smartlist_t *list, const char *prefix, HKEY key)
+{
+  directory_array *arr;
+  dir_scan_pool    pool;
+  HANDLE           threads [MAXIMUM_WAIT_OBJECTS];
+  int              i, max, jobs, num_threads = 0, found = 0;
+
+  max = list ? smartlist_len (list) : 0;
+  jobs = process_dir_jobs (max);
+
+  if (jobs <= 1)
+  {
+    for (i = 0; i < max; i++)
+    {
+      arr = smartlist_get (list, i);
+      if (!arr->done)
+         found += process_dir (arr->dir, arr->num_dup, arr->exist, arr->check_empty,
+                               arr->is_dir, arr->exp_ok, prefix, key);
+      arr->done = true;
+    }
+    return (found);
+  }
+
+  process_dir_spec();
+
+  memset (&pool, '\0', sizeof(pool));
+  pool.scans = CALLOC (max, sizeof(*pool.scans));
+
+  for (i = 0; i < max; i++)
+  {
+    dir_scan *ds = pool.scans + pool.num;
+
+    arr = smartlist_get (list, i);
+    if (arr->done)
+       continue;
+
+    arr->done = true;
+    process_dir_init (ds, arr->dir, arr->num_dup, arr->exist, arr->check_empty,
+                      arr->is_dir, arr->exp_ok, prefix, key);
+    ds->done = CreateEvent (NULL, TRUE, FALSE, NULL);
+    pool.num++;
+  }
+
+  TRACE (1, "Scanning %ld directories using %d threads.\n", pool.num, jobs);
+
+  for (i = 0; i < jobs; i++)
+  {
+    threads [num_threads] = CreateThread (NULL, 0, process_dir_worker, &pool, 0, NULL);
+    if (threads[num_threads])
+       num_threads++;
+  }
+
+  for (i = 0; i < pool.num; i++)
+  {
+    dir_scan *ds = pool.scans + i;
+
+    /* If no threads could be created, do it here.
+     */
+    if (num_threads == 0)
+       process_dir_scan (ds);
+    else
+    {
+      while (!halt_flag && WaitForSingleObject(ds->done, 100) == WAIT_TIMEOUT)
+            ;
+    }
+    if (halt_flag)
+       break;
+    found += process_dir_report (ds);
+  }
+
+  if (num_threads > 0)
+     WaitForMultipleObjects (num_threads, threads, TRUE, INFINITE);
+
+  for (i = 0; i < num_threads; i++)
+      CloseHandle (threads[i]);
+
+  for (i = 0; i < pool.num; i++)
+  {
+    CloseHandle (pool.scans[i].done);
+    process_dir_free (pool.scans + i);
+  }
+  FREE (pool.scans);
   return (found);
 }
 
@@ -2566,12 +2951,8 @@ int do_check_env (const char *env_name)
 
     if (arr->is_cwd)
        TRACE (1, "arr->dir: '%s', arr->is_cwd: 1\n", arr->dir);
-
-    if (!arr->done)
-       found += process_dir (arr->dir, arr->num_dup, arr->exist, arr->check_empty,
-                             arr->is_dir, arr->exp_ok, env_name, NULL);
-    arr->done = true;
   }
+  found = process_dir_list (list, env_name, NULL);
   dir_array_free();
   FREE (orig_e);
   return (found);
@@ -2767,6 +3148,13 @@ static const struct option long_options[] = {
            { "grep",        required_argument, NULL, 0 },    /* 45 */
            { "only",        no_argument,       NULL, 0 },
            { "case",        no_argument,       NULL, 'c' },  /* 47 */
+           { "jobs",        required_argument, NULL, 'j' },
+           { "grep-regex",  required_argument, NULL, 0 },    /* 49 */
+           { "grep-file",   required_argument, NULL, 0 },
+           { "json",        no_argument,       NULL, 0 },    /* 51 */
+           { "ndjson",      no_argument,       NULL, 0 },
+           { "spec",        required_argument, NULL, 0 },    /* 53 */
+           { "refresh",     no_argument,       NULL, 0 },
            { NULL,          no_argument,       NULL, 0 }
          };
 
@@ -2818,7 +3206,14 @@ static int *values_tab[] = {
             &opt.keep_temp,
             (int*)&opt.grep.content,  /* 45 */
             &opt.grep.only,
-            (int*)&opt.case_sensitive /* 47 */
+            (int*)&opt.case_sensitive, /* 47 */
+            NULL,
+            &opt.grep.regex,          /* 49 */
+            (int*)&opt.grep.needles,
+            &opt.json,                /* 51 */
+            &opt.json,
+            (int*)&opt.evry_specs,    /* 53 */
+            &opt.evry_refresh
           };
 
 /**
@@ -2993,6 +3388,9 @@ static void set_short_option (int o, const char *arg)
     case 'c':
          opt.case_sensitive = true;
          break;
+    case 'j':
+         opt.jobs = atoi (arg);
+         break;
     case 'k':
          opt.keep_temp = true;
          break;
@@ -3031,6 +3429,81 @@ static void set_short_option (int o, const char *arg)
   }
 }
 
+/**
+ * Add a needle for `--grep` or `--grep-file`. The first is also `opt.grep.content`.
+ */
+static void add_grep_needle (const char *needle)
+{
+  if (!opt.grep.needles)
+     opt.grep.needles = smartlist_new();
+  smartlist_add (opt.grep.needles, STRDUP(needle));
+  if (!opt.grep.content)
+     opt.grep.content = STRDUP (needle);
+}
+
+/**
+ * `getopt_long()` handler for option `--grep-file=file`.
+ *
+ * One needle per line; only empty lines are ignored. Not read with
+ * `smartlist_read_file()` since a needle like `#include` is not a comment.
+ */
+static void set_grep_file (const char *file)
+{
+  smartlist_lines *lines = smartlist_lines_open (file);
+  const char      *line;
+  size_t           len;
+
+  if (!lines)
+     usage ("Failed to read the \"--grep-file\" '%s'.\n", file);
+
+  while (smartlist_lines_next(lines, &line, &len))
+  {
+    char *needle;
+
+    if (len == 0)
+       continue;
+    needle = str_ndup (line, len);
+    add_grep_needle (needle);
+    FREE (needle);
+  }
+  smartlist_lines_close (lines);
+}
+
+/**
+ * Fix a file-spec that is not a `--regex`: <br>
+ *  \li Convert a SFN like `"progra~1"`.
+ *  \li Append a `".*"` (or `".pc*"` or `".cmake*"`) if it has no `'.'`.
+ *
+ * \param[in] spec  the `MALLOC()`-ed file-spec.
+ * \retval    the fixed `spec`; possibly reallocated.
+ */
+static char *fix_file_spec (char *spec)
+{
+  char *end, *dot, *fspec;
+
+  if (strchr(spec, '~') > spec)
+  {
+    fspec = spec;
+    spec = _fix_path (fspec, NULL);
+    FREE (fspec);
+  }
+
+  end = strrchr (spec, '\0');
+  dot = strrchr (spec, '.');
+  if (!dot && !opt.do_vcpkg && !opt.do_python)
+  {
+    if (opt.do_pkg && end > spec && end[-1] != '*')
+       spec = str_acat (spec, ".pc*");
+
+    else if (opt.do_cmake && !str_endswith(spec, ".cmake"))
+       spec = str_acat (spec, ".cmake*");
+
+    else if (end > spec && end[-1] != '*' && end[-1] != '$')
+       spec = str_acat (spec, ".*");
+  }
+  return (spec);
+}
+
 /**
  * The handler for long options called from `getopt_long()`.
  *
@@ -3081,7 +3554,41 @@ static void set_long_option (int o, const char *arg)
 
   if (!strcmp("grep", long_options[o].name))
   {
+    add_grep_needle (arg);
+    return;
+  }
+
+  if (!strcmp("grep-file", long_options[o].name))
+  {
+    set_grep_file (arg);
+    return;
+  }
+
+  if (!strcmp("json", long_options[o].name))
+  {
+    opt.json = 1;
+    return;
+  }
+
+  if (!strcmp("ndjson", long_options[o].name))
+  {
+    opt.json = 2;
+    return;
+  }
+
+  if (!strcmp("spec", long_options[o].name))
+  {
+    if (!opt.evry_specs)
+       opt.evry_specs = smartlist_new();
+    smartlist_add_strdup (opt.evry_specs, arg);
+    return;
+  }
+
+  if (!strcmp("grep-regex", long_options[o].name))
+  {
+    FREE (opt.grep.content);
     opt.grep.content = STRDUP (arg);
+    opt.grep.regex   = 1;
     return;
   }
 
@@ -3128,7 +3635,7 @@ static void parse_cmdline (void)
   struct command_line *c = &opt.cmd_line;
 
   c->env_opt       = "ENVTOOL_OPTIONS";
-  c->short_opt     = "+chH:vVdDkorsS:tTuq";
+  c->short_opt     = "+chH:j:vVdDkorsS:tTuq";
   c->long_opt      = long_options;
   c->set_short_opt = set_short_option;
   c->set_long_opt  = set_long_option;
@@ -3194,6 +3701,36 @@ static int eval_options (void)
     else if (opt.do_vcpkg)
        WARN ("Option '--grep' is not supported for a VCPKG search.\n");
   }
+
+  if (opt.grep.needles && opt.grep.regex)
+  {
+    WARN ("Option '--grep-regex' cannot be combined with '--grep' or '--grep-file'.\n");
+    return (0);
+  }
+
+  if (opt.grep.needles && smartlist_len(opt.grep.needles) > 1)
+  {
+    char errbuf [200];
+
+    opt.grep.multi = grep_multi_compile (opt.grep.needles, !opt.case_sensitive, errbuf, sizeof(errbuf));
+    if (!opt.grep.multi)
+    {
+      WARN ("Illegal '--grep' needles: %s.\n", errbuf);
+      return (0);
+    }
+  }
+
+  if (opt.grep.content && opt.grep.regex)
+  {
+    char errbuf [200];
+
+    opt.grep.re = grep_regex_compile (opt.grep.content, !opt.case_sensitive, errbuf, sizeof(errbuf));
+    if (!opt.grep.re)
+    {
+      WARN ("Invalid regular expression \"%s\": %s\n", opt.grep.content, errbuf);
+      return (0);
+    }
+  }
   return (1);
 }
 
@@ -3230,7 +3767,12 @@ static void MS_CDECL cleanup (void)
   FREE (user_env_lib);
   FREE (user_env_inc);
   FREE (opt.file_spec);
+  grep_queue_exit();
+  grep_regex_free (opt.grep.re);
+  grep_multi_free (opt.grep.multi);
+  smartlist_free_all (opt.grep.needles);
   FREE (opt.grep.content);
+  fnmatch_free (file_match);
 
   compiler_exit();
 
@@ -3241,6 +3783,9 @@ static void MS_CDECL cleanup (void)
   smartlist_free (reg_array);
 
   smartlist_free_all (opt.evry_host);
+  smartlist_free_all (opt.evry_specs);
+  ETP_exit();
+  FREE (opt.evry_cache_file);
   smartlist_free_all (opt.owners);
 
   getopt_free (&opt.cmd_line);
@@ -3348,6 +3893,9 @@ static void init_all (const char *argv0)
   opt.under_appveyor = (stricmp(user, "APPVYR-WIN\\appveyor") == 0);
   opt.under_github   = str_endswith (user, "\\runneradmin");
   opt.evry_busy_wait = 2;
+  opt.jobs           = 1;
+  opt.use_buffered_io = 1;  /* 'ETP.buffered_io = 0' in the config-file turns it off */
+  opt.use_pipelining = 1;   /* 'ETP.pipelining = 0' in the config-file turns it off */
 
   if (GetModuleFileName(NULL, buf, sizeof(buf)))
        who_am_I = STRDUP (buf);
@@ -3428,6 +3976,22 @@ static bool cfg_ETP_handler (const char *key, const char *value)
     opt.use_nonblock_io = atoi (value);
     return (true);
   }
+  if (!stricmp(key, "pipelining"))
+  {
+    opt.use_pipelining = atoi (value);
+    return (true);
+  }
+  if (!stricmp(key, "cache_ttl"))
+  {
+    opt.evry_cache_ttl = atoi (value);
+    return (true);
+  }
+  if (!stricmp(key, "cache_file"))
+  {
+    FREE (opt.evry_cache_file);
+    opt.evry_cache_file = getenv_expand2 (value);
+    return (true);
+  }
   return (false);
 }
 
@@ -3650,32 +4214,18 @@ int MS_CDECL main (int argc, const char **argv)
   if (!opt.file_spec)
      usage ("You must give a filespec to search for.\n");
 
+  if (opt.evry_specs && !(opt.do_evry && opt.evry_host))
+     usage ("Option \"--spec\" needs at least one \"--evry:host\".\n");
+
   if (!opt.evry_raw && !opt.dir_mode)
   {
     if (!opt.use_regex)
     {
-      char *end, *dot, *fspec;
-
-      if (strchr(opt.file_spec, '~') > opt.file_spec)
-      {
-        fspec = opt.file_spec;
-        opt.file_spec = _fix_path (fspec, NULL);
-        FREE (fspec);
-      }
-
-      end = strrchr (opt.file_spec, '\0');
-      dot = strrchr (opt.file_spec, '.');
-      if (!dot && !opt.do_vcpkg && !opt.do_python)
-      {
-        if (opt.do_pkg && end > opt.file_spec && end[-1] != '*')
-           opt.file_spec = str_acat (opt.file_spec, ".pc*");
-
-        else if (opt.do_cmake && !str_endswith(opt.file_spec, ".cmake"))
-           opt.file_spec = str_acat (opt.file_spec, ".cmake*");
+      int i, max = opt.evry_specs ? smartlist_len (opt.evry_specs) : 0;
 
-        else if (end > opt.file_spec && end[-1] != '*' && end[-1] != '$')
-           opt.file_spec = str_acat (opt.file_spec, ".*");
-      }
+      opt.file_spec = fix_file_spec (opt.file_spec);
+      for (i = 0; i < max; i++)
+          smartlist_set (opt.evry_specs, i, fix_file_spec(smartlist_get(opt.evry_specs, i)));
     }
     else
     {
@@ -3776,24 +4326,15 @@ int MS_CDECL main (int argc, const char **argv)
    */
   if (opt.do_evry)
   {
-    int i, max = 0;
-
-    if (opt.evry_host)
-       max = smartlist_len (opt.evry_host);
-
     /* Mode "--evry:host" specified at least once.
-     * Connect and query all hosts.
+     * Connect and query all hosts together.
      */
-    for (i = 0; i < max; i++)
-    {
-      const char *host = smartlist_get (opt.evry_host, i);
+    if (opt.evry_host)
+       found += do_check_evry_ept_hosts (opt.evry_host);
 
-      report_header_set ("Matches from %s:\n", host);
-      found += do_check_evry_ept (host);
-    }
     /* If no remote host(s) was queried, query locally.
      */
-    if (max  == 0)
+    else
     {
       report_header_set ("Matches from EveryThing:\n");
       found += do_check_evry();
@@ -3826,16 +4367,16 @@ void regex_print (const regex_t *re, const regmatch_t *rm, const char *str)
 }
 
 /*
- * Returns a copy of `de`.
+ * Returns a copy of `de` allocated from the smartlist `sl`.
  */
-static struct dirent2 *copy_de (const struct dirent2 *de)
+static struct dirent2 *copy_de (smartlist_t *sl, const struct dirent2 *de)
 {
-  struct dirent2 *copy = MALLOC (sizeof(*copy));
+  struct dirent2 *copy = smartlist_alloc (sl, sizeof(*copy));
 
   TRACE (2, "Adding '%s'\n", de->d_name);
   memcpy (copy, de, sizeof(*copy));
   copy->d_link = NULL;
-  copy->d_name = STRDUP (de->d_name);
+  copy->d_name = smartlist_strdup (sl, de->d_name);
   slashify2 (copy->d_name, copy->d_name, '\\');
   return (copy);
 }
@@ -3843,7 +4384,8 @@ static struct dirent2 *copy_de (const struct dirent2 *de)
 /**
  * Traverse a `dir` and look for files matching file-spec.
  *
- * \return A smartlist of `struct dirent2*` entries.
+ * \return An arena-backed smartlist of `struct dirent2*` entries.
+ *         A `smartlist_free()` frees the entries too.
  *
  * \note Does not work recursively.
  *
@@ -3864,13 +4406,13 @@ smartlist_t *get_matching_files (const char *dir, const char *file_spec)
   if (!is_directory(dir) || (dp = opendir2x(dir, &dir_opt)) == NULL)
      return (NULL);
 
-  dir_list = smartlist_new();
+  dir_list = smartlist_new_arena();
 
   while ((de = readdir2(dp)) != NULL)
   {
     if (!(de->d_attrib & FILE_ATTRIBUTE_DIRECTORY) /* &&
         fnmatch(file_spec, de->d_name, FNM_FLAG_NOCASE) == FNM_MATCH */)
-      smartlist_add (dir_list, copy_de(de));
+      smartlist_add (dir_list, copy_de(dir_list, de));
   }
   closedir2 (dp);
   return (dir_list);
@@ -3948,6 +4490,8 @@ static bool is_shadow_candidate (const struct dirent2 *this_de,
  *
  * But the "time-slack" is controlled by `opt.shadow_dtime` (in seconds).
  * E.g. if opt.shadow_dtime == 23668200  (== 9 months), the shadow-state is ignored.
+ *
+ * \note This is the naive O(files^2) reference version used by `shadow_find (dir_list, true)`.
  */
 static void check_shadow_files (smartlist_t *this_de_list,
                                 smartlist_t *prev_de_list,
@@ -3982,34 +4526,200 @@ static void check_shadow_files (smartlist_t *this_de_list,
 }
 
 /**
- * For all directories (in `dir_list`), build lists of files matching `file_spec`
- * and do a shadow check of files in all directories after the `arr_i->dir`.
- * This is to show possibly newer files that should be used instead.
+ * \typedef shadow_node
+ * A node in the basename hash-table built by `shadow_find_hashed()`.
+ */
+typedef struct shadow_node {
+        const struct dirent2 *de;       /**< the file-entry */
+        const char           *base;     /**< `basename (de->d_name)` */
+        DWORD                 hash;     /**< the case-folded hash of `base` */
+        int                   dir_idx;  /**< the index of this directory in `dir_list` */
+        int                   de_idx;   /**< the index of `de` in `directory_array::dirent2` */
+        struct shadow_node   *next;     /**< the next node in this bucket */
+      } shadow_node;
+
+/**
+ * \typedef shadow_pair
+ * A shadow found by `shadow_find_hashed()` and the indices needed to
+ * sort it into the same order as the nested loops in `check_shadow_files()`.
+ */
+typedef struct shadow_pair {
+        int                  this_dir, prev_dir;
+        int                  this_idx, prev_idx;
+        struct shadow_entry *se;
+      } shadow_pair;
+
+/*
+ * A case-folded FNV-1a hash of a basename.
+ * Names equal according to `stricmp()` will always hash equal.
+ */
+static DWORD shadow_hash (const char *base)
+{
+  DWORD hash = 2166136261UL;
+
+  for ( ; *base; base++)
+  {
+    hash ^= (BYTE) tolower ((int)(BYTE)*base);
+    hash *= 16777619UL;
+  }
+  return (hash);
+}
+
+/*
+ * Sort the shadows on (`this_dir` ascending, `prev_dir` descending,
+ * `this_idx` ascending, `prev_idx` ascending). <br>
+ * That is the order `shadow_report()` always reported them in.
+ */
+static int compare_shadow_pair (const void **_a, const void **_b)
+{
+  const shadow_pair *a = *(const shadow_pair**) _a;
+  const shadow_pair *b = *(const shadow_pair**) _b;
+
+  if (a->this_dir != b->this_dir)
+     return (a->this_dir - b->this_dir);
+  if (a->prev_dir != b->prev_dir)
+     return (b->prev_dir - a->prev_dir);
+  if (a->this_idx != b->this_idx)
+     return (a->this_idx - b->this_idx);
+  return (a->prev_idx - b->prev_idx);
+}
+
+/**
+ * Find all shadows in `dir_list` by a hash-join on the case-folded basenames.
  *
- * \param[in] dir_list   List of directories from the expansion of e.g. `%PATH%`.
- * \param[in] file_spec  The file-spec to check for shadows.
- *                       E.g. `"*.exe"` if we look for shadows in `%PATH%` and
- *                            `"*.h"` if we look for shadows in `%INCLUDE%`.
+ * All `directory_array::dirent2` lists are put into one hash-table in a single pass.
+ * Only files in the same bucket with equal basenames are checked by `is_shadow_candidate()`.
+ * So the cost is O(files) instead of O(dirs^2 * files^2).
  */
-static void shadow_report (smartlist_t *dir_list, const char *file_spec)
+static void shadow_find_hashed (smartlist_t *dir_list, smartlist_t *shadow_list)
 {
-  directory_array *arr_i, *arr_j;
-  smartlist_t     *shadows;
-  int              i, j, max;
+  const directory_array *arr;
+  shadow_node  *nodes, **buckets, *a, *b;
+  smartlist_t  *pairs;
+  size_t        num_buckets = 64, num_nodes = 0, n;
+  int           i, j, max = smartlist_len (dir_list);
 
-  shadows = smartlist_new();
-  max = smartlist_len (dir_list);
+  for (i = 0; i < max; i++)
+  {
+    arr = smartlist_get (dir_list, i);
+    if (arr->dirent2)
+       num_nodes += smartlist_len (arr->dirent2);
+  }
+  if (num_nodes == 0)
+     return;
+
+  while (num_buckets < num_nodes)
+     num_buckets *= 2;
+
+  nodes   = CALLOC (num_nodes, sizeof(*nodes));
+  buckets = CALLOC (num_buckets, sizeof(*buckets));
+  n = 0;
 
   for (i = 0; i < max; i++)
   {
-    arr_i = smartlist_get (dir_list, i);
-    if (arr_i->exist && !arr_i->is_native)
-       arr_i->dirent2 = get_matching_files (arr_i->dir, file_spec);
+    int max_j;
+
+    arr = smartlist_get (dir_list, i);
+    if (!arr->dirent2)
+       continue;
+
+    max_j = smartlist_len (arr->dirent2);
+    for (j = 0; j < max_j; j++, n++)
+    {
+      shadow_node *node = nodes + n;
+      size_t       slot;
+
+      node->de      = smartlist_get (arr->dirent2, j);
+      node->base    = basename (node->de->d_name);
+      node->hash    = shadow_hash (node->base);
+      node->dir_idx = i;
+      node->de_idx  = j;
+      slot = node->hash & (num_buckets - 1);
+      node->next = buckets [slot];
+      buckets [slot] = node;
+    }
+  }
+
+  pairs = smartlist_new();
+
+  for (n = 0; n < num_buckets; n++)
+  {
+    for (a = buckets[n]; a; a = a->next)
+    {
+      for (b = a->next; b; b = b->next)
+      {
+        const shadow_node *this_node, *prev_node;
+        FILETIME           newest, oldest;
+
+        if (a->hash != b->hash || a->dir_idx == b->dir_idx || stricmp(a->base, b->base))
+           continue;
+
+        /* The file in the directory ahead in `dir_list` is the one that shadows.
+         */
+        if (a->dir_idx < b->dir_idx)
+             this_node = a, prev_node = b;
+        else this_node = b, prev_node = a;
+
+        if (is_shadow_candidate(this_node->de, prev_node->de, &newest, &oldest))
+        {
+          shadow_pair *sp = MALLOC (sizeof(*sp));
+
+          sp->se = MALLOC (sizeof(*sp->se));
+          sp->se->shadowing_file      = this_node->de->d_name;
+          sp->se->shadowed_file       = prev_node->de->d_name;
+          sp->se->shadowed_FILE_TIME  = newest;
+          sp->se->shadowing_FILE_TIME = oldest;
+          sp->this_dir = this_node->dir_idx;
+          sp->prev_dir = prev_node->dir_idx;
+          sp->this_idx = this_node->de_idx;
+          sp->prev_idx = prev_node->de_idx;
+          smartlist_add (pairs, sp);
+        }
+      }
+    }
+  }
+
+  smartlist_sort (pairs, compare_shadow_pair);
+  max = smartlist_len (pairs);
+  for (i = 0; i < max; i++)
+  {
+    shadow_pair *sp = smartlist_get (pairs, i);
+
+    smartlist_add (shadow_list, sp->se);
+    FREE (sp);
+  }
+  smartlist_free (pairs);
+  FREE (buckets);
+  FREE (nodes);
+}
+
+/**
+ * Find all shadowing files in the `directory_array::dirent2` lists of `dir_list`.
+ *
+ * \param[in] dir_list  List of directories from the expansion of e.g. `%PATH%`.
+ *                      The `dirent2` lists must be filled by `get_matching_files()`.
+ * \param[in] naive     Use the old nested-loop `check_shadow_files()` reference
+ *                      engine instead of the hash-join in `shadow_find_hashed()`.
+ *                      Both return the shadows in the same order.
+ *
+ * \retval A smartlist of `struct shadow_entry*`. Free it using `shadow_free()`.
+ */
+smartlist_t *shadow_find (smartlist_t *dir_list, bool naive)
+{
+  const directory_array *arr_i, *arr_j;
+  smartlist_t           *shadows = smartlist_new();
+  int                    i, j, max;
+
+  if (!naive)
+  {
+    shadow_find_hashed (dir_list, shadows);
+    return (shadows);
   }
 
   /* For all directories in env-var, do a shadow check of files in
    * all directories after the 'arr_i->dir'
    */
+  max = smartlist_len (dir_list);
   for (i = 0; i < max; i++)
   {
     arr_i = smartlist_get (dir_list, i);
@@ -4022,6 +4732,51 @@ static void shadow_report (smartlist_t *dir_list, const char *file_spec)
          check_shadow_files (arr_i->dirent2, arr_j->dirent2, shadows);
     }
   }
+  return (shadows);
+}
+
+/**
+ * Free the list returned from `shadow_find()`.
+ * The file-names are owned by the `dirent2` lists.
+ */
+void shadow_free (smartlist_t *shadows)
+{
+#if defined(_CRTDBG_MAP_ALLOC)
+  smartlist_wipe (shadows, free);
+#else
+  _WFUNC_CAST_OFF()
+  smartlist_wipe (shadows, (smartlist_free_func)free_at);
+  _WFUNC_CAST_POP()
+#endif
+  smartlist_free (shadows);
+}
+
+/**
+ * For all directories (in `dir_list`), build lists of files matching `file_spec`
+ * and do a shadow check of files in all directories after the `arr_i->dir`.
+ * This is to show possibly newer files that should be used instead.
+ *
+ * \param[in] dir_list   List of directories from the expansion of e.g. `%PATH%`.
+ * \param[in] file_spec  The file-spec to check for shadows.
+ *                       E.g. `"*.exe"` if we look for shadows in `%PATH%` and
+ *                            `"*.h"` if we look for shadows in `%INCLUDE%`.
+ */
+static void shadow_report (smartlist_t *dir_list, const char *file_spec)
+{
+  directory_array *arr_i;
+  smartlist_t     *shadows;
+  int              i, max;
+
+  max = smartlist_len (dir_list);
+
+  for (i = 0; i < max; i++)
+  {
+    arr_i = smartlist_get (dir_list, i);
+    if (arr_i->exist && !arr_i->is_native)
+       arr_i->dirent2 = get_matching_files (arr_i->dir, file_spec);
+  }
+
+  shadows = shadow_find (dir_list, false);
 
   max = smartlist_len (shadows);
   if (max > 0)
@@ -4057,20 +4812,20 @@ static void shadow_report (smartlist_t *dir_list, const char *file_spec)
       C_printf ("               %-*s  ~6%s~0\n", (int)longest, slashify(se->shadowing_file, slash), t2);
     }
 
-    /* We're done; free the shadow-list
-     */
-#if defined(_CRTDBG_MAP_ALLOC)
-    smartlist_wipe (shadows, free);
-#else
-    _WFUNC_CAST_OFF()
-    smartlist_wipe (shadows, (smartlist_free_func)free_at);
-    _WFUNC_CAST_POP()
-#endif
   }
 
-  smartlist_free (shadows);
+  /* We're done; free the shadow-list
+   */
+  shadow_free (shadows);
 }
 
+/**
+ * Save the directories for `env_var` to cache.
+ *
+ * A directory counted in `dir_num_entries()` also gets a stamp; it's `mtime`,
+ * `size` and number of entries. This stamp is checked in `get_dir_stamp_from_cache()`
+ * on the next run. Stamps for directories not counted on this run are deleted.
+ */
 static void put_dirlist_to_cache (const char *env_var, smartlist_t *dirs)
 {
   const directory_array *da;
@@ -4084,35 +4839,83 @@ static void put_dirlist_to_cache (const char *env_var, smartlist_t *dirs)
 
     _fix_path (da->dir, result);
     cache_putf (SECTION_ENV_DIR, "env_dir_%s_%d = %s", env_var, i, result);
+
+    if (da->num_entries >= 0)
+         cache_putf (SECTION_ENV_DIR, "env_stamp_%s_%d = %u,%u,%d",
+                     env_var, i, (unsigned)da->mtime, (unsigned)da->size, da->num_entries);
+    else cache_delf (SECTION_ENV_DIR, "env_stamp_%s_%d", env_var, i);
+  }
+
+  /* Remove the directories left from a longer `env_var` on a previous run.
+   */
+  for (i = max;; i++)
+  {
+    char key [100];
+
+    snprintf (key, sizeof(key), "env_dir_%s_%d", env_var, i);
+    if (!cache_get(SECTION_ENV_DIR, key))
+       break;
+    cache_del (SECTION_ENV_DIR, key);
+    cache_delf (SECTION_ENV_DIR, "env_stamp_%s_%d", env_var, i);
   }
 }
 
 /**
- * The opposite of the above; get the directories for `env_var` from cache.
- * The `dir_array` smartlist is empty at this point.
+ * The opposite of the above; get the stamp for directory `d` at position `idx`
+ * in `env_var` from cache.
+ *
+ * If the cached directory is the same as `d->dir` and the `mtime` and `size`
+ * from the `safe_stat()` in `dir_array_add_or_insert()` still matches the stamp,
+ * the cached number of entries is still valid. Creating or deleting a file in
+ * a directory updates it's `mtime`.
  *
- * NB. Not used yet.
+ * \retval true  a cache-hit; `d->num_entries` is set from the stamp.
+ * \retval false a cache-miss or a stale stamp; `d` must be re-scanned.
  */
-_WUNUSED_FUNC_OFF()
-static int get_dirlist_from_cache (const char *env_var)
+static bool get_dir_stamp_from_cache (const char *env_var, int idx, directory_array *d)
 {
-  int i;
-
-  for (i = 0;; i++)
-  {
-    char dir [_MAX_PATH];
-    char format [50];
+  const char *dir;
+  char        key [100];
+  char        format [100];
+  char        result [_MAX_PATH+1];
+  unsigned    mtime, size;
+  int         num_entries;
+
+  snprintf (key, sizeof(key), "env_dir_%s_%d", env_var, idx);
+  dir = cache_get (SECTION_ENV_DIR, key);
+  if (!dir || !str_equal(dir, _fix_path(d->dir, result)))
+     return (false);
 
-    snprintf (format, sizeof(format), "env_dir_%s_%d = %%s", env_var, i);
-    if (cache_getf(SECTION_ENV_DIR, format, dir) != 1)
-       break;
+  snprintf (format, sizeof(format), "env_stamp_%s_%d = %%u,%%u,%%d", env_var, idx);
+  if (cache_getf(SECTION_ENV_DIR, format, &mtime, &size, &num_entries) != 3 || num_entries < 0)
+     return (false);
 
-    dir_array_add (dir, str_equal(dir, current_dir));
+  if (mtime != (unsigned)d->mtime || size != (unsigned)d->size)
+  {
+    TRACE (1, "Stale stamp for '%s'.\n", d->dir);
+    return (false);
   }
-  TRACE (1, "Found %d cached 'env_dir_x'.\n", i);
-  return (i);
+  d->num_entries = num_entries;
+  return (true);
+}
+
+/**
+ * Return the number of entries in directory `d` at position `idx` in `env_var`.
+ * `dir` is the slashified version of `d->dir`.
+ *
+ * Only emptiness is checked. Hence the count stops at 1 entry; like `dir_is_empty()`
+ * this is fast for a huge directory.
+ *
+ * Use the cached number if the stamp of `d` is still fresh.
+ * Otherwise re-scan the directory. Returns -1 if it could not be read.
+ */
+static int dir_num_entries (const char *env_var, int idx, directory_array *d, const char *dir)
+{
+  if (d->num_entries < 0 && !get_dir_stamp_from_cache(env_var, idx, d))
+     d->num_entries = dir_count_entries (dir, 1);
+  TRACE (3, "at least %d entries in '%s'.\n", d->num_entries, dir);
+  return (d->num_entries);
 }
-_WUNUSED_FUNC_POP()
 
 /**
  * Expand and check a single env-var for missing directories
@@ -4141,7 +4944,7 @@ static void check_env_val (const char *env, const char *file_spec, int *num, cha
   smartlist_t *list = NULL;
   int          i, errors, ignored = 0, max = 0;
   char        *value;
-  const directory_array *arr;
+  directory_array *arr;
 
   status[0] = '\0';
   *num = 0;
@@ -4204,7 +5007,7 @@ static void check_env_val (const char *env, const char *file_spec, int *num, cha
       snprintf (status, status_sz, "~5Missing dir~0: ~3\"%s\"~0", fbuf);
       errors++;
     }
-    else if (!arr->is_cwd && dir_is_empty(fbuf))
+    else if (!arr->is_cwd && dir_num_entries(env, i, arr, fbuf) == 0)
     {
       snprintf (status, status_sz, "~5Empty dir~0: ~3\"%s\"~0", fbuf);
       errors++;
@@ -314,6 +314,9 @@ typedef enum SignStatus {
         SIGN_CHECK_SIGNED
       } SignStatus;
 
+typedef struct grep_regex grep_regex;  /* Opaque struct; defined in report.c */
+typedef struct grep_multi grep_multi;  /* Opaque struct; defined in report.c */
+
 #include "sort.h"
 #include "smartlist.h"
 #include "report.h"
@@ -331,6 +334,10 @@ typedef struct grep_info {
         DWORD   max_matches;   /**< The maximum number of matches to print for each file. */
         DWORD   binary_files;  /**< The number of files detected as binary files. */
         int     only;          /**< Show file(s) that only matches 'content' (not yet). */
+        int     regex;         /**< `--grep-regex`; 'content' is an extended regular expression. */
+        grep_regex  *re;       /**< The compiled 'content' with `--grep-regex`. */
+        smartlist_t *needles;  /**< All `--grep` and `--grep-file` needles; 'content' is the first. */
+        grep_multi  *multi;    /**< The automaton for 'needles' if there are more than one. */
       } grep_info;
 
 /**\typedef prog_options
@@ -361,6 +368,7 @@ typedef struct prog_options {
         int             use_regex;
         int             use_buffered_io;
         int             use_nonblock_io;
+        int             use_pipelining;
         int             dir_mode;
         int             lua_mode;
         int             man_mode;
@@ -392,7 +400,9 @@ typedef struct prog_options {
         int             do_check;
         int             do_help;
         int             case_sensitive;
+        int             jobs;               /**< cmd-line `-j N` / `--jobs N`; number of threads in `process_dir_list()` and `grep_worker()` */
         int             keep_temp;          /**< cmd-line `-k`; do not delete any temporary files from `popen_run_py()` */
+        int             json;               /**< cmd-line `--json` (1) or `--ndjson` (2); print JSON records in `report_file()` */
         bool            under_conemu;       /**< true if running under ConEmu console-emulator */
         bool            under_winterm;      /**< true if running under WindowsTerminal */
         bool            under_appveyor;     /**< true if running under AppVeyor */
@@ -403,6 +413,10 @@ typedef struct prog_options {
         bool            evry_raw;           /**< use raw non-regex searches */
         UINT            evry_busy_wait;     /**< max number of seconds to wait for a busy EveryThing */
         smartlist_t    *evry_host;
+        smartlist_t    *evry_specs;         /**< more file-specs from `--spec` for the ETP-host(s) */
+        int             evry_refresh;       /**< cmd-line `--refresh`; do not use the ETP result cache */
+        UINT            evry_cache_ttl;     /**< seconds to keep ETP results in the cache. 0 disables it */
+        char           *evry_cache_file;    /**< the ETP result cache-file */
         char           *file_spec;
         beep_info       beep;
         command_line    cmd_line;
@@ -448,6 +462,9 @@ typedef struct directory_array {
         int          num_dup;     /**< is duplicated elsewhere in `%VAR%`? */
         bool         check_empty; /**< check if it contains at least 1 file? */
         bool         done;        /**< alreay processed */
+        time_t       mtime;       /**< `st_mtime` of this directory; part of the stamp in `SECTION_ENV_DIR` */
+        DWORD        size;        /**< `st_size` of this directory; part of the stamp */
+        int          num_entries; /**< number of entries in it; counted up to 1. -1 if not counted yet */
      // char        *env_var;     /**< the env-var these directories came from (or NULL) */
         smartlist_t *dirent2;     /**< List of `struct dirent2` for this directory; used in `check_shadow_files()` only */
       } directory_array;
@@ -498,6 +515,9 @@ struct shadow_entry {
        FILETIME  shadowing_FILE_TIME;  /**< dirent2::d_time_create or dirent2::d_time_write. */
      };
 
+extern smartlist_t *shadow_find (smartlist_t *dir_list, bool naive);
+extern void         shadow_free (smartlist_t *shadows);
+
 /*
  * Defined in newer <sal.h> for MSVC.
  */
@@ -598,6 +618,7 @@ extern bool  _has_drive2            (const char *path);
 extern bool   is_directory          (const char *file);
 extern int    safe_stat             (const char *file, struct stat *st, DWORD *win_err);
 extern int    safe_stat_sys         (const char *file, struct stat *st, DWORD *win_err);
+extern int    safe_stat_quiet       (const char *file, struct stat *st, DWORD *win_err);
 extern UINT   count_digit           (UINT64 n);
 extern bool   legal_file_name       (const char *fname);
 
@@ -723,6 +744,7 @@ extern const char *get_time_str (time_t t);
 extern const char *get_time_str_FILETIME (const FILETIME *ft);
 extern const char *get_file_ext (const char *file);
 extern char       *create_temp_file (void);
+extern double      bench_time (void);
 extern const char *check_if_shebang (const char *fname);
 extern bool        check_if_zip (const char *fname);
 extern bool        check_if_gzip (const char *fname);
@@ -863,6 +885,7 @@ extern char    *strdup_at  (const char *str, const char *file, unsigned line);
 extern wchar_t *wcsdup_at  (const wchar_t *str, const char *file, unsigned line);
 extern void     free_at    (void *ptr, const char *file, unsigned line);
 extern void     mem_report (void);
+extern size_t   mem_peak   (void);
 
 #if defined(_CRTDBG_MAP_ALLOC)
   #define MALLOC        malloc
@@ -896,11 +919,18 @@ char *popen_last_line (void);
 #define FNM_FLAG_NOESCAPE  0x01
 #define FNM_FLAG_PATHNAME  0x02
 #define FNM_FLAG_NOCASE    0x04
+#define FNM_FLAG_DOTLESS   0x08   /* for 'fnmatch_exec()' only */
 
 extern int   fnmatch      (const char *pattern, const char *string, int flags);
 extern int   fnmatch_case (int flags);
 extern char *fnmatch_res  (int rc);
 
+typedef struct fnmatch_prog fnmatch_prog;
+
+extern fnmatch_prog *fnmatch_compile (const char *pattern, int flags);
+extern int           fnmatch_exec    (const fnmatch_prog *prog, const char *string, int flags);
+extern void          fnmatch_free    (fnmatch_prog *prog);
+
 /* Handy macros: */
 
 /** \def DIM(arr)
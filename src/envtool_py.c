@@ -2642,21 +2642,23 @@ bool py_cfg_handler (const char *section, const char *key, const char *value)
  */
 static int get_modules_from_cache (python_info *pi)
 {
-  int i = 0;
-  int dups = 0;
+  cache_getf_desc *desc;
+  int              i = 0;
+  int              dups = 0;
 
   if (!opt.use_cache)
      return (0);
 
+  desc = cache_getf_compile ("%s,%s,%d,%s,%s");
   while (1)
   {
     python_module m;
-    char   format [50];
+    char   key [50];
     char  *mod_name, *mod_version, *location, *dist_info;
     int    rc, is_zip;
 
-    snprintf (format, sizeof(format), "python_modules%d_%d = %%s,%%s,%%d,%%s,%%s", pi->py_index, i);
-    rc = cache_getf (SECTION_PYTHON, format, &mod_name, &mod_version, &is_zip, &location, &dist_info);
+    snprintf (key, sizeof(key), "python_modules%d_%d", pi->py_index, i);
+    rc = cache_getf_run (desc, SECTION_PYTHON, key, &mod_name, &mod_version, &is_zip, &location, &dist_info);
     TRACE (3, "rc: %d.\n", rc);
 
     if (rc < 5)
@@ -2673,6 +2675,7 @@ static int get_modules_from_cache (python_info *pi)
        dups++;
     i++;
   }
+  cache_getf_free (desc);
   return (i - dups);
 }
 
@@ -0,0 +1,1199 @@
+/** \file    etp_mock.c
+ *  \ingroup EveryThing_ETP
+ *  \brief
+ *    A stand-in ETP-server for testing and benchmarking `Everything_ETP.c`
+ *    without a real EveryThing instance.
+ *
+ * It speaks the subset of the ETP protocol that `Everything_ETP.c` uses:
+ * \code
+ *   USER [name]                 -> 230 / 331 / 530
+ *   PASS password               -> 230 / 530
+ *   EVERYTHING SEARCH spec      -> 200
+ *   EVERYTHING REGEX 0|1        -> 200
+ *   EVERYTHING CASE 0|1         -> 200
+ *   EVERYTHING SORT xx_ASCENDING / xx_DESCENDING   -> 200 (xx = NAME, PATH, SIZE or DATE_MODIFIED)
+ *   EVERYTHING PATH_COLUMN / SIZE_COLUMN / DATE_MODIFIED_COLUMN 0|1  -> 200
+ *   EVERYTHING QUERY            -> 200-Query results, RESULT_COUNT N, PATH, SIZE, DATE_MODIFIED,
+ *                                  FILE or FOLDER lines, 200 End.
+ *   FEAT, NOOP, QUIT
+ * \endcode
+ *
+ * The corpus is synthetic and deterministic; see `ETP_mock_cfg`.
+ * A `REGEX 1` search supports `^ $ . [] \` and the `* + ?` quantifiers.
+ * A `REGEX 0` search is one or more terms that must all match;
+ * a term with a `*` or `?` is a wildcard for the whole name, otherwise a sub-string.
+ * Like EveryThing, only the file-name is matched and not the path.
+ *
+ * To act as a far away host, a connection waits `cfg->rtt` msec each time it had to
+ * wait for a command. As for one round trip on a slow link.
+ *
+ * This file does not depend on the rest of envtool. It's used by `tests.c`
+ * and is also a stand-alone program. On Linux:
+ * \code
+ *   cc -DETP_MOCK_TEST -o etp_mock etp_mock.c -lpthread
+ *   ./etp_mock -p 2121 -n 100000 -r 50 -a
+ * \endcode
+ *
+ * And query it from Windows with `envtool --evry:host:2121 *.txt`.
+ * Without `-a`, it listens on `127.0.0.1` only.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#if defined(_WIN32)
+  #include <winsock2.h>
+  #include <windows.h>
+
+  #define THREAD_FUNC         DWORD WINAPI
+  #define THREAD_RET          0
+  #define MSG_NOSIGNAL        0
+  #define SHUT_RDWR           SD_BOTH
+  #define strdup              _strdup
+  #define strcasecmp          _stricmp
+  #define mock_sleep(ms)      Sleep (ms)
+
+  typedef HANDLE              thread_t;
+  typedef CRITICAL_SECTION    mutex_t;
+  typedef int                 mock_socklen;
+
+  #define mutex_init(m)       InitializeCriticalSection (m)
+  #define mutex_destroy(m)    DeleteCriticalSection (m)
+  #define mutex_lock(m)       EnterCriticalSection (m)
+  #define mutex_unlock(m)     LeaveCriticalSection (m)
+
+#else
+  #include <unistd.h>
+  #include <strings.h>
+  #include <pthread.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <arpa/inet.h>
+
+  #define THREAD_FUNC         void *
+  #define THREAD_RET          NULL
+  #define INVALID_SOCKET      (-1)
+  #define closesocket(s)      close (s)
+  #define mock_sleep(ms)      usleep (1000 * (ms))
+
+  typedef int                 SOCKET;
+  typedef pthread_t           thread_t;
+  typedef pthread_mutex_t     mutex_t;
+  typedef socklen_t           mock_socklen;
+
+  #define mutex_init(m)       pthread_mutex_init (m, NULL)
+  #define mutex_destroy(m)    pthread_mutex_destroy (m)
+  #define mutex_lock(m)       pthread_mutex_lock (m)
+  #define mutex_unlock(m)     pthread_mutex_unlock (m)
+#endif
+
+#include "etp_mock.h"
+
+#define MOCK_MAX_CLIENTS  64      /**< max number of simultaneous connections */
+#define MOCK_LINE_MAX     1000    /**< max length of a command */
+#define MOCK_TX_CHUNK     65536   /**< send the results in chunks of this size */
+
+/**
+ * The FILETIME of 2020-01-01 00:00:00 UTC. The base of the synthetic modify-times.
+ */
+#define MOCK_FILETIME_BASE  132223104000000000ULL
+
+/**
+ * 5 years in FILETIME units (100 nsec).
+ */
+#define MOCK_FILETIME_SPAN  (5ULL * 365 * 24 * 3600 * 10000000ULL)
+
+/**
+ * The extensions of the synthetic files.
+ */
+static const char *mock_ext[] = { "c", "h", "txt", "exe", "dll", "py", "md", "json", "obj", "lib" };
+
+/**
+ * \enum mock_sort
+ * The `EVERYTHING SORT` keys.
+ */
+enum mock_sort {
+     MOCK_SORT_NONE = 0,
+     MOCK_SORT_NAME,
+     MOCK_SORT_PATH,
+     MOCK_SORT_SIZE,
+     MOCK_SORT_DATE
+   };
+
+/**
+ * \typedef mock_entry
+ * A file or folder in the synthetic corpus.
+ */
+typedef struct mock_entry {
+        char     *path;     /**< the folder it's in */
+        char     *name;     /**< the file or folder name */
+        uint64_t  size;     /**< the file-size. 0 for a folder */
+        uint64_t  ft;       /**< the modify-time as a FILETIME */
+        bool      is_dir;
+        unsigned  idx;      /**< the index in `ETP_mock::corpus` */
+      } mock_entry;
+
+/**
+ * \struct ETP_mock
+ * The state of one server.
+ */
+struct ETP_mock {
+       ETP_mock_cfg    cfg;
+       SOCKET          listen_sock;
+       uint16_t        port;
+       thread_t        thread;          /**< the `mock_accept()` thread */
+       mutex_t         lock;            /**< protects the fields below */
+       SOCKET          clients [MOCK_MAX_CLIENTS];
+       int             active;          /**< number of `mock_serve()` threads running */
+       ETP_mock_stats  stats;
+       mock_entry     *corpus;          /**< the synthetic corpus */
+       unsigned        corpus_len;
+     };
+
+/**
+ * \typedef mock_client
+ * The state of one connection.
+ */
+typedef struct mock_client {
+        ETP_mock      *mock;
+        SOCKET         sock;
+        int            slot;            /**< the index in `ETP_mock::clients` */
+        bool           user_ok;         /**< the `USER` was accepted */
+        bool           logged_in;
+        char           rx_buf [4*MOCK_LINE_MAX];
+        size_t         rx_head, rx_tail;
+        char          *tx_buf;
+        size_t         tx_len;
+        uint64_t       sent;
+        unsigned       commands;
+        unsigned       queries;
+        uint64_t       results;
+
+        /* The `EVERYTHING xx` settings of this session.
+         */
+        char          *search;
+        bool           regex;
+        bool           match_case;
+        bool           path_column;
+        bool           size_column;
+        bool           date_column;
+        enum mock_sort sort;
+        bool           descending;
+      } mock_client;
+
+/**
+ * Make up the synthetic corpus.
+ * A simple LCG makes the sizes and dates equal on each run.
+ */
+static bool mock_make_corpus (ETP_mock *mock)
+{
+  unsigned num_dirs = mock->cfg.num_dirs;
+  unsigned num_files = mock->cfg.num_files;
+  unsigned i, num = num_files;
+  uint32_t seed = 12345;
+  char     buf [100];
+
+  if (num_dirs == 0)
+     num_dirs = 1 + num_files / 100;
+  mock->cfg.num_dirs = num_dirs;
+
+  if (mock->cfg.with_dirs)
+     num += num_dirs;
+
+  mock->corpus = calloc (num ? num : 1, sizeof(*mock->corpus));
+  if (!mock->corpus)
+     return (false);
+
+  for (i = 0; i < num; i++)
+  {
+    mock_entry *e = mock->corpus + i;
+
+    seed = 1103515245 * seed + 12345;
+    e->idx = i;
+    e->ft  = MOCK_FILETIME_BASE + (uint64_t)seed * 100003 % MOCK_FILETIME_SPAN;
+
+    if (i < num_files)
+    {
+      snprintf (buf, sizeof(buf), "c:\\corpus\\dir-%03u", i % num_dirs);
+      e->path = strdup (buf);
+      snprintf (buf, sizeof(buf), "file-%06u.%s", i, mock_ext[i % (sizeof(mock_ext) / sizeof(mock_ext[0]))]);
+      e->name = strdup (buf);
+      e->size = (seed >> 8) % 10000000;
+    }
+    else
+    {
+      snprintf (buf, sizeof(buf), "dir-%03u", i - num_files);
+      e->path   = strdup ("c:\\corpus");
+      e->name   = strdup (buf);
+      e->is_dir = true;
+    }
+    mock->corpus_len++;
+    if (!e->path || !e->name)
+       return (false);
+  }
+  return (true);
+}
+
+static void mock_free_corpus (ETP_mock *mock)
+{
+  unsigned i;
+
+  for (i = 0; i < mock->corpus_len; i++)
+  {
+    free (mock->corpus[i].path);
+    free (mock->corpus[i].name);
+  }
+  free (mock->corpus);
+  mock->corpus = NULL;
+  mock->corpus_len = 0;
+}
+
+/**
+ * Compare 2 characters; case-insensitive unless `match_case`.
+ */
+static bool chr_equal (int a, int b, bool match_case)
+{
+  if (match_case)
+     return (a == b);
+  return (tolower(a & 255) == tolower(b & 255));
+}
+
+/**
+ * Return a pointer past the regex atom at `re`.
+ */
+static const char *re_atom_end (const char *re)
+{
+  const char *p;
+
+  if (re[0] == '\\' && re[1])
+     return (re + 2);
+
+  if (re[0] != '[')
+     return (re + 1);
+
+  p = re + 1;
+  if (*p == '^')
+     p++;
+  if (*p == ']')   /* A leading ']' is a literal */
+     p++;
+  for ( ; *p && *p != ']'; p++)
+  {
+    if (*p == '\\' && p[1])
+       p++;
+  }
+  return (*p == ']' ? p + 1 : re + 1);
+}
+
+/**
+ * Match character `c` against the `[...]` class at `re`.
+ */
+static bool re_class_match (const char *re, int c, bool match_case)
+{
+  const char *p = re + 1;
+  bool  negate = false, found = false, first = true;
+
+  if (*p == '^')
+  {
+    negate = true;
+    p++;
+  }
+  while (*p && (*p != ']' || first))
+  {
+    int lo = *p, hi;
+
+    if (lo == '\\' && p[1])
+       lo = *(++p);
+    if (p[1] == '-' && p[2] && p[2] != ']')
+    {
+      hi = p[2];
+      p += 3;
+    }
+    else
+    {
+      hi = lo;
+      p++;
+    }
+    if ((c >= lo && c <= hi) ||
+        (!match_case && tolower(c) >= tolower(lo) && tolower(c) <= tolower(hi)))
+       found = true;
+    first = false;
+  }
+  return (found != negate);
+}
+
+/**
+ * Match character `c` against the regex atom at `re`.
+ */
+static bool re_atom_match (const char *re, int c, bool match_case)
+{
+  if (re[0] == '.')
+     return (true);
+
+  if (re[0] == '[' && re_atom_end(re) > re + 1)
+     return re_class_match (re, c, match_case);
+
+  if (re[0] == '\\' && re[1])
+  {
+    switch (re[1])
+    {
+      case 'd':
+           return (isdigit(c & 255) != 0);
+      case 'w':
+           return (isalnum(c & 255) || c == '_');
+      case 's':
+           return (isspace(c & 255) != 0);
+      default:
+           return chr_equal (re[1], c, match_case);
+    }
+  }
+  return chr_equal (re[0], c, match_case);
+}
+
+/**
+ * Match the regex `re` at the start of `text`.
+ * A simple backtracking matcher after Kernighan & Pike.
+ */
+static bool re_match_here (const char *re, const char *text, bool match_case)
+{
+  const char *end, *t;
+  int         min, max;
+
+  if (*re == '\0')
+     return (true);
+
+  if (re[0] == '$' && re[1] == '\0')
+     return (*text == '\0');
+
+  end = re_atom_end (re);
+  if (*end != '*' && *end != '+' && *end != '?')
+  {
+    if (*text && re_atom_match(re, *text, match_case))
+       return re_match_here (end, text + 1, match_case);
+    return (false);
+  }
+
+  for (t = text; *t && re_atom_match(re, *t, match_case); t++)
+      ;
+  min = (*end == '+') ? 1 : 0;
+  max = (int) (t - text);
+  if (*end == '?' && max > 1)
+     max = 1;
+
+  for ( ; max >= min; max--)   /* Greedy; try the longest first */
+  {
+    if (re_match_here(end + 1, text + max, match_case))
+       return (true);
+  }
+  return (false);
+}
+
+static bool re_match (const char *re, const char *text, bool match_case)
+{
+  if (*re == '^')
+     return re_match_here (re + 1, text, match_case);
+
+  do
+  {
+    if (re_match_here(re, text, match_case))
+       return (true);
+  }
+  while (*text++);
+  return (false);
+}
+
+/**
+ * Match `text` against the wildcard `pat` with `*` and `?`.
+ */
+static bool wild_match (const char *pat, const char *text, bool match_case)
+{
+  const char *star = NULL, *star_text = NULL;
+
+  while (*text)
+  {
+    if (*pat == '*')
+    {
+      star = pat++;
+      star_text = text;
+    }
+    else if (*pat == '?' || (*pat && chr_equal(*pat, *text, match_case)))
+    {
+      pat++;
+      text++;
+    }
+    else if (star)
+    {
+      pat = star + 1;
+      text = ++star_text;
+    }
+    else
+      return (false);
+  }
+  while (*pat == '*')
+     pat++;
+  return (*pat == '\0');
+}
+
+/**
+ * Return true if `text` contains the `len` first characters of `str`.
+ */
+static bool sub_match (const char *str, size_t len, const char *text, bool match_case)
+{
+  size_t i;
+
+  for ( ; *text; text++)
+  {
+    for (i = 0; i < len && text[i] && chr_equal(str[i], text[i], match_case); i++)
+        ;
+    if (i == len)
+       return (true);
+  }
+  return (len == 0);
+}
+
+/**
+ * Match a file-name against the `EVERYTHING SEARCH` of this session.
+ */
+static bool mock_match (const mock_client *cl, const char *name)
+{
+  const char *s = cl->search;
+
+  if (!s || !*s)
+     return (true);
+
+  if (cl->regex)
+     return re_match (s, name, cl->match_case);
+
+  while (*s)
+  {
+    char   term [MOCK_LINE_MAX];
+    size_t len = strcspn (s, " ");
+
+    if (len > 0)
+    {
+      if (len >= sizeof(term))
+         len = sizeof(term) - 1;
+      memcpy (term, s, len);
+      term [len] = '\0';
+
+      if (strpbrk(term, "*?") ? !wild_match(term, name, cl->match_case) :
+                                !sub_match(term, len, name, cl->match_case))
+         return (false);
+    }
+    s += len;
+    while (*s == ' ')
+       s++;
+  }
+  return (true);
+}
+
+static int sort_tie (const mock_entry *a, const mock_entry *b)
+{
+  return (a->idx < b->idx ? -1 : a->idx > b->idx);
+}
+
+static int sort_name (const void *_a, const void *_b)
+{
+  const mock_entry *a = *(const mock_entry**) _a;
+  const mock_entry *b = *(const mock_entry**) _b;
+  int   rc = strcasecmp (a->name, b->name);
+
+  return (rc ? rc : sort_tie(a, b));
+}
+
+static int sort_path (const void *_a, const void *_b)
+{
+  const mock_entry *a = *(const mock_entry**) _a;
+  const mock_entry *b = *(const mock_entry**) _b;
+  int   rc = strcasecmp (a->path, b->path);
+
+  if (rc == 0)
+     rc = strcasecmp (a->name, b->name);
+  return (rc ? rc : sort_tie(a, b));
+}
+
+static int sort_size (const void *_a, const void *_b)
+{
+  const mock_entry *a = *(const mock_entry**) _a;
+  const mock_entry *b = *(const mock_entry**) _b;
+
+  if (a->size != b->size)
+     return (a->size < b->size ? -1 : 1);
+  return sort_tie (a, b);
+}
+
+static int sort_date (const void *_a, const void *_b)
+{
+  const mock_entry *a = *(const mock_entry**) _a;
+  const mock_entry *b = *(const mock_entry**) _b;
+
+  if (a->ft != b->ft)
+     return (a->ft < b->ft ? -1 : 1);
+  return sort_tie (a, b);
+}
+
+/**
+ * Send all of `buf`.
+ */
+static bool mock_send (mock_client *cl, const char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    int rc = send (cl->sock, buf, (int) (len < MOCK_TX_CHUNK ? len : MOCK_TX_CHUNK), MSG_NOSIGNAL);
+
+    if (rc <= 0)
+       return (false);
+    buf += rc;
+    len -= rc;
+    cl->sent += rc;
+  }
+  return (true);
+}
+
+/**
+ * Add a line to the transmit buffer. Send the buffer when it's full.
+ */
+static bool mock_add (mock_client *cl, const char *fmt, ...)
+{
+  va_list args;
+  int     len;
+
+  if (cl->tx_len + MOCK_LINE_MAX > MOCK_TX_CHUNK)
+  {
+    if (!mock_send(cl, cl->tx_buf, cl->tx_len))
+       return (false);
+    cl->tx_len = 0;
+  }
+
+  va_start (args, fmt);
+  len = vsnprintf (cl->tx_buf + cl->tx_len, MOCK_LINE_MAX - 2, fmt, args);
+  va_end (args);
+
+  if (len < 0 || len > MOCK_LINE_MAX - 3)
+     len = MOCK_LINE_MAX - 3;
+  if (cl->mock->cfg.verbose >= 2)
+     fprintf (stderr, "etp_mock %u: < %.*s\n", cl->mock->port, len, cl->tx_buf + cl->tx_len);
+
+  cl->tx_len += len;
+  cl->tx_buf [cl->tx_len++] = '\r';
+  cl->tx_buf [cl->tx_len++] = '\n';
+  return (true);
+}
+
+/**
+ * Send the pending lines in the transmit buffer.
+ */
+static bool mock_flush (mock_client *cl)
+{
+  bool rc = mock_send (cl, cl->tx_buf, cl->tx_len);
+
+  cl->tx_len = 0;
+  return (rc);
+}
+
+/**
+ * Reply to an `EVERYTHING QUERY` command.
+ */
+static bool mock_query (mock_client *cl)
+{
+  ETP_mock           *mock = cl->mock;
+  const mock_entry  **match;
+  unsigned            i, num = 0;
+  bool                rc = true;
+
+  match = malloc ((mock->corpus_len + 1) * sizeof(*match));
+  if (!match)
+     return mock_add (cl, "500 Out of memory.");
+
+  for (i = 0; i < mock->corpus_len; i++)
+  {
+    if (mock_match(cl, mock->corpus[i].name))
+       match [num++] = mock->corpus + i;
+  }
+
+  switch (cl->sort)
+  {
+    case MOCK_SORT_NAME:
+         qsort (match, num, sizeof(*match), sort_name);
+         break;
+    case MOCK_SORT_PATH:
+         qsort (match, num, sizeof(*match), sort_path);
+         break;
+    case MOCK_SORT_SIZE:
+         qsort (match, num, sizeof(*match), sort_size);
+         break;
+    case MOCK_SORT_DATE:
+         qsort (match, num, sizeof(*match), sort_date);
+         break;
+    default:
+         break;
+  }
+
+  rc = mock_add (cl, "200-Query results") && mock_add (cl, " RESULT_COUNT %u", num);
+
+  for (i = 0; rc && i < num; i++)
+  {
+    const mock_entry *e = match [cl->descending ? num - 1 - i : i];
+
+    if (cl->path_column)
+       rc = mock_add (cl, " PATH %s", e->path);
+    if (rc && cl->size_column)
+       rc = mock_add (cl, " SIZE %" PRIu64, e->size);
+    if (rc && cl->date_column)
+       rc = mock_add (cl, " DATE_MODIFIED %" PRIu64, e->ft);
+    if (rc)
+       rc = mock_add (cl, " %s %s", e->is_dir ? "FOLDER" : "FILE", e->name);
+  }
+  if (rc)
+     rc = mock_add (cl, "200 End.");
+
+  cl->queries++;
+  cl->results += num;
+  free (match);
+  return (rc);
+}
+
+/**
+ * Handle an `EVERYTHING xx` command.
+ */
+static bool mock_everything (mock_client *cl, const char *cmd)
+{
+  const char *arg = strchr (cmd, ' ');
+  size_t      len = arg ? (size_t)(arg - cmd) : strlen (cmd);
+  bool        on;
+
+  arg = arg ? arg + 1 : "";
+  on  = (atoi(arg) != 0);
+
+  if (len == 5 && !strncmp(cmd, "QUERY", 5))
+     return mock_query (cl);
+
+  if (len == 6 && !strncmp(cmd, "SEARCH", 6))
+  {
+    free (cl->search);
+    cl->search = strdup (arg);
+    return mock_add (cl, "200 Search set to (%s).", arg);
+  }
+
+  if (len == 5 && !strncmp(cmd, "REGEX", 5))
+  {
+    cl->regex = on;
+    return mock_add (cl, "200 Regex set to (%d).", on);
+  }
+
+  if (len == 4 && !strncmp(cmd, "CASE", 4))
+  {
+    cl->match_case = on;
+    return mock_add (cl, "200 Match case set to (%d).", on);
+  }
+
+  if (len == 11 && !strncmp(cmd, "PATH_COLUMN", 11))
+  {
+    cl->path_column = on;
+    return mock_add (cl, "200 Path column set to (%d).", on);
+  }
+
+  if (len == 11 && !strncmp(cmd, "SIZE_COLUMN", 11))
+  {
+    cl->size_column = on;
+    return mock_add (cl, "200 Size column set to (%d).", on);
+  }
+
+  if (len == 20 && !strncmp(cmd, "DATE_MODIFIED_COLUMN", 20))
+  {
+    cl->date_column = on;
+    return mock_add (cl, "200 Date modified column set to (%d).", on);
+  }
+
+  if (len == 4 && !strncmp(cmd, "SORT", 4))
+  {
+    static const struct {
+           const char    *name;
+           enum mock_sort sort;
+         } sorts[] = {
+           { "NAME_",          MOCK_SORT_NAME },
+           { "PATH_",          MOCK_SORT_PATH },
+           { "SIZE_",          MOCK_SORT_SIZE },
+           { "DATE_MODIFIED_", MOCK_SORT_DATE }
+         };
+    unsigned i;
+
+    for (i = 0; i < sizeof(sorts) / sizeof(sorts[0]); i++)
+    {
+      size_t      n = strlen (sorts[i].name);
+      const char *dir = arg + n;
+
+      if (strncmp(arg, sorts[i].name, n))
+         continue;
+      if (strcmp(dir, "ASCENDING") && strcmp(dir, "DESCENDING"))
+         break;
+      cl->sort = sorts[i].sort;
+      cl->descending = (*dir == 'D');
+      return mock_add (cl, "200 Sort set to (%s).", arg);
+    }
+    return mock_add (cl, "501 Unknown sort (%s).", arg);
+  }
+  return mock_add (cl, "501 Unknown EVERYTHING command.");
+}
+
+/**
+ * Handle a command. Returns `false` to close the connection.
+ */
+static bool mock_command (mock_client *cl, const char *cmd)
+{
+  const ETP_mock_cfg *cfg = &cl->mock->cfg;
+
+  if (cfg->verbose)
+     fprintf (stderr, "etp_mock %u: > %s\n", cl->mock->port, cmd);
+  cl->commands++;
+
+  if (!strcmp(cmd, "USER") || !strncmp(cmd, "USER ", 5))
+  {
+    const char *user = cmd[4] ? cmd + 5 : "";
+
+    cl->logged_in = false;
+    cl->user_ok = (!cfg->user || !strcmp(user, cfg->user));
+    if (cl->user_ok && (!cfg->password || (!*user && !*cfg->password)))
+    {
+      cl->logged_in = true;
+      return mock_add (cl, "230 Logged on.");
+    }
+    if (!*user)
+       return mock_add (cl, "530 Login or password incorrect!");
+    return mock_add (cl, "331 Password required for %s", user);
+  }
+
+  if (!strncmp(cmd, "PASS ", 5) || !strcmp(cmd, "PASS"))
+  {
+    const char *pass = cmd[4] ? cmd + 5 : "";
+
+    cl->logged_in = (cl->user_ok && (!cfg->password || !strcmp(pass, cfg->password)));
+    if (cl->logged_in)
+       return mock_add (cl, "230 Logged on.");
+    return mock_add (cl, "530 Login or password incorrect!");
+  }
+
+  if (!strcmp(cmd, "QUIT"))
+  {
+    mock_add (cl, "221 Goodbye.");
+    return (false);
+  }
+
+  if (!strcmp(cmd, "NOOP"))
+     return mock_add (cl, "200 NOOP ok.");
+
+  if (!strcmp(cmd, "FEAT"))
+     return mock_add (cl, "211-Features:") && mock_add (cl, " UTF8") &&
+            mock_add (cl, " EVERYTHING") && mock_add (cl, "211 End");
+
+  if (!cl->logged_in)
+     return mock_add (cl, "530 Not logged on.");
+
+  if (!strncmp(cmd, "EVERYTHING ", 11))
+     return mock_everything (cl, cmd + 11);
+
+  return mock_add (cl, "500 Syntax error, command unrecognized.");
+}
+
+/**
+ * Get the next command from `cl->rx_buf`.
+ * Returns `NULL` if there is no complete line in it.
+ */
+static char *mock_get_line (mock_client *cl)
+{
+  char *start = cl->rx_buf + cl->rx_head;
+  char *end = memchr (start, '\n', cl->rx_tail - cl->rx_head);
+
+  if (!end)
+     return (NULL);
+
+  cl->rx_head = end - cl->rx_buf + 1;
+  if (end > start && end[-1] == '\r')
+     end--;
+  *end = '\0';
+  return (start);
+}
+
+/**
+ * Receive more commands into `cl->rx_buf`.
+ * Sleep for `cfg->rtt` msec since it had to wait for them.
+ */
+static bool mock_recv (mock_client *cl)
+{
+  int rc;
+
+  if (cl->rx_head > 0)
+  {
+    memmove (cl->rx_buf, cl->rx_buf + cl->rx_head, cl->rx_tail - cl->rx_head);
+    cl->rx_tail -= cl->rx_head;
+    cl->rx_head = 0;
+  }
+  if (cl->rx_tail >= sizeof(cl->rx_buf) - 1)   /* A too long command; drop it */
+     cl->rx_tail = 0;
+
+  rc = recv (cl->sock, cl->rx_buf + cl->rx_tail, (int) (sizeof(cl->rx_buf) - 1 - cl->rx_tail), 0);
+  if (rc <= 0)
+     return (false);
+
+  cl->rx_tail += rc;
+  if (cl->mock->cfg.rtt)
+     mock_sleep (cl->mock->cfg.rtt);
+  return (true);
+}
+
+/**
+ * The thread serving one client.
+ */
+static THREAD_FUNC mock_serve (void *arg)
+{
+  mock_client *cl = arg;
+  ETP_mock    *mock = cl->mock;
+  bool         ok;
+
+  ok = mock_add (cl, "220 Welcome to Everything ETP/FTP") && mock_flush (cl);
+  while (ok)
+  {
+    char *cmd = mock_get_line (cl);
+
+    if (cmd)
+    {
+      ok = mock_command (cl, cmd);
+      continue;
+    }
+    /* All commands received so far are handled. Send the replies before waiting.
+     */
+    ok = mock_flush (cl) && mock_recv (cl);
+  }
+  mock_flush (cl);
+
+  mutex_lock (&mock->lock);
+  mock->clients [cl->slot] = INVALID_SOCKET;
+  mock->stats.connections++;
+  mock->stats.commands   += cl->commands;
+  mock->stats.queries    += cl->queries;
+  mock->stats.results    += cl->results;
+  mock->stats.bytes_sent += cl->sent;
+  mock->active--;
+  mutex_unlock (&mock->lock);
+
+  closesocket (cl->sock);
+  free (cl->search);
+  free (cl->tx_buf);
+  free (cl);
+  return (THREAD_RET);
+}
+
+/**
+ * Start a `mock_serve()` thread for a new client.
+ */
+static void mock_new_client (ETP_mock *mock, SOCKET sock)
+{
+  mock_client *cl = calloc (1, sizeof(*cl));
+  bool         ok = false;
+  int          slot;
+
+  if (cl)
+     cl->tx_buf = malloc (MOCK_TX_CHUNK);
+
+  mutex_lock (&mock->lock);
+  for (slot = 0; slot < MOCK_MAX_CLIENTS; slot++)
+      if (mock->clients[slot] == INVALID_SOCKET)
+         break;
+
+  if (cl && cl->tx_buf && slot < MOCK_MAX_CLIENTS)
+  {
+    thread_t t;
+
+    cl->mock = mock;
+    cl->sock = sock;
+    cl->slot = slot;
+    mock->clients [slot] = sock;
+    mock->active++;
+#if defined(_WIN32)
+    t = CreateThread (NULL, 0, mock_serve, cl, 0, NULL);
+    ok = (t != NULL);
+    if (ok)
+       CloseHandle (t);
+#else
+    ok = (pthread_create(&t, NULL, mock_serve, cl) == 0);
+    if (ok)
+       pthread_detach (t);
+#endif
+    if (!ok)
+    {
+      mock->clients [slot] = INVALID_SOCKET;
+      mock->active--;
+    }
+  }
+  mutex_unlock (&mock->lock);
+
+  if (!ok)
+  {
+    closesocket (sock);
+    if (cl)
+       free (cl->tx_buf);
+    free (cl);
+  }
+}
+
+/**
+ * The thread accepting clients until `ETP_mock_stop()` closes the listening socket.
+ */
+static THREAD_FUNC mock_accept (void *arg)
+{
+  ETP_mock *mock = arg;
+
+  while (1)
+  {
+    SOCKET sock = accept (mock->listen_sock, NULL, NULL);
+
+    if (sock == INVALID_SOCKET)
+       break;
+    mock_new_client (mock, sock);
+  }
+  return (THREAD_RET);
+}
+
+/**
+ * Make the corpus and start listening.
+ *
+ * \param[in] cfg  the settings of this server.
+ * \retval    the server or `NULL` on failure.
+ */
+ETP_mock *ETP_mock_start (const ETP_mock_cfg *cfg)
+{
+  struct sockaddr_in sa;
+  mock_socklen       sa_len = sizeof(sa);
+  ETP_mock          *mock;
+  int                i, on = 1;
+
+#if defined(_WIN32)
+  WSADATA wsadata;
+
+  if (WSAStartup(MAKEWORD(2,2), &wsadata))
+     return (NULL);
+#endif
+
+  mock = calloc (1, sizeof(*mock));
+  if (!mock)
+     return (NULL);
+
+  mock->cfg = *cfg;
+  mock->listen_sock = INVALID_SOCKET;
+  for (i = 0; i < MOCK_MAX_CLIENTS; i++)
+      mock->clients[i] = INVALID_SOCKET;
+  mutex_init (&mock->lock);
+
+  if (!mock_make_corpus(mock))
+     goto fail;
+
+  memset (&sa, '\0', sizeof(sa));
+  sa.sin_family      = AF_INET;
+  sa.sin_port        = htons (cfg->port);
+  sa.sin_addr.s_addr = htonl (cfg->listen_any ? INADDR_ANY : INADDR_LOOPBACK);
+
+  mock->listen_sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (mock->listen_sock == INVALID_SOCKET)
+     goto fail;
+
+  setsockopt (mock->listen_sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+  if (bind(mock->listen_sock, (const struct sockaddr*)&sa, sizeof(sa)) ||
+      listen(mock->listen_sock, MOCK_MAX_CLIENTS) ||
+      getsockname(mock->listen_sock, (struct sockaddr*)&sa, &sa_len))
+     goto fail;
+
+  mock->port = ntohs (sa.sin_port);
+
+#if defined(_WIN32)
+  mock->thread = CreateThread (NULL, 0, mock_accept, mock, 0, NULL);
+  if (mock->thread)
+     return (mock);
+#else
+  if (pthread_create(&mock->thread, NULL, mock_accept, mock) == 0)
+     return (mock);
+#endif
+
+fail:
+  if (mock->listen_sock != INVALID_SOCKET)
+     closesocket (mock->listen_sock);
+  mock_free_corpus (mock);
+  mutex_destroy (&mock->lock);
+  free (mock);
+#if defined(_WIN32)
+  WSACleanup();
+#endif
+  return (NULL);
+}
+
+/**
+ * Return the port the server listens on.
+ */
+uint16_t ETP_mock_port (const ETP_mock *mock)
+{
+  return (mock->port);
+}
+
+/**
+ * Stop accepting clients, disconnect the ones still connected and wait for
+ * their threads to finish. Then free the server.
+ *
+ * \param[in]  mock   the server to stop.
+ * \param[out] stats  if not `NULL`, the counters of this server.
+ */
+void ETP_mock_stop (ETP_mock *mock, ETP_mock_stats *stats)
+{
+  int i, active;
+
+  if (!mock)
+     return;
+
+  /* A `close()` alone does not make a waiting `accept()` fail on Linux.
+   */
+  shutdown (mock->listen_sock, SHUT_RDWR);
+  closesocket (mock->listen_sock);
+#if defined(_WIN32)
+  WaitForSingleObject (mock->thread, INFINITE);
+  CloseHandle (mock->thread);
+#else
+  pthread_join (mock->thread, NULL);
+#endif
+
+  mutex_lock (&mock->lock);
+  for (i = 0; i < MOCK_MAX_CLIENTS; i++)
+  {
+    if (mock->clients[i] != INVALID_SOCKET)
+       shutdown (mock->clients[i], SHUT_RDWR);
+  }
+  mutex_unlock (&mock->lock);
+
+  do
+  {
+    mutex_lock (&mock->lock);
+    active = mock->active;
+    mutex_unlock (&mock->lock);
+    if (active > 0)
+       mock_sleep (10);
+  }
+  while (active > 0);
+
+  if (stats)
+     *stats = mock->stats;
+
+  mock_free_corpus (mock);
+  mutex_destroy (&mock->lock);
+  free (mock);
+#if defined(_WIN32)
+  WSACleanup();
+#endif
+}
+
+#if defined(ETP_MOCK_TEST)
+
+#include <signal.h>
+
+static volatile int quit = 0;
+
+static void sig_handler (int sig)
+{
+  quit = 1;
+  (void) sig;
+}
+
+static void usage (void)
+{
+  printf ("Usage: etp_mock [-p port] [-n files] [-d dirs] [-D] [-r msec] [-u user] [-P password] [-a] [-v]\n"
+          "       -p:  the port to listen on (default 21).\n"
+          "       -n:  the number of files in the corpus (default 10000).\n"
+          "       -d:  the number of folders (default 1 per 100 files).\n"
+          "       -D:  report the folders as results too.\n"
+          "       -r:  the round trip time to inject.\n"
+          "       -u:  the user to accept (default any).\n"
+          "       -P:  the password to accept (default none).\n"
+          "       -a:  listen on all interfaces (default 127.0.0.1 only).\n"
+          "       -v:  print the commands (-vv: and the replies).\n");
+  exit (-1);
+}
+
+int main (int argc, char **argv)
+{
+  ETP_mock_cfg   cfg;
+  ETP_mock_stats stats;
+  ETP_mock      *mock;
+  int            i;
+
+  memset (&cfg, '\0', sizeof(cfg));
+  cfg.port       = 21;
+  cfg.num_files  = 10000;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i+1] : NULL;
+
+    if (arg[0] != '-' || !arg[1] || (arg[2] && arg[1] != 'v'))
+       usage();
+
+    switch (arg[1])
+    {
+      case 'D':
+           cfg.with_dirs = true;
+           continue;
+      case 'a':
+           cfg.listen_any = true;
+           continue;
+      case 'v':
+           cfg.verbose += (int) strlen (arg + 1);
+           continue;
+    }
+
+    if (!val)
+       usage();
+    i++;
+
+    switch (arg[1])
+    {
+      case 'p':
+           cfg.port = (uint16_t) atoi (val);
+           break;
+      case 'n':
+           cfg.num_files = (unsigned) atoi (val);
+           break;
+      case 'd':
+           cfg.num_dirs = (unsigned) atoi (val);
+           break;
+      case 'r':
+           cfg.rtt = (unsigned) atoi (val);
+           break;
+      case 'u':
+           cfg.user = val;
+           break;
+      case 'P':
+           cfg.password = val;
+           break;
+      default:
+           usage();
+    }
+  }
+
+  mock = ETP_mock_start (&cfg);
+  if (!mock)
+  {
+    fprintf (stderr, "Failed to start on port %u.\n", cfg.port);
+    return (1);
+  }
+
+  printf ("Serving %u files on port %u. Press ^C to stop.\n", cfg.num_files, ETP_mock_port(mock));
+  fflush (stdout);
+  signal (SIGINT, sig_handler);
+  signal (SIGTERM, sig_handler);
+  while (!quit)
+     mock_sleep (100);
+
+  ETP_mock_stop (mock, &stats);
+  printf ("%u connections, %u commands, %u queries, %" PRIu64 " results, %" PRIu64 " bytes sent.\n",
+          stats.connections, stats.commands, stats.queries, stats.results, stats.bytes_sent);
+  return (0);
+}
+#endif  /* ETP_MOCK_TEST */
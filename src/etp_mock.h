@@ -0,0 +1,48 @@
+/** \file etp_mock.h
+ *  \ingroup EveryThing_ETP
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * \typedef ETP_mock_cfg
+ *
+ * The settings of a stand-in ETP-server started by `ETP_mock_start()`.
+ *
+ * It serves a synthetic corpus of `num_files` files named `file-NNNNNN.ext`
+ * (`NNNNNN` = `000000` ... `num_files - 1`) spread over `num_dirs` folders
+ * named `c:\corpus\dir-NNN`. The extension cycles through 10 extensions; `.txt` is
+ * the 3rd. With `with_dirs == true`, the folders are matched too.
+ */
+typedef struct ETP_mock_cfg {
+        const char *user;         /**< the `USER` to accept. `NULL` accepts any user */
+        const char *password;     /**< the `PASS` to accept. `NULL` ignores passwords (like `etp_server_password=`) */
+        uint16_t    port;         /**< the port to listen on. 0 picks a free port */
+        bool        listen_any;   /**< listen on all interfaces; not only `127.0.0.1` */
+        unsigned    num_files;    /**< the number of files in the corpus */
+        unsigned    num_dirs;     /**< the number of folders. 0 gives 1 folder per 100 files */
+        bool        with_dirs;    /**< report the folders as results too */
+        unsigned    rtt;          /**< msec round trip time to inject */
+        int         verbose;      /**< print the commands and replies to `stderr` */
+      } ETP_mock_cfg;
+
+/**
+ * \typedef ETP_mock_stats
+ *
+ * The counters returned by `ETP_mock_stop()`.
+ */
+typedef struct ETP_mock_stats {
+        unsigned  connections;    /**< number of clients served */
+        unsigned  commands;       /**< number of commands received */
+        unsigned  queries;        /**< number of `EVERYTHING QUERY` commands */
+        uint64_t  results;        /**< number of results sent */
+        uint64_t  bytes_sent;     /**< number of bytes sent */
+      } ETP_mock_stats;
+
+typedef struct ETP_mock ETP_mock;
+
+extern ETP_mock *ETP_mock_start (const ETP_mock_cfg *cfg);
+extern uint16_t  ETP_mock_port  (const ETP_mock *mock);
+extern void      ETP_mock_stop  (ETP_mock *mock, ETP_mock_stats *stats);
@@ -0,0 +1,619 @@
+/**
+ * \file    inflate.c
+ * \ingroup Misc
+ * \brief
+ *   A small streaming DEFLATE decoder (RFC 1951) for searching
+ *   inside GZIP-files (RFC 1952) and ZIP-files without a temporary file.
+ *
+ * The input must be in memory (a memory-mapped file). The output goes
+ * through a `2 * INFLATE_WINDOW` byte sliding window and is passed to
+ * an `inflate_func` callback one chunk at a time. Hence the memory used
+ * does not depend on the size of the decompressed data.
+ *
+ * CRCs are not checked.
+ */
+#include "envtool.h"
+#include "inflate.h"
+
+#define MAX_BITS     15    /**< the longest Huffman code */
+#define MAX_LCODES   286   /**< the max number of literal/length codes */
+#define MAX_DCODES   30    /**< the max number of distance codes */
+#define FIXED_LCODES 288   /**< the number of codes in the fixed literal/length code */
+#define FAST_BITS    9     /**< codes this short are decoded with a table lookup */
+
+/**
+ * \typedef huffman
+ *
+ * A canonical Huffman code. As in Mark Adler's `puff.c`; `count[]` and
+ * `symbol[]` are enough to decode. `fast[]` is indexed by the next
+ * `FAST_BITS` input bits and holds `(length << 9) | symbol` for codes
+ * not longer than that. 0 means the code is longer.
+ */
+typedef struct huffman {
+        WORD count [MAX_BITS+1];
+        WORD symbol [FIXED_LCODES];
+        WORD fast [1 << FAST_BITS];
+      } huffman;
+
+/**
+ * \typedef inflate_state
+ *
+ * The state of one `inflate_raw()` call.
+ */
+typedef struct inflate_state {
+        const BYTE  *in;         /**< the next input byte */
+        const BYTE  *in_end;     /**< the end of the input */
+        UINT64       bit_buf;    /**< the input bits not used yet */
+        unsigned     bit_cnt;    /**< the number of bits in `bit_buf` */
+        BYTE        *window;     /**< the output; `2 * INFLATE_WINDOW` bytes */
+        size_t       pos;        /**< the next output position in `window` */
+        size_t       flushed;    /**< `window` is passed to `func` up to here */
+        UINT64       total;      /**< the total number of output bytes */
+        inflate_func func;
+        void        *arg;
+        bool         error;      /**< corrupt input */
+        bool         stop;       /**< `func` returned `false` */
+        huffman      lencode;
+        huffman      distcode;
+      } inflate_state;
+
+static const WORD len_base [29] = {
+                  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+                };
+static const BYTE len_extra [29] = {
+                  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+                };
+static const WORD dist_base [30] = {
+                  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                  8193, 12289, 16385, 24577
+                };
+static const BYTE dist_extra [30] = {
+                  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+                };
+
+/**
+ * Fill `s->bit_buf` with as many whole input bytes as fits.
+ */
+static void fill_bits (inflate_state *s)
+{
+  while (s->bit_cnt <= 56 && s->in < s->in_end)
+  {
+    s->bit_buf |= (UINT64)*s->in++ << s->bit_cnt;
+    s->bit_cnt += 8;
+  }
+}
+
+/**
+ * Return the next `need` bits (LSB first). Set `s->error` on end of input.
+ */
+static unsigned get_bits (inflate_state *s, unsigned need)
+{
+  unsigned val;
+
+  if (s->bit_cnt < need)
+  {
+    fill_bits (s);
+    if (s->bit_cnt < need)
+    {
+      s->error = true;
+      return (0);
+    }
+  }
+  val = (unsigned) (s->bit_buf & ((1U << need) - 1));
+  s->bit_buf >>= need;
+  s->bit_cnt -= need;
+  return (val);
+}
+
+/**
+ * Build a canonical Huffman code from the code lengths in `length[0..n-1]`.
+ * An incomplete code is accepted; a code not assigned gives an error in `decode()`.
+ *
+ * \retval false if the code is over-subscribed.
+ */
+static bool build_huffman (huffman *h, const BYTE *length, int n)
+{
+  WORD offs [MAX_BITS+1], next_code [MAX_BITS+1];
+  int  sym, len, left = 1;
+  WORD code = 0;
+
+  memset (h->count, '\0', sizeof(h->count));
+  memset (h->fast, '\0', sizeof(h->fast));
+
+  for (sym = 0; sym < n; sym++)
+      h->count [length[sym]]++;
+
+  for (len = 1; len <= MAX_BITS; len++)
+  {
+    left <<= 1;
+    left -= h->count [len];
+    if (left < 0)
+       return (false);
+  }
+
+  offs [1] = 0;
+  for (len = 1; len < MAX_BITS; len++)
+      offs [len+1] = offs [len] + h->count [len];
+
+  h->count [0] = 0;
+  for (len = 1; len <= MAX_BITS; len++)
+  {
+    code = (code + h->count [len-1]) << 1;
+    next_code [len] = code;
+  }
+
+  for (sym = 0; sym < n; sym++)
+  {
+    unsigned rev, i;
+
+    len = length [sym];
+    if (len == 0)
+       continue;
+
+    h->symbol [offs[len]++] = (WORD) sym;
+    code = next_code [len]++;
+    if (len > FAST_BITS)
+       continue;
+
+    /* The input is LSB first; index `fast[]` by the bit-reversed code.
+     */
+    for (rev = 0, i = 0; i < (unsigned)len; i++)
+        rev |= ((code >> i) & 1) << (len - 1 - i);
+    for (i = rev; i < (1U << FAST_BITS); i += (1U << len))
+        h->fast [i] = (WORD) ((len << 9) | sym);
+  }
+  return (true);
+}
+
+/**
+ * Decode one symbol with the code `h`.
+ * Use `h->fast[]` and fall back to a bit-by-bit decode for long codes.
+ */
+static int decode (inflate_state *s, const huffman *h)
+{
+  int      code = 0, first = 0, index = 0, len;
+  unsigned entry;
+
+  if (s->bit_cnt < MAX_BITS)
+     fill_bits (s);
+
+  entry = h->fast [s->bit_buf & ((1 << FAST_BITS) - 1)];
+  if (entry && (entry >> 9) <= s->bit_cnt)
+  {
+    s->bit_buf >>= entry >> 9;
+    s->bit_cnt  -= entry >> 9;
+    return (entry & 511);
+  }
+
+  for (len = 1; len <= MAX_BITS && len <= (int)s->bit_cnt; len++)
+  {
+    int count = h->count [len];
+
+    code |= (int) ((s->bit_buf >> (len - 1)) & 1);
+    if (code - count < first)
+    {
+      s->bit_buf >>= len;
+      s->bit_cnt  -= len;
+      return (h->symbol [index + (code - first)]);
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code  <<= 1;
+  }
+  s->error = true;
+  return (-1);
+}
+
+/**
+ * Pass the output not yet flushed to `s->func`.
+ * Then slide the window when it is full.
+ */
+static void flush_window (inflate_state *s)
+{
+  if (s->pos > s->flushed && !(*s->func) (s->arg, s->window + s->flushed, s->pos - s->flushed))
+     s->stop = true;
+  s->flushed = s->pos;
+
+  if (s->pos == 2*INFLATE_WINDOW)
+  {
+    memmove (s->window, s->window + INFLATE_WINDOW, INFLATE_WINDOW);
+    s->pos = s->flushed = INFLATE_WINDOW;
+  }
+}
+
+/**
+ * Copy `len` bytes from `dist` bytes back in the output.
+ * The areas can overlap; a run of bytes is repeated then.
+ */
+static void copy_match (inflate_state *s, unsigned len, unsigned dist)
+{
+  if (dist > s->total)
+  {
+    s->error = true;
+    return;
+  }
+  s->total += len;
+
+  while (len > 0 && !s->stop)
+  {
+    size_t n = min (len, 2*INFLATE_WINDOW - s->pos);
+    BYTE  *to = s->window + s->pos;
+    BYTE  *from = to - dist;
+
+    s->pos += n;
+    len -= (unsigned) n;
+    while (n--)
+       *to++ = *from++;
+    if (s->pos == 2*INFLATE_WINDOW)
+       flush_window (s);
+  }
+}
+
+/**
+ * Decode a stored block.
+ */
+static void inflate_stored (inflate_state *s)
+{
+  size_t len, nlen;
+
+  /* Go back to a byte boundary and "unread" the whole bytes in `bit_buf`.
+   */
+  s->in -= s->bit_cnt / 8;
+  s->bit_buf = 0;
+  s->bit_cnt = 0;
+
+  if (s->in + 4 > s->in_end)
+  {
+    s->error = true;
+    return;
+  }
+  len  = s->in[0] | (s->in[1] << 8);
+  nlen = s->in[2] | (s->in[3] << 8);
+  s->in += 4;
+  if (len != (~nlen & 0xFFFF) || len > (size_t)(s->in_end - s->in))
+  {
+    s->error = true;
+    return;
+  }
+  s->total += len;
+
+  while (len > 0 && !s->stop)
+  {
+    size_t n = min (len, 2*INFLATE_WINDOW - s->pos);
+
+    memcpy (s->window + s->pos, s->in, n);
+    s->in  += n;
+    s->pos += n;
+    len    -= n;
+    if (s->pos == 2*INFLATE_WINDOW)
+       flush_window (s);
+  }
+}
+
+/**
+ * Decode the literal/length and distance codes of a block with `s->lencode`
+ * and `s->distcode` until the end-of-block code.
+ */
+static void inflate_codes (inflate_state *s)
+{
+  while (!s->error && !s->stop)
+  {
+    int sym = decode (s, &s->lencode);
+
+    if (sym < 256)
+    {
+      if (sym < 0)
+         break;
+      s->window [s->pos++] = (BYTE) sym;
+      s->total++;
+      if (s->pos == 2*INFLATE_WINDOW)
+         flush_window (s);
+    }
+    else if (sym == 256)
+      break;
+    else
+    {
+      unsigned len, dist;
+
+      sym -= 257;
+      if (sym >= 29)
+      {
+        s->error = true;
+        break;
+      }
+      len = len_base [sym] + get_bits (s, len_extra[sym]);
+
+      sym = decode (s, &s->distcode);
+      if (sym < 0 || sym >= 30)
+      {
+        s->error = true;
+        break;
+      }
+      dist = dist_base [sym] + get_bits (s, dist_extra[sym]);
+      if (!s->error)
+         copy_match (s, len, dist);
+    }
+  }
+}
+
+/**
+ * Set up the fixed codes for a block of type 1.
+ */
+static void inflate_fixed (inflate_state *s)
+{
+  BYTE lengths [FIXED_LCODES];
+  int  i;
+
+  for (i = 0; i < 144; i++)
+      lengths [i] = 8;
+  for ( ; i < 256; i++)
+      lengths [i] = 9;
+  for ( ; i < 280; i++)
+      lengths [i] = 7;
+  for ( ; i < FIXED_LCODES; i++)
+      lengths [i] = 8;
+  build_huffman (&s->lencode, lengths, FIXED_LCODES);
+
+  for (i = 0; i < MAX_DCODES; i++)
+      lengths [i] = 5;
+  build_huffman (&s->distcode, lengths, MAX_DCODES);
+
+  inflate_codes (s);
+}
+
+/**
+ * Read the code lengths for a block of type 2. Then decode it.
+ */
+static void inflate_dynamic (inflate_state *s)
+{
+  static const BYTE order [19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+  BYTE lengths [MAX_LCODES + MAX_DCODES];
+  int  nlen, ndist, ncode, i;
+
+  nlen  = get_bits (s, 5) + 257;
+  ndist = get_bits (s, 5) + 1;
+  ncode = get_bits (s, 4) + 4;
+  if (s->error || nlen > MAX_LCODES || ndist > MAX_DCODES)
+  {
+    s->error = true;
+    return;
+  }
+
+  memset (lengths, '\0', sizeof(lengths));
+  for (i = 0; i < ncode; i++)
+      lengths [order[i]] = (BYTE) get_bits (s, 3);
+
+  if (s->error || !build_huffman(&s->lencode, lengths, 19))
+  {
+    s->error = true;
+    return;
+  }
+
+  i = 0;
+  while (i < nlen + ndist && !s->error)
+  {
+    int sym = decode (s, &s->lencode);
+    int len = 0, repeat;
+
+    if (sym < 0)
+       break;
+    if (sym < 16)
+    {
+      lengths [i++] = (BYTE) sym;
+      continue;
+    }
+    if (sym == 16)
+    {
+      if (i == 0)
+      {
+        s->error = true;
+        break;
+      }
+      len = lengths [i-1];
+      repeat = 3 + get_bits (s, 2);
+    }
+    else if (sym == 17)
+      repeat = 3 + get_bits (s, 3);
+    else
+      repeat = 11 + get_bits (s, 7);
+
+    if (i + repeat > nlen + ndist)
+    {
+      s->error = true;
+      break;
+    }
+    while (repeat--)
+      lengths [i++] = (BYTE) len;
+  }
+
+  if (s->error || lengths[256] == 0 ||
+      !build_huffman(&s->lencode, lengths, nlen) ||
+      !build_huffman(&s->distcode, lengths + nlen, ndist))
+  {
+    s->error = true;
+    return;
+  }
+  inflate_codes (s);
+}
+
+/**
+ * Decompress the raw DEFLATE data in `in` and pass the output to `func`.
+ *
+ * \param[in]  in       the compressed data.
+ * \param[in]  in_len   the size of `in`.
+ * \param[out] in_used  if not `NULL`, set to the number of bytes used from `in`.
+ * \param[in]  func     the function to call for each chunk of output.
+ * \param[in]  arg      the argument for `func`.
+ * \retval     `INFLATE_OK`, `INFLATE_STOPPED` or `INFLATE_ERROR`.
+ */
+int inflate_raw (const BYTE *in, size_t in_len, size_t *in_used, inflate_func func, void *arg)
+{
+  inflate_state *s = CALLOC (sizeof(*s), 1);
+  int            last, type, rc;
+
+  s->in     = in;
+  s->in_end = in + in_len;
+  s->window = MALLOC (2*INFLATE_WINDOW);
+  s->func   = func;
+  s->arg    = arg;
+
+  do
+  {
+    last = get_bits (s, 1);
+    type = get_bits (s, 2);
+    if (s->error)
+       break;
+
+    if (type == 0)
+         inflate_stored (s);
+    else if (type == 1)
+         inflate_fixed (s);
+    else if (type == 2)
+         inflate_dynamic (s);
+    else s->error = true;
+  }
+  while (!last && !s->error && !s->stop);
+
+  if (!s->error && !s->stop)
+     flush_window (s);
+
+  if (in_used)
+     *in_used = (s->in - in) - s->bit_cnt / 8;
+
+  rc = s->error ? INFLATE_ERROR : s->stop ? INFLATE_STOPPED : INFLATE_OK;
+  FREE (s->window);
+  FREE (s);
+  return (rc);
+}
+
+/**
+ * Decompress all the members of a GZIP-file in `in`.
+ *
+ * \param[in] in      the GZIP data.
+ * \param[in] in_len  the size of `in`.
+ * \param[in] func    the function to call for each chunk of output.
+ * \param[in] arg     the argument for `func`.
+ * \retval    `INFLATE_OK`, `INFLATE_STOPPED` or `INFLATE_ERROR`.
+ */
+int inflate_gzip (const BYTE *in, size_t in_len, inflate_func func, void *arg)
+{
+  const BYTE *p = in, *end = in + in_len;
+  int         rc = INFLATE_ERROR;
+
+  while (end - p >= 18 && p[0] == 0x1F && p[1] == 0x8B && p[2] == 8)
+  {
+    BYTE   flags = p[3];
+    size_t used;
+
+    p += 10;
+    if (flags & 4)          /* FEXTRA */
+    {
+      if (end - p < 2)
+         return (INFLATE_ERROR);
+      p += 2 + (p[0] | (p[1] << 8));
+    }
+    if (flags & 8)          /* FNAME */
+       while (p < end && *p++)
+          ;
+    if (flags & 16)         /* FCOMMENT */
+       while (p < end && *p++)
+          ;
+    if (flags & 2)          /* FHCRC */
+       p += 2;
+    if (p >= end)
+       return (INFLATE_ERROR);
+
+    rc = inflate_raw (p, end - p, &used, func, arg);
+    if (rc != INFLATE_OK)
+       break;
+    p += used + 8;          /* skip the CRC32 and ISIZE */
+  }
+  return (rc);
+}
+
+/**
+ * Little-endian reads for `zip_foreach()`.
+ */
+#define GET_WORD(p)   ((WORD) ((p)[0] | ((p)[1] << 8)))
+#define GET_DWORD(p)  ((DWORD) ((p)[0] | ((p)[1] << 8) | ((p)[2] << 16) | ((DWORD)(p)[3] << 24)))
+
+/**
+ * Walk the central directory of the ZIP-file in `in` and call `func`
+ * for each member. Encrypted members, ZIP64 members and other methods
+ * than stored or deflated are passed with no `data`.
+ *
+ * \param[in] in      the ZIP data.
+ * \param[in] in_len  the size of `in`.
+ * \param[in] func    the function to call for each member.
+ * \param[in] arg     the argument for `func`.
+ * \retval    `INFLATE_OK`, `INFLATE_STOPPED` or `INFLATE_ERROR`.
+ */
+int zip_foreach (const BYTE *in, size_t in_len, zip_member_func func, void *arg)
+{
+  const BYTE *end = in + in_len;
+  const BYTE *eocd = NULL, *p;
+  size_t      back;
+  unsigned    i, entries;
+
+  /* Find the "End of central directory" record. It's followed by a comment
+   * of at most 64 kByte.
+   */
+  for (back = 22; back <= in_len && back <= 22 + 0xFFFF; back++)
+      if (GET_DWORD(end - back) == 0x06054B50)    /* "PK\5\6" */
+      {
+        eocd = end - back;
+        break;
+      }
+  if (!eocd)
+     return (INFLATE_ERROR);
+
+  entries = GET_WORD (eocd + 10);
+  if (GET_DWORD(eocd + 16) >= in_len)
+     return (INFLATE_ERROR);
+  p = in + GET_DWORD (eocd + 16);
+
+  for (i = 0; i < entries; i++)
+  {
+    const BYTE *local, *data;
+    const char *name;
+    WORD        flags, method, name_len;
+    DWORD       comp_size, ofs;
+
+    if (end - p < 46 || GET_DWORD(p) != 0x02014B50)   /* "PK\1\2" */
+       return (INFLATE_ERROR);
+
+    flags     = GET_WORD (p + 8);
+    method    = GET_WORD (p + 10);
+    comp_size = GET_DWORD (p + 20);
+    name_len  = GET_WORD (p + 28);
+    ofs       = GET_DWORD (p + 42);
+    name      = (const char*) p + 46;
+    p += 46 + name_len + GET_WORD (p + 30) + GET_WORD (p + 32);
+    if (p > end)
+       return (INFLATE_ERROR);
+
+    if ((flags & 1) || (method != 0 && method != 8) || comp_size == 0xFFFFFFFF || ofs >= in_len)
+    {
+      if (!(*func) (arg, name, name_len, method, NULL, 0))
+         return (INFLATE_STOPPED);
+      continue;
+    }
+
+    local = in + ofs;
+    if (end - local < 30 || GET_DWORD(local) != 0x04034B50)   /* "PK\3\4" */
+       return (INFLATE_ERROR);
+
+    data = local + 30 + GET_WORD (local + 26) + GET_WORD (local + 28);
+    if (data > end || comp_size > (DWORD)(end - data))
+       return (INFLATE_ERROR);
+
+    if (!(*func) (arg, name, name_len, method, data, comp_size))
+       return (INFLATE_STOPPED);
+  }
+  return (INFLATE_OK);
+}
@@ -0,0 +1,40 @@
+/** \file inflate.h
+ *  \ingroup Misc
+ */
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * The return values of `inflate_raw()`, `inflate_gzip()` and `zip_foreach()`.
+ */
+#define INFLATE_OK        0   /**< all the data was decompressed */
+#define INFLATE_STOPPED   1   /**< the callback returned `false` */
+#define INFLATE_ERROR    -1   /**< corrupt or unsupported data */
+
+/**
+ * \typedef inflate_func
+ *
+ * The callback for each chunk of decompressed data.
+ * The chunks are at most `2 * INFLATE_WINDOW` bytes.
+ * Returns `false` to stop the decompression.
+ */
+typedef bool (*inflate_func) (void *arg, const BYTE *data, size_t len);
+
+/**
+ * \typedef zip_member_func
+ *
+ * The callback for each member of a ZIP-file found by `zip_foreach()`.
+ * `method` is 0 (stored) or 8 (deflated). `data` is the compressed data.
+ * `data` is `NULL` for a member that cannot be decompressed (encrypted, ZIP64
+ * or another `method`); the caller can report it.
+ * Returns `false` to stop the iteration.
+ */
+typedef bool (*zip_member_func) (void *arg, const char *name, size_t name_len,
+                                 int method, const BYTE *data, size_t data_len);
+
+#define INFLATE_WINDOW  32768  /**< the max DEFLATE distance */
+
+extern int inflate_raw (const BYTE *in, size_t in_len, size_t *in_used, inflate_func func, void *arg);
+extern int inflate_gzip (const BYTE *in, size_t in_len, inflate_func func, void *arg);
+extern int zip_foreach (const BYTE *in, size_t in_len, zip_member_func func, void *arg);
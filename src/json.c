@@ -401,3 +401,197 @@ const JSON_tok_t *JSON_get_token_by_index (const JSON_tok_t *token, JSON_type_t
   return (NULL);
 }
 
+/**
+ * Make room for `len` more bytes in `w->buf`.
+ */
+static char *JSON_write_grow (JSON_writer *w, size_t len)
+{
+  if (w->len + len > w->size)
+  {
+    w->size = max (2*w->size, w->len + len + 200);
+    w->buf  = REALLOC (w->buf, w->size);
+  }
+  return (w->buf + w->len);
+}
+
+/**
+ * Add a `,` if needed and the `"key":` (if not `NULL`).
+ */
+static void JSON_write_key (JSON_writer *w, const char *key)
+{
+  if (w->comma)
+     *JSON_write_grow (w, 1) = ',', w->len++;
+  w->comma = true;
+  if (key)
+  {
+    size_t len = strlen (key);
+    char  *p = JSON_write_grow (w, 6*len + 3);
+
+    *p++ = '"';
+    p += JSON_escape (p, key, len);
+    *p++ = '"';
+    *p++ = ':';
+    w->len = p - w->buf;
+  }
+}
+
+/**
+ * Escape the `len` bytes in `src` as a JSON string without the quotes.
+ * `dst` must have room for `6 * len` bytes.
+ *
+ * Control-characters, `"` and `\\` are escaped. So are bytes >= 0x80
+ * (as `\u00XX`); the input is not known to be UTF-8.
+ *
+ * \retval the number of bytes written to `dst`.
+ */
+size_t JSON_escape (char *dst, const char *src, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+  const BYTE *s = (const BYTE*) src;
+  char       *d = dst;
+  size_t      i;
+
+  for (i = 0; i < len; i++)
+  {
+    BYTE c = s[i];
+
+    if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\')
+    {
+      *d++ = (char) c;
+      continue;
+    }
+    *d++ = '\\';
+    switch (c)
+    {
+      case '"':
+      case '\\':
+           *d++ = (char) c;
+           break;
+      case '\n':
+           *d++ = 'n';
+           break;
+      case '\r':
+           *d++ = 'r';
+           break;
+      case '\t':
+           *d++ = 't';
+           break;
+      default:
+           *d++ = 'u';
+           *d++ = '0';
+           *d++ = '0';
+           *d++ = hex [c >> 4];
+           *d++ = hex [c & 15];
+           break;
+    }
+  }
+  return (d - dst);
+}
+
+/**
+ * Start a new record in `w`. The buffer is kept.
+ */
+void JSON_write_reset (JSON_writer *w)
+{
+  w->len   = 0;
+  w->comma = false;
+}
+
+/**
+ * Free the buffer of `w`.
+ */
+void JSON_write_free (JSON_writer *w)
+{
+  FREE (w->buf);
+  w->len = w->size = 0;
+}
+
+/**
+ * Start an object (`bracket == '{'`) or an array (`bracket == '['`).
+ * As the value of `key` or as an array element if `key == NULL`.
+ */
+void JSON_write_begin (JSON_writer *w, const char *key, char bracket)
+{
+  JSON_write_key (w, key);
+  *JSON_write_grow (w, 1) = bracket;
+  w->len++;
+  w->comma = false;
+}
+
+/**
+ * End an object (`bracket == '}'`) or an array (`bracket == ']'`).
+ */
+void JSON_write_end (JSON_writer *w, char bracket)
+{
+  *JSON_write_grow (w, 1) = bracket;
+  w->len++;
+  w->comma = true;
+}
+
+/**
+ * Write the escaped string `str` of length `len`.
+ */
+void JSON_write_strn (JSON_writer *w, const char *key, const char *str, size_t len)
+{
+  char *p;
+
+  JSON_write_key (w, key);
+  p = JSON_write_grow (w, 6*len + 2);
+  *p++ = '"';
+  p += JSON_escape (p, str, len);
+  *p++ = '"';
+  w->len = p - w->buf;
+}
+
+/**
+ * Write the escaped 0-terminated string `str`.
+ */
+void JSON_write_str (JSON_writer *w, const char *key, const char *str)
+{
+  JSON_write_strn (w, key, str, strlen(str));
+}
+
+/**
+ * Write a number.
+ */
+void JSON_write_int (JSON_writer *w, const char *key, __int64 val)
+{
+  char buf [30];
+  int  len = snprintf (buf, sizeof(buf), "%" S64_FMT, val);
+
+  JSON_write_key (w, key);
+  JSON_write_raw (w, NULL, buf, len);
+  w->comma = true;
+}
+
+/**
+ * Write `true` or `false`.
+ */
+void JSON_write_bool (JSON_writer *w, const char *key, bool val)
+{
+  JSON_write_key (w, key);
+  JSON_write_raw (w, NULL, val ? "true" : "false", val ? 4 : 5);
+  w->comma = true;
+}
+
+/**
+ * Write `null`.
+ */
+void JSON_write_null (JSON_writer *w, const char *key)
+{
+  JSON_write_key (w, key);
+  JSON_write_raw (w, NULL, "null", 4);
+  w->comma = true;
+}
+
+/**
+ * Write `len` bytes of already formatted JSON.
+ * With a `key`, as its value. Otherwise appended as is (without a `,`).
+ */
+void JSON_write_raw (JSON_writer *w, const char *key, const char *raw, size_t len)
+{
+  if (key)
+     JSON_write_key (w, key);
+  memcpy (JSON_write_grow(w, len), raw, len);
+  w->len += len;
+}
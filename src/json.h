@@ -66,6 +66,19 @@ typedef struct JSON_parser {
     //  uint32_t      column;     /**< Current parser column of input (unreliable, does not work) */
       } JSON_parser;
 
+/**
+ * \typedef JSON_writer
+ *
+ * A growing buffer for writing one JSON record with the `JSON_write_*()`
+ * functions. Keys and string values are escaped as needed.
+ */
+typedef struct JSON_writer {
+        char   *buf;       /**< the record (not 0-terminated) */
+        size_t  len;       /**< the length of the record */
+        size_t  size;      /**< the allocated size of `buf` */
+        bool    comma;     /**< a `,` is needed before the next value */
+      } JSON_writer;
+
 void              JSON_init (JSON_parser *parser);
 int               JSON_parse (JSON_parser *parser, const char *js, size_t len, JSON_tok_t *tokens, size_t num_tokens);
 int               JSON_parse_primitive (JSON_parser *parser, const char *js, size_t len, JSON_tok_t *tokens, size_t num_tokens);
@@ -75,6 +88,18 @@ const JSON_tok_t *JSON_get_token_by_index (const JSON_tok_t *token, JSON_type_t
 const char       *JSON_typestr (JSON_type_t t);
 const char       *JSON_strerror (JSON_err e);
 
+void              JSON_write_reset (JSON_writer *w);
+void              JSON_write_free (JSON_writer *w);
+void              JSON_write_begin (JSON_writer *w, const char *key, char bracket);
+void              JSON_write_end (JSON_writer *w, char bracket);
+void              JSON_write_str (JSON_writer *w, const char *key, const char *str);
+void              JSON_write_strn (JSON_writer *w, const char *key, const char *str, size_t len);
+void              JSON_write_int (JSON_writer *w, const char *key, __int64 val);
+void              JSON_write_bool (JSON_writer *w, const char *key, bool val);
+void              JSON_write_null (JSON_writer *w, const char *key);
+void              JSON_write_raw (JSON_writer *w, const char *key, const char *raw, size_t len);
+size_t            JSON_escape (char *dst, const char *src, size_t len);
+
 #endif
 
 
@@ -436,10 +436,8 @@ static int lua_search_internal (const char *search_spec, bool is_CPATH)
              lua_print_exports (de->d_name, r.filler);
        }
       }
-      FREE (de->d_name);
-      FREE (de);
     }
-    smartlist_free (dirlist);
+    smartlist_free (dirlist);   /* This frees all the 'de' too */
   }
   return (found);
 }
@@ -75,11 +75,26 @@ static HANDLE kernel32_hnd, userenv_hnd;
   static struct mem_head *mem_list = NULL; /**< The linked list of our allocations */
   static size_t mem_reallocs    = 0;       /**< Number of realloc() */
   static DWORD  mem_max         = 0;       /**< Max bytes allocated at one time */
+  static DWORD  mem_max_since   = 0;       /**< Max bytes allocated since the last `mem_peak()` */
   static DWORD  mem_allocated   = 0;       /**< Total bytes allocated */
   static DWORD  mem_deallocated = 0;       /**< Bytes deallocated */
   static size_t mem_allocs      = 0;       /**< Number of allocations */
   static size_t mem_frees       = 0;       /**< Number of mem-frees */
 
+  /**
+   * A simple spin-lock protecting the \ref mem_list and the above counters.
+   * Needed since worker-threads (like in `process_dir_list()`) also allocate memory.
+   * Needs no initialisation; hence can be used before `init_misc()`.
+   */
+  static volatile LONG mem_lock = 0;
+
+  #define MEM_LOCK()    do {                                                  \
+                          while (InterlockedCompareExchange(&mem_lock, 1, 0)) \
+                                Sleep (0);                                    \
+                        } while (0)
+
+  #define MEM_UNLOCK()  InterlockedExchange (&mem_lock, 0)
+
   /**
    * Add this memory block to the \ref mem_list.
    * \param[in] m    the block to add.
@@ -88,14 +103,18 @@ static HANDLE kernel32_hnd, userenv_hnd;
    */
   static void add_to_mem_list (struct mem_head *m, const char *file, unsigned line)
   {
-    m->next = mem_list;
     m->line = line;
     _strlcpy (m->file, file, sizeof(m->file));
+    MEM_LOCK();
+    m->next  = mem_list;
     mem_list = m;
     mem_allocated += (DWORD) m->size;
     if (mem_allocated > mem_max)
        mem_max = mem_allocated;
+    if (mem_allocated > mem_max_since)
+       mem_max_since = mem_allocated;
     mem_allocs++;
+    MEM_UNLOCK();
   }
 
   /**
@@ -107,6 +126,7 @@ static HANDLE kernel32_hnd, userenv_hnd;
 
   /**
    * Delete this memory block from the \ref mem_list.
+   * The caller must hold the `MEM_LOCK()`.
    * \param[in] m    the block to delete.
    * \param[in] line the line where this function was called.
    */
@@ -1761,6 +1781,189 @@ char *fnmatch_res (int rc)
           rc == FNM_NOMATCH ? "FNM_NOMATCH" : "??");
 }
 
+/**
+ * \typedef fnmatch_prog
+ *
+ * A file-spec pattern compiled once by `fnmatch_compile()` and matched
+ * against many names by `fnmatch_exec()`.
+ *
+ * Most patterns given to `envtool --path` etc. are of the form
+ * `prefix*suffix`, a pure literal or something close to it. So we
+ * extract the literal prefix, the literal suffix and the minimum length
+ * of a matching name. That rejects most names without looking at the
+ * pattern again. Only the names passing these checks are given to
+ * `fnmatch()` (unless the pattern is simple enough to decide it here).
+ */
+struct fnmatch_prog {
+       char   *pattern;     /**< the original pattern; used for `fnmatch()` and the dotless-file rule */
+       char   *folded;      /**< a copy of `pattern`; upper-cased if `FNM_FLAG_NOCASE` */
+       int     flags;       /**< the `fnmatch()` flags */
+       size_t  pattern_len; /**< `strlen (pattern)` */
+       size_t  prefix_len;  /**< length of the literal prefix; starts at `folded` */
+       size_t  suffix_len;  /**< length of the literal suffix; ends at `folded + pattern_len` */
+       size_t  min_len;     /**< a name must be at least this long to match */
+       bool    literal;     /**< the pattern has no wild-cards, escapes or slashes */
+       bool    simple;      /**< the pattern is `prefix*suffix` (with 1 or more `*`) */
+     };
+
+/**
+ * Return true if `c` is a character that can not be part of a literal
+ * prefix or suffix. A slash matches either slash in `fnmatch()` and a
+ * `\\` could be an escape. So stop at these too.
+ */
+static bool fnmatch_special (int c)
+{
+  return (c == '*' || c == '?' || c == '[' || c == ']' || IS_SLASH(c));
+}
+
+/**
+ * Compile the `pattern` for use in `fnmatch_exec()`.
+ *
+ * \param[in] pattern  the file-spec to compile.
+ * \param[in] flags    the `fnmatch()` flags to use for all names.
+ * \retval    the compiled program. Free it using `fnmatch_free()`.
+ */
+fnmatch_prog *fnmatch_compile (const char *pattern, int flags)
+{
+  fnmatch_prog *prog = CALLOC (sizeof(*prog), 1);
+  const char   *p;
+  bool          escapes = false;
+  size_t        i, stars = 0;
+
+  prog->pattern     = STRDUP (pattern);
+  prog->folded      = STRDUP (pattern);
+  prog->flags       = flags;
+  prog->pattern_len = strlen (pattern);
+
+  if (flags & FNM_FLAG_NOCASE)
+     for (i = 0; i < prog->pattern_len; i++)
+         prog->folded[i] = (char) TOUPPER (prog->folded[i]);
+
+  /* The escape handling in `fnmatch()` is a bit odd.
+   * Don't try to compute a `min_len` for a pattern with escapes.
+   */
+  if (!(flags & FNM_FLAG_NOESCAPE) && strchr(pattern, '\\'))
+     escapes = true;
+
+  for (p = pattern; *p && !fnmatch_special(*p); p++)
+      prog->prefix_len++;
+
+  for (p = pattern + prog->pattern_len; p > pattern && !fnmatch_special(p[-1]); p--)
+      prog->suffix_len++;
+
+  prog->literal = (prog->prefix_len == prog->pattern_len);
+
+  for (p = pattern; !escapes && *p; p++)
+  {
+    if (*p == '*')
+    {
+      stars++;
+      continue;
+    }
+    prog->min_len++;
+    if (*p == '[')
+    {
+      /* Skip to the end of this range-expression. Same as `range_match()` does.
+       */
+      if (*++p == '!')
+         p++;
+      for ( ; *p && *p != ']'; p++)
+      {
+        if (p[1] == '-' && p[2] && p[2] != ']')
+           p += 2;
+      }
+      if (!*p)
+         break;
+    }
+  }
+
+  if (!escapes && stars > 0 && prog->prefix_len + stars + prog->suffix_len == prog->pattern_len)
+     prog->simple = true;
+
+  TRACE (2, "pattern: '%s', prefix_len: %u, suffix_len: %u, min_len: %u, literal: %d, simple: %d.\n",
+         pattern, (unsigned)prog->prefix_len, (unsigned)prog->suffix_len, (unsigned)prog->min_len,
+         prog->literal, prog->simple);
+  return (prog);
+}
+
+/**
+ * Compare `len` characters of the name `s` against the pre-folded `pattern`.
+ */
+static bool fnmatch_literal (const fnmatch_prog *prog, const char *pattern, const char *s, size_t len)
+{
+  size_t i;
+
+  if (prog->flags & FNM_FLAG_NOCASE)
+  {
+    for (i = 0; i < len; i++)
+        if (TOUPPER(s[i]) != pattern[i])
+           return (false);
+    return (true);
+  }
+  return (memcmp(pattern, s, len) == 0);
+}
+
+/**
+ * Match the `string` against a pattern compiled by `fnmatch_compile()`.
+ * Returns the same as `fnmatch (pattern, string, flags)` would do.
+ *
+ * \param[in] prog    the compiled pattern.
+ * \param[in] string  the name to match.
+ * \param[in] flags   if `FNM_FLAG_DOTLESS`, a `string` that is a leading part of
+ *                   the pattern also qualifies as a match.
+ *                   I.e. if the pattern is `"ratio.*"` and `string == "ratio"`.
+ */
+int fnmatch_exec (const fnmatch_prog *prog, const char *string, int flags)
+{
+  size_t len = strlen (string);
+  int    rc  = FNM_NOMATCH;
+
+  if (len < prog->min_len)
+     goto no_match;
+
+  if (prog->literal)
+  {
+    if (len == prog->pattern_len && fnmatch_literal(prog, prog->folded, string, len))
+       return (FNM_MATCH);
+    goto no_match;
+  }
+
+  if (!fnmatch_literal(prog, prog->folded, string, prog->prefix_len))
+     goto no_match;
+
+  if (len < prog->prefix_len + prog->suffix_len)
+     goto no_match;
+
+  if (!fnmatch_literal(prog, prog->folded + prog->pattern_len - prog->suffix_len,
+                       string + len - prog->suffix_len, prog->suffix_len))
+     goto no_match;
+
+  if (prog->simple && !(prog->flags & FNM_FLAG_PATHNAME))
+     return (FNM_MATCH);
+
+  rc = fnmatch (prog->pattern, string, prog->flags);
+  if (rc == FNM_MATCH)
+     return (rc);
+
+no_match:
+  if ((flags & FNM_FLAG_DOTLESS) && len <= prog->pattern_len && str_equal_n(string, prog->pattern, len))
+     rc = FNM_MATCH;
+  return (rc);
+}
+
+/**
+ * Free the memory allocated by `fnmatch_compile()`.
+ */
+void fnmatch_free (fnmatch_prog *prog)
+{
+  if (prog)
+  {
+    FREE (prog->pattern);
+    FREE (prog->folded);
+    FREE (prog);
+  }
+}
+
 /**
  * Strip drive-letter, directory and suffix from a filename.
  */
@@ -1993,8 +2196,10 @@ bool is_directory (const char *path)
  *
  * These could be locked and `GetFileAttributes()` always fails on such files.
  * Best alternative is to use `FindFirstFile()`.
+ *
+ * No `TRACE()` unless `trace == true`.
  */
-int safe_stat_sys (const char *file, struct stat *st, DWORD *win_err)
+static int _safe_stat_sys (const char *file, struct stat *st, DWORD *win_err, bool trace)
 {
   WIN32_FIND_DATA ff_data;
   HANDLE          hnd;
@@ -2019,8 +2224,9 @@ int safe_stat_sys (const char *file, struct stat *st, DWORD *win_err)
     }
     FindClose (hnd);
   }
-  TRACE (1, "file: '%s', attr: 0x%08lX, err: %lu, mtime: %" U64_FMT " fsize: %s\n",
-         file, (unsigned long)ff_data.dwFileAttributes, err, (UINT64)st->st_mtime, get_file_size_str(st->st_size));
+  if (trace)
+     TRACE (1, "file: '%s', attr: 0x%08lX, err: %lu, mtime: %" U64_FMT " fsize: %s\n",
+            file, (unsigned long)ff_data.dwFileAttributes, err, (UINT64)st->st_mtime, get_file_size_str(st->st_size));
 
   if (win_err)
      *win_err = err;
@@ -2031,6 +2237,7 @@ int safe_stat_sys (const char *file, struct stat *st, DWORD *win_err)
  * A bit safer `stat()`.
  * If given a hidden / system file (like `c:\\pagefile.sys`), some
  * `stat()` implementations can crash. MSVC would be one case.
+ * No `TRACE()` unless `trace == true`.
  *
  * \return any `GetLastError()` is set in `*win_err`.
  * \retval 0   okay (the same as `stat()`).
@@ -2038,7 +2245,7 @@ int safe_stat_sys (const char *file, struct stat *st, DWORD *win_err)
  *
  * \note directories are passed directly to `stat()`.
  */
-int safe_stat (const char *file, struct stat *st, DWORD *win_err)
+static int _safe_stat (const char *file, struct stat *st, DWORD *win_err, bool trace)
 {
   DWORD   err = 0;
   DWORD   attr = 0;
@@ -2063,7 +2270,7 @@ int safe_stat (const char *file, struct stat *st, DWORD *win_err)
      attr = GetFileAttributes (file);
 
   if (attr == INVALID_FILE_ATTRIBUTES && GetLastError() == ERROR_SHARING_VIOLATION)
-     return safe_stat_sys (file, st, win_err);
+     return _safe_stat_sys (file, st, win_err, trace);
 
   memset (st, '\0', sizeof(*st));
   st->st_size = (off_t)-1;     /* signal if stat() fails */
@@ -2109,17 +2316,60 @@ int safe_stat (const char *file, struct stat *st, DWORD *win_err)
   else
     err = GetLastError();
 
-  if (w_file[0])
-      TRACE (1, "w_file: '%S', attr: 0x%08lX, hnd: %p, err: %lu, mtime: %" U64_FMT " fsize: %s\n",
-             w_file, (unsigned long)attr, hnd, err, (UINT64)st->st_mtime, get_file_size_str(st->st_size));
-  else TRACE (1, "file: '%s', attr: 0x%08lX, hnd: %p, err: %lu, mtime: %" U64_FMT " fsize: %s\n",
-              file, (unsigned long)attr, hnd, err, (UINT64)st->st_mtime, get_file_size_str(st->st_size));
+  if (trace)
+  {
+    if (w_file[0])
+        TRACE (1, "w_file: '%S', attr: 0x%08lX, hnd: %p, err: %lu, mtime: %" U64_FMT " fsize: %s\n",
+               w_file, (unsigned long)attr, hnd, err, (UINT64)st->st_mtime, get_file_size_str(st->st_size));
+    else TRACE (1, "file: '%s', attr: 0x%08lX, hnd: %p, err: %lu, mtime: %" U64_FMT " fsize: %s\n",
+                file, (unsigned long)attr, hnd, err, (UINT64)st->st_mtime, get_file_size_str(st->st_size));
+  }
 
   if (win_err)
      *win_err = err;
   return (err ? -1 : 0);
 }
 
+/**
+ * The `safe_stat()` used by all but the worker-threads. See `_safe_stat()`.
+ */
+int safe_stat (const char *file, struct stat *st, DWORD *win_err)
+{
+  return _safe_stat (file, st, win_err, true);
+}
+
+/**
+ * See `_safe_stat_sys()`.
+ */
+int safe_stat_sys (const char *file, struct stat *st, DWORD *win_err)
+{
+  return _safe_stat_sys (file, st, win_err, true);
+}
+
+/**
+ * As `safe_stat()`, but with no `TRACE()` and no use of the static buffer
+ * in `get_file_size_str()`. Hence it can be called from a worker-thread.
+ */
+int safe_stat_quiet (const char *file, struct stat *st, DWORD *win_err)
+{
+  return _safe_stat (file, st, win_err, false);
+}
+
+/**
+ * Return a high-resolution time-stamp in seconds.
+ * Used to time the benchmarks done on `envtool -tt`.
+ */
+double bench_time (void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+
+  if (freq.QuadPart == 0)
+     QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&now);
+  return ((double)now.QuadPart / (double)freq.QuadPart);
+}
+
 /**
  * Create a `%TEMP%-file`.
  * \return An allocated string of the file-name.
@@ -3404,8 +3654,10 @@ void *realloc_at (void *ptr, size_t size, const char *file, unsigned line)
     ptr = malloc_at (size, file, line);
     size = p->size - sizeof(*p);
     memmove (ptr, p+1, size);        /* since memory could be overlapping */
+    MEM_LOCK();
     del_from_mem_list (p, __LINE__);
     mem_reallocs++;
+    MEM_UNLOCK();
     free (p);
   }
   return (ptr);
@@ -3429,8 +3681,10 @@ void free_at (void *ptr, const char *file, unsigned line)
      FATAL ("'free()' of unknown block at %s, line %u.\n", file, line);
 
   head->marker = MEM_FREED;
+  MEM_LOCK();
   del_from_mem_list (head, __LINE__);
   mem_frees++;
+  MEM_UNLOCK();
   free (head);
 }
 #endif  /* !_CRTDBG_MAP_ALLOC */
@@ -3462,10 +3716,31 @@ void mem_report (void)
   }
   if (num == 0)
      C_printf ("  No un-freed memory.\n");
+  smartlist_arena_report();
   C_flush();
 #endif
 }
 
+/**
+ * Return the max bytes allocated at one time since the previous call.
+ * And restart the counting from the bytes allocated now.
+ * For the benchmarks in `tests.c`.
+ *
+ * \retval 0 if the allocations are not counted (`_CRTDBG_MAP_ALLOC` is defined).
+ */
+size_t mem_peak (void)
+{
+  size_t peak = 0;
+
+#if !defined(_CRTDBG_MAP_ALLOC)
+  MEM_LOCK();
+  peak = mem_max_since;
+  mem_max_since = mem_allocated;
+  MEM_UNLOCK();
+#endif
+  return (peak);
+}
+
 #if defined(_MSC_VER) && defined(_DEBUG)
 /**
  * Only one global mem-state.
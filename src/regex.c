@@ -1078,7 +1078,7 @@ static reg_errcode_t regex_compile (const char *pattern, size_t size,
 
   /* Initialize the compile stack.
    */
-  compile_stack.stack = MALLOC (INIT_COMPILE_STACK_SIZE);
+  compile_stack.stack = MALLOC (INIT_COMPILE_STACK_SIZE * sizeof(compile_stack_elt_t));
   if (!compile_stack.stack)
      return (REG_ESPACE);
 
@@ -9,155 +9,1431 @@
 #include "Everything_ETP.h"
 #include "ignore.h"
 #include "description.h"
+#include "regex.h"
+#include "inflate.h"
+#include "json.h"
 #include "report.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #include <emmintrin.h>
+  #define HAVE_GREP_SSE2
+#endif
+
+/**
+ * Report time and name of `file`.
+ *
+ * Also: if the match came from a
+ * registry search, report which key had the match.
+ */
+static int    found_in_hkey_current_user = 0;
+static int    found_in_hkey_current_user_env = 0;
+static int    found_in_hkey_local_machine = 0;
+static int    found_in_hkey_local_machine_sess_man = 0;
+static int    found_in_python_egg = 0;
+static int    found_in_default_env = 0;
+static UINT64 total_size = 0;
+static int    longest_file_so_far = 0;
+static char   report_header [_MAX_PATH+50];
+static char   report_source [_MAX_PATH+50];
+static DWORD  json_records = 0;
+
+DWORD num_version_ok = 0;
+DWORD num_verified = 0;
+DWORD num_evry_dups = 0;
+DWORD num_evry_ignored = 0;
+
+/**
+ * \typedef grep_report
+ *
+ * The state of one `grep_file()` call. The `grep_buffer()` argument for
+ * `report_grep_match()`.
+ */
+typedef struct grep_report {
+        FMT_buf    *fmt;          /**< the format structure to print matches into */
+        int         matches;      /**< the number of matches printed */
+        bool        first_match;  /**< no match printed yet */
+        const char *mmap_max;     /**< the end of the file's view */
+        const char *needle;       /**< the needle that matched with several `--grep` needles */
+        const char *member;       /**< the ZIP-member to print before the first match in it */
+        DWORD       line_base;    /**< the lines before the current chunk of a compressed file */
+        smartlist_t *traces;      /**< the `GR_TRACE()` messages from a `grep_worker()`. `NULL` in the main-thread */
+        bool        truncated;    /**< a JSON match was dropped since `fmt` was full */
+      } grep_report;
+
+/**
+ * \def GR_TRACE(gr, level, ...)
+ * Like `TRACE()`. But in a `grep_worker()` thread, save the message in `gr->traces`.
+ * `report_grep_file()` prints them in the main-thread.
+ */
+#define GR_TRACE(gr, level, ...)  do {                                          \
+                                    if (opt.debug >= level)                     \
+                                       grep_trace (gr, __LINE__, __VA_ARGS__);  \
+                                  } while (0)
+
+/**
+ * Print a `GR_TRACE()` message with the same prefix as `TRACE()`.
+ * Or save it in `gr->traces`.
+ */
+static void grep_trace (grep_report *gr, int line, const char *fmt, ...)
+{
+  char    buf [_MAX_PATH+200];
+  int     len;
+  va_list args;
+
+  len = snprintf (buf, sizeof(buf), "%s(%d): ", __FILE(), line);
+  va_start (args, fmt);
+  vsnprintf (buf + len, sizeof(buf) - len, fmt, args);
+  va_end (args);
+
+  if (gr->traces)
+       smartlist_add_strdup (gr->traces, buf);
+  else debug_printf ("%s", buf);
+}
+
+/**
+ * Print a chunk of a match-line. Replace a `<TAB>` with 2 spaces.
+ * Stop printing:
+ *  * when `max_len` character printed.
+ *  * or when a newline is found.
+ *  * or `p` pointer reached beyond `gr->mmap_max`.
+ */
+static size_t save_chunk (grep_report *gr, const char *str, size_t max_len)
+{
+  FMT_buf    *fmt = gr->fmt;
+  const char *p = str;
+  size_t      len = 0;
+
+  for (p = str; *p != '\r' && *p != '\n' && len < max_len && p < gr->mmap_max; len++, p++)
+  {
+    if (*p == '\t')
+         BUF_PUTS (fmt, "  ");
+    else if (*p == '~')
+         BUF_PUTS (fmt, "~~");
+    else BUF_PUTC (fmt, *p);
+    if (fmt->buffer_left < 2)
+       break;
+  }
+  return (len);
+}
+
+/**
+ * Print a match as a "grep --line-number 'content' file" would do:
+ *   2: * 'content' rest of line.
+ *   ^     ^
+ *   |     |__ match in hightlighted colour    (white on red background)
+ *   |________ line_num in hightlighted colour (bright green)
+ *
+ * \todo If these are > 1 matches on the same line, remember the previous
+ *       output (using a `FMT_BUF`), and merge current result with the previous.
+ *
+ * \todo Add a configurable `before-context` and `after-context`. Similar to grep.
+ */
+static void save_match (grep_report *gr, DWORD line_num, const char *line, const char *match, size_t match_len, size_t line_max)
+{
+  FMT_buf    *fmt = gr->fmt;
+  const char *p, *rest, *indent = "        ";
+  size_t      len, rest_max;
+
+  if (gr->first_match)
+     BUF_PUTC (fmt, '\n');
+  gr->first_match = false;
+
+  if (gr->member)
+  {
+    BUF_PRINTF (fmt, "%s~3%s~0:\n", indent, gr->member);
+    gr->member = NULL;
+  }
+
+  len = BUF_PRINTF (fmt, "%s~2%lu:~0 ", indent, line_num);
+  if (gr->needle)
+  {
+    BUF_PUTS (fmt, "~6[");
+    for (p = gr->needle; *p; p++)
+    {
+      if (*p == '~')    /* Not a colour-code; like 'save_chunk()' */
+           BUF_PUTS (fmt, "~~");
+      else BUF_PUTC (fmt, *p);
+    }
+    BUF_PUTS (fmt, "]~0 ");
+    len += strlen (gr->needle) + 3;
+  }
+  len += save_chunk (gr, line, match - line);
+
+  BUF_PUTS (fmt, "~8");  /* bright white on red background */
+  len += save_chunk (gr, match, match_len);
+  BUF_PUTS (fmt, "~0");
+
+  rest = match + match_len;
+  rest_max = C_screen_width() - 1 - len;
+  rest_max = min (line_max, rest_max);
+  save_chunk (gr, rest, rest_max);
+  BUF_PUTC (fmt, '\n');
+}
+
+/**
+ * The max bytes of a match-line in a JSON grep-record.
+ */
+#define GREP_JSON_TEXT_MAX  256
+
+/**
+ * Print max `_MAX_PATH` bytes of `str` as an escaped JSON string.
+ */
+static void save_json_str (FMT_buf *fmt, const char *str, size_t len)
+{
+  char esc [6*_MAX_PATH + 1];
+
+  len = JSON_escape (esc, str, min(len, _MAX_PATH));
+  esc [len] = '\0';
+  BUF_PUTC (fmt, '"');
+  BUF_PUTS (fmt, esc);
+  BUF_PUTC (fmt, '"');
+}
+
+/**
+ * With `--json` or `--ndjson`, print a match as an element of the `"lines"`
+ * array in the record from `report_file()`:
+ *   {"line":2,"column":5,"length":7,"text":"the line"}
+ *
+ * The `"needle"` and `"member"` are added as needed. A match that does not
+ * fit in `gr->fmt` is dropped; it is still counted in the `"matches"`.
+ * But then `gr->truncated` is set and the record gets a `"truncated":true`.
+ */
+static void save_match_json (grep_report *gr, DWORD line_num, const char *line, const char *match, size_t match_len, size_t line_max)
+{
+  FMT_buf *fmt = gr->fmt;
+  size_t   need, len = min (line_max, GREP_JSON_TEXT_MAX);
+
+  if (len > 0 && line[len-1] == '\r')
+     len--;
+
+  need = 100 + 6 * len;
+  if (gr->needle)
+     need += 20 + 6 * min (strlen(gr->needle), _MAX_PATH);
+  if (gr->member)
+     need += 20 + 6 * min (strlen(gr->member), _MAX_PATH);
+  if (fmt->buffer_left < need)
+  {
+    gr->truncated = true;
+    return;
+  }
+
+  if (!gr->first_match)
+     BUF_PUTC (fmt, ',');
+  gr->first_match = false;
+
+  BUF_PRINTF (fmt, "{\"line\":%lu,\"column\":%u,\"length\":%u,\"text\":",
+              line_num, (unsigned)(match - line + 1), (unsigned)match_len);
+  save_json_str (fmt, line, len);
+  if (gr->needle)
+  {
+    BUF_PUTS (fmt, ",\"needle\":");
+    save_json_str (fmt, gr->needle, strlen(gr->needle));
+  }
+  if (gr->member)
+  {
+    BUF_PUTS (fmt, ",\"member\":");
+    save_json_str (fmt, gr->member, strlen(gr->member));
+  }
+  BUF_PUTC (fmt, '}');
+}
+
+/**
+ * Lower- and upper-case an ASCII character as `strnicmp()` does in the "C" locale.
+ */
+#define GREP_LOWER(c)  (((c) >= 'A' && (c) <= 'Z') ? (c) + 'a' - 'A' : (c))
+#define GREP_UPPER(c)  (((c) >= 'a' && (c) <= 'z') ? (c) - 'a' + 'A' : (c))
+
+/**
+ * Compare `len` bytes at `p` with `needle`.
+ */
+static bool grep_equal (const char *p, const char *needle, size_t len, bool ignore_case)
+{
+  size_t i;
+
+  if (!ignore_case)
+     return (memcmp (p, needle, len) == 0);
+
+  for (i = 0; i < len; i++)
+  {
+    int c1 = *(const BYTE*) (p + i);
+    int c2 = *(const BYTE*) (needle + i);
+
+    if (GREP_LOWER(c1) != GREP_LOWER(c2))
+       return (false);
+  }
+  return (true);
+}
+
+#if defined(HAVE_GREP_SSE2)
+/**
+ * Return the index of the lowest bit set in `mask` (which is not 0).
+ */
+static unsigned grep_lowest_bit (unsigned mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz (mask);
+#else
+  unsigned long bit;
+
+  _BitScanForward (&bit, mask);
+  return (bit);
+#endif
+}
+#endif
+
+/**
+ * Find the first occurrence of `needle` in the range `p` to `end`.
+ * The whole needle must be inside the range.
+ *
+ * With SSE2, 16 positions are tested at a time for the first and last
+ * byte of `needle` (in both cases if `ignore_case`). Only the positions
+ * where both bytes matches are compared in full.
+ *
+ * \param[in] p            the start of the range to search.
+ * \param[in] end          the end of the range.
+ * \param[in] needle       the string to search for. Need not be 0-terminated.
+ * \param[in] len          the length of `needle`.
+ * \param[in] ignore_case  compare ASCII letters case-insensitively.
+ * \retval    the start of the match or `NULL` if not found.
+ */
+const char *grep_find (const char *p, const char *end, const char *needle, size_t len, bool ignore_case)
+{
+  const char *last;
+  int         first_lo, first_up, last_lo, last_up;
+
+  if (len == 0 || p >= end || (size_t)(end - p) < len)
+     return (NULL);
+
+  last     = end - len;   /* the last possible start of a match */
+  first_lo = first_up = *(const BYTE*) needle;
+  last_lo  = last_up  = *(const BYTE*) (needle + len - 1);
+
+  if (ignore_case)
+  {
+    first_lo = GREP_LOWER (first_lo);
+    first_up = GREP_UPPER (first_lo);
+    last_lo  = GREP_LOWER (last_lo);
+    last_up  = GREP_UPPER (last_lo);
+  }
+
+#if defined(HAVE_GREP_SSE2)
+  {
+    const __m128i v_first_lo = _mm_set1_epi8 ((char)first_lo);
+    const __m128i v_first_up = _mm_set1_epi8 ((char)first_up);
+    const __m128i v_last_lo  = _mm_set1_epi8 ((char)last_lo);
+    const __m128i v_last_up  = _mm_set1_epi8 ((char)last_up);
+
+    while (last - p >= 15)
+    {
+      __m128i  a = _mm_loadu_si128 ((const __m128i*)p);
+      __m128i  b = _mm_loadu_si128 ((const __m128i*)(p + len - 1));
+      __m128i  eq_a = _mm_or_si128 (_mm_cmpeq_epi8(a, v_first_lo), _mm_cmpeq_epi8(a, v_first_up));
+      __m128i  eq_b = _mm_or_si128 (_mm_cmpeq_epi8(b, v_last_lo), _mm_cmpeq_epi8(b, v_last_up));
+      unsigned mask = (unsigned) _mm_movemask_epi8 (_mm_and_si128(eq_a, eq_b));
+
+      while (mask)
+      {
+        const char *match = p + grep_lowest_bit (mask);
+
+        if (grep_equal(match, needle, len, ignore_case))
+           return (match);
+        mask &= mask - 1;
+      }
+      p += 16;
+    }
+  }
+#else
+  if (!ignore_case)
+  {
+    while (p <= last)
+    {
+      p = memchr (p, first_lo, last - p + 1);
+      if (!p)
+         return (NULL);
+      if (grep_equal(p, needle, len, false))
+         return (p);
+      p++;
+    }
+    return (NULL);
+  }
+#endif
+
+  for ( ; p <= last; p++)
+  {
+    int c = *(const BYTE*) p;
+
+    if ((c == first_lo || c == first_up) && grep_equal(p, needle, len, ignore_case))
+       return (p);
+  }
+  return (NULL);
+}
+
+/**
+ * Count the `'\n'` characters in the range `start` to `end`.
+ *
+ * With SSE2, 16 bytes are compared at a time and the results added
+ * into 16 byte-counters. These are summed every 255 rounds.
+ *
+ * \param[in]  start    the start of the range.
+ * \param[in]  end      the end of the range.
+ * \param[out] last_nl  if not `NULL`, set to the last `'\n'` in the range
+ *                      (or `NULL` if none).
+ * \retval     the number of `'\n'` characters.
+ */
+size_t grep_count_lines (const char *start, const char *end, const char **last_nl)
+{
+  const char *p = start;
+  size_t      count = 0;
+
+#if defined(HAVE_GREP_SSE2)
+  const __m128i v_nl = _mm_set1_epi8 ('\n');
+
+  while (end - p >= 16)
+  {
+    __m128i acc = _mm_setzero_si128();
+    int     i;
+
+    for (i = 0; i < 255 && end - p >= 16; i++, p += 16)
+        acc = _mm_sub_epi8 (acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), v_nl));
+
+    acc = _mm_sad_epu8 (acc, _mm_setzero_si128());
+    count += (size_t) _mm_cvtsi128_si32 (acc) + (size_t) _mm_extract_epi16 (acc, 4);
+  }
+#endif
+
+  for ( ; p < end; p++)
+  {
+    if (*p == '\n')
+       count++;
+  }
+
+  if (last_nl)
+  {
+    *last_nl = NULL;
+    for (p = end; count > 0 && p > start; p--)
+    {
+      if (p[-1] == '\n')
+      {
+        *last_nl = p - 1;
+        break;
+      }
+    }
+  }
+  return (count);
+}
+
+/**
+ * Search for `content` in a buffer and call `func` for each match.
+ *
+ * Newlines are only counted (with `grep_count_lines()`) between the
+ * matches found by `grep_find()`. The matches, line-numbers and line-ranges
+ * are the same as the old byte-at-a-time loop in `report_grep_file()` gave:
+ *  \li a match cannot start at a `"\n"` or a `"\r\n"`.
+ *  \li the search continues 1 byte after the end of a match.
+ *  \li the line-end is at the first `'\r'` after the match (or the first `'\n'`).
+ *
+ * \param[in] buf          the start of the buffer.
+ * \param[in] end          the end of the buffer.
+ * \param[in] content      the 0-terminated string to search for.
+ * \param[in] ignore_case  compare ASCII letters case-insensitively.
+ * \param[in] func         the function to call for each match. Returns `false` to stop.
+ * \param[in] arg          the argument for `func`.
+ * \retval    the number of times `func` was called.
+ */
+int grep_buffer (const char *buf, const char *end, const char *content, bool ignore_case,
+                 grep_func func, void *arg)
+{
+  const char *pos = buf, *line_start = buf;
+  const char *match, *line_end, *nl;
+  size_t      len = strlen (content);
+  DWORD       line_num = 1;
+  int         matches = 0;
+
+  if (content[0] == '\n' || (content[0] == '\r' && content[1] == '\n'))
+     return (0);
+
+  while (pos < end && (match = grep_find(pos, end, content, len, ignore_case)) != NULL)
+  {
+    size_t lines = grep_count_lines (pos, match, &nl);
+
+    if (lines > 0)
+    {
+      line_num  += (DWORD) lines;
+      line_start = nl + 1;
+    }
+
+    /* A lone `"\r"` cannot match at a `"\r\n"`.
+     */
+    if (match[0] == '\r' && match + 1 < end && match[1] == '\n')
+    {
+      pos = match + 1;
+      continue;
+    }
+
+    line_end = memchr (match + len, '\r', end - match - len);
+    if (!line_end)
+       line_end = memchr (match + len, '\n', end - match - len);
+    if (!line_end)
+       line_end = end;
+
+    matches++;
+    if (!(*func) (arg, line_num, line_start, match, len, line_end))
+       break;
+    pos = match + len + 1;
+  }
+  return (matches);
+}
+
+/**
+ * \typedef grep_regex
+ *
+ * A compiled `--grep-regex` pattern and it's required literal.
+ */
+struct grep_regex {
+       regex_t  re;             /**< the compiled pattern */
+       char     literal [100];  /**< the longest literal any match must contain */
+       size_t   literal_len;    /**< the length of `literal`; 0 if none found */
+       bool     ignore_case;    /**< compiled with `REG_ICASE` */
+     };
+
+/**
+ * Skip a `[...]` bracket-expression starting at `p`.
+ */
+static const char *regex_skip_bracket (const char *p)
+{
+  p++;
+  if (*p == '^')
+     p++;
+  if (*p == ']')
+     p++;
+  while (*p && *p != ']')
+  {
+    if (p[0] == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '='))
+    {
+      const char *end = strchr (p + 2, ']');
+
+      if (end)
+         p = end;
+    }
+    p++;
+  }
+  return (*p ? p + 1 : p);
+}
+
+/**
+ * Skip a `(...)` group starting at `p`.
+ */
+static const char *regex_skip_group (const char *p)
+{
+  int depth = 0;
+
+  while (*p)
+  {
+    if (*p == '\\' && p[1])
+       p += 2;
+    else if (*p == '[')
+       p = regex_skip_bracket (p);
+    else
+    {
+      if (*p == '(')
+         depth++;
+      else if (*p == ')' && --depth == 0)
+         return (p + 1);
+      p++;
+    }
+  }
+  return (p);
+}
+
+/**
+ * Skip a `*`, `+`, `?` or `{n,m}` quantifier starting at `p`.
+ */
+static const char *regex_skip_quantifier (const char *p)
+{
+  if (*p == '{')
+  {
+    const char *end = strchr (p, '}');
+
+    return (end ? end + 1 : p + 1);
+  }
+  return (p + 1);
+}
+
+/**
+ * Find the longest literal string that any match of the extended regular
+ * expression `pattern` must contain. Used as a prefilter for `regexec()`.
+ *
+ * This is conservative; a literal ends at any meta-character, group or
+ * bracket-expression. A character followed by `*`, `?` or `{` is optional
+ * and is dropped. A `|` outside a group means there is no such literal.
+ *
+ * \param[in]  pattern  the pattern given to `grep_regex_compile()`.
+ * \param[out] literal  the buffer for the literal; not 0-terminated.
+ * \param[in]  size     the size of `literal`.
+ * \retval     the length of the literal; 0 if none.
+ */
+size_t grep_regex_literal (const char *pattern, char *literal, size_t size)
+{
+  const char *p;
+  char        run [100];
+  size_t      run_len = 0, best_len = 0;
+
+  for (p = pattern; *p; )
+  {
+    if (*p == '\\' && p[1])
+       p += 2;
+    else if (*p == '[')
+       p = regex_skip_bracket (p);
+    else if (*p == '(')
+       p = regex_skip_group (p);
+    else if (*p++ == '|')
+       return (0);
+  }
+
+#define END_RUN() do {                                  \
+          if (run_len > best_len && run_len <= size) {  \
+            memcpy (literal, run, run_len);             \
+            best_len = run_len;                         \
+          }                                             \
+          run_len = 0;                                  \
+        } while (0)
+
+  for (p = pattern; *p; )
+  {
+    int ch;
+
+    if (*p == '\\')
+    {
+      /* `\.` etc. is a literal. `\w`, `\b`, `\1` etc. are not.
+       */
+      if (!p[1] || !strchr(".[]()*+?{}|^$\\", p[1]))
+      {
+        END_RUN();
+        p += p[1] ? 2 : 1;
+        continue;
+      }
+      ch = p[1];
+      p += 2;
+    }
+    else if (*p == '[')
+    {
+      END_RUN();
+      p = regex_skip_bracket (p);
+      continue;
+    }
+    else if (*p == '(')
+    {
+      END_RUN();
+      p = regex_skip_group (p);
+      continue;
+    }
+    else if (strchr("*+?{", *p))
+    {
+      END_RUN();
+      p = regex_skip_quantifier (p);
+      continue;
+    }
+    else if (strchr(".^$)", *p))
+    {
+      END_RUN();
+      p++;
+      continue;
+    }
+    else
+      ch = *p++;
+
+    if (*p == '*' || *p == '?' || *p == '{')   /* `ch` is optional */
+    {
+      END_RUN();
+      p = regex_skip_quantifier (p);
+      continue;
+    }
+
+    if (run_len == sizeof(run))
+       END_RUN();
+    run [run_len++] = (char) ch;
+
+    if (*p == '+')   /* `ch` is required, but the next literal may not follow it */
+    {
+      END_RUN();
+      p++;
+    }
+  }
+  END_RUN();
+#undef END_RUN
+
+  return (best_len);
+}
+
+/**
+ * Compile the extended regular expression `pattern` for `grep_buffer_regex()`.
+ *
+ * \param[in]  pattern      the pattern.
+ * \param[in]  ignore_case  compile it with `REG_ICASE`.
+ * \param[out] err_buf      the error from `regerror()` on failure.
+ * \param[in]  err_size     the size of `err_buf`.
+ * \retval     the compiled pattern or `NULL` on failure.
+ */
+grep_regex *grep_regex_compile (const char *pattern, bool ignore_case, char *err_buf, size_t err_size)
+{
+  grep_regex *re = CALLOC (sizeof(*re), 1);
+  int         rc = regcomp (&re->re, pattern, REG_EXTENDED | (ignore_case ? REG_ICASE : 0));
+
+  if (rc)
+  {
+    regerror (rc, &re->re, err_buf, err_size);
+    regfree (&re->re);
+    FREE (re);
+    return (NULL);
+  }
+  re->ignore_case = ignore_case;
+  re->literal_len = grep_regex_literal (pattern, re->literal, sizeof(re->literal));
+  TRACE (1, "regex: '%s', literal: '%.*s'.\n", pattern, (int)re->literal_len, re->literal);
+  return (re);
+}
+
+/**
+ * Free a pattern from `grep_regex_compile()`.
+ */
+void grep_regex_free (grep_regex *re)
+{
+  if (re)
+  {
+    regfree (&re->re);
+    FREE (re);
+  }
+}
+
+/**
+ * Search for the regular expression `re` in a buffer and call `func` for each match.
+ *
+ * If `re` has a required literal, it is found with `grep_find()` first and
+ * `regexec()` is only run on the lines containing it. Otherwise on every line.
+ * Each line is copied and 0-terminated (without it's `"\r\n"` or `"\n"`)
+ * since `regexec()` needs that. There can be several matches in a line.
+ *
+ * \param[in] buf   the start of the buffer.
+ * \param[in] end   the end of the buffer.
+ * \param[in] re    the pattern from `grep_regex_compile()`.
+ * \param[in] func  the function to call for each match. Returns `false` to stop.
+ * \param[in] arg   the argument for `func`.
+ * \retval    the number of times `func` was called.
+ */
+int grep_buffer_regex (const char *buf, const char *end, const grep_regex *re,
+                       grep_func func, void *arg)
+{
+  const char *pos = buf, *counted = buf;
+  char       *line = NULL;
+  size_t      line_size = 0;
+  DWORD       line_num = 1;
+  int         matches = 0;
+  bool        stop = false;
+
+  while (!stop && pos < end)
+  {
+    const char *line_start, *line_end, *next;
+    size_t      len, ofs = 0;
+    int         eflags = 0;
+
+    if (re->literal_len > 0)
+    {
+      const char *cand = grep_find (pos, end, re->literal, re->literal_len, re->ignore_case);
+
+      if (!cand)
+         break;
+      for (line_start = cand; line_start > pos && line_start[-1] != '\n'; line_start--)
+          ;
+    }
+    else
+      line_start = pos;
+
+    next = memchr (line_start, '\n', end - line_start);
+    line_end = next ? next : end;
+    pos = next ? next + 1 : end;
+    if (line_end > line_start && line_end[-1] == '\r')
+       line_end--;
+
+    line_num += (DWORD) grep_count_lines (counted, line_start, NULL);
+    counted = line_start;
+
+    len = line_end - line_start;
+    if (len + 1 > line_size)
+    {
+      line_size = len + 100;
+      line = REALLOC (line, line_size);
+    }
+    memcpy (line, line_start, len);
+    line [len] = '\0';
+
+    while (1)
+    {
+      regmatch_t m;
+      size_t     so, eo;
+
+      if (regexec(&re->re, line + ofs, 1, &m, eflags) != REG_NOERROR)
+         break;
+
+      so = ofs + m.rm_so;
+      eo = ofs + m.rm_eo;
+      matches++;
+      if (!(*func) (arg, line_num, line_start, line_start + so, eo - so, line_end))
+      {
+        stop = true;
+        break;
+      }
+      if (eo >= len)
+         break;
+      ofs = (eo > so) ? eo : eo + 1;
+      eflags = REG_NOTBOL;
+    }
+  }
+  FREE (line);
+  return (matches);
+}
+
+/**
+ * \typedef grep_multi
+ *
+ * An Aho-Corasick automaton for several `--grep` needles.
+ *
+ * The bytes used in the needles are mapped to `num_classes - 1` classes
+ * (all other bytes to class 0). Hence the full transition table `delta[]`
+ * is `num_states * num_classes` and small enough to stay in the cache.
+ * State 0 is the root.
+ */
+struct grep_multi {
+       int     *delta;         /**< `delta [state * num_classes + class]` = next state */
+       int     *needle;        /**< the needle ending in a state or -1 */
+       int     *out;           /**< the first state with a needle on the suffix-chain or -1 */
+       int     *dict;          /**< the next state with a needle on the suffix-chain or -1 */
+       int      num_states;
+       int      num_classes;
+       BYTE     cls [256];     /**< the class of each (case-folded) byte */
+       char   **needles;       /**< a copy of the needles */
+       size_t  *needle_len;    /**< and their lengths */
+       int      num_needles;
+     };
+
+/**
+ * Add a new state to the `grep_multi` trie.
+ */
+static int grep_multi_new_state (grep_multi *gm, int *max_states)
+{
+  int s = gm->num_states++;
+
+  if (s >= *max_states)
+  {
+    *max_states = 2 * s + 16;
+    gm->delta  = REALLOC (gm->delta, *max_states * gm->num_classes * sizeof(int));
+    gm->needle = REALLOC (gm->needle, *max_states * sizeof(int));
+  }
+  memset (gm->delta + s * gm->num_classes, '\0', gm->num_classes * sizeof(int));
+  gm->needle [s] = -1;
+  return (s);
+}
+
+/**
+ * Build an Aho-Corasick automaton for the needles in `needles`.
+ *
+ * Empty needles are ignored. A needle with a `'\r'` or `'\n'` can never
+ * match and is refused.
+ *
+ * \param[in]  needles      the list of needles (`char *`).
+ * \param[in]  ignore_case  match ASCII letters case-insensitively.
+ * \param[out] err_buf      the reason on failure.
+ * \param[in]  err_size     the size of `err_buf`.
+ * \retval     the automaton or `NULL` on failure.
+ */
+grep_multi *grep_multi_compile (const smartlist_t *needles, bool ignore_case, char *err_buf, size_t err_size)
+{
+  grep_multi *gm;
+  BYTE        used [256];
+  int         i, c, K, max_states = 0, head, tail, *queue, *fail;
+  int         max = smartlist_len (needles);
+
+  memset (used, '\0', sizeof(used));
+  for (i = 0; i < max; i++)
+  {
+    const BYTE *n = smartlist_get (needles, i);
+
+    if (strpbrk((const char*)n, "\r\n"))
+    {
+      snprintf (err_buf, err_size, "needle %d contains a newline", i + 1);
+      return (NULL);
+    }
+    for ( ; *n; n++)
+        used [ignore_case ? GREP_LOWER(*n) : *n] = 1;
+  }
+
+  gm = CALLOC (sizeof(*gm), 1);
+  K = 1;
+  for (c = 0; c < 256; c++)
+      if (used[c])
+         gm->cls [c] = (BYTE) K++;
+  for (c = 0; c < 256; c++)
+      gm->cls [c] = gm->cls [ignore_case ? GREP_LOWER(c) : c];
+
+  gm->num_classes = K;
+  gm->needles     = CALLOC (sizeof(char*), max + 1);
+  gm->needle_len  = CALLOC (sizeof(size_t), max + 1);
+  grep_multi_new_state (gm, &max_states);
+
+  /* Build the trie.
+   */
+  for (i = 0; i < max; i++)
+  {
+    const char *n = smartlist_get (needles, i);
+    size_t      len = strlen (n);
+    int         s = 0;
+
+    if (len == 0)
+       continue;
+
+    gm->needles [gm->num_needles]    = STRDUP (n);
+    gm->needle_len [gm->num_needles] = len;
+
+    for ( ; *n; n++)
+    {
+      int *next = gm->delta + s * K + gm->cls [*(const BYTE*)n];
+
+      if (*next == 0)
+      {
+        int t = grep_multi_new_state (gm, &max_states);
+
+        next = gm->delta + s * K + gm->cls [*(const BYTE*)n];
+        *next = t;
+      }
+      s = *next;
+    }
+    if (gm->needle[s] == -1)     /* keep the first of duplicate needles */
+       gm->needle [s] = gm->num_needles;
+    gm->num_needles++;
+  }
+
+  /* Breadth-first; set the failure and dictionary links and turn
+   * the trie into a complete transition table.
+   */
+  fail     = CALLOC (sizeof(int), gm->num_states);
+  queue    = CALLOC (sizeof(int), gm->num_states);
+  gm->dict = MALLOC (sizeof(int) * gm->num_states);
+  gm->out  = MALLOC (sizeof(int) * gm->num_states);
+  head = tail = 0;
+
+  gm->dict [0] = -1;
+  for (c = 0; c < K; c++)
+  {
+    int t = gm->delta [c];
+
+    if (t)
+    {
+      fail [t] = 0;
+      gm->dict [t] = -1;
+      queue [tail++] = t;
+    }
+  }
+
+  while (head < tail)
+  {
+    int s = queue [head++];
+
+    for (c = 0; c < K; c++)
+    {
+      int t = gm->delta [s * K + c];
+      int f = gm->delta [fail[s] * K + c];
+
+      if (t)
+      {
+        fail [t] = f;
+        gm->dict [t] = (gm->needle[f] >= 0) ? f : gm->dict [f];
+        queue [tail++] = t;
+      }
+      else
+        gm->delta [s * K + c] = f;
+    }
+  }
+
+  for (i = 0; i < gm->num_states; i++)
+      gm->out [i] = (gm->needle[i] >= 0) ? i : gm->dict [i];
+
+  FREE (fail);
+  FREE (queue);
+
+  TRACE (1, "%d needles, %d states, %d byte-classes.\n", gm->num_needles, gm->num_states, K);
+  return (gm);
+}
+
+/**
+ * Free an automaton from `grep_multi_compile()`.
+ */
+void grep_multi_free (grep_multi *gm)
+{
+  int i;
+
+  if (!gm)
+     return;
+  for (i = 0; i < gm->num_needles; i++)
+      FREE (gm->needles[i]);
+  FREE (gm->needles);
+  FREE (gm->needle_len);
+  FREE (gm->delta);
+  FREE (gm->needle);
+  FREE (gm->out);
+  FREE (gm->dict);
+  FREE (gm);
+}
+
+/**
+ * Return needle number `i` of the automaton `gm`.
+ */
+const char *grep_multi_needle (const grep_multi *gm, int i)
+{
+  ASSERT (i >= 0 && i < gm->num_needles);
+  return (gm->needles[i]);
+}
+
+/**
+ * Search for all the needles of `gm` in one pass over a buffer
+ * and call `func` for each match.
+ *
+ * Every occurrence of every needle is reported; including overlapping ones.
+ * The matches come in order of their end; at the same end, the longest first.
+ * The line-end is at the first `'\r'` or `'\n'` after the match.
+ *
+ * \param[in] buf   the start of the buffer.
+ * \param[in] end   the end of the buffer.
+ * \param[in] gm    the automaton from `grep_multi_compile()`.
+ * \param[in] func  the function to call for each match. Returns `false` to stop.
+ * \param[in] arg   the argument for `func`.
+ * \retval    the number of times `func` was called.
+ */
+int grep_buffer_multi (const char *buf, const char *end, const grep_multi *gm,
+                       grep_multi_func func, void *arg)
+{
+  const BYTE *p = (const BYTE*) buf;
+  const BYTE *cls = gm->cls;
+  const int  *delta = gm->delta;
+  const char *counted = buf, *line_start = buf, *line_end = buf, *nl;
+  DWORD       line_num = 1;
+  int         K = gm->num_classes;
+  int         state = 0, matches = 0;
+
+  for ( ; p < (const BYTE*)end; p++)
+  {
+    size_t lines;
+    int         o;
+
+    state = delta [state * K + cls[*p]];
+    o = gm->out [state];
+    if (o < 0)
+       continue;
+
+    lines = grep_count_lines (counted, (const char*)p, &nl);
+    if (lines > 0)
+    {
+      line_num  += (DWORD) lines;
+      line_start = nl + 1;
+    }
+    counted = (const char*) p;
+
+    if (line_end <= (const char*)p)
+    {
+      line_end = (const char*) p + 1;
+      while (line_end < end && *line_end != '\r' && *line_end != '\n')
+         line_end++;
+    }
+
+    for ( ; o >= 0; o = gm->dict[o])
+    {
+      int    i   = gm->needle [o];
+      size_t len = gm->needle_len [i];
+
+      matches++;
+      if (!(*func) (arg, i, line_num, line_start, (const char*)p + 1 - len, len, line_end))
+         return (matches);
+    }
+  }
+  return (matches);
+}
+
+/**
+ * The `grep_buffer()` and `grep_buffer_regex()` callback for `grep_file()`.
+ * Stop when `opt.grep.max_matches` matches are printed.
+ */
+static bool report_grep_match (void *arg, DWORD line_num, const char *line_start,
+                               const char *match, size_t match_len, const char *line_end)
+{
+  grep_report *gr = (grep_report*) arg;
+
+  line_num += gr->line_base;
+  GR_TRACE (gr, 1, "Found at line: %lu -> '%.*s'\n", line_num, (int)match_len, match);
+
+  if (opt.json)
+       save_match_json (gr, line_num, line_start, match, match_len, line_end - line_start);
+  else save_match (gr, line_num, line_start, match, match_len, line_end - line_start);
+
+  if (++gr->matches >= (int)opt.grep.max_matches && opt.grep.max_matches)
+  {
+    if (!opt.json)
+       BUF_PUTS (gr->fmt, "        ...\n");
+    return (false);
+  }
+  return (true);
+}
+
+/**
+ * The `grep_buffer_multi()` callback for `grep_file()`.
+ * Print the needle that matched in front of the line.
+ */
+static bool report_grep_multi_match (void *arg, int needle, DWORD line_num, const char *line_start,
+                                     const char *match, size_t match_len, const char *line_end)
+{
+  grep_report *gr = (grep_report*) arg;
+
+  gr->needle = grep_multi_needle (opt.grep.multi, needle);
+  return (report_grep_match (arg, line_num, line_start, match, match_len, line_end));
+}
+
+/**
+ * Search a buffer with the search selected by the `--grep` options.
+ */
+static int grep_search (grep_report *gr, const char *buf, const char *end, const char *content)
+{
+  if (opt.grep.multi)
+     return (grep_buffer_multi (buf, end, opt.grep.multi, report_grep_multi_match, gr));
+  if (opt.grep.re)
+     return (grep_buffer_regex (buf, end, opt.grep.re, report_grep_match, gr));
+  return (grep_buffer (buf, end, content, !opt.case_sensitive, report_grep_match, gr));
+}
+
+/**
+ * The max length of a line carried over between the chunks of a
+ * compressed file. A longer line is searched in pieces.
+ */
+#define GREP_STREAM_MAX_LINE  (1024*1024)
+
+/**
+ * \typedef grep_stream
+ *
+ * The state while searching the decompressed data of a GZIP-file
+ * or a ZIP-member. The `inflate_func` argument for `grep_stream_data()`.
+ */
+typedef struct grep_stream {
+        grep_report *gr;
+        const char  *content;
+        char        *buf;        /**< the partial last line of the previous chunk + the new chunk */
+        size_t       len;        /**< the number of bytes in `buf` */
+        size_t       size;       /**< the allocated size of `buf` */
+        UINT64       total;      /**< the number of decompressed bytes in this stream */
+        int          matches;    /**< the number of matches in all streams */
+        bool         started;    /**< the binary check is done */
+        bool         binary;     /**< the data has binary content */
+      } grep_stream;
+
+/**
+ * Return `true` if `opt.grep.max_matches` matches are printed for the file in `gr`.
+ */
+static bool grep_max_reached (const grep_report *gr)
+{
+  return (opt.grep.max_matches && gr->matches >= (int)opt.grep.max_matches);
+}
+
+/**
+ * Search the whole lines in `gs->buf` (or all of it if `flush == true`)
+ * and keep the rest for the next chunk.
+ *
+ * \retval false if `opt.grep.max_matches` was reached.
+ */
+static bool grep_stream_search (grep_stream *gs, bool flush)
+{
+  grep_report *gr = gs->gr;
+  const char  *nl;
+  size_t       len = gs->len;
+
+  if (!flush && len < GREP_STREAM_MAX_LINE)
+  {
+    for (nl = gs->buf + len; nl > gs->buf && nl[-1] != '\n'; nl--)
+        ;
+    len = nl - gs->buf;
+  }
+  if (len == 0)
+     return (true);
+
+  gr->mmap_max = gs->buf + len;
+  gs->matches += grep_search (gr, gs->buf, gs->buf + len, gs->content);
+  gr->line_base += (DWORD) grep_count_lines (gs->buf, gs->buf + len, NULL);
+
+  gs->len -= len;
+  memmove (gs->buf, gs->buf + len, gs->len);
+  return (!grep_max_reached(gr));
+}
+
+/**
+ * The `inflate_func` for `grep_compressed()`. Add a chunk of decompressed
+ * data to `gs->buf` and search the complete lines in it.
+ * Stop on binary content.
+ */
+static bool grep_stream_data (void *arg, const BYTE *data, size_t len)
+{
+  grep_stream *gs = (grep_stream*) arg;
+
+  if (!gs->started)
+  {
+    gs->started = true;
+    if (memchr(data, '\0', min(len, 100)))
+    {
+      gs->binary = true;
+      return (false);
+    }
+  }
+
+  if (gs->len + len > gs->size)
+  {
+    gs->size = gs->len + len;
+    gs->buf  = REALLOC (gs->buf, gs->size);
+  }
+  memcpy (gs->buf + gs->len, data, len);
+  gs->len   += len;
+  gs->total += len;
+  return (grep_stream_search (gs, false));
+}
+
+/**
+ * Start searching a new stream of decompressed data.
+ */
+static void grep_stream_start (grep_stream *gs)
+{
+  gs->gr->line_base = 0;
+  gs->len     = 0;
+  gs->total   = 0;
+  gs->started = false;
+  gs->binary  = false;
+}
+
+/**
+ * Search the last line of a stream of decompressed data.
+ */
+static void grep_stream_end (grep_stream *gs)
+{
+  if (!gs->binary && gs->len > 0 && !grep_max_reached(gs->gr))
+     grep_stream_search (gs, true);
+}
+
 /**
- * Report time and name of `file`.
+ * The `zip_member_func` for `grep_compressed()`.
+ * Search a stored or deflated member. Skip members with binary content
+ * (like `*.pyc` files in an `.egg`).
  *
- * Also: if the match came from a
- * registry search, report which key had the match.
+ * A stored member is passed to `grep_stream_data()` in `INFLATE_WINDOW`
+ * sized pieces like the output of `inflate_raw()`. Hence only a partial
+ * line is kept in `gs->buf`.
  */
-static int    found_in_hkey_current_user = 0;
-static int    found_in_hkey_current_user_env = 0;
-static int    found_in_hkey_local_machine = 0;
-static int    found_in_hkey_local_machine_sess_man = 0;
-static int    found_in_python_egg = 0;
-static int    found_in_default_env = 0;
-static UINT64 total_size = 0;
-static int    longest_file_so_far = 0;
-static char   report_header [_MAX_PATH+50];
+static bool grep_zip_member (void *arg, const char *name, size_t name_len,
+                             int method, const BYTE *data, size_t data_len)
+{
+  grep_stream *gs = (grep_stream*) arg;
+  grep_report *gr = gs->gr;
+  char         member [_MAX_PATH];
+  size_t       ofs, len;
+  int          rc;
 
-DWORD num_version_ok = 0;
-DWORD num_verified = 0;
-DWORD num_evry_dups = 0;
-DWORD num_evry_ignored = 0;
+  if (name_len > 0 && name[name_len-1] == '/')   /* a directory */
+     return (true);
+
+  snprintf (member, sizeof(member), "%.*s", (int)name_len, name);
+  if (!data)
+  {
+    GR_TRACE (gr, 2, "Skipping '%s'; encrypted, ZIP64 or method: %d.\n", member, method);
+    return (true);
+  }
+
+  gr->member = member;
+  grep_stream_start (gs);
+
+  if (method == 0)
+  {
+    for (ofs = 0; ofs < data_len; ofs += len)
+    {
+      len = min (data_len - ofs, INFLATE_WINDOW);
+      if (!grep_stream_data(gs, data + ofs, len))
+         break;
+    }
+    rc = (ofs < data_len) ? INFLATE_STOPPED : INFLATE_OK;
+  }
+  else
+    rc = inflate_raw (data, data_len, NULL, grep_stream_data, gs);
+
+  if (rc == INFLATE_ERROR)
+       GR_TRACE (gr, 1, "Failed to inflate '%s'.\n", member);
+  else GR_TRACE (gr, 2, "'%s': rc: %d, %" U64_FMT " bytes from %u compressed bytes.\n",
+                 member, rc, gs->total, (unsigned)data_len);
+  grep_stream_end (gs);
 
-static const char *mmap_max;
-static bool        first_match = false;
+  if (gs->binary)
+     GR_TRACE (gr, 2, "Ignoring binary member '%s'.\n", member);
+
+  gr->member = NULL;
+  return (!grep_max_reached(gr));
+}
 
 /**
- * Print a chunk of a match-line. Replace a `<TAB>` with 2 spaces.
- * Stop printing:
- *  * when `max_len` character printed.
- *  * or when a newline is found.
- *  * or `p` pointer reached beyond `mmap_max`.
+ * Search the decompressed content of a GZIP-file or the members of a ZIP-file.
+ * The data is decompressed in chunks by `inflate_gzip()` or `inflate_raw()`;
+ * never all of it into memory.
+ *
+ * \param[in]  gr       the report state.
+ * \param[in]  is_zip   `buf` is a ZIP-file. Otherwise a GZIP-file.
+ * \param[in]  buf      the start of the (memory-mapped) file.
+ * \param[in]  end      the end of the file.
+ * \param[in]  content  the content to search for.
+ * \param[out] binary   set to `true` if a GZIP-file has binary content.
+ * \retval     the number of matches.
  */
-static size_t save_chunk (FMT_buf *fmt, const char *str, size_t max_len)
+static int grep_compressed (grep_report *gr, bool is_zip, const BYTE *buf, const BYTE *end,
+                            const char *content, bool *binary)
 {
-  const char *p = str;
-  size_t      len = 0;
+  grep_stream gs;
+  int         rc;
+
+  memset (&gs, '\0', sizeof(gs));
+  gs.gr      = gr;
+  gs.content = content;
 
-  for (p = str; *p != '\r' && *p != '\n' && len < max_len && p < mmap_max; len++, p++)
+  if (is_zip)
+     rc = zip_foreach (buf, end - buf, grep_zip_member, &gs);
+  else
   {
-    if (*p == '\t')
-         BUF_PUTS (fmt, "  ");
-    else if (*p == '~')
-         BUF_PUTS (fmt, "~~");
-    else BUF_PUTC (fmt, *p);
-    if (fmt->buffer_left < 2)
-       break;
+    grep_stream_start (&gs);
+    rc = inflate_gzip (buf, end - buf, grep_stream_data, &gs);
+    grep_stream_end (&gs);
+    *binary = gs.binary;
+    GR_TRACE (gr, 2, "rc: %d, %" U64_FMT " bytes from %u compressed bytes.\n",
+              rc, gs.total, (unsigned)(end - buf));
   }
-  return (len);
+
+  if (rc == INFLATE_ERROR)
+     GR_TRACE (gr, 1, "Corrupt %s-file.\n", is_zip ? "ZIP" : "GZIP");
+  FREE (gs.buf);
+  return (gs.matches);
 }
 
 /**
- * Print a match as a "grep --line-number 'content' file" would do:
- *   2: * 'content' rest of line.
- *   ^     ^
- *   |     |__ match in hightlighted colour    (white on red background)
- *   |________ line_num in hightlighted colour (bright green)
- *
- * \todo If these are > 1 matches on the same line, remember the previous
- *       output (using a `FMT_BUF`), and merge current result with the previous.
+ * Check if `file` is a compressed file that `grep_compressed()` can search.
+ * The same extensions as `check_if_gzip()` and `check_if_zip()` accept.
+ * But check the signature in the already mapped file.
  *
- * \todo Add a configurable `before-context` and `after-context`. Similar to grep.
+ * \retval 1 for a GZIP-file, 2 for a ZIP-file or 0.
  */
-static void save_match (FMT_buf *fmt, DWORD line_num, const char *line, const char *match, size_t match_len, size_t line_max)
+static int grep_compressed_type (const char *file, const BYTE *buf, const BYTE *end)
 {
-  const char *rest, *indent = "        ";
-  size_t      len, rest_max;
-
-  if (first_match)
-     BUF_PUTC (fmt, '\n');
-  first_match = false;
+  const char *ext = get_file_ext (file);
 
-  len = BUF_PRINTF (fmt, "%s~2%lu:~0 ", indent, line_num);
-  len += save_chunk (fmt, line, match - line);
-
-  BUF_PUTS (fmt, "~8");  /* bright white on red background */
-  len += save_chunk (fmt, match, match_len);
-  BUF_PUTS (fmt, "~0");
+  if (end - buf >= 4 && buf[0] == 0x1F && buf[1] == 0x8B && buf[2] == 8 &&
+      !stricmp(ext, "gz"))
+     return (1);
 
-  rest = match + match_len;
-  rest_max = C_screen_width() - 1 - len;
-  rest_max = min (line_max, rest_max);
-  save_chunk (fmt, rest, rest_max);
-  BUF_PUTC (fmt, '\n');
+  if (end - buf >= 4 && !memcmp(buf, "PK\3\4", 4) &&
+      (!stricmp(ext, "egg") || !stricmp(ext, "whl") || !stricmp(ext, "zip")))
+     return (2);
+  return (0);
 }
 
 /**
  * Open a `file` in memory-mapped mode and search for `content`.
+ * Or for the regular expression `opt.grep.re` with `--grep-regex`.
+ * Or for all the needles in `opt.grep.multi` with several `--grep` options.
  * The search is case-sensitive if `opt.case_sensitive == true`.
+ * A `.gz` file or the members of a `.egg`, `.whl` or `.zip` file are searched
+ * decompressed by `grep_compressed()`.
  *
- * \param[in,out] fmt      the format structure to use.
- * \param[in]     file     the file to search.
- * \param[in]     content  the content in `file` to search for.
+ * Does not touch the `opt.grep` counters; hence it can be called
+ * from a `grep_worker()` thread. Then the traces are saved in `traces`.
+ * And on an error, `win_strerror()` is left to the caller.
  *
- * \retval The number of matches found in `file`.
+ * \param[in,out] fmt        the format structure to use.
+ * \param[in]     file       the file to search.
+ * \param[in]     content    the content in `file` to search for.
+ * \param[out]    binary     set to `true` if `file` was ignored as a binary file.
+ * \param[out]    truncated  set to `true` if a JSON match did not fit in `fmt`.
+ * \param[out]    failed     set to the operation that failed on an error.
+ * \param[in]     traces     the list for the `GR_TRACE()` messages in a `grep_worker()`.
+ *                           `NULL` to print them.
+ *
+ * \retval The number of matches found in `file` or a negative `GetLastError()` code.
  */
-static int report_grep_file (FMT_buf *fmt, const char *file, const char *content)
+static int grep_file (FMT_buf *fmt, const char *file, const char *content, bool *binary,
+                      bool *truncated, const char **failed, smartlist_t *traces)
 {
   HANDLE        hnd_file, mmap_file;
   LARGE_INTEGER fsize;
-  const char   *mmap_buf, *p;
-  const char   *line_start, *line_end, *match;
-  DWORD         line_num = 1, err = 0;
-  size_t        match_len = strlen (content);
-  int           matches = 0;
+  const char   *mmap_buf, *mmap_max, *p;
+  grep_report   gr;
+  int           matches = 0, compressed;
+
+  *binary    = false;
+  *truncated = false;
+  *failed    = NULL;
+
+  memset (&gr, '\0', sizeof(gr));
+  gr.fmt         = fmt;
+  gr.first_match = true;
+  gr.traces      = traces;
 
-  if (opt.debug >= 1)
+  if (opt.debug >= 1 && !opt.json)
      BUF_PUTC (fmt, '\n');
 
-  TRACE (1, "grepping file '%s' for '%s'.\n", file, content);
+  GR_TRACE (&gr, 1, "grepping file '%s' for '%s'.\n", file, content);
 
   hnd_file = CreateFile (file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
   if (hnd_file == INVALID_HANDLE_VALUE)
   {
-    err = GetLastError();
-    TRACE (1, "Could not open file: %s.\n", win_strerror(err));
-    return (-(int)err);
+    *failed = "Could not open file";
+    return (-(int)GetLastError());
   }
 
   if (!GetFileSizeEx(hnd_file, &fsize))
   {
-    err = GetLastError();
-    TRACE (1, "Could not get file-size: %s.\n", win_strerror(err));
+    *failed = "Could not get file-size";
+    matches = -(int)GetLastError();
     CloseHandle (hnd_file);
-    return (-(int)err);
+    return (matches);
   }
 
   mmap_file = CreateFileMapping (hnd_file, NULL, PAGE_READONLY, 0, 0, NULL);
   if (!mmap_file)
   {
-    err = GetLastError();
-    TRACE (1, "CreateFileMapping() failed: %s.\n", win_strerror(err));
+    *failed = "CreateFileMapping() failed";
+    matches = -(int)GetLastError();
     CloseHandle (hnd_file);
-    return (-(int)err);
+    return (matches);
   }
 
   mmap_buf = MapViewOfFile (mmap_file, FILE_MAP_READ, 0, 0, 0);
   if (!mmap_buf)
   {
-    err = GetLastError();
-    TRACE (1, "MapViewOfFile() failed: %s.\n", win_strerror(err));
+    *failed = "MapViewOfFile() failed";
+    matches = -(int)GetLastError();
     CloseHandle (hnd_file);
     CloseHandle (mmap_file);
-    return (-(int)err);
+    return (matches);
   }
 
   mmap_max = mmap_buf + ((UINT64)fsize.HighPart << 32) + fsize.LowPart;
-  TRACE (1, "view range: 0x%p - 0x%p. fsize: %" U64_FMT " bytes.\n",
-         mmap_buf, mmap_max-1, ((UINT64)fsize.HighPart << 32) + fsize.LowPart);
+  GR_TRACE (&gr, 1, "view range: 0x%p - 0x%p. fsize: %" U64_FMT " bytes.\n",
+            mmap_buf, mmap_max-1, ((UINT64)fsize.HighPart << 32) + fsize.LowPart);
+
+  gr.mmap_max = mmap_max;
+
+  /* Search inside a `.gz` man-page or a `.egg` / `.zip` on `PYTHONPATH`.
+   */
+  compressed = grep_compressed_type (file, (const BYTE*)mmap_buf, (const BYTE*)mmap_max);
+  if (compressed)
+  {
+    matches = grep_compressed (&gr, compressed == 2, (const BYTE*)mmap_buf, (const BYTE*)mmap_max,
+                               content, binary);
+    if (*binary)
+       GR_TRACE (&gr, 1, "Ignoring binary file %s.\n", file);
+    goto quit;
+  }
 
   p = mmap_max;
   if (p > mmap_buf + 100)
@@ -167,55 +1443,296 @@ static int report_grep_file (FMT_buf *fmt, const char *file, const char *content
    */
   if (memchr(mmap_buf, '\0', p - mmap_buf))
   {
-    TRACE (1, "Ignoring binary file %s.\n", file);
-    opt.grep.binary_files++;
+    GR_TRACE (&gr, 1, "Ignoring binary file %s.\n", file);
+    *binary = true;
     goto quit;
   }
 
-  match = line_end = NULL;
-  first_match = true;
+  matches = grep_search (&gr, mmap_buf, mmap_max, content);
+
+quit:
+  *truncated = gr.truncated;
+  UnmapViewOfFile (mmap_buf);
+  CloseHandle (hnd_file);
+  CloseHandle (mmap_file);
+  return (matches);
+}
+
+/**
+ * \typedef grep_job
+ *
+ * A file queued by `grep_queue_add()` for a `grep_worker()` thread.
+ */
+typedef struct grep_job {
+        char        *file;     /**< the file to search for `opt.grep.content` */
+        char        *output;   /**< the printed matches from `grep_file()` */
+        int          matches;  /**< the return value of `grep_file()`; a negative error-code on error */
+        const char  *failed;   /**< the operation that failed on an error */
+        smartlist_t *traces;   /**< the `GR_TRACE()` messages from `grep_file()` */
+        bool         binary;   /**< the file was ignored as a binary file */
+        bool         truncated; /**< a JSON match did not fit in `output` */
+        bool         used;     /**< `report_grep_file()` has taken the result */
+        HANDLE       done;     /**< set when a worker is done with this job */
+      } grep_job;
+
+/**
+ * \typedef grep_queue
+ *
+ * The queue of `grep_job` and the pool of `grep_worker()` threads.
+ */
+typedef struct grep_queue {
+        smartlist_t     *jobs;         /**< the `grep_job` in the order they were queued */
+        int              next_job;     /**< index of the next job for a worker */
+        int              next_used;    /**< index of the first job not used by `report_grep_file()` */
+        int              next_freed;   /**< index of the first skipped job that may still hold a result */
+        CRITICAL_SECTION crit;         /**< protects the above */
+        HANDLE           sema;         /**< released once for each queued job */
+        HANDLE           threads [MAXIMUM_WAIT_OBJECTS];
+        int              num_threads;
+        volatile bool    quit;         /**< tell the workers to quit */
+      } grep_queue;
+
+static grep_queue grep_q;
+
+/**
+ * Search a file for a `grep_job` into a private `FMT_buf`.
+ */
+static void grep_job_run (grep_job *job)
+{
+  FMT_buf fmt;
+
+  BUF_INIT (&fmt, 10000, 1);
+  job->traces  = smartlist_new();
+  job->matches = grep_file (&fmt, job->file, opt.grep.content, &job->binary, &job->truncated,
+                            &job->failed, job->traces);
+  job->output  = STRDUP (fmt.buffer_start);
+  BUF_FREE (&fmt);
+}
+
+/**
+ * A thread taking the jobs from `grep_q` in order.
+ */
+static DWORD WINAPI grep_worker (void *arg)
+{
+  while (1)
+  {
+    grep_job *job;
+
+    WaitForSingleObject (grep_q.sema, INFINITE);
+    if (grep_q.quit)
+       break;
+
+    EnterCriticalSection (&grep_q.crit);
+    job = smartlist_get (grep_q.jobs, grep_q.next_job++);
+    LeaveCriticalSection (&grep_q.crit);
+
+    grep_job_run (job);
+    SetEvent (job->done);
+  }
+  ARGSUSED (arg);
+  return (0);
+}
+
+/**
+ * Start the `grep_worker()` threads. `--jobs 0` means one thread per CPU.
+ */
+static bool grep_queue_init (void)
+{
+  int i, jobs = opt.jobs;
 
-  for (p = line_start = mmap_buf; p < mmap_max; p++)
+  if (jobs == 0)
   {
-    if (p[0] == '\r' && p[1] == '\n')
-    {
-      line_start = ++p + 1;  /* MSDOS terminated file */
-      line_num++;
-    }
-    else if (p[0] == '\n')
-    {
-      line_start = p + 1;    /* Unix terminated file */
-      line_num++;
-    }
-    else if (str_equal_n(p, content, match_len))
+    SYSTEM_INFO si;
+
+    GetSystemInfo (&si);
+    jobs = (int) si.dwNumberOfProcessors;
+  }
+  if (jobs > MAXIMUM_WAIT_OBJECTS)
+     jobs = MAXIMUM_WAIT_OBJECTS;
+
+  grep_q.jobs = smartlist_new();
+  grep_q.sema = CreateSemaphore (NULL, 0, LONG_MAX, NULL);
+  InitializeCriticalSection (&grep_q.crit);
+
+  for (i = 0; grep_q.sema && i < jobs; i++)
+  {
+    grep_q.threads [grep_q.num_threads] = CreateThread (NULL, 0, grep_worker, NULL, 0, NULL);
+    if (grep_q.threads[grep_q.num_threads])
+       grep_q.num_threads++;
+  }
+  TRACE (1, "Started %d grep threads.\n", grep_q.num_threads);
+  return (grep_q.num_threads > 0);
+}
+
+/**
+ * Queue `file` to be searched for `opt.grep.content` by a `grep_worker()`.
+ * `report_grep_file()` will later take the result for the same file.
+ *
+ * Does nothing with `--jobs 1` or if no threads could be started.
+ * Then `report_grep_file()` searches the file itself.
+ */
+void grep_queue_add (const char *file)
+{
+  grep_job *job;
+
+  if (!opt.grep.content || opt.jobs == 1)
+     return;
+
+  if (!grep_q.jobs && !grep_queue_init())
+     return;
+
+  if (grep_q.num_threads == 0)
+     return;
+
+  job = CALLOC (sizeof(*job), 1);
+  job->file = STRDUP (file);
+  job->done = CreateEvent (NULL, TRUE, FALSE, NULL);
+
+  EnterCriticalSection (&grep_q.crit);
+  smartlist_add (grep_q.jobs, job);
+  LeaveCriticalSection (&grep_q.crit);
+  ReleaseSemaphore (grep_q.sema, 1, NULL);
+}
+
+/**
+ * Free the result of a `grep_job` once it's taken or skipped.
+ * The `job` itself stays in `grep_q.jobs` until `grep_queue_exit()`.
+ */
+static void grep_job_free_result (grep_job *job)
+{
+  FREE (job->output);
+  smartlist_free_all (job->traces);
+  job->traces = NULL;
+}
+
+/**
+ * Find the queued job for `file`. Since the files are normally reported
+ * in the order they were queued, the search starts after the last job used.
+ * Jobs for files that were not reported (filtered out) are skipped. Their
+ * results are freed if the worker is done with them.
+ */
+static grep_job *grep_queue_find (const char *file)
+{
+  grep_job *job = NULL;
+  int       i, max;
+
+  if (grep_q.num_threads == 0)
+     return (NULL);
+
+  EnterCriticalSection (&grep_q.crit);
+  max = smartlist_len (grep_q.jobs);
+  for (i = grep_q.next_used; i < max; i++)
+  {
+    grep_job *j = smartlist_get (grep_q.jobs, i);
+
+    if (!j->used && !strcmp(j->file, file))
     {
-      TRACE (1, "Found at line: %lu, ofs: %zu -> '%.*s'\n",
-             line_num, (size_t)(p - mmap_buf), (int)match_len, p);
-      match = p;
-      p += match_len;
-      line_end = memchr (p, '\r', mmap_max - p);
-      if (!line_end)
-         line_end = memchr (p, '\n', mmap_max - p);
-      if (!line_end)
-         line_end = mmap_max;
+      j->used = true;
+      grep_q.next_used = i + 1;
+      job = j;
+      break;
     }
-    if (match)
+  }
+
+  for (i = grep_q.next_freed; job && i < grep_q.next_used - 1; i++)
+  {
+    grep_job *j = smartlist_get (grep_q.jobs, i);
+
+    if (!j->used)
     {
-      save_match (fmt, line_num, line_start, match, match_len, line_end - line_start);
-      match = NULL;
-      opt.grep.num_matches++;
-      if (++matches >= (int)opt.grep.max_matches && opt.grep.max_matches)
-      {
-        BUF_PUTS (fmt, "        ...\n");
-        break;
-      }
+      if (WaitForSingleObject(j->done, 0) != WAIT_OBJECT_0)
+         break;    /* A worker is still on it; free it later */
+      j->used = true;
+      grep_job_free_result (j);
     }
+    grep_q.next_freed = i + 1;
   }
+  LeaveCriticalSection (&grep_q.crit);
+  return (job);
+}
 
-quit:
-  UnmapViewOfFile (mmap_buf);
-  CloseHandle (hnd_file);
-  CloseHandle (mmap_file);
+/**
+ * Stop the `grep_worker()` threads and free all jobs.
+ */
+void grep_queue_exit (void)
+{
+  int i;
+
+  if (!grep_q.jobs)
+     return;
+
+  grep_q.quit = true;
+  if (grep_q.num_threads > 0)
+  {
+    ReleaseSemaphore (grep_q.sema, grep_q.num_threads, NULL);
+    WaitForMultipleObjects (grep_q.num_threads, grep_q.threads, TRUE, INFINITE);
+  }
+  for (i = 0; i < grep_q.num_threads; i++)
+      CloseHandle (grep_q.threads[i]);
+
+  for (i = 0; i < smartlist_len(grep_q.jobs); i++)
+  {
+    grep_job *job = smartlist_get (grep_q.jobs, i);
+
+    CloseHandle (job->done);
+    FREE (job->file);
+    grep_job_free_result (job);
+    FREE (job);
+  }
+  smartlist_free (grep_q.jobs);
+  if (grep_q.sema)
+     CloseHandle (grep_q.sema);
+  DeleteCriticalSection (&grep_q.crit);
+  memset (&grep_q, '\0', sizeof(grep_q));
+}
+
+/**
+ * Search `file` for `content` and print the matches into `fmt`.
+ *
+ * If the file was queued by `grep_queue_add()`, wait for the worker and
+ * take it's result. Otherwise search it here.
+ * The `opt.grep` counters are only updated here in the main-thread.
+ * And the traces and errors of a worker are printed here.
+ *
+ * \param[in,out] fmt        the format structure to use.
+ * \param[in]     file       the file to search.
+ * \param[in]     content    the content in `file` to search for.
+ * \param[out]    truncated  set to `true` if a JSON match did not fit in `fmt`.
+ *
+ * \retval The number of matches found in `file`.
+ */
+static int report_grep_file (FMT_buf *fmt, const char *file, const char *content, bool *truncated)
+{
+  grep_job   *job = NULL;
+  const char *failed;
+  bool        binary;
+  int         i, matches;
+
+  if (content == opt.grep.content)
+     job = grep_queue_find (file);
+
+  if (job)
+  {
+    WaitForSingleObject (job->done, INFINITE);
+    for (i = 0; i < smartlist_len(job->traces); i++)
+        debug_printf ("%s", (const char*)smartlist_get(job->traces, i));
+    BUF_PUTS (fmt, job->output);
+    matches = job->matches;
+    binary  = job->binary;
+    failed  = job->failed;
+    *truncated = job->truncated;
+    grep_job_free_result (job);
+  }
+  else
+    matches = grep_file (fmt, file, content, &binary, truncated, &failed, NULL);
+
+  if (failed)
+     TRACE (1, "%s: %s.\n", failed, win_strerror(-matches));
+
+  if (binary)
+     opt.grep.binary_files++;
+  if (matches > 0)
+     opt.grep.num_matches += matches;
   return (matches);
 }
 
@@ -229,13 +1746,32 @@ static int found_everything_db_dirty = 0;
 
 static int found_access_denied = 0;
 
+/**
+ * \typedef PE_brief
+ *
+ * The PE-information from `get_PE_file_brief()` for a JSON record.
+ */
+typedef struct PE_brief {
+        struct ver_info ver;
+        enum Bitness    bits;
+        bool            chksum_ok;
+      } PE_brief;
+
+/**
+ * The JSON record being built by `report_json()`.
+ */
+static JSON_writer json_writer;
+
 /**
  * Local functions.
  */
 static bool get_wintrust_info (const char *file, char *dest, size_t dest_size);
 static int  get_trailing_indent (const char *file);
-static bool get_PE_file_brief (const report *r, char *dest, size_t dest_size);
+static bool get_PE_file_brief (const report *r, char *dest, size_t dest_size, PE_brief *pe);
 static void print_PE_file_details (const char *filler);
+static void report_json (const report *r, const char *file, size_t file_len, UINT64 size,
+                         const char *owner, const PE_brief *pe, const char *link,
+                         const char *shebang, int matches, const char *grep_lines, bool truncated);
 
 /**
  * Increment total size for found files.
@@ -254,6 +1790,9 @@ void incr_total_size (UINT64 size)
  *
  * \param[in] r  The `report *` of the file or directory to report.
  *
+ * With `--json` or `--ndjson`, the same information is written as one
+ * JSON record by `report_json()` instead.
+ *
  * \note The `r` structure can be modified by a `r->pre_action` or `r->post_action` function.
  */
 int report_file (report *r)
@@ -261,15 +1800,22 @@ int report_file (report *r)
   const char *note = NULL;
   const char *link = NULL;
   const char *ext  = NULL;
+  const char *shebang = NULL;
   const char *description;
   char        size [40] = "?";
-  int         len;
+  char        owner [100] = "";
+  int         len, matches = 0;
+  size_t      file_len;
   UINT64      fsize;
+  UINT64      json_size = r->fsize;
+  PE_brief    pe;
+  bool        have_PE = false;
   bool        have_it = true;
   bool        show_dir_size = true;
   bool        show_pc_files_only = false;
   bool        show_this_file = true;
   bool        possible_PE_file = true;
+  bool        truncated = false;
 
   FMT_buf     fmt_buf_time_size;
   FMT_buf     fmt_buf_file_info;
@@ -404,6 +1950,7 @@ int report_file (report *r)
     else
       fsize = r->fsize;
 
+    json_size = fsize;
     snprintf (size, sizeof(size), " - %s", get_file_size_str(fsize));
     incr_total_size (fsize);
   }
@@ -426,7 +1973,7 @@ int report_file (report *r)
   {
     static DWORD num_version_ok_last = 0;
 
-    show_this_file = get_PE_file_brief (r, fmt_buf_ver_info.buffer_start, fmt_buf_ver_info.buffer_size);
+    show_this_file = have_PE = get_PE_file_brief (r, fmt_buf_ver_info.buffer_start, fmt_buf_ver_info.buffer_size, &pe);
     if (show_this_file && opt.signed_status != SIGN_CHECK_NONE)
     {
       show_this_file = get_wintrust_info (r->file, fmt_buf_trust_info.buffer_start, fmt_buf_trust_info.buffer_size);
@@ -453,6 +2000,8 @@ int report_file (report *r)
     {
       int i, max = smartlist_len (opt.owners);
 
+      _strlcpy (owner, account_name, sizeof(owner));
+
       /* Show only the file/directory if it matches (or not matches) one of the
        * owners in `opt.owners`.
        * With `opt.owners == "*"`, match all.
@@ -508,6 +2057,7 @@ int report_file (report *r)
   BUF_PRINTF (&fmt_buf_file_info, "%s%c", r->file, r->is_dir ? DIR_SEP: '\0');
   slashify2 (fmt_buf_file_info.buffer_start, fmt_buf_file_info.buffer_start,
              opt.show_unix_paths ? '/' : '\\');
+  file_len = strlen (fmt_buf_file_info.buffer_start);
 
   if (!r->is_dir && r->key == HKEY_MAN_FILE)
   {
@@ -523,16 +2073,14 @@ int report_file (report *r)
   }
   else if (!r->is_dir)
   {
-    const char *shebang = check_if_shebang (r->file);
-
+    shebang = check_if_shebang (r->file);
     if (shebang)
        BUF_PRINTF (&fmt_buf_file_info, "%*s(%s)", get_trailing_indent(r->file), " ", shebang);
   }
 
   if (r->content && !r->is_dir)
   {
-    int matches = report_grep_file (&fmt_buf_grep_info, link ? link : r->file, r->content);
-
+    matches = report_grep_file (&fmt_buf_grep_info, link ? link : r->file, r->content, &truncated);
     if (opt.grep.only && matches == 0)
        show_this_file = false;
   }
@@ -543,6 +2091,14 @@ int report_file (report *r)
     return (0);
   }
 
+  if (opt.json)
+  {
+    report_json (r, fmt_buf_file_info.buffer_start, file_len, json_size, owner,
+                 have_PE ? &pe : NULL, link, shebang, matches, fmt_buf_grep_info.buffer_start, truncated);
+    get_PE_version_info_free();
+    return (1);
+  }
+
   len = C_puts (fmt_buf_time_size.buffer_start);
   C_puts (fmt_buf_owner_info.buffer_start);
 
@@ -614,25 +2170,47 @@ int report_file2 (report *r)
  */
 void report_header_print (void)
 {
-  if (report_header[0])
-     C_printf ("~3%s", report_header);
-  C_puts ("~0");
+  if (!opt.json)
+  {
+    if (report_header[0])
+       C_printf ("~3%s", report_header);
+    C_puts ("~0");
+  }
   report_header[0] = '\0';
   longest_file_so_far = 0;
 }
 
 /**
  * Set the `report_header`.
+ * And the `report_source` for a JSON record. E.g. `"%PATH"` from
+ * a `"Matches in %PATH:\n"` header.
  */
 void report_header_set (const char *fmt, ...)
 {
-  va_list args;
+  static const char *prefixes[] = { "Matches in ", "Matches from ", "Matches for " };
+  const char *p = report_header;
+  va_list     args;
+  size_t      i, len;
 
   va_start (args, fmt);
   if (!fmt || !fmt[0])
        report_header[0] = '\0';
   else vsnprintf (report_header, sizeof(report_header), fmt, args);
   va_end (args);
+
+  for (i = 0; i < DIM(prefixes); i++)
+  {
+    len = strlen (prefixes[i]);
+    if (!strncmp(p, prefixes[i], len))
+    {
+      p += len;
+      break;
+    }
+  }
+  _strlcpy (report_source, p, sizeof(report_source));
+  len = strlen (report_source);
+  while (len > 0 && (report_source[len-1] == '\n' || report_source[len-1] == ':'))
+     report_source [--len] = '\0';
 }
 
 /**
@@ -703,7 +2281,7 @@ static void print_PE_file_details (const char *filler)
  * If so, save the checksum, version-info, signing-status for later when
  * `report_file()` is ready to print this info.
  */
-static bool get_PE_file_brief (const report *r, char *dest, size_t dest_size)
+static bool get_PE_file_brief (const report *r, char *dest, size_t dest_size, PE_brief *pe)
 {
   struct ver_info ver;
   enum Bitness    bits;
@@ -732,6 +2310,10 @@ static bool get_PE_file_brief (const report *r, char *dest, size_t dest_size)
   if (version_ok)
      num_version_ok++;
 
+  pe->ver       = ver;
+  pe->bits      = bits;
+  pe->chksum_ok = chksum_ok;
+
   bitness = (bits == bit_32) ? "~232" :
             (bits == bit_64) ? "~364" : "~5?";
 
@@ -811,8 +2393,120 @@ static bool get_wintrust_info (const char *file, char *dest, size_t dest_size)
   return (false);
 }
 
+/**
+ * Return a name for the `report::key` in a JSON record.
+ */
+static const char *report_key_name (HKEY key)
+{
+  return (key == HKEY_CURRENT_USER              ? "hkcu_app_path"  :
+          key == HKEY_LOCAL_MACHINE             ? "hklm_app_path"  :
+          key == HKEY_CURRENT_USER_ENV          ? "hkcu_env"       :
+          key == HKEY_LOCAL_MACHINE_SESSION_MAN ? "hklm_env"       :
+          key == HKEY_PYTHON_PATH               ? "python"         :
+          key == HKEY_PYTHON_EGG                ? "python_egg"     :
+          key == HKEY_EVERYTHING                ? "everything"     :
+          key == HKEY_EVERYTHING_ETP            ? "everything_etp" :
+          key == HKEY_MAN_FILE                  ? "man"            :
+          key == HKEY_INC_LIB_FILE              ? "inc_lib"        :
+          key == HKEY_PKG_CONFIG_FILE           ? "pkg_config"     :
+          key == HKEY_CMAKE_FILE                ? "cmake"          :
+          key == HKEY_LUA_FILE                  ? "lua"            :
+          key == HKEY_LUA_DLL                   ? "lua_dll"        : "env");
+}
+
+/**
+ * With `--json` or `--ndjson`, write the record for a file from `report_file()`.
+ * E.g.:
+ * \code
+ *   {"file":"c:\\bin\\foo.exe","is_dir":false,"size":1234,"mtime":1577836800,
+ *    "key":"env","source":"%PATH","pe":{"version":"1.2.3.4","bits":64,"chksum_ok":true}}
+ * \endcode
+ *
+ * Each record is written as soon as it is ready; nothing is kept for
+ * `report_final()` except the number of records. With `--json`, the records
+ * are the elements of one array. With `--ndjson`, there is one record per line.
+ */
+static void report_json (const report *r, const char *file, size_t file_len, UINT64 size,
+                         const char *owner, const PE_brief *pe, const char *link,
+                         const char *shebang, int matches, const char *grep_lines, bool truncated)
+{
+  JSON_writer *w = &json_writer;
+  const char  *descr;
+
+  JSON_write_reset (w);
+  if (opt.json == 1)
+     JSON_write_raw (w, NULL, json_records ? ",\n" : "[\n", 2);
+
+  JSON_write_begin (w, NULL, '{');
+  JSON_write_strn (w, "file", file, file_len);
+  JSON_write_bool (w, "is_dir", r->is_dir ? true : false);
+
+  if ((__int64)size < 0)
+       JSON_write_null (w, "size");
+  else JSON_write_int (w, "size", (__int64)size);
+
+  if (r->mtime == 0)
+       JSON_write_null (w, "mtime");
+  else JSON_write_int (w, "mtime", (__int64)r->mtime);
+
+  JSON_write_str (w, "key", report_key_name(r->key));
+  if (report_source[0])
+       JSON_write_str (w, "source", report_source);
+  else JSON_write_null (w, "source");
+
+  if (opt.show_owner && r->key != HKEY_EVERYTHING_ETP)
+  {
+    if (owner[0])
+         JSON_write_str (w, "owner", owner);
+    else JSON_write_null (w, "owner");
+  }
+
+  if (pe)
+  {
+    char version [50];
+
+    snprintf (version, sizeof(version), "%u.%u.%u.%u",
+              pe->ver.val_1, pe->ver.val_2, pe->ver.val_3, pe->ver.val_4);
+    JSON_write_begin (w, "pe", '{');
+    JSON_write_str (w, "version", version);
+    if (pe->bits == bit_32 || pe->bits == bit_64)
+         JSON_write_int (w, "bits", pe->bits == bit_32 ? 32 : 64);
+    else JSON_write_null (w, "bits");
+    JSON_write_bool (w, "chksum_ok", pe->chksum_ok);
+    JSON_write_end (w, '}');
+  }
+
+  if (link)
+     JSON_write_str (w, "link", link);
+  if (shebang)
+     JSON_write_str (w, "shebang", shebang);
+
+  if (opt.show_descr && (descr = file_descr_get(r->file)) != NULL && *descr)
+     JSON_write_str (w, "descr", descr);
+
+  if (r->content && !r->is_dir)
+  {
+    JSON_write_begin (w, "grep", '{');
+    JSON_write_int (w, "matches", matches > 0 ? matches : 0);
+    if (truncated)
+       JSON_write_bool (w, "truncated", true);
+    JSON_write_raw (w, "lines", "[", 1);
+    JSON_write_raw (w, NULL, grep_lines, strlen(grep_lines));
+    JSON_write_raw (w, NULL, "]", 1);
+    JSON_write_end (w, '}');
+  }
+  JSON_write_end (w, '}');
+
+  if (opt.json == 2)
+     JSON_write_raw (w, NULL, "\n", 1);
+
+  C_write (w->buf, w->len);
+  json_records++;
+}
+
 /**
  * Print a summary at end of program.
+ * With `--json`, only close the array of records.
  */
 void report_final (int found)
 {
@@ -820,6 +2514,19 @@ void report_final (int found)
   char duplicates [50] = "";
   char ignored [50] = "";
 
+  if (opt.json)
+  {
+    if (opt.json == 1)
+    {
+      if (json_records)
+           C_write ("\n]\n", 3);
+      else C_write ("[]\n", 3);
+    }
+    JSON_write_free (&json_writer);
+    json_records = 0;
+    return;
+  }
+
   if ((found_in_hkey_current_user || found_in_hkey_current_user_env ||
        found_in_hkey_local_machine || found_in_hkey_local_machine_sess_man) &&
        found_in_default_env)
@@ -906,6 +2613,7 @@ void report_final (int found)
   {
     if (opt.debug >= 1 && ETP_total_rcv)
        C_printf ("\n%s bytes received from ETP-host(s).", str_dword(ETP_total_rcv));
+    ETP_report_hosts();
   }
   else if (opt.PE_check)
   {
@@ -18,6 +18,25 @@ typedef struct report {
         int       (*post_action) (struct report *r);
       } report;
 
+/**
+ * \typedef grep_func
+ *
+ * The callback for each match found by `grep_buffer()`.
+ * Returns `false` to stop the search.
+ */
+typedef bool (*grep_func) (void *arg, DWORD line_num, const char *line_start,
+                           const char *match, size_t match_len, const char *line_end);
+
+/**
+ * \typedef grep_multi_func
+ *
+ * The callback for each match found by `grep_buffer_multi()`.
+ * `needle` is the index of the needle that matched.
+ * Returns `false` to stop the search.
+ */
+typedef bool (*grep_multi_func) (void *arg, int needle, DWORD line_num, const char *line_start,
+                                 const char *match, size_t match_len, const char *line_end);
+
 extern DWORD num_version_ok;
 extern DWORD num_verified;
 extern DWORD num_evry_dups;
@@ -29,3 +48,20 @@ extern void  report_header_print (void);
 extern void  report_header_set (const char *fmt, ...);
 extern void  report_final (int found);
 
+extern const char *grep_find (const char *p, const char *end, const char *needle, size_t len, bool ignore_case);
+extern size_t      grep_count_lines (const char *start, const char *end, const char **last_nl);
+extern int         grep_buffer (const char *buf, const char *end, const char *content, bool ignore_case,
+                                grep_func func, void *arg);
+extern size_t      grep_regex_literal (const char *pattern, char *literal, size_t size);
+extern grep_regex *grep_regex_compile (const char *pattern, bool ignore_case, char *err_buf, size_t err_size);
+extern void        grep_regex_free (grep_regex *re);
+extern int         grep_buffer_regex (const char *buf, const char *end, const grep_regex *re,
+                                      grep_func func, void *arg);
+extern grep_multi *grep_multi_compile (const smartlist_t *needles, bool ignore_case, char *err_buf, size_t err_size);
+extern void        grep_multi_free (grep_multi *gm);
+extern const char *grep_multi_needle (const grep_multi *gm, int i);
+extern int         grep_buffer_multi (const char *buf, const char *end, const grep_multi *gm,
+                                      grep_multi_func func, void *arg);
+extern void        grep_queue_add (const char *file);
+extern void        grep_queue_exit (void);
+
@@ -4,6 +4,7 @@
  *   Functions for dynamic arrays.
  */
 #include "envtool.h"
+#include "color.h"
 #include "smartlist.h"
 
 /**
@@ -26,8 +27,53 @@ typedef struct smartlist_t {
         void **list;
         int    num_used;
         int    capacity;
+
+        /**
+         * For a list created by `smartlist_new_arena()`, the elements are allocated
+         * from these chunks. And freed all at once in `smartlist_free()`.
+         */
+        bool                    is_arena;
+        struct smartlist_chunk *arena;
       } smartlist_t;
 
+/**
+ * \typedef smartlist_chunk
+ *
+ * A chunk of memory in an arena-backed smartlist.
+ * The memory handed out by `smartlist_alloc()` follows this header.
+ */
+typedef struct smartlist_chunk {
+        struct smartlist_chunk *next;  /**< the previous (full) chunk */
+        size_t                  size;  /**< the size of the memory after the header */
+        size_t                  used;  /**< how much of it is used */
+      } smartlist_chunk;
+
+/**
+ * \def SMARTLIST_CHUNK_SIZE
+ *
+ * The size of a `smartlist_chunk`. A larger allocation gets a chunk of it's own.
+ */
+#define SMARTLIST_CHUNK_SIZE  (16*1024)
+
+/**
+ * \def SMARTLIST_CHUNK_HDR
+ *
+ * The size of the `smartlist_chunk` header; rounded up to keep the memory after it aligned.
+ */
+#define SMARTLIST_CHUNK_HDR  ((sizeof(smartlist_chunk) + 15) & ~15)
+
+/**
+ * The arena statistics for `smartlist_arena_report()`.
+ */
+static struct {
+       DWORD  lists;        /**< number of `smartlist_new_arena()` calls */
+       DWORD  chunks;       /**< number of chunks allocated */
+       UINT64 allocs;       /**< number of `smartlist_alloc()` calls served from a chunk */
+       UINT64 bytes;        /**< the total bytes served from chunks */
+       size_t in_use;       /**< the size of all chunks in use now */
+       size_t max_in_use;   /**< the maximum of `in_use` */
+     } arena_stats;
+
 /**
  * \def SMARTLIST_DEFAULT_CAPACITY
  *
@@ -132,15 +178,119 @@ smartlist_t *smartlist_new (void)
 
   sl->num_used = 0;
   sl->capacity = SMARTLIST_DEFAULT_CAPACITY;
+  sl->is_arena = false;
+  sl->arena    = NULL;
   sl->list = CALLOC (sizeof(void*), sl->capacity);
   if (!sl->list)
      FREE (sl);
   return (sl);
 }
 
+/**
+ * Allocate, initialise and return an empty arena-backed smartlist.
+ *
+ * Elements allocated with `smartlist_alloc()`, `smartlist_strdup()` or `smartlist_add_strdup()`
+ * are carved from chunks owned by the list. These are freed all at once in `smartlist_free()`,
+ * `smartlist_free_all()` or `smartlist_wipe()`. A `free_fn` given to these functions is not called.
+ * Hence all elements must be allocated from the list itself.
+ */
+smartlist_t *smartlist_new_arena (void)
+{
+  smartlist_t *sl = smartlist_new();
+
+  if (sl)
+  {
+    sl->is_arena = true;
+    arena_stats.lists++;
+  }
+  return (sl);
+}
+
+/**
+ * Free all the chunks of an arena-backed smartlist.
+ */
+static void smartlist_arena_free (smartlist_t *sl)
+{
+  smartlist_chunk *chunk, *next;
+
+  for (chunk = sl->arena; chunk; chunk = next)
+  {
+    next = chunk->next;
+    arena_stats.in_use -= SMARTLIST_CHUNK_HDR + chunk->size;
+    FREE (chunk);
+  }
+  sl->arena = NULL;
+}
+
+/**
+ * Allocate `size` bytes for an element of `sl`. <br>
+ * From the chunks of an arena-backed smartlist. Otherwise from `MALLOC()`.
+ * The memory is not zeroed.
+ */
+void *smartlist_alloc (smartlist_t *sl, size_t size)
+{
+  smartlist_chunk *chunk;
+  void            *p;
+
+  ASSERT (sl);
+  if (!sl->is_arena)
+     return MALLOC (size);
+
+  size  = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  chunk = sl->arena;
+  if (!chunk || chunk->used + size > chunk->size)
+  {
+    size_t chunk_size = max (size, SMARTLIST_CHUNK_SIZE);
+
+    chunk = MALLOC (SMARTLIST_CHUNK_HDR + chunk_size);
+    chunk->next = sl->arena;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    sl->arena   = chunk;
+
+    arena_stats.chunks++;
+    arena_stats.in_use += SMARTLIST_CHUNK_HDR + chunk_size;
+    if (arena_stats.in_use > arena_stats.max_in_use)
+       arena_stats.max_in_use = arena_stats.in_use;
+  }
+  p = (char*)chunk + SMARTLIST_CHUNK_HDR + chunk->used;
+  chunk->used += size;
+  arena_stats.allocs++;
+  arena_stats.bytes += size;
+  return (p);
+}
+
+/**
+ * Return a copy of `str` allocated by `smartlist_alloc()`.
+ * It is not added to `sl`.
+ */
+char *smartlist_strdup (smartlist_t *sl, const char *str)
+{
+  size_t len = strlen (str) + 1;
+
+  return memcpy (smartlist_alloc(sl, len), str, len);
+}
+
+/**
+ * Print the arena statistics. Called from `mem_report()`.
+ */
+void smartlist_arena_report (void)
+{
+  if (arena_stats.lists == 0)
+     return;
+
+  C_printf ("  Smartlist arenas:       %lu lists, %lu chunks, max %s in use.\n",
+            (unsigned long)arena_stats.lists, (unsigned long)arena_stats.chunks,
+            str_trim((char*)get_file_size_str(arena_stats.max_in_use)));
+  C_printf ("  Arena allocations:      %s", str_qword(arena_stats.allocs));
+  C_printf (" (saved that many MALLOC() + FREE()), %s bytes.\n", str_qword(arena_stats.bytes));
+  if (arena_stats.in_use > 0)
+     C_printf ("  Arena chunks not freed: %s bytes.\n", str_qword(arena_stats.in_use));
+}
+
 /**
  * Deallocate a smartlist. Does not release storage associated with the
- * list's elements.
+ * list's elements. Unless it is an arena-backed smartlist.
  */
 void smartlist_free (smartlist_t *sl)
 {
@@ -149,6 +299,7 @@ void smartlist_free (smartlist_t *sl)
     ASSERT_VAL (sl->list);  /* detect a double smartlist_free() */
     ASSERT_VAL (sl);
     sl->num_used = 0;
+    smartlist_arena_free (sl);
     FREE (sl->list);
     FREE (sl);
   }
@@ -162,7 +313,7 @@ void smartlist_free (smartlist_t *sl)
  */
 void smartlist_free_all (smartlist_t *sl)
 {
-  if (sl)
+  if (sl && !sl->is_arena)
   {
     int i, max = smartlist_len (sl);
 
@@ -231,10 +382,11 @@ unsigned smartlist_addu (smartlist_t *sl, unsigned element)
 
 /**
  * Append a malloced copy of `string` to `sl`.
+ * For an arena-backed smartlist, the copy is allocated from it's arena.
  */
 char *smartlist_add_strdup (struct smartlist_t *sl, const char *string)
 {
-  char *copy = STRDUP (string);
+  char *copy = sl->is_arena ? smartlist_strdup (sl, string) : STRDUP (string);
 
   smartlist_add (sl, copy);
   return (copy);
@@ -292,14 +444,20 @@ void smartlist_clear (smartlist_t *sl)
 
 /**
  * Like `smartlist_clear()`, but call a `free_fn` for all items first.
+ * For an arena-backed smartlist, free all the items at once instead.
  */
 void smartlist_wipe (smartlist_t *sl, void (*free_fn)(void *a))
 {
   int i;
 
   ASSERT (sl);
-  for (i = 0; i < sl->num_used; i++)
-     (*free_fn) (sl->list[i]);
+  if (sl->is_arena)
+     smartlist_arena_free (sl);
+  else
+  {
+    for (i = 0; i < sl->num_used; i++)
+       (*free_fn) (sl->list[i]);
+  }
   smartlist_clear (sl);
 }
 
@@ -326,59 +484,282 @@ int smartlist_duplicates (smartlist_t *sl, smartlist_sort_func compare)
  * If `free_fn` is provided, calls `free_fn` on each duplicate. <br>
  * Otherwise, just removes them. <br>
  * Preserves the list order.
+ *
+ * Done in one compaction pass. Each member is compared to the last member kept.
  */
 int smartlist_make_uniq (smartlist_t *sl, smartlist_sort_func compare, smartlist_free_func free_fn)
 {
-  int i, dups = 0;
+  int i, j, dups;
 
-  for (i = 1; i < sl->num_used; i++)
+  ASSERT (sl);
+  ASSERT_VAL (sl);
+
+  if (sl->num_used < 2)
+     return (0);
+
+  for (i = j = 1; i < sl->num_used; i++)
   {
-    if ((*compare)((const void**)&sl->list[i-1],
+    if ((*compare)((const void**)&sl->list[j-1],
                    (const void**)&sl->list[i]) == 0)
     {
-      if (free_fn)
+      if (free_fn && !sl->is_arena)
         (*free_fn) (sl->list[i]);
-      smartlist_del_keeporder (sl, i--);
-      dups++;
+    }
+    else
+      sl->list [j++] = sl->list [i];
+  }
+
+  dups = sl->num_used - j;
+  memset (sl->list + j, '\0', dups * sizeof(void*));
+  sl->num_used = j;
+  return (dups);
+}
+
+/**
+ * Remove all duplicate members from an unsorted smartlist `sl`.
+ * The first occurrence of each member is kept in it's original order. <br>
+ * `hash` must return the same value for members where `compare` returns 0. <br>
+ * If `free_fn` is provided, calls `free_fn` on each duplicate. <br>
+ * No member can be `NULL`.
+ *
+ * Uses a temporary hash-set (open addressing) of the members kept so far.
+ */
+int smartlist_uniq_unsorted (smartlist_t *sl, smartlist_hash_func hash, smartlist_sort_func compare, smartlist_free_func free_fn)
+{
+  void   **set;
+  unsigned size = 16;
+  int      i, j, dups;
+
+  ASSERT (sl);
+  ASSERT_VAL (sl);
+
+  if (sl->num_used < 2)
+     return (0);
+
+  while (size < 2U * (unsigned)sl->num_used)
+     size <<= 1;
+  set = CALLOC (size, sizeof(void*));
+
+  for (i = j = 0; i < sl->num_used; i++)
+  {
+    unsigned h = (*hash) (sl->list[i]) & (size - 1);
+    bool     dup = false;
+
+    ASSERT (sl->list[i]);
+    while (set[h])
+    {
+      if ((*compare)((const void**)&set[h], (const void**)&sl->list[i]) == 0)
+      {
+        dup = true;
+        break;
+      }
+      h = (h + 1) & (size - 1);
+    }
+
+    if (dup)
+    {
+      if (free_fn && !sl->is_arena)
+        (*free_fn) (sl->list[i]);
+    }
+    else
+    {
+      set [h] = sl->list [i];
+      sl->list [j++] = sl->list [i];
     }
   }
+  FREE (set);
+
+  dups = sl->num_used - j;
+  memset (sl->list + j, '\0', dups * sizeof(void*));
+  sl->num_used = j;
   return (dups);
 }
 
+/**
+ * A `smartlist_uniq_unsorted()` hash-function for a smartlist of strings.
+ * This is FNV-1a.
+ */
+unsigned smartlist_hash_str (const void *a)
+{
+  const BYTE *s = (const BYTE*) a;
+  unsigned    h = 2166136261U;
+
+  while (*s)
+     h = (h ^ *s++) * 16777619U;
+  return (h);
+}
+
+/**
+ * Ditto for a smartlist of case-insensitive strings. Like file-names.
+ */
+unsigned smartlist_hash_stri (const void *a)
+{
+  const BYTE *s = (const BYTE*) a;
+  unsigned    h = 2166136261U;
+
+  while (*s)
+     h = (h ^ (BYTE)tolower(*s++)) * 16777619U;
+  return (h);
+}
+
+/**
+ * \typedef smartlist_lines
+ *
+ * The state of a memory-mapped file for `smartlist_lines_next()`.
+ */
+struct smartlist_lines {
+       HANDLE      mmap_hnd;  /**< the file-mapping handle; `NULL` for an empty file */
+       const char *mmap_buf;  /**< the start of the read-only view */
+       const char *next;      /**< the start of the next line */
+       const char *end;       /**< the end of the view */
+     };
+
+/**
+ * Open and map `file` into memory for reading lines with `smartlist_lines_next()`.
+ *
+ * \param[in] file  the file to map.
+ * \retval    the allocated iterator or `NULL` on failure.
+ */
+smartlist_lines *smartlist_lines_open (const char *file)
+{
+  smartlist_lines *lines;
+  HANDLE           hnd_file;
+  LARGE_INTEGER    fsize;
+
+  hnd_file = CreateFile (file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hnd_file == INVALID_HANDLE_VALUE)
+     return (NULL);
+
+  if (!GetFileSizeEx(hnd_file, &fsize) || (sizeof(void*) == 4 && fsize.HighPart != 0))
+  {
+    TRACE (1, "Could not get file-size or file is too large.\n");
+    CloseHandle (hnd_file);
+    return (NULL);
+  }
+
+  lines = CALLOC (sizeof(*lines), 1);
+
+  /* An empty file cannot be mapped. It simply has no lines.
+   */
+  if (fsize.QuadPart == 0)
+  {
+    CloseHandle (hnd_file);
+    return (lines);
+  }
+
+  lines->mmap_hnd = CreateFileMapping (hnd_file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle (hnd_file);   /* The mapping keeps it's own reference */
+  if (lines->mmap_hnd)
+     lines->mmap_buf = MapViewOfFile (lines->mmap_hnd, FILE_MAP_READ, 0, 0, 0);
+
+  if (!lines->mmap_buf)
+  {
+    TRACE (1, "Failed to map '%s': %s.\n", file, win_strerror(GetLastError()));
+    smartlist_lines_close (lines);
+    return (NULL);
+  }
+  lines->next = lines->mmap_buf;
+  lines->end  = lines->mmap_buf + (size_t)fsize.QuadPart;
+  return (lines);
+}
+
+/**
+ * Return the next line from a `smartlist_lines_open()` file as a view into
+ * the mapping. No data is copied and there is no limit on the line-length.
+ * The `"\n"` or `"\r\n"` at the end is not part of the line.
+ *
+ * \param[in]  lines  the iterator from `smartlist_lines_open()`.
+ * \param[out] line   the start of the line; it is not 0-terminated.
+ * \param[out] len    the length of the line.
+ * \retval     `false` at the end of the file.
+ */
+bool smartlist_lines_next (smartlist_lines *lines, const char **line, size_t *len)
+{
+  const char *start = lines->next;
+  const char *nl;
+
+  if (start >= lines->end)
+     return (false);
+
+  nl = memchr (start, '\n', lines->end - start);
+  if (nl)
+       lines->next = nl + 1;
+  else lines->next = nl = lines->end;
+
+  if (nl > start && nl[-1] == '\r')
+     nl--;
+  *line = start;
+  *len  = nl - start;
+  return (true);
+}
+
+/**
+ * Unmap the file and free the iterator from `smartlist_lines_open()`.
+ * Any line returned from it is no longer valid.
+ */
+void smartlist_lines_close (smartlist_lines *lines)
+{
+  if (lines->mmap_buf)
+     UnmapViewOfFile (lines->mmap_buf);
+  if (lines->mmap_hnd)
+     CloseHandle (lines->mmap_hnd);
+  FREE (lines);
+}
+
 /**
  * Open a file and return the parsed lines as a smartlist. <br>
  * Lines starting with `#` or `;` are assumed to be comment lines
  * and ignored in the returned list.
+ *
+ * The file is read with `smartlist_lines_next()`. Each line is copied into
+ * one buffer with a `"\n"` at the end (as `fgets()` would in text-mode)
+ * and passed to `parse()`. The buffer grows as needed; lines are never split.
  */
 smartlist_t *smartlist_read_file (smartlist_parse_func parse, const char *file_fmt, ...)
 {
-  smartlist_t *sl;
-  char         file [_MAX_PATH];
-  FILE        *f;
-  va_list      args;
+  smartlist_t     *sl;
+  smartlist_lines *lines;
+  char             file [_MAX_PATH];
+  char            *buf = NULL;
+  const char      *line;
+  size_t           len, buf_size = 0;
+  va_list          args;
 
   va_start (args, file_fmt);
   vsnprintf (file, sizeof(file), file_fmt, args);
   va_end (args);
 
-  f = fopen (file, "r");
-  if (!f)
+  lines = smartlist_lines_open (file);
+  if (!lines)
      return (NULL);
 
   sl = smartlist_new();
 
-  while (sl)
+  while (smartlist_lines_next(lines, &line, &len))
   {
-    char buf[5000], *p;
+    const char *p   = line;
+    const char *end = line + len;
+    bool        eol = (lines->next > end);
 
-    if (!fgets(buf, sizeof(buf)-1, f))   /* EOF */
-       break;
+    while (p < end && isspace((int)*(const BYTE*)p))
+       p++;
+    if (p < end && (*p == '#' || *p == ';'))
+       continue;
 
-    p = str_ltrim (buf);
-    if (*p != '#' && *p != ';')
-       (*parse) (sl, buf);
+    if (len + 2 > buf_size)
+    {
+      buf_size = max (len + 2, 2*buf_size);
+      buf = REALLOC (buf, buf_size);
+    }
+    memcpy (buf, line, len);
+    if (eol)
+       buf [len++] = '\n';
+    buf [len] = '\0';
+    (*parse) (sl, buf);
   }
-  fclose (f);
+  FREE (buf);
+  smartlist_lines_close (lines);
   return (sl);
 }
 
@@ -579,6 +960,311 @@ void smartlist_sort (smartlist_t *sl, smartlist_sort_func compare)
   }
 }
 
+/**
+ * Lists shorter than this are sorted by the calling thread only.
+ */
+#define SMARTLIST_SORT_CUTOFF   20000
+
+/**
+ * Runs shorter than this are sorted with an insertion-sort.
+ */
+#define SMARTLIST_SORT_RUN      32
+
+/**
+ * \typedef sort_job
+ *
+ * A piece of work for a `smartlist_sort_parallel()` thread.
+ * Either sort `list[0 .. n1-1]` or merge the sorted runs
+ * `list[0 .. n1-1]` and `list[n1 .. n1+n2-1]`.
+ */
+typedef struct sort_job {
+        void              **list;     /**< the start of this job's part of the list */
+        void              **tmp;      /**< the scratch-area for the same part */
+        int                 n1, n2;   /**< the length of the 1st and 2nd run */
+        bool                merge;    /**< merge 2 runs or sort 1 run */
+        smartlist_sort_func compare;  /**< the user's compare function */
+      } sort_job;
+
+/**
+ * Merge the sorted runs `list[0 .. n1-1]` and `list[n1 .. n1+n2-1]`
+ * via `tmp`. Take from the 1st run on equal members to keep it stable.
+ */
+static void merge_runs (void **list, void **tmp, int n1, int n2, smartlist_sort_func compare)
+{
+  void **a = list, **b = list + n1;
+  int    i = 0, j = 0, k = 0;
+
+  /* Already in order?
+   */
+  if (n1 == 0 || n2 == 0 || (*compare) ((const void**)&a[n1-1], (const void**)&b[0]) <= 0)
+     return;
+
+  while (i < n1 && j < n2)
+  {
+    if ((*compare) ((const void**)&b[j], (const void**)&a[i]) < 0)
+         tmp [k++] = b [j++];
+    else tmp [k++] = a [i++];
+  }
+  while (i < n1)
+     tmp [k++] = a [i++];
+  while (j < n2)
+     tmp [k++] = b [j++];
+  memcpy (list, tmp, k * sizeof(void*));
+}
+
+/**
+ * A stable top-down merge-sort of `list[0 .. num-1]`.
+ * Short runs are done with an insertion-sort.
+ */
+static void merge_sort (void **list, void **tmp, int num, smartlist_sort_func compare)
+{
+  int half;
+
+  if (num <= SMARTLIST_SORT_RUN)
+  {
+    int i, j;
+
+    for (i = 1; i < num; i++)
+    {
+      void *elem = list [i];
+
+      for (j = i; j > 0 && (*compare) ((const void**)&elem, (const void**)&list[j-1]) < 0; j--)
+          list [j] = list [j-1];
+      list [j] = elem;
+    }
+    return;
+  }
+  half = num / 2;
+  merge_sort (list, tmp, half, compare);
+  merge_sort (list + half, tmp + half, num - half, compare);
+  merge_runs (list, tmp, half, num - half, compare);
+}
+
+static void sort_job_run (sort_job *job)
+{
+  if (job->merge)
+       merge_runs (job->list, job->tmp, job->n1, job->n2, job->compare);
+  else merge_sort (job->list, job->tmp, job->n1, job->compare);
+}
+
+static DWORD WINAPI sort_worker (void *arg)
+{
+  sort_job_run ((sort_job*)arg);
+  return (0);
+}
+
+/**
+ * Run `num` sort-jobs concurrently.
+ * The 1st job is done by the calling thread. Any job that a thread
+ * could not be created for, is also done here.
+ */
+static void sort_jobs_run (sort_job *jobs, int num)
+{
+  HANDLE threads [MAXIMUM_WAIT_OBJECTS];
+  int    i, num_threads = 0;
+
+  for (i = 1; i < num; i++)
+  {
+    threads [num_threads] = CreateThread (NULL, 0, sort_worker, jobs + i, 0, NULL);
+    if (threads[num_threads])
+         num_threads++;
+    else sort_job_run (jobs + i);
+  }
+  sort_job_run (jobs);
+
+  if (num_threads > 0)
+     WaitForMultipleObjects (num_threads, threads, TRUE, INFINITE);
+  for (i = 0; i < num_threads; i++)
+      CloseHandle (threads[i]);
+}
+
+/**
+ * Return the number of threads to use for sorting `num` members.
+ */
+static int sort_num_threads (int num, int num_threads)
+{
+  if (num_threads <= 0)
+  {
+    SYSTEM_INFO si;
+
+    GetSystemInfo (&si);
+    num_threads = (int) si.dwNumberOfProcessors;
+  }
+  if (num_threads > MAXIMUM_WAIT_OBJECTS)
+     num_threads = MAXIMUM_WAIT_OBJECTS;
+
+  /* Let each thread have at least `SMARTLIST_SORT_CUTOFF / 2` members.
+   */
+  if (num_threads > 1 && num / num_threads < SMARTLIST_SORT_CUTOFF / 2)
+     num_threads = max (1, num / (SMARTLIST_SORT_CUTOFF / 2));
+  return (num_threads);
+}
+
+/**
+ * The worker for `smartlist_sort_parallel()` and `smartlist_sort_on_key()`.
+ *
+ * Split `list` into `num_threads` runs and let a thread sort each run.
+ * Then merge pairs of adjacent runs concurrently until 1 run is left.
+ */
+static void sort_parallel (void **list, int num, smartlist_sort_func compare, int num_threads)
+{
+  sort_job *jobs;
+  void    **tmp;
+  int      *start, i, runs;
+
+  if (num < 2)
+     return;
+
+  tmp = MALLOC (num * sizeof(void*));
+  num_threads = (num < SMARTLIST_SORT_CUTOFF) ? 1 : sort_num_threads (num, num_threads);
+
+  if (num_threads <= 1)
+  {
+    merge_sort (list, tmp, num, compare);
+    FREE (tmp);
+    return;
+  }
+
+  jobs  = CALLOC (num_threads, sizeof(*jobs));
+  start = CALLOC (num_threads + 1, sizeof(*start));
+
+  for (i = 0; i <= num_threads; i++)
+      start [i] = (int) (((UINT64)num * i) / num_threads);
+
+  for (i = 0; i < num_threads; i++)
+  {
+    jobs[i].list    = list + start[i];
+    jobs[i].tmp     = tmp + start[i];
+    jobs[i].n1      = start[i+1] - start[i];
+    jobs[i].compare = compare;
+  }
+  sort_jobs_run (jobs, num_threads);
+
+  /* Merge run 0 with 1, 2 with 3 etc. An odd run at the end is left for the next pass.
+   */
+  for (runs = num_threads; runs > 1; runs = (runs + 1) / 2)
+  {
+    int num_jobs = 0;
+
+    for (i = 0; i + 1 < runs; i += 2)
+    {
+      sort_job *job = jobs + num_jobs++;
+
+      job->list    = list + start[i];
+      job->tmp     = tmp + start[i];
+      job->n1      = start[i+1] - start[i];
+      job->n2      = start[i+2] - start[i+1];
+      job->merge   = true;
+      job->compare = compare;
+    }
+    sort_jobs_run (jobs, num_jobs);
+
+    /* Drop the start of each 2nd run.
+     */
+    for (i = 0; i <= runs; i += 2)
+        start [i/2] = start [i];
+    start [(runs + 1) / 2] = num;
+  }
+  FREE (start);
+  FREE (jobs);
+  FREE (tmp);
+}
+
+/**
+ * Like `smartlist_sort()`, but a stable merge-sort that calls `compare`
+ * directly. Lists with `SMARTLIST_SORT_CUTOFF` or more members are sorted
+ * by up to `num_threads` threads (0 means one thread per CPU).
+ *
+ * \param[in] sl           the smartlist to sort.
+ * \param[in] compare      the compare function; a `smartlist_sort()` function.
+ * \param[in] num_threads  the max number of threads to use.
+ */
+void smartlist_sort_parallel (smartlist_t *sl, smartlist_sort_func compare, int num_threads)
+{
+  sort_parallel (sl->list, sl->num_used, compare, num_threads);
+}
+
+/**
+ * \typedef sort_key
+ *
+ * A member and it's key for `smartlist_sort_on_key()`.
+ */
+typedef struct sort_key {
+        const char *key;
+        void       *elem;
+      } sort_key;
+
+static int compare_sort_key (const void **_a, const void **_b)
+{
+  const sort_key *a = *_a;
+  const sort_key *b = *_b;
+
+  return strcmp (a->key, b->key);
+}
+
+/**
+ * Sort the members of `sl` on the string returned by `key_func()`.
+ *
+ * The keys are extracted once (and lower-cased once if `ignore_case` is true)
+ * and then compared with `strcmp()`. This avoids calling `key_func()` and a
+ * `stricmp()` in a compare function O(n log n) times.
+ * The sort is stable and done by `smartlist_sort_parallel()`.
+ *
+ * \param[in] sl           the smartlist to sort.
+ * \param[in] key_func     the function returning the key of a member.
+ * \param[in] ignore_case  sort as with `stricmp()`.
+ * \param[in] num_threads  the max number of threads to use; 0 means one thread per CPU.
+ */
+void smartlist_sort_on_key (smartlist_t *sl, smartlist_key_func key_func, bool ignore_case, int num_threads)
+{
+  sort_key *keys;
+  void    **ptrs;
+  char     *folded = NULL;
+  size_t    size = 0;
+  int       i, num = sl->num_used;
+
+  if (num < 2)
+     return;
+
+  keys = MALLOC (num * sizeof(*keys));
+  ptrs = MALLOC (num * sizeof(*ptrs));
+
+  for (i = 0; i < num; i++)
+  {
+    keys[i].elem = sl->list[i];
+    keys[i].key  = (*key_func) (sl->list[i]);
+    ptrs[i] = keys + i;
+    if (ignore_case)
+       size += strlen (keys[i].key) + 1;
+  }
+
+  /* Lower-case all keys into one buffer.
+   */
+  if (ignore_case)
+  {
+    char *p = folded = MALLOC (size);
+
+    for (i = 0; i < num; i++)
+    {
+      const char *k = keys[i].key;
+
+      keys[i].key = p;
+      while (*k)
+        *p++ = (char) tolower ((int)*(const BYTE*)k++);
+      *p++ = '\0';
+    }
+  }
+
+  sort_parallel (ptrs, num, compare_sort_key, num_threads);
+
+  for (i = 0; i < num; i++)
+      sl->list[i] = ((sort_key*)ptrs[i])->elem;
+
+  FREE (folded);
+  FREE (ptrs);
+  FREE (keys);
+}
+
 /**
  * Assuming the members of `sl` are in order, return the index of the
  * member that matches `key`.
@@ -911,7 +1597,7 @@ char *smartlist_add_strdup_dbg (smartlist_t *sl, const char *string, const char
      FATAL ("Illegal use of 'smartlist_add_strdup (%s, \"%.10s\")' from %s(%u).\n", sl_name, string, file, line);
   ASSERT_VAL (sl);
 
-  copy = STRDUP (string);
+  copy = sl->is_arena ? smartlist_strdup (sl, string) : STRDUP (string);
   if (!copy)
      FATAL ("`strdup()` failed in 'smartlist_add_strdup (%s, \"%.10s\")' from %s(%u).\n", sl_name, string, file, line);
   smartlist_add (sl, copy);
@@ -9,14 +9,21 @@
 #define SMARTLIST_EMPTY(sl)    (smartlist_len(sl) == 0)
 
 typedef struct smartlist_t smartlist_t;  /* Opaque struct; defined in smartlist.c */
+typedef struct smartlist_lines smartlist_lines;  /* Opaque struct; defined in smartlist.c */
 
 typedef int  (*smartlist_sort_func) (const void **a, const void **b);
 typedef int  (*smartlist_compare_func) (const void *key, const void **member);
 typedef void (*smartlist_parse_func) (smartlist_t *sl, const char *line);
 typedef void (*smartlist_parse_reg_func) (smartlist_t *sl, const char *key, const char *value);
 typedef void (*smartlist_free_func) (void *a);
+typedef unsigned (*smartlist_hash_func) (const void *a);
+typedef const char *(*smartlist_key_func) (const void *a);
 
 smartlist_t *smartlist_new  (void);
+smartlist_t *smartlist_new_arena (void);
+void        *smartlist_alloc  (smartlist_t *sl, size_t size);
+char        *smartlist_strdup (smartlist_t *sl, const char *str);
+void         smartlist_arena_report (void);
 int          smartlist_len  (const smartlist_t *sl);
 void        *smartlist_get  (const smartlist_t *sl, int idx);
 unsigned     smartlist_getu (const smartlist_t *sl, int idx);
@@ -40,8 +47,14 @@ void         smartlist_wipe (smartlist_t *sl, smartlist_free_func free_fn);
 
 int          smartlist_duplicates (smartlist_t *sl, smartlist_sort_func compare);
 int          smartlist_make_uniq (smartlist_t *sl, smartlist_sort_func compare, smartlist_free_func free_fn);
+int          smartlist_uniq_unsorted (smartlist_t *sl, smartlist_hash_func hash,
+                                      smartlist_sort_func compare, smartlist_free_func free_fn);
+unsigned     smartlist_hash_str  (const void *a);
+unsigned     smartlist_hash_stri (const void *a);
 
 void         smartlist_sort (smartlist_t *sl, smartlist_sort_func compare);
+void         smartlist_sort_parallel (smartlist_t *sl, smartlist_sort_func compare, int num_threads);
+void         smartlist_sort_on_key (smartlist_t *sl, smartlist_key_func key_func, bool ignore_case, int num_threads);
 
 int          smartlist_bsearch_idx (const smartlist_t *sl, const void *key,
                                     smartlist_compare_func compare, bool *found_out);
@@ -50,6 +63,9 @@ void        *smartlist_bsearch (const smartlist_t *sl, const void *key,
                                 smartlist_compare_func compare);
 
 smartlist_t *smartlist_read_file (smartlist_parse_func parse, const char *file_fmt, ...);
+smartlist_lines *smartlist_lines_open (const char *file);
+bool             smartlist_lines_next (smartlist_lines *lines, const char **line, size_t *len);
+void             smartlist_lines_close (smartlist_lines *lines);
 int          smartlist_write_file (smartlist_t *sl, const char *file_fmt, ...);
 smartlist_t *smartlist_read_registry (smartlist_parse_reg_func parse, const char *reg_fmt, ...);
 
@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <winsock2.h>
 #include <windows.h>
 #include <shellapi.h>
 #include <shlobj.h>
@@ -19,6 +22,11 @@
 #include "cache.h"
 #include "vcpkg.h"
 #include "dirlist.h"
+#include "regex.h"
+#include "inflate.h"
+#include "json.h"
+#include "report.h"
+#include "etp_mock.h"
 
 extern bool find_vstudio_init (void);
 
@@ -202,6 +210,1689 @@ static void test_fnmatch (void)
   C_putc ('\n');
 }
 
+/**
+ * Differential test of `fnmatch_exec()` against `fnmatch()`.
+ *
+ * Every pattern in `patterns[]` is matched against every name in `names[]`
+ * with and without `FNM_FLAG_NOCASE`. The results must be the same.
+ * The dotless-file rule (`FNM_FLAG_DOTLESS`) must give the same result as
+ * the `str_equal_n()` test that `process_dir()` used before.
+ */
+static void test_fnmatch_compiled (void)
+{
+  static const char *patterns[] = {
+                    "*", "*.*", "bar*", "Bar*", "*.exe", "*.EXE", "ratio.*", "ratio",
+                    "foo*bar", "foo**bar", "f?o*", "*o?", "mil[!k]-bar*", "[a-c]*.[ch]",
+                    "*[0-9]", "foo/bar*", "foo\\bar*", "foo\\*", "*.tar.gz", "a*b*c",
+                    "", "[", "*]", "x[]y"
+                  };
+  static const char *names[] = {
+                    "barney.txt", "BARNEY.TXT", "ratio", "ratio.h", "rat", "foobar", "fooXbar",
+                    "foo", "FOO.EXE", "a.exe", ".exe", "milk-bar", "milf-bar", "b.c", "c.h",
+                    "d.c", "file9", "foo/barney.txt", "foo\\barney", "x.tar.gz", "tar.gz",
+                    "abc", "acb", "", "[", "x]", "xy"
+                  };
+  size_t i, j;
+  int    k, fails = 0, tests = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < DIM(patterns); i++)
+  {
+    for (k = 0; k < 2; k++)
+    {
+      int           flags = FNM_FLAG_NOESCAPE | (k ? FNM_FLAG_NOCASE : 0);
+      fnmatch_prog *prog  = fnmatch_compile (patterns[i], flags);
+
+      for (j = 0; j < DIM(names); j++)
+      {
+        int rc1 = fnmatch (patterns[i], names[j], flags);
+        int rc2 = fnmatch_exec (prog, names[j], 0);
+        int rc3 = fnmatch_exec (prog, names[j], FNM_FLAG_DOTLESS);
+        int rc4 = rc1;
+
+        if (rc4 == FNM_NOMATCH && str_equal_n(names[j], patterns[i], strlen(names[j])))
+           rc4 = FNM_MATCH;
+
+        tests++;
+        if (rc1 == rc2 && rc3 == rc4)
+           continue;
+
+        fails++;
+        C_printf ("~5  FAIL~0 fnmatch_exec (\"%s\", \"%s\", 0x%02X): %s\n",
+                  patterns[i], names[j], (UINT)flags, fnmatch_res(rc2));
+      }
+      fnmatch_free (prog);
+    }
+  }
+  if (fails == 0)
+     C_printf ("~2  OK  ~0 %d tests.\n", tests);
+  C_putc ('\n');
+}
+
+/**
+ * Benchmark the hash-join in `shadow_find()` against the nested-loop
+ * version on a synthetic directory tree. Both must return the same
+ * shadows in the same order.
+ *
+ * Half of the files in each directory exists in all directories (with
+ * different case and random write-times). The other half are unique.
+ */
+static void test_shadow_find (void)
+{
+  smartlist_t *dir_list = smartlist_new();
+  smartlist_t *shadows1, *shadows2;
+  ULONGLONG    save_dtime = opt.shadow_dtime;
+  DWORD        seed = 1;
+  double       t_naive, t_hash;
+  int          i, j, max, same;
+  const int    num_dirs = 30, num_files = 300;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+  opt.shadow_dtime = 0;
+
+  for (i = 0; i < num_dirs; i++)
+  {
+    directory_array *arr = CALLOC (sizeof(*arr), 1);
+    char   dir [_MAX_PATH];
+
+    snprintf (dir, sizeof(dir), "c:\\synthetic\\dir_%02d", i);
+    arr->dir     = STRDUP (dir);
+    arr->exist   = arr->is_dir = 1;
+    arr->dirent2 = smartlist_new();
+
+    for (j = 0; j < num_files; j++)
+    {
+      struct dirent2 *de = CALLOC (sizeof(*de), 1);
+      char      file [_MAX_PATH];
+      ULONGLONG ft;
+
+      if (j & 1)
+           snprintf (file, sizeof(file), "%s\\%s_%05d.exe", dir, (i & 1) ? "FILE" : "file", j);
+      else snprintf (file, sizeof(file), "%s\\uniq_%02d_%05d.exe", dir, i, j);
+
+      seed = 1103515245 * seed + 12345;
+      ft = 130000000000000000ULL + 10000000ULL * (seed >> 8);
+      de->d_name = STRDUP (file);
+      de->d_time_write.dwLowDateTime  = (DWORD) ft;
+      de->d_time_write.dwHighDateTime = (DWORD) (ft >> 32);
+      smartlist_add (arr->dirent2, de);
+    }
+    smartlist_add (dir_list, arr);
+  }
+
+  t_naive  = bench_time();
+  shadows1 = shadow_find (dir_list, true);
+  t_naive  = bench_time() - t_naive;
+
+  t_hash   = bench_time();
+  shadows2 = shadow_find (dir_list, false);
+  t_hash   = bench_time() - t_hash;
+
+  max  = smartlist_len (shadows1);
+  same = (max == smartlist_len(shadows2));
+  for (i = 0; same && i < max; i++)
+  {
+    const struct shadow_entry *se1 = smartlist_get (shadows1, i);
+    const struct shadow_entry *se2 = smartlist_get (shadows2, i);
+
+    same = (se1->shadowing_file == se2->shadowing_file && se1->shadowed_file == se2->shadowed_file);
+  }
+
+  C_printf ("%s~0 %d dirs * %d files, %d shadows. nested-loop: %.3f sec, hash-join: %.3f sec (%.1f times faster).\n\n",
+            same ? "~2  OK  " : "~5  FAIL", num_dirs, num_files, max, t_naive, t_hash,
+            t_hash > 0.0 ? t_naive / t_hash : 0.0);
+
+  shadow_free (shadows1);
+  shadow_free (shadows2);
+  smartlist_wipe (dir_list, dir_array_wiper);
+  smartlist_free (dir_list);
+  opt.shadow_dtime = save_dtime;
+}
+
+/**
+ * Benchmark `fnmatch_exec()` against `fnmatch()` on a million synthetic
+ * file-names for some typical patterns. Both must give the same number
+ * of matches.
+ */
+static void test_fnmatch_bench (void)
+{
+  static const char *patterns[] = { "*.dll", "lib*.a", "python3*", "*zlib*.h" };
+  static const char *exts[]     = { "exe", "dll", "h", "a", "txt", "DLL" };
+  static const char *stems[]    = { "lib", "python3", "zlib", "Lib", "foo" };
+  const int num_names = 1000000;
+  char    **names = MALLOC (num_names * sizeof(char*));
+  char     *buf   = MALLOC (num_names * 24);
+  DWORD     seed  = 1;
+  size_t    i;
+  int       j, flags = fnmatch_case(0) | FNM_FLAG_NOESCAPE;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (j = 0; j < num_names; j++)
+  {
+    seed = 1103515245 * seed + 12345;
+    names[j] = buf + 24 * j;
+    snprintf (names[j], 24, "%s%05u.%s", stems[(seed >> 8) % DIM(stems)],
+              (unsigned)(seed >> 12) % 100000, exts[(seed >> 20) % DIM(exts)]);
+  }
+
+  for (i = 0; i < DIM(patterns); i++)
+  {
+    fnmatch_prog *prog = fnmatch_compile (patterns[i], flags);
+    double        t_ref, t_prog;
+    int           n_ref = 0, n_prog = 0;
+
+    t_ref = bench_time();
+    for (j = 0; j < num_names; j++)
+        if (fnmatch(patterns[i], names[j], flags) == FNM_MATCH)
+           n_ref++;
+    t_ref = bench_time() - t_ref;
+
+    t_prog = bench_time();
+    for (j = 0; j < num_names; j++)
+        if (fnmatch_exec(prog, names[j], 0) == FNM_MATCH)
+           n_prog++;
+    t_prog = bench_time() - t_prog;
+
+    C_printf ("%s~0 %-10s %7d matches. fnmatch(): %.3f sec, fnmatch_exec(): %.3f sec (%.1f times faster).\n",
+              n_ref == n_prog ? "~2  OK  " : "~5  FAIL", patterns[i], n_prog, t_ref, t_prog,
+              t_prog > 0.0 ? t_ref / t_prog : 0.0);
+    fnmatch_free (prog);
+  }
+  C_putc ('\n');
+  FREE (names);
+  FREE (buf);
+}
+
+/**
+ * `smartlist_make_uniq()` and `smartlist_uniq_unsorted()` helpers.
+ */
+static int compare_str (const void **a, const void **b)
+{
+  return strcmp (*(const char**)a, *(const char**)b);
+}
+
+static int compare_stri (const void **a, const void **b)
+{
+  return stricmp (*(const char**)a, *(const char**)b);
+}
+
+/**
+ * The old `smartlist_make_uniq()` with a `smartlist_del_keeporder()` for each duplicate.
+ * Used as a reference in `test_smartlist_uniq_bench()`.
+ */
+static int smartlist_make_uniq_ref (smartlist_t *sl, smartlist_sort_func compare)
+{
+  int i, dups = 0;
+
+  for (i = 1; i < smartlist_len(sl); i++)
+  {
+    const void *a = smartlist_get (sl, i-1);
+    const void *b = smartlist_get (sl, i);
+
+    if ((*compare)(&a, &b) == 0)
+    {
+      smartlist_del_keeporder (sl, i--);
+      dups++;
+    }
+  }
+  return (dups);
+}
+
+/**
+ * Test `smartlist_make_uniq()` and `smartlist_uniq_unsorted()` on a small list.
+ * The unsorted version must keep the first occurrences in their original order.
+ */
+static void test_smartlist_uniq (void)
+{
+  static const char *words[] = { "b", "a", "B", "c", "a", "b", "d", "c" };
+  smartlist_t *sl;
+  char        *str;
+  int          i, dups;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  sl = smartlist_new();
+  for (i = 0; i < DIM(words); i++)
+      smartlist_add (sl, (void*)words[i]);
+  dups = smartlist_uniq_unsorted (sl, smartlist_hash_str, compare_str, NULL);
+  str  = smartlist_join_str (sl, ",");
+  C_printf ("  %s~0 smartlist_uniq_unsorted():      %d dups -> %s\n",
+            (dups == 3 && !strcmp(str, "b,a,B,c,d")) ? "~2OK  " : "~5FAIL", dups, str);
+  FREE (str);
+
+  smartlist_clear (sl);
+  for (i = 0; i < DIM(words); i++)
+      smartlist_add (sl, (void*)words[i]);
+  dups = smartlist_uniq_unsorted (sl, smartlist_hash_stri, compare_stri, NULL);
+  str  = smartlist_join_str (sl, ",");
+  C_printf ("  %s~0 smartlist_uniq_unsorted(), -i:  %d dups -> %s\n",
+            (dups == 4 && !strcmp(str, "b,a,c,d")) ? "~2OK  " : "~5FAIL", dups, str);
+  FREE (str);
+
+  smartlist_clear (sl);
+  for (i = 0; i < DIM(words); i++)
+      smartlist_add (sl, (void*)words[i]);
+  smartlist_sort (sl, compare_str);
+  dups = smartlist_make_uniq (sl, compare_str, NULL);
+  str  = smartlist_join_str (sl, ",");
+  C_printf ("  %s~0 smartlist_make_uniq():          %d dups -> %s\n\n",
+            (dups == 3 && !strcmp(str, "B,a,b,c,d")) ? "~2OK  " : "~5FAIL", dups, str);
+  FREE (str);
+  smartlist_free (sl);
+}
+
+/**
+ * Compare the old and new `smartlist_make_uniq()` and `smartlist_uniq_unsorted()`
+ * on 100.000 strings where 50% are duplicates.
+ */
+static void test_smartlist_uniq_bench (void)
+{
+  const int    num = 100000;
+  char        *buf = MALLOC (num * 12);
+  smartlist_t *sl1 = smartlist_new();
+  smartlist_t *sl2 = smartlist_new();
+  smartlist_t *sl3 = smartlist_new();
+  DWORD        seed = 1;
+  double       t_ref, t_new, t_hash;
+  int          i, dups1, dups2, dups3;
+  bool         same;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  /* 'num/2' different strings; each added twice in a random order.
+   */
+  for (i = 0; i < num; i++)
+  {
+    char *str = buf + 12 * i;
+
+    seed = 1103515245 * seed + 12345;
+    snprintf (str, 12, "str%06d", i < num/2 ? i : (int)((seed >> 8) % (num/2)));
+    smartlist_add (sl1, str);
+  }
+  for (i = num/2; i < num; i++)
+  {
+    seed = 1103515245 * seed + 12345;
+    smartlist_swap (sl1, i, (int)((seed >> 8) % num));
+  }
+  smartlist_append (sl2, sl1);
+  smartlist_append (sl3, sl1);
+  smartlist_sort (sl1, compare_str);
+  smartlist_sort (sl2, compare_str);
+
+  t_ref = bench_time();
+  dups1 = smartlist_make_uniq_ref (sl1, compare_str);
+  t_ref = bench_time() - t_ref;
+
+  t_new = bench_time();
+  dups2 = smartlist_make_uniq (sl2, compare_str, NULL);
+  t_new = bench_time() - t_new;
+
+  t_hash = bench_time();
+  dups3 = smartlist_uniq_unsorted (sl3, smartlist_hash_str, compare_str, NULL);
+  t_hash = bench_time() - t_hash;
+
+  same = (dups1 == dups2 && dups1 == dups3 && smartlist_len(sl1) == smartlist_len(sl2));
+  for (i = 0; same && i < smartlist_len(sl1); i++)
+      same = (smartlist_get(sl1, i) == smartlist_get(sl2, i));
+
+  C_printf ("%s~0 %d strings, %d dups. Old: %.3f sec, smartlist_make_uniq(): %.3f sec, "
+            "smartlist_uniq_unsorted(): %.3f sec.\n\n",
+            same ? "~2  OK  " : "~5  FAIL", num, dups2, t_ref, t_new, t_hash);
+
+  smartlist_free (sl1);
+  smartlist_free (sl2);
+  smartlist_free (sl3);
+  FREE (buf);
+}
+
+/**
+ * Fill a normal and an arena-backed smartlist with the same 100.000 strings.
+ * Check they are equal and print the time to fill and free each.
+ */
+static void test_smartlist_arena (void)
+{
+  const int    num = 100000;
+  smartlist_t *sl1, *sl2;
+  double       t_malloc, t_arena;
+  int          i;
+  bool         same;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  t_malloc = bench_time();
+  sl1 = smartlist_new();
+  for (i = 0; i < num; i++)
+  {
+    char buf [30];
+
+    snprintf (buf, sizeof(buf), "c:\\dir_%d\\file_%d.h", i % 100, i);
+    smartlist_add_strdup (sl1, buf);
+  }
+  t_malloc = bench_time() - t_malloc;
+
+  t_arena = bench_time();
+  sl2 = smartlist_new_arena();
+  for (i = 0; i < num; i++)
+  {
+    char buf [30];
+
+    snprintf (buf, sizeof(buf), "c:\\dir_%d\\file_%d.h", i % 100, i);
+    smartlist_add_strdup (sl2, buf);
+  }
+  t_arena = bench_time() - t_arena;
+
+  same = (smartlist_len(sl1) == smartlist_len(sl2));
+  for (i = 0; same && i < num; i++)
+      same = !strcmp (smartlist_get(sl1, i), smartlist_get(sl2, i));
+
+  t_malloc -= bench_time();
+  smartlist_free_all (sl1);
+  t_malloc += bench_time();
+
+  t_arena -= bench_time();
+  smartlist_free_all (sl2);
+  t_arena += bench_time();
+
+  C_printf ("%s~0 %d strings. smartlist_new(): %.3f sec, smartlist_new_arena(): %.3f sec.\n\n",
+            same ? "~2  OK  " : "~5  FAIL", num, t_malloc, t_arena);
+}
+
+/**
+ * `smartlist_sort_on_key()` helper.
+ */
+static const char *str_key (const void *a)
+{
+  return (const char*) a;
+}
+
+/**
+ * Check that `sl` is sorted as with `stricmp()` and that equal strings
+ * (which were added in order of their address) are still in that order.
+ */
+static bool smartlist_sorted_stable (smartlist_t *sl)
+{
+  int i;
+
+  for (i = 1; i < smartlist_len(sl); i++)
+  {
+    const char *a = smartlist_get (sl, i-1);
+    const char *b = smartlist_get (sl, i);
+    int         rc = stricmp (a, b);
+
+    if (rc > 0 || (rc == 0 && a > b))
+       return (false);
+  }
+  return (true);
+}
+
+/**
+ * Sort 100.000 strings with many duplicates (ignoring case) using
+ * `smartlist_sort()`, `smartlist_sort_parallel()` and `smartlist_sort_on_key()`.
+ * The last 2 must give the same stable order.
+ */
+static void test_smartlist_sort (void)
+{
+  const int    num = 100000;
+  char        *buf = MALLOC (num * 12);
+  smartlist_t *sl1 = smartlist_new();
+  smartlist_t *sl2 = smartlist_new();
+  smartlist_t *sl3 = smartlist_new();
+  DWORD        seed = 1;
+  double       t_qsort, t_merge, t_key;
+  int          i;
+  bool         same;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < num; i++)
+  {
+    char *str = buf + 12 * i;
+
+    seed = 1103515245 * seed + 12345;
+    snprintf (str, 12, "%s%05d", (seed & 0x10000) ? "STR" : "str", (int)((seed >> 8) % 10000));
+    smartlist_add (sl1, str);
+  }
+  smartlist_append (sl2, sl1);
+  smartlist_append (sl3, sl1);
+
+  t_qsort = bench_time();
+  smartlist_sort (sl1, compare_stri);
+  t_qsort = bench_time() - t_qsort;
+
+  t_merge = bench_time();
+  smartlist_sort_parallel (sl2, compare_stri, 4);
+  t_merge = bench_time() - t_merge;
+
+  t_key = bench_time();
+  smartlist_sort_on_key (sl3, str_key, true, 4);
+  t_key = bench_time() - t_key;
+
+  same = smartlist_sorted_stable (sl2) && smartlist_sorted_stable (sl3);
+  for (i = 0; same && i < num; i++)
+      same = (smartlist_get(sl2, i) == smartlist_get(sl3, i) &&
+              !stricmp(smartlist_get(sl1, i), smartlist_get(sl2, i)));
+
+  C_printf ("%s~0 %d strings. smartlist_sort(): %.3f sec, smartlist_sort_parallel(): %.3f sec, "
+            "smartlist_sort_on_key(): %.3f sec.\n\n",
+            same ? "~2  OK  " : "~5  FAIL", num, t_qsort, t_merge, t_key);
+
+  smartlist_free (sl1);
+  smartlist_free (sl2);
+  smartlist_free (sl3);
+  FREE (buf);
+}
+
+/**
+ * `smartlist_read_file()` parser for `test_smartlist_read_file()`.
+ */
+static void read_file_parse (smartlist_t *sl, const char *line)
+{
+  smartlist_add_strdup (sl, line);
+}
+
+/**
+ * Test `smartlist_read_file()` on a file with a comment, `"\r\n"` line-endings,
+ * a line longer than the old 5000 bytes limit and no newline at the end.
+ */
+static void test_smartlist_read_file (void)
+{
+  char        *file = create_temp_file();
+  smartlist_t *sl = NULL;
+  FILE        *f;
+  bool         ok = false;
+  int          i;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  f = file ? fopen (file, "wb") : NULL;
+  if (f)
+  {
+    fputs ("# comment\r\nline 1\r\n", f);
+    for (i = 0; i < 20000; i++)
+        fputc ('x', f);
+    fputs ("\nline 3", f);
+    fclose (f);
+    sl = smartlist_read_file (read_file_parse, file);
+  }
+
+  if (sl && smartlist_len(sl) == 3)
+     ok = (!strcmp(smartlist_get(sl, 0), "line 1\n") &&
+           strlen(smartlist_get(sl, 1)) == 20001 &&
+           !strcmp(smartlist_get(sl, 2), "line 3"));
+
+  C_printf ("%s~0 %d lines read.\n\n", ok ? "~2  OK  " : "~5  FAIL", sl ? smartlist_len(sl) : -1);
+
+  if (sl)
+     smartlist_free_all (sl);
+  if (file)
+     DeleteFile (file);
+  FREE (file);
+}
+
+static size_t read_file_bytes;
+
+/**
+ * `smartlist_read_file()` parser for `test_smartlist_lines_bench()`.
+ * Count the bytes only.
+ */
+static void read_file_count (smartlist_t *sl, const char *line)
+{
+  read_file_bytes += strlen (line);
+  ARGSUSED (sl);
+}
+
+/**
+ * Compare the throughput of `fgets()`, `smartlist_lines_next()` and
+ * `smartlist_read_file()` on a 100 MB file.
+ */
+static void test_smartlist_lines_bench (void)
+{
+  const size_t     size = 100*1024*1024;
+  char            *file = create_temp_file();
+  char             buf [5000];
+  smartlist_lines *lines;
+  const char      *line;
+  size_t           len, written = 0, bytes1 = 0, bytes2 = 0;
+  double           t_fgets, t_lines, t_read;
+  DWORD            seed = 1;
+  FILE            *f;
+  int              num = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  f = file ? fopen (file, "wb") : NULL;
+  if (!f)
+  {
+    C_printf ("~5  FAIL~0 No temp-file.\n\n");
+    FREE (file);
+    return;
+  }
+
+  memset (buf, 'x', sizeof(buf));
+  while (written < size)
+  {
+    seed = 1103515245 * seed + 12345;
+    len = 10 + (seed >> 8) % 150;
+    fwrite (buf, 1, len, f);
+    fputc ('\n', f);
+    written += len + 1;
+    num++;
+  }
+  fclose (f);
+
+  t_fgets = bench_time();
+  f = fopen (file, "rb");
+  while (fgets(buf, sizeof(buf), f))
+     bytes1 += strlen (buf);
+  fclose (f);
+  t_fgets = bench_time() - t_fgets;
+
+  t_lines = bench_time();
+  lines = smartlist_lines_open (file);
+  while (lines && smartlist_lines_next(lines, &line, &len))
+     bytes2 += len + 1;
+  if (lines)
+     smartlist_lines_close (lines);
+  t_lines = bench_time() - t_lines;
+
+  read_file_bytes = 0;
+  t_read = bench_time();
+  smartlist_free (smartlist_read_file (read_file_count, file));
+  t_read = bench_time() - t_read;
+
+  C_printf ("%s~0 %d lines, %s. fgets(): %.0f MB/s, smartlist_lines_next(): %.0f MB/s, "
+            "smartlist_read_file(): %.0f MB/s.\n\n",
+            (bytes1 == written && bytes2 == written && read_file_bytes == written) ? "~2  OK  " : "~5  FAIL",
+            num, get_file_size_str(written), written / (1024*1024*t_fgets),
+            written / (1024*1024*t_lines), written / (1024*1024*t_read));
+  DeleteFile (file);
+  FREE (file);
+}
+
+/**
+ * The old byte-at-a-time loop from `report_grep_file()`.
+ * Used as a reference in `test_grep_buffer()` and `test_grep_bench()`.
+ * `buf` must be 0-terminated.
+ */
+static int grep_buffer_ref (const char *buf, const char *end, const char *content,
+                            grep_func func, void *arg)
+{
+  const char *p, *line_start, *line_end, *match = NULL;
+  size_t      match_len = strlen (content);
+  DWORD       line_num = 1;
+  int         matches = 0;
+
+  for (p = line_start = buf; p < end; p++)
+  {
+    if (p[0] == '\r' && p[1] == '\n')
+    {
+      line_start = ++p + 1;
+      line_num++;
+    }
+    else if (p[0] == '\n')
+    {
+      line_start = p + 1;
+      line_num++;
+    }
+    else if (str_equal_n(p, content, match_len))
+    {
+      match = p;
+      p += match_len;
+      line_end = memchr (p, '\r', end - p);
+      if (!line_end)
+         line_end = memchr (p, '\n', end - p);
+      if (!line_end)
+         line_end = end;
+    }
+    if (match)
+    {
+      matches++;
+      if (!(*func) (arg, line_num, line_start, match, match_len, line_end))
+         break;
+      match = NULL;
+    }
+  }
+  return (matches);
+}
+
+/**
+ * A `grep_func` for the grep tests.
+ * Add the line-number and offsets of each match to the checksum in `arg`.
+ */
+static bool grep_checksum (void *arg, DWORD line_num, const char *line_start,
+                           const char *match, size_t match_len, const char *line_end)
+{
+  UINT64 *sum = (UINT64*) arg;
+
+  *sum = 31 * *sum + line_num;
+  *sum = 31 * *sum + (UINT64) (match - line_start);
+  *sum = 31 * *sum + (UINT64) (line_end - match);
+  ARGSUSED (match_len);
+  return (true);
+}
+
+/**
+ * Fill `buf` with `size` random characters (and a 0-terminator).
+ * Mostly from `alphabet`, with `"\n"` or `"\r\n"` line-endings.
+ */
+static void grep_fill (char *buf, size_t size, const char *alphabet, DWORD *seed)
+{
+  size_t i, alpha_len = strlen (alphabet);
+
+  for (i = 0; i < size; i++)
+  {
+    *seed = 1103515245 * *seed + 12345;
+    if ((*seed >> 8) % 40 == 0)
+         buf [i] = '\n';
+    else if ((*seed >> 8) % 40 == 1 && i + 1 < size)
+    {
+      buf [i++] = '\r';
+      buf [i]   = '\n';
+    }
+    else buf [i] = alphabet [(*seed >> 16) % alpha_len];
+  }
+  buf [size] = '\0';
+}
+
+/**
+ * Compare `grep_buffer()` with the old loop on random buffers of
+ * different sizes. Case-sensitive and case-insensitive.
+ */
+static void test_grep_buffer (void)
+{
+  static const char *needles[] = { "a", "ab", "aB\r", "b\na", "xAbx", "\r", "abababababababababab" };
+  static const int   sizes[]   = { 0, 1, 15, 16, 17, 100, 1000, 65536 };
+  char  *buf = MALLOC (65536 + 1);
+  int    save = opt.case_sensitive;
+  DWORD  seed = 1;
+  int    i, j, cs, tests = 0, fails = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < DIM(sizes); i++)
+      for (j = 0; j < DIM(needles); j++)
+          for (cs = 0; cs <= 1; cs++)
+          {
+            UINT64 sum1 = 0, sum2 = 0;
+            int    num1, num2;
+
+            grep_fill (buf, sizes[i], "abAB x", &seed);
+            opt.case_sensitive = cs;
+            num1 = grep_buffer_ref (buf, buf + sizes[i], needles[j], grep_checksum, &sum1);
+            num2 = grep_buffer (buf, buf + sizes[i], needles[j], !cs, grep_checksum, &sum2);
+            tests++;
+            if (num1 != num2 || sum1 != sum2)
+            {
+              fails++;
+              C_printf ("~5  FAIL~0 size: %d, needle: %d, case_sensitive: %d: %d/%d matches.\n",
+                        sizes[i], j, cs, num1, num2);
+            }
+          }
+
+  opt.case_sensitive = save;
+  C_printf ("%s~0 %d of %d tests.\n\n", fails ? "~5  FAIL" : "~2  OK  ", tests - fails, tests);
+  FREE (buf);
+}
+
+/**
+ * Compare the throughput of the old loop and `grep_buffer()`
+ * over a 2 GB corpus (a 64 MB buffer searched 32 times).
+ */
+static void test_grep_bench (void)
+{
+  const size_t size   = 64*1024*1024;
+  const int    rounds = 32;
+  const char  *needle = "SMARTLIST_FOREACH";
+  char        *buf = MALLOC (size + 1);
+  int          save = opt.case_sensitive;
+  double       t_ref, t_new;
+  DWORD        seed = 1;
+  int          i, cs;
+  size_t       ofs;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  grep_fill (buf, size, "abcdefghijklmnopqrstuvwxyz_ ();{}", &seed);
+  for (ofs = 4096; ofs + 100 < size; ofs += 4096 + (ofs % 1000))
+      memcpy (buf + ofs, needle, strlen(needle));
+
+  for (cs = 1; cs >= 0; cs--)
+  {
+    UINT64 sum1 = 0, sum2 = 0;
+    int    num1 = 0, num2 = 0;
+
+    opt.case_sensitive = cs;
+
+    t_ref = bench_time();
+    for (i = 0; i < rounds; i++)
+        num1 += grep_buffer_ref (buf, buf + size, needle, grep_checksum, &sum1);
+    t_ref = bench_time() - t_ref;
+
+    t_new = bench_time();
+    for (i = 0; i < rounds; i++)
+        num2 += grep_buffer (buf, buf + size, needle, !cs, grep_checksum, &sum2);
+    t_new = bench_time() - t_new;
+
+    C_printf ("%s~0 %s, %d matches. Old: %.0f MB/s, grep_buffer(): %.0f MB/s.\n",
+              (num1 == num2 && sum1 == sum2) ? "~2  OK  " : "~5  FAIL",
+              cs ? "case-sensitive  " : "case-insensitive", num2,
+              (double)rounds * size / (1024*1024*t_ref), (double)rounds * size / (1024*1024*t_new));
+  }
+  C_putc ('\n');
+  opt.case_sensitive = save;
+  FREE (buf);
+}
+
+/**
+ * Search every line of a buffer for the regular expression `re` without any
+ * literal prefilter. Used as a reference in `test_grep_regex()`.
+ */
+static int grep_buffer_regex_ref (const char *buf, const char *end, const regex_t *re,
+                                  grep_func func, void *arg)
+{
+  const char *line_start = buf;
+  DWORD       line_num = 1;
+  int         matches = 0;
+
+  while (line_start < end)
+  {
+    const char *nl = memchr (line_start, '\n', end - line_start);
+    const char *line_end = nl ? nl : end;
+    char       *line;
+    size_t      len, ofs = 0;
+    int         eflags = 0;
+
+    if (line_end > line_start && line_end[-1] == '\r')
+       line_end--;
+
+    len = line_end - line_start;
+    line = MALLOC (len + 1);
+    memcpy (line, line_start, len);
+    line [len] = '\0';
+
+    while (1)
+    {
+      regmatch_t m;
+
+      if (regexec(re, line + ofs, 1, &m, eflags) != REG_NOERROR)
+         break;
+      matches++;
+      (*func) (arg, line_num, line_start, line_start + ofs + m.rm_so, m.rm_eo - m.rm_so, line_end);
+      if (ofs + m.rm_eo >= len)
+         break;
+      ofs += (m.rm_eo > m.rm_so) ? m.rm_eo : m.rm_eo + 1;
+      eflags = REG_NOTBOL;
+    }
+    FREE (line);
+    line_start = nl ? nl + 1 : end;
+    line_num++;
+  }
+  return (matches);
+}
+
+/**
+ * Test the literal extraction of `grep_regex_literal()` and compare
+ * `grep_buffer_regex()` with a search of every line on random buffers.
+ */
+static void test_grep_regex (void)
+{
+  static const struct {
+         const char *pattern;
+         const char *literal;
+       } literals[] = {
+         { "foo.*barbaz",        "barbaz"        },
+         { "ab+cd",              "ab"            },
+         { "colou?r",            "colo"          },
+         { "(a|b)xyz",           "xyz"           },
+         { "a|bcd",              ""              },
+         { "x[0-9]+yy",          "yy"            },
+         { "\\.h$",              ".h"            },
+         { "#include <std",      "#include <std" },
+         { "a{2}bc",             "bc"            },
+         { "[[:alpha:]]+_t\\b",  "_t"            },
+         { "^[^]a]*$",           ""              }
+       };
+  static const char *patterns[] = { "ab", "a[bB]+x", "^b", "x$", "a|B", "(ab)+", "b*", "A.b\r" };
+  char  *buf = MALLOC (20000 + 1);
+  DWORD  seed = 1;
+  int    i, j, cs, tests = 0, fails = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (i = 0; i < DIM(literals); i++)
+  {
+    char   literal [100];
+    size_t len = grep_regex_literal (literals[i].pattern, literal, sizeof(literal));
+
+    tests++;
+    if (len != strlen(literals[i].literal) || memcmp(literal, literals[i].literal, len))
+    {
+      fails++;
+      C_printf ("~5  FAIL~0 grep_regex_literal (\"%s\") -> \"%.*s\", expected \"%s\".\n",
+                literals[i].pattern, (int)len, literal, literals[i].literal);
+    }
+  }
+
+  for (i = 0; i < DIM(patterns); i++)
+      for (j = 0; j < 4; j++)
+          for (cs = 0; cs <= 1; cs++)
+          {
+            grep_regex *re;
+            regex_t     ref;
+            char        errbuf [100];
+            UINT64      sum1 = 0, sum2 = 0;
+            int         num1, num2, size = (j == 0) ? 0 : (j == 1) ? 17 : (j == 2) ? 1000 : 20000;
+
+            grep_fill (buf, size, "abAB x", &seed);
+            re = grep_regex_compile (patterns[i], !cs, errbuf, sizeof(errbuf));
+            regcomp (&ref, patterns[i], REG_EXTENDED | (cs ? 0 : REG_ICASE));
+            num1 = grep_buffer_regex_ref (buf, buf + size, &ref, grep_checksum, &sum1);
+            num2 = re ? grep_buffer_regex (buf, buf + size, re, grep_checksum, &sum2) : -1;
+            tests++;
+            if (num1 != num2 || sum1 != sum2)
+            {
+              fails++;
+              C_printf ("~5  FAIL~0 pattern: \"%s\", size: %d, case_sensitive: %d: %d/%d matches.\n",
+                        patterns[i], size, cs, num1, num2);
+            }
+            grep_regex_free (re);
+            regfree (&ref);
+          }
+
+  C_printf ("%s~0 %d of %d tests.\n\n", fails ? "~5  FAIL" : "~2  OK  ", tests - fails, tests);
+  FREE (buf);
+}
+
+/**
+ * Compare the throughput of the fixed-string `grep_buffer()`, `grep_buffer_regex()`
+ * with a literal prefilter and a search of every line on a 64 MB buffer.
+ */
+static void test_grep_regex_bench (void)
+{
+  const size_t size = 64*1024*1024;
+  char        *buf = MALLOC (size + 1);
+  const char  *needle = "SMARTLIST_FOREACH";
+  const char  *pattern = "SMARTLIST_[A-Z]+";
+  grep_regex  *re;
+  regex_t      ref;
+  char         errbuf [100];
+  UINT64       sum1 = 0, sum2 = 0, sum3 = 0;
+  double       t_fixed, t_regex, t_ref;
+  DWORD        seed = 1;
+  int          num1, num2, num3;
+  size_t       ofs;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  grep_fill (buf, size, "abcdefghijklmnopqrstuvwxyz_ ();{}", &seed);
+  for (ofs = 4096; ofs + 100 < size; ofs += 4096 + (ofs % 1000))
+      memcpy (buf + ofs, needle, strlen(needle));
+
+  re = grep_regex_compile (pattern, false, errbuf, sizeof(errbuf));
+  regcomp (&ref, pattern, REG_EXTENDED);
+
+  t_fixed = bench_time();
+  num1 = grep_buffer (buf, buf + size, needle, false, grep_checksum, &sum1);
+  t_fixed = bench_time() - t_fixed;
+
+  t_regex = bench_time();
+  num2 = grep_buffer_regex (buf, buf + size, re, grep_checksum, &sum2);
+  t_regex = bench_time() - t_regex;
+
+  t_ref = bench_time();
+  num3 = grep_buffer_regex_ref (buf, buf + size, &ref, grep_checksum, &sum3);
+  t_ref = bench_time() - t_ref;
+
+  C_printf ("%s~0 %d matches. grep_buffer(): %.0f MB/s, grep_buffer_regex(): %.0f MB/s, "
+            "regexec() on all lines: %.0f MB/s.\n\n",
+            (num1 == num2 && num2 == num3 && sum2 == sum3) ? "~2  OK  " : "~5  FAIL", num2,
+            size / (1024*1024*t_fixed), size / (1024*1024*t_regex), size / (1024*1024*t_ref));
+
+  grep_regex_free (re);
+  regfree (&ref);
+  FREE (buf);
+}
+
+/**
+ * \typedef grep_multi_hit
+ *
+ * A match found by `grep_buffer_multi_ref()`.
+ */
+typedef struct grep_multi_hit {
+        size_t start;
+        size_t len;
+        int    needle;
+      } grep_multi_hit;
+
+/**
+ * `qsort()` compare function for `grep_multi_hit`; the order
+ * `grep_buffer_multi()` reports matches in.
+ */
+static int grep_multi_hit_compare (const void *_a, const void *_b)
+{
+  const grep_multi_hit *a = (const grep_multi_hit*) _a;
+  const grep_multi_hit *b = (const grep_multi_hit*) _b;
+  size_t a_end = a->start + a->len;
+  size_t b_end = b->start + b->len;
+
+  if (a_end != b_end)
+     return (a_end < b_end ? -1 : 1);
+  if (a->len != b->len)
+     return (a->len > b->len ? -1 : 1);
+  return (a->needle - b->needle);
+}
+
+/**
+ * Search for each needle at every offset of `buf`.
+ * Used as a reference in `test_grep_multi()`. Honours `opt.case_sensitive`.
+ */
+static int grep_buffer_multi_ref (const char *buf, const char *end, const char **needles, int num_needles,
+                                  grep_multi_func func, void *arg)
+{
+  grep_multi_hit *hits = NULL;
+  const char     *p, *line_start = buf, *line_end, *counted = buf;
+  size_t          num = 0, max = 0;
+  DWORD           line_num = 1;
+  int             i, matches = 0;
+
+  for (i = 0; i < num_needles; i++)
+  {
+    size_t len = strlen (needles[i]);
+
+    for (p = buf; p + len <= end; p++)
+    {
+      if (!str_equal_n(p, needles[i], len))
+         continue;
+      if (num == max)
+      {
+        max = 2 * max + 16;
+        hits = REALLOC (hits, max * sizeof(*hits));
+      }
+      hits [num].start  = p - buf;
+      hits [num].len    = len;
+      hits [num].needle = i;
+      num++;
+    }
+  }
+
+  if (num > 0)
+     qsort (hits, num, sizeof(*hits), grep_multi_hit_compare);
+
+  for (i = 0; i < (int)num; i++)
+  {
+    const char *match = buf + hits[i].start;
+
+    for ( ; counted < match; counted++)
+        if (*counted == '\n')
+        {
+          line_num++;
+          line_start = counted + 1;
+        }
+
+    line_end = match + hits[i].len;
+    while (line_end < end && *line_end != '\r' && *line_end != '\n')
+       line_end++;
+
+    matches++;
+    if (!(*func) (arg, hits[i].needle, line_num, line_start, match, hits[i].len, line_end))
+       break;
+  }
+  FREE (hits);
+  return (matches);
+}
+
+/**
+ * A `grep_multi_func` for the grep tests.
+ * Add the needle to the checksum in `arg` and call `grep_checksum()`.
+ */
+static bool grep_multi_checksum (void *arg, int needle, DWORD line_num, const char *line_start,
+                                 const char *match, size_t match_len, const char *line_end)
+{
+  UINT64 *sum = (UINT64*) arg;
+
+  *sum = 31 * *sum + (UINT64) needle;
+  return (grep_checksum (arg, line_num, line_start, match, match_len, line_end));
+}
+
+/**
+ * Compare `grep_buffer_multi()` with a search for each needle at every
+ * offset on random buffers. Case-sensitive and case-insensitive.
+ */
+static void test_grep_multi (void)
+{
+  static const char *needles[] = { "ab", "b", "abab", "xA", "Bx", "a b", "bbbbb", "A" };
+  static const int   sizes[]   = { 0, 1, 17, 1000, 20000 };
+  smartlist_t *sl = smartlist_new();
+  char        *buf = MALLOC (20000 + 1);
+  int          save = opt.case_sensitive;
+  DWORD        seed = 1;
+  int          i, n, cs, tests = 0, fails = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  /* Use the first 'n' needles; a single needle too.
+   */
+  for (n = 1; n <= DIM(needles); n++)
+  {
+    smartlist_add (sl, (void*)needles[n-1]);
+
+    for (i = 0; i < DIM(sizes); i++)
+        for (cs = 0; cs <= 1; cs++)
+        {
+          grep_multi *gm;
+          char        errbuf [100];
+          UINT64      sum1 = 0, sum2 = 0;
+          int         num1, num2;
+
+          grep_fill (buf, sizes[i], "abAB x", &seed);
+          opt.case_sensitive = cs;
+          gm = grep_multi_compile (sl, !cs, errbuf, sizeof(errbuf));
+          num1 = grep_buffer_multi_ref (buf, buf + sizes[i], needles, n, grep_multi_checksum, &sum1);
+          num2 = gm ? grep_buffer_multi (buf, buf + sizes[i], gm, grep_multi_checksum, &sum2) : -1;
+          tests++;
+          if (num1 != num2 || sum1 != sum2)
+          {
+            fails++;
+            C_printf ("~5  FAIL~0 needles: %d, size: %d, case_sensitive: %d: %d/%d matches.\n",
+                      n, sizes[i], cs, num1, num2);
+          }
+          grep_multi_free (gm);
+        }
+  }
+
+  /* A needle with a newline is refused.
+   */
+  smartlist_add (sl, "a\nb");
+  tests++;
+  if (grep_multi_compile(sl, false, buf, 100))
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 a needle with a newline was accepted.\n");
+  }
+
+  opt.case_sensitive = save;
+  C_printf ("%s~0 %d of %d tests.\n\n", fails ? "~5  FAIL" : "~2  OK  ", tests - fails, tests);
+  smartlist_free (sl);
+  FREE (buf);
+}
+
+/**
+ * Compare the throughput of one `grep_buffer()` pass per needle with
+ * one `grep_buffer_multi()` pass for 50 needles on a 64 MB buffer.
+ */
+static void test_grep_multi_bench (void)
+{
+  const size_t size = 64*1024*1024;
+  char        *buf = MALLOC (size + 1);
+  char         needles [50][30];
+  smartlist_t *sl = smartlist_new();
+  grep_multi  *gm;
+  char         errbuf [100];
+  UINT64       sum = 0;
+  double       t_single, t_multi;
+  DWORD        seed = 1;
+  int          i, num1 = 0, num2;
+  size_t       ofs;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  grep_fill (buf, size, "abcdefghijklmnopqrstuvwxyz_ ();{}", &seed);
+  for (i = 0; i < DIM(needles); i++)
+  {
+    snprintf (needles[i], sizeof(needles[i]), "symbol_%c%c_name", 'A' + i % 26, 'a' + i / 26);
+    smartlist_add (sl, needles[i]);
+  }
+  for (i = 0, ofs = 4096; ofs + 100 < size; ofs += 4096 + (ofs % 1000), i++)
+      memcpy (buf + ofs, needles [i % DIM(needles)], strlen(needles[i % DIM(needles)]));
+
+  t_single = bench_time();
+  for (i = 0; i < DIM(needles); i++)
+      num1 += grep_buffer (buf, buf + size, needles[i], false, grep_checksum, &sum);
+  t_single = bench_time() - t_single;
+
+  gm = grep_multi_compile (sl, false, errbuf, sizeof(errbuf));
+  t_multi = bench_time();
+  num2 = grep_buffer_multi (buf, buf + size, gm, grep_multi_checksum, &sum);
+  t_multi = bench_time() - t_multi;
+
+  C_printf ("%s~0 %d matches. %d * grep_buffer(): %.3f sec, grep_buffer_multi(): %.3f sec (%.0f MB/s).\n\n",
+            (num1 == num2) ? "~2  OK  " : "~5  FAIL", num2, DIM(needles),
+            t_single, t_multi, size / (1024*1024*t_multi));
+
+  grep_multi_free (gm);
+  smartlist_free (sl);
+  FREE (buf);
+}
+
+/**
+ * The test data for `test_inflate()`:
+ *  \li `gz_lines`:   a GZIP-file (dynamic Huffman blocks) of the 175000 bytes from `inflate_lines()`.
+ *  \li `gz_members`: 2 GZIP-members; "stored block\n" * 4 (a stored block) and "fixed huffman\n" (a fixed block).
+ *  \li `zip_egg`:    a ZIP-file with a stored "EGG-INFO/PKG-INFO", a deflated "foo/__init__.py" and a "foo/" directory.
+ */
+static const BYTE gz_lines [866] = {
+                  0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xED, 0xD0, 0x3B, 0x0A, 0x02, 0x31,
+                  0x14, 0x40, 0xD1, 0xDE, 0x55, 0x64, 0x09, 0x8E, 0x5F, 0x70, 0x37, 0x11, 0x22, 0x33, 0x10, 0x92,
+                  0x41, 0xC3, 0xAC, 0x5F, 0xC4, 0x5A, 0x1E, 0xF6, 0xA7, 0xBF, 0xDC, 0xE2, 0xD4, 0xA5, 0x95, 0xB4,
+                  0xBF, 0xA5, 0xD2, 0xB6, 0xD1, 0x7B, 0x4D, 0x4B, 0x7B, 0xD4, 0x3C, 0x4A, 0x1A, 0xE5, 0x35, 0x52,
+                  0xAE, 0xEB, 0x9C, 0x77, 0xF5, 0x93, 0x4C, 0x3F, 0x92, 0xFB, 0x33, 0x6F, 0xFD, 0x9B, 0x1C, 0xE2,
+                  0xCB, 0x31, 0xBE, 0x9C, 0xE2, 0xCB, 0x39, 0xBE, 0x5C, 0xE2, 0xCB, 0x35, 0xBE, 0x70, 0xE1, 0xC2,
+                  0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70,
+                  0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C,
+                  0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17,
+                  0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85,
+                  0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1,
+                  0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8,
+                  0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E,
+                  0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B,
+                  0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2,
+                  0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70,
+                  0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C,
+                  0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17,
+                  0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85,
+                  0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1,
+                  0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8,
+                  0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E,
+                  0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B,
+                  0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2,
+                  0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70,
+                  0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C,
+                  0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17,
+                  0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85,
+                  0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1,
+                  0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8,
+                  0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E,
+                  0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B,
+                  0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2,
+                  0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70,
+                  0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C,
+                  0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17,
+                  0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85,
+                  0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1,
+                  0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8,
+                  0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E,
+                  0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B,
+                  0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2,
+                  0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70,
+                  0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C,
+                  0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17,
+                  0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85,
+                  0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1,
+                  0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8,
+                  0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E,
+                  0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B,
+                  0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2,
+                  0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70,
+                  0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C, 0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x17, 0x2E, 0x5C,
+                  0xB8, 0x70, 0xE1, 0xC2, 0x85, 0x0B, 0x97, 0xBF, 0x5D, 0xDE, 0x78, 0x1B, 0x0C, 0x17, 0x98, 0xAB,
+                  0x02, 0x00
+                };
+static const BYTE gz_members [109] = {
+                  0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x01, 0x34, 0x00, 0xCB, 0xFF, 0x73,
+                  0x74, 0x6F, 0x72, 0x65, 0x64, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x0A, 0x73, 0x74, 0x6F, 0x72,
+                  0x65, 0x64, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x0A, 0x73, 0x74, 0x6F, 0x72, 0x65, 0x64, 0x20,
+                  0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x0A, 0x73, 0x74, 0x6F, 0x72, 0x65, 0x64, 0x20, 0x62, 0x6C, 0x6F,
+                  0x63, 0x6B, 0x0A, 0x17, 0x67, 0x9A, 0x42, 0x34, 0x00, 0x00, 0x00, 0x1F, 0x8B, 0x08, 0x00, 0x00,
+                  0x00, 0x00, 0x00, 0x02, 0x03, 0x4B, 0xCB, 0xAC, 0x48, 0x4D, 0x51, 0xC8, 0x28, 0x4D, 0x4B, 0xCB,
+                  0x4D, 0xCC, 0xE3, 0x02, 0x00, 0xE1, 0x8D, 0x89, 0x9B, 0x0E, 0x00, 0x00, 0x00
+                };
+static const BYTE zip_egg [392] = {
+                  0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x50, 0xD1, 0x13,
+                  0x23, 0x13, 0x17, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x45, 0x47,
+                  0x47, 0x2D, 0x49, 0x4E, 0x46, 0x4F, 0x2F, 0x50, 0x4B, 0x47, 0x2D, 0x49, 0x4E, 0x46, 0x4F, 0x4E,
+                  0x61, 0x6D, 0x65, 0x3A, 0x20, 0x66, 0x6F, 0x6F, 0x0A, 0x56, 0x65, 0x72, 0x73, 0x69, 0x6F, 0x6E,
+                  0x3A, 0x20, 0x31, 0x2E, 0x30, 0x0A, 0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00,
+                  0x00, 0x00, 0x21, 0x50, 0x02, 0xCA, 0xD9, 0x6F, 0x2F, 0x00, 0x00, 0x00, 0x87, 0x00, 0x00, 0x00,
+                  0x0F, 0x00, 0x00, 0x00, 0x66, 0x6F, 0x6F, 0x2F, 0x5F, 0x5F, 0x69, 0x6E, 0x69, 0x74, 0x5F, 0x5F,
+                  0x2E, 0x70, 0x79, 0xCB, 0xCC, 0x2D, 0xC8, 0x2F, 0x2A, 0x51, 0x28, 0xAE, 0x2C, 0xE6, 0x4A, 0x49,
+                  0x4D, 0x53, 0x48, 0xCB, 0xCF, 0xD7, 0xD0, 0xB4, 0xE2, 0x52, 0x00, 0x82, 0xA2, 0xD4, 0x92, 0xD2,
+                  0xA2, 0x3C, 0x90, 0x8C, 0x5E, 0x59, 0x6A, 0x51, 0x71, 0x66, 0x7E, 0x1E, 0x57, 0x26, 0xCD, 0x14,
+                  0x03, 0x00, 0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x50,
+                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+                  0x66, 0x6F, 0x6F, 0x2F, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00,
+                  0x00, 0x00, 0x21, 0x50, 0xD1, 0x13, 0x23, 0x13, 0x17, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00, 0x00,
+                  0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x00, 0x00,
+                  0x00, 0x00, 0x45, 0x47, 0x47, 0x2D, 0x49, 0x4E, 0x46, 0x4F, 0x2F, 0x50, 0x4B, 0x47, 0x2D, 0x49,
+                  0x4E, 0x46, 0x4F, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00,
+                  0x00, 0x21, 0x50, 0x02, 0xCA, 0xD9, 0x6F, 0x2F, 0x00, 0x00, 0x00, 0x87, 0x00, 0x00, 0x00, 0x0F,
+                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x46, 0x00, 0x00,
+                  0x00, 0x66, 0x6F, 0x6F, 0x2F, 0x5F, 0x5F, 0x69, 0x6E, 0x69, 0x74, 0x5F, 0x5F, 0x2E, 0x70, 0x79,
+                  0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x50,
+                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0xA2, 0x00, 0x00, 0x00, 0x66, 0x6F,
+                  0x6F, 0x2F, 0x50, 0x4B, 0x05, 0x06, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x03, 0x00, 0xAE, 0x00,
+                  0x00, 0x00, 0xC4, 0x00, 0x00, 0x00, 0x00, 0x00
+                };
+
+/**
+ * Make the text that `gz_lines` decompresses to.
+ */
+static char *inflate_lines (size_t *len)
+{
+  static const char *words[] = { "alpha", "bravo" };
+  char  *text = MALLOC (175000 + 1);
+  size_t pos = 0;
+  int    i;
+
+  for (i = 0; i < 5000; i++)
+      pos += snprintf (text + pos, 175000 + 1 - pos, "line %u: envtool inflate test %s\n", i % 8, words[i % 2]);
+  *len = pos;
+  return (text);
+}
+
+/**
+ * \typedef inflate_check
+ *
+ * The `inflate_compare()` argument.
+ */
+typedef struct inflate_check {
+        const char *expect;      /**< the expected output */
+        size_t      expect_len;  /**< the length of `expect` */
+        size_t      pos;         /**< the output so far */
+        int         chunks;      /**< the number of calls */
+        int         stop_at;     /**< return `false` at this call; 0 = never */
+        bool        ok;          /**< no mismatch and no chunk too large */
+      } inflate_check;
+
+/**
+ * An `inflate_func` comparing the output with `check->expect`.
+ */
+static bool inflate_compare (void *arg, const BYTE *data, size_t len)
+{
+  inflate_check *check = (inflate_check*) arg;
+
+  if (len > 2*INFLATE_WINDOW || check->pos + len > check->expect_len ||
+      memcmp(check->expect + check->pos, data, len))
+     check->ok = false;
+  check->pos += len;
+  return (++check->chunks != check->stop_at);
+}
+
+/**
+ * The `zip_member_func` for `test_inflate()`.
+ */
+static bool zip_check_member (void *arg, const char *name, size_t name_len,
+                              int method, const BYTE *data, size_t data_len)
+{
+  static const char *py = "import sys\ndef foo():\n    return sys.version\n"
+                          "import sys\ndef foo():\n    return sys.version\n"
+                          "import sys\ndef foo():\n    return sys.version\n";
+  inflate_check  check;
+  int           *num = (int*) arg;
+
+  memset (&check, '\0', sizeof(check));
+  check.ok = true;
+
+  if (*num == 0 && name_len == 17 && !memcmp(name, "EGG-INFO/PKG-INFO", 17) && method == 0)
+  {
+    check.expect = "Name: foo\nVersion: 1.0\n";
+    check.expect_len = strlen (check.expect);
+    inflate_compare (&check, data, data_len);
+  }
+  else if (*num == 1 && name_len == 15 && !memcmp(name, "foo/__init__.py", 15) && method == 8)
+  {
+    check.expect = py;
+    check.expect_len = strlen (py);
+    if (inflate_raw(data, data_len, NULL, inflate_compare, &check) != INFLATE_OK)
+       check.ok = false;
+  }
+  else if (*num == 2 && name_len == 4 && !memcmp(name, "foo/", 4) && data_len == 0)
+    ;
+  else
+    check.ok = false;
+
+  if (!check.ok || check.pos != check.expect_len)
+  {
+    C_printf ("~5  FAIL~0 ZIP-member %d: '%.*s'.\n", *num, (int)name_len, name);
+    *num = -100;
+    return (false);
+  }
+  (*num)++;
+  return (true);
+}
+
+/**
+ * Test `inflate_gzip()`, `inflate_raw()` and `zip_foreach()`
+ * on some known data. And on truncated data.
+ */
+static void test_inflate (void)
+{
+  inflate_check check;
+  size_t        lines_len;
+  char         *lines = inflate_lines (&lines_len);
+  int           rc, num, tests = 0, fails = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  /* The whole `gz_lines` in chunks of at most 2 * INFLATE_WINDOW bytes.
+   */
+  memset (&check, '\0', sizeof(check));
+  check.expect = lines;
+  check.expect_len = lines_len;
+  check.ok = true;
+  rc = inflate_gzip (gz_lines, sizeof(gz_lines), inflate_compare, &check);
+  tests++;
+  if (rc != INFLATE_OK || !check.ok || check.pos != lines_len || check.chunks < 3)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 gz_lines: rc: %d, %u of %u bytes in %d chunks.\n",
+              rc, (unsigned)check.pos, (unsigned)lines_len, check.chunks);
+  }
+
+  /* Stop after the 2nd chunk.
+   */
+  memset (&check, '\0', sizeof(check));
+  check.expect = lines;
+  check.expect_len = lines_len;
+  check.ok = true;
+  check.stop_at = 2;
+  rc = inflate_gzip (gz_lines, sizeof(gz_lines), inflate_compare, &check);
+  tests++;
+  if (rc != INFLATE_STOPPED || !check.ok || check.chunks != 2)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 gz_lines stopped: rc: %d, %d chunks.\n", rc, check.chunks);
+  }
+
+  /* Truncated; some output and an error.
+   */
+  memset (&check, '\0', sizeof(check));
+  check.expect = lines;
+  check.expect_len = lines_len;
+  check.ok = true;
+  rc = inflate_gzip (gz_lines, sizeof(gz_lines) / 2, inflate_compare, &check);
+  tests++;
+  if (rc != INFLATE_ERROR || !check.ok)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 gz_lines truncated: rc: %d.\n", rc);
+  }
+
+  /* 2 GZIP-members; a stored and a fixed Huffman block.
+   */
+  memset (&check, '\0', sizeof(check));
+  check.expect = "stored block\nstored block\nstored block\nstored block\nfixed huffman\n";
+  check.expect_len = strlen (check.expect);
+  check.ok = true;
+  rc = inflate_gzip (gz_members, sizeof(gz_members), inflate_compare, &check);
+  tests++;
+  if (rc != INFLATE_OK || !check.ok || check.pos != check.expect_len)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 gz_members: rc: %d, %u bytes.\n", rc, (unsigned)check.pos);
+  }
+
+  /* The ZIP-members and a truncated ZIP-file.
+   */
+  num = 0;
+  rc = zip_foreach (zip_egg, sizeof(zip_egg), zip_check_member, &num);
+  tests++;
+  if (rc != INFLATE_OK || num != 3)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 zip_egg: rc: %d, %d members.\n", rc, num);
+  }
+
+  num = 0;
+  rc = zip_foreach (zip_egg, sizeof(zip_egg) - 30, zip_check_member, &num);
+  tests++;
+  if (rc != INFLATE_ERROR)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 zip_egg truncated: rc: %d.\n", rc);
+  }
+
+  C_printf ("%s~0 %d of %d tests.\n\n", fails ? "~5  FAIL" : "~2  OK  ", tests - fails, tests);
+  FREE (lines);
+}
+
+/**
+ * Test the `JSON_write_*()` functions used for `--json` and `--ndjson`.
+ * The result must be as expected and be accepted by `JSON_parse()`.
+ */
+static void test_json_writer (void)
+{
+  static const char expect[] =
+    "{\"file\":\"c:\\\\tmp\\\\\\\"x\\\".txt\",\"size\":-1,\"mtime\":1577836800,"
+    "\"is_dir\":false,\"owner\":null,\"text\":\"a\\tb\\r\\n\\u0001\\u00e6\","
+    "\"grep\":{\"matches\":2,\"lines\":[{\"line\":1},{\"line\":2}]},\"list\":[1,true,\"x\"]}";
+  JSON_writer w;
+  JSON_parser p;
+  JSON_tok_t  t [30];
+  int         rc, tests = 0, fails = 0;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  memset (&w, '\0', sizeof(w));
+  JSON_write_begin (&w, NULL, '{');
+  JSON_write_str (&w, "file", "c:\\tmp\\\"x\".txt");
+  JSON_write_int (&w, "size", -1);
+  JSON_write_int (&w, "mtime", 1577836800);
+  JSON_write_bool (&w, "is_dir", false);
+  JSON_write_null (&w, "owner");
+  JSON_write_strn (&w, "text", "a\tb\r\n\x01\xE6 not this", 7);
+  JSON_write_begin (&w, "grep", '{');
+  JSON_write_int (&w, "matches", 2);
+  JSON_write_raw (&w, "lines", "[{\"line\":1},{\"line\":2}]", 23);
+  JSON_write_end (&w, '}');
+  JSON_write_begin (&w, "list", '[');
+  JSON_write_int (&w, NULL, 1);
+  JSON_write_bool (&w, NULL, true);
+  JSON_write_str (&w, NULL, "x");
+  JSON_write_end (&w, ']');
+  JSON_write_end (&w, '}');
+
+  tests++;
+  if (w.len != sizeof(expect) - 1 || memcmp(w.buf, expect, w.len))
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 got: '%.*s'\n", (int)w.len, w.buf);
+  }
+
+  JSON_init (&p);
+  rc = JSON_parse (&p, w.buf, w.len, t, DIM(t));
+  tests++;
+  if (rc <= 0 || t[0].type != JSON_OBJECT || t[0].size != 8)
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 JSON_parse(): %d.\n", rc);
+  }
+
+  /* Reuse the buffer for the next record.
+   */
+  JSON_write_reset (&w);
+  JSON_write_begin (&w, NULL, '[');
+  JSON_write_end (&w, ']');
+  tests++;
+  if (w.len != 2 || memcmp(w.buf, "[]", 2))
+  {
+    fails++;
+    C_printf ("~5  FAIL~0 reset: '%.*s'\n", (int)w.len, w.buf);
+  }
+
+  JSON_write_free (&w);
+  C_printf ("%s~0 %d of %d tests.\n\n", fails ? "~5  FAIL" : "~2  OK  ", tests - fails, tests);
+}
+
+/**
+ * Redirect `stdout` to `file`.
+ *
+ * \retval the duplicated original `stdout` for `stdout_restore()` or -1.
+ */
+static int stdout_to_file (const char *file)
+{
+  int fd_out, fd_file;
+
+  C_flush();
+  fd_file = _open (file, _O_WRONLY | _O_CREAT | _O_TRUNC, _S_IREAD | _S_IWRITE);
+  if (fd_file < 0)
+     return (-1);
+
+  fd_out = _dup (1);
+  if (fd_out >= 0)
+     _dup2 (fd_file, 1);
+  _close (fd_file);
+  return (fd_out);
+}
+
+/**
+ * Redirect `stdout` to the `NUL` device for a benchmark.
+ */
+static int stdout_to_nul (void)
+{
+  return stdout_to_file ("NUL");
+}
+
+/**
+ * Restore `stdout` after `stdout_to_file()` or `stdout_to_nul()`.
+ */
+static void stdout_restore (int fd_out)
+{
+  C_flush();
+  _dup2 (fd_out, 1);
+  _close (fd_out);
+}
+
+/**
+ * Grep a file with `num` matching lines into a `--ndjson` record.
+ * Return the number of `"lines"` elements and if the record has
+ * `"matches":num` and a `"truncated":true`.
+ */
+static int report_json_grep (int num, bool *count_ok, bool *truncated)
+{
+  char  *file = create_temp_file();
+  char  *out  = create_temp_file();
+  char  *buf, *p, expect [50];
+  size_t size;
+  FILE  *f;
+  report r;
+  int    i, fd_out, lines = 0;
+  int    save_json = opt.json;
+  char  *save_content = opt.grep.content;
+  UINT   save_max = opt.grep.max_matches;
+
+  *count_ok = *truncated = false;
+  f = (file && out) ? fopen (file, "wb") : NULL;
+  if (!f)
+  {
+    FREE (file);
+    FREE (out);
+    return (-1);
+  }
+  for (i = 0; i < num; i++)
+      fprintf (f, "line %d has a needle in it\n", i);
+  fclose (f);
+
+  fd_out = stdout_to_file (out);
+  opt.json = 2;
+  opt.grep.content = "needle";
+  opt.grep.max_matches = 0;
+
+  memset (&r, '\0', sizeof(r));
+  r.file    = file;
+  r.content = opt.grep.content;
+  r.key     = HKEY_EVERYTHING_ETP;
+  report_file (&r);
+  C_flush();
+
+  opt.json = save_json;
+  opt.grep.content = save_content;
+  opt.grep.max_matches = save_max;
+  if (fd_out >= 0)
+     stdout_restore (fd_out);
+
+  buf = fopen_mem (out, &size);
+  if (buf)
+  {
+    for (p = buf; (p = strstr(p, "{\"line\":")) != NULL; p++)
+        lines++;
+    snprintf (expect, sizeof(expect), "\"matches\":%d,", num);
+    *count_ok  = (strstr(buf, expect) != NULL);
+    *truncated = (strstr(buf, "\"truncated\":true") != NULL);
+    FREE (buf);
+  }
+  DeleteFile (file);
+  DeleteFile (out);
+  FREE (file);
+  FREE (out);
+  return (lines);
+}
+
+/**
+ * Check that a `--json` grep-record with more matches than fits in it's
+ * `"lines"` array is marked `"truncated":true`. And that a record
+ * where all fits is not.
+ */
+static void test_report_json_truncated (void)
+{
+  bool count_ok, truncated;
+  int  lines;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  lines = report_json_grep (5, &count_ok, &truncated);
+  C_printf ("%s~0 5 matches    -> %4d lines, truncated: %d.\n",
+            (lines == 5 && count_ok && !truncated) ? "~2  OK  " : "~5  FAIL", lines, truncated);
+
+  lines = report_json_grep (1000, &count_ok, &truncated);
+  C_printf ("%s~0 1000 matches -> %4d lines, truncated: %d.\n\n",
+            (lines > 0 && lines < 1000 && count_ok && truncated) ? "~2  OK  " : "~5  FAIL", lines, truncated);
+}
+
+/**
+ * Compare the speed of `report_file()` for the coloured text output
+ * and with `--json` / `--ndjson`. The output goes to the `NUL` device.
+ *
+ * The records are made up `HKEY_EVERYTHING_ETP` files with an extension.
+ * Hence `report_file()` does not access the file-system for them.
+ */
+static void test_report_json_bench (void)
+{
+  const int num = 100000;
+  report    r;
+  char      file [_MAX_PATH];
+  double    t [3];
+  int       i, mode, fd_out, save_json = opt.json;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  fd_out = stdout_to_nul();
+  if (fd_out < 0)
+  {
+    C_printf ("~5  FAIL~0 cannot open 'NUL'.\n\n");
+    return;
+  }
+
+  for (mode = 0; mode < 3; mode++)
+  {
+    opt.json = mode;
+    report_header_set ("Matches from bench:\n");
+    t[mode] = bench_time();
+    for (i = 0; i < num; i++)
+    {
+      snprintf (file, sizeof(file), "c:\\bench\\sub-dir-%d\\file-%d.txt", i % 100, i);
+      memset (&r, '\0', sizeof(r));
+      r.file  = file;
+      r.mtime = 1577836800 + i;
+      r.fsize = 1000 + i;
+      r.key   = HKEY_EVERYTHING_ETP;
+      report_file (&r);
+    }
+    if (opt.json)
+       report_final (num);
+    C_flush();
+    t[mode] = bench_time() - t[mode];
+  }
+  report_header_set (NULL);
+  opt.json = save_json;
+  stdout_restore (fd_out);
+
+  C_printf ("~2  OK  ~0 %d records. text: %.3f sec (%.0f/s), --json: %.3f sec (%.0f/s), --ndjson: %.3f sec (%.0f/s).\n\n",
+            num, t[0], num / t[0], t[1], num / t[1], t[2], num / t[2]);
+}
+
 /**
  * Tests for some functions in misc.c.
  */
@@ -756,6 +2447,417 @@ static void test_AppVeyor_GitHub (void)
   opt.debug = save;
 }
 
+/**
+ * Start an `ETP_mock` server with `num` files for the ETP tests.
+ * It has a `rtt` msec round trip time and accepts only the user `bench` with password `bench`.
+ * Put the `"user:password@host:port"` to query in `host`.
+ */
+static ETP_mock *ETP_mock_bench_start (unsigned num, unsigned rtt, bool with_dirs, char *host, size_t host_size)
+{
+  ETP_mock_cfg cfg;
+  ETP_mock    *mock;
+
+  memset (&cfg, '\0', sizeof(cfg));
+  cfg.user      = "bench";
+  cfg.password  = "bench";
+  cfg.num_files = num;
+  cfg.num_dirs  = with_dirs ? 20 : 0;
+  cfg.with_dirs = with_dirs;
+  cfg.rtt       = rtt;
+  mock = ETP_mock_start (&cfg);
+  if (mock)
+     snprintf (host, host_size, "bench:bench@127.0.0.1:%u", ETP_mock_port(mock));
+  return (mock);
+}
+
+/**
+ * Run the ETP client against an `ETP_mock` server with 1.000 files in 20 folders.
+ * Check the number of results for some file-specs.
+ */
+static void test_ETP_mock (void)
+{
+  static const struct {
+         const char *spec;
+         int         case_sensitive;
+         int         use_regex;
+         int         expect;
+       } tests[] = {
+         { "*",                            0, 0, 1020 },
+         { "file-*",                       0, 0, 1000 },
+         { "dir-*",                        0, 0,   20 },
+         { "*.txt",                        0, 0,  100 },
+         { "*.TXT",                        0, 0,  100 },
+         { "*.TXT",                        1, 0,    0 },
+         { "file-00000?.*",                0, 0,   10 },
+         { "^file-0001[0-4][05]\\.[cp].*$", 0, 1,   10 },
+         { "nothing-*",                    0, 0,    0 }
+       };
+  ETP_mock *mock;
+  char     *save_spec = opt.file_spec;
+  int       save_case = opt.case_sensitive;
+  int       save_regex = opt.use_regex;
+  int       save_quiet = opt.quiet;
+  UINT      save_ttl = opt.evry_cache_ttl;
+  int       i, fd_out, found;
+  char      host [50];
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  mock = ETP_mock_bench_start (1000, 0, true, host, sizeof(host));
+  if (!mock)
+  {
+    C_printf ("~5  FAIL~0 cannot start the stand-in ETP-server.\n\n");
+    return;
+  }
+
+  opt.evry_cache_ttl = 0;
+  for (i = 0; i < DIM(tests); i++)
+  {
+    fd_out = stdout_to_nul();
+    opt.file_spec      = (char*) tests[i].spec;
+    opt.case_sensitive = tests[i].case_sensitive;
+    opt.use_regex      = tests[i].use_regex;
+    opt.quiet          = 1;
+    found = do_check_evry_ept (host);
+    opt.file_spec      = save_spec;
+    opt.case_sensitive = save_case;
+    opt.use_regex      = save_regex;
+    opt.quiet          = save_quiet;
+    if (fd_out >= 0)
+       stdout_restore (fd_out);
+
+    C_printf ("%s~0 %-35s%s -> %4d results.\n", found == tests[i].expect ? "~2  OK  " : "~5  FAIL",
+              tests[i].spec, tests[i].case_sensitive ? " (case)" : "       ", found);
+  }
+  opt.evry_cache_ttl = save_ttl;
+  ETP_mock_stop (mock, NULL);
+  C_putc ('\n');
+}
+
+/**
+ * Return true if `file_a` and `file_b` have the same non-empty content.
+ */
+static bool files_equal (const char *file_a, const char *file_b)
+{
+  size_t size_a = 0, size_b = 0;
+  char  *a = fopen_mem (file_a, &size_a);
+  char  *b = fopen_mem (file_b, &size_b);
+  bool   equal = (a && b && size_a > 0 && size_a == size_b && !memcmp(a, b, size_a));
+
+  FREE (a);
+  FREE (b);
+  return (equal);
+}
+
+/**
+ * Test the ETP result cache against an `ETP_mock` server with 1.000 files.
+ *
+ * The same query is done 5 times with a temporary cache-file:
+ *  \li a live query that saves the results.
+ *  \li a cache hit.
+ *  \li with `--refresh`; a live query.
+ *  \li a cache hit after the cache-file was written and read back.
+ *  \li a live query after the TTL expired.
+ *
+ * Each must print exactly what the 1st query printed. And only 3 of them may
+ * connect to the server.
+ *
+ * Not `opt.quiet` and with a host-name like an interactive user. Hence the
+ * `"Resolving"` and `"Connecting"` lines are compared too.
+ */
+static void test_ETP_cache (void)
+{
+  static const char *what[] = { "live", "cache hit", "--refresh", "cache-file hit", "expired" };
+  ETP_mock      *mock;
+  ETP_mock_stats stats;
+  char          *save_spec = opt.file_spec;
+  char          *save_file = opt.evry_cache_file;
+  UINT           save_ttl = opt.evry_cache_ttl;
+  int            save_quiet = opt.quiet;
+  char          *out [DIM(what)];
+  char          *cache_file;
+  int            i, fd_out, found [DIM(what)];
+  double         t [DIM(what)];
+  char           host [50];
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  mock = ETP_mock_bench_start (1000, 0, false, host, sizeof(host));
+  if (!mock)
+  {
+    C_printf ("~5  FAIL~0 cannot start the stand-in ETP-server.\n\n");
+    return;
+  }
+  snprintf (host, sizeof(host), "bench:bench@localhost:%u", ETP_mock_port(mock));
+
+  ETP_exit();     /* Write and forget the real cache */
+  cache_file = create_temp_file();
+  opt.evry_cache_file = cache_file;
+  opt.evry_cache_ttl  = 60;
+  opt.file_spec       = "*.txt";
+  opt.quiet           = 0;
+
+  for (i = 0; i < DIM(what); i++)
+  {
+    opt.evry_refresh = (i == 2);
+    if (i == 3)
+       ETP_exit();
+    else if (i == 4)
+    {
+      opt.evry_cache_ttl = 1;
+      Sleep (1100);
+    }
+    out[i] = create_temp_file();
+    fd_out = out[i] ? stdout_to_file (out[i]) : -1;
+    t[i] = bench_time();
+    found[i] = do_check_evry_ept (host);
+    t[i] = bench_time() - t[i];
+    if (fd_out >= 0)
+       stdout_restore (fd_out);
+  }
+
+  opt.evry_refresh = 0;
+  ETP_exit();
+  ETP_mock_stop (mock, &stats);
+
+  for (i = 0; i < DIM(what); i++)
+  {
+    bool ok = (found[i] == 100 && (i == 0 || (out[i] && files_equal(out[0], out[i]))));
+
+    C_printf ("%s~0 %-15s -> %3d results, %.3f msec.\n", ok ? "~2  OK  " : "~5  FAIL",
+              what[i], found[i], 1000.0 * t[i]);
+    if (out[i])
+       DeleteFile (out[i]);
+    FREE (out[i]);
+  }
+  C_printf ("%s~0 %u connections to the ETP-server.\n\n",
+            stats.connections == 3 ? "~2  OK  " : "~5  FAIL", stats.connections);
+
+  DeleteFile (cache_file);
+  FREE (cache_file);
+  opt.evry_cache_file = save_file;
+  opt.evry_cache_ttl  = save_ttl;
+  opt.file_spec       = save_spec;
+  opt.quiet           = save_quiet;
+}
+
+/**
+ * Compare the ETP receive speed with `opt.use_buffered_io` on and off.
+ * Query an `ETP_mock` server for 50.000 results; printed to `NUL`.
+ * Report the results per second and the peak memory of the client.
+ */
+static void test_ETP_recv_bench (void)
+{
+  const int  num = 50000;
+  ETP_mock  *mock;
+  char       host [50];
+  char      *save_spec = opt.file_spec;
+  int        save_buffered = opt.use_buffered_io;
+  int        save_quiet = opt.quiet;
+  UINT       save_ttl = opt.evry_cache_ttl;
+  int        i, fd_out, found [2];
+  double     t [2];
+  size_t     peak [2];
+  DWORD      rcv;
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  mock = ETP_mock_bench_start (num, 0, false, host, sizeof(host));
+  if (!mock)
+  {
+    C_printf ("~5  FAIL~0 cannot start the stand-in ETP-server.\n\n");
+    return;
+  }
+
+  fd_out = stdout_to_nul();
+  opt.file_spec = "*";
+  opt.quiet = 1;
+  opt.evry_cache_ttl = 0;
+  rcv = ETP_total_rcv;
+
+  for (i = 0; i < 2; i++)
+  {
+    opt.use_buffered_io = (i == 0);
+    mem_peak();
+    t[i] = bench_time();
+    found[i] = do_check_evry_ept (host);
+    t[i] = bench_time() - t[i];
+    peak[i] = mem_peak();
+  }
+  rcv = (ETP_total_rcv - rcv) / 2;
+
+  opt.file_spec = save_spec;
+  opt.use_buffered_io = save_buffered;
+  opt.quiet = save_quiet;
+  opt.evry_cache_ttl = save_ttl;
+  if (fd_out >= 0)
+     stdout_restore (fd_out);
+  ETP_mock_stop (mock, NULL);
+
+  C_printf ("%s~0 %d results, %s bytes.\n"
+            "        buffered:           %.3f sec (%.0f results/s), peak memory: %u kB.\n"
+            "        1 byte per recv():  %.3f sec (%.0f results/s), peak memory: %u kB.\n\n",
+            (found[0] == num && found[1] == num) ? "~2  OK  " : "~5  FAIL",
+            found[0], str_dword(rcv),
+            t[0], found[0] / t[0], (unsigned) (peak[0] / 1024),
+            t[1], found[1] / t[1], (unsigned) (peak[1] / 1024));
+}
+
+/**
+ * Compare querying 4 ETP-hosts one at a time with `do_check_evry_ept_hosts()`.
+ * Each `ETP_mock` server has a 50 msec round trip time and sends 5.000 results.
+ */
+static void test_ETP_hosts_bench (void)
+{
+  const int    num = 5000;
+  ETP_mock    *mock [4];
+  smartlist_t *hosts = smartlist_new();
+  char        *save_spec = opt.file_spec;
+  int          save_quiet = opt.quiet;
+  UINT         save_ttl = opt.evry_cache_ttl;
+  int          i, started, fd_out, found [2] = { 0, 0 };
+  double       t [2];
+  size_t       peak [2];
+  char         host [50];
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  for (started = 0; started < DIM(mock); started++)
+  {
+    mock [started] = ETP_mock_bench_start (num, 50, false, host, sizeof(host));
+    if (!mock[started])
+       break;
+    smartlist_add_strdup (hosts, host);
+  }
+
+  if (started == DIM(mock))
+  {
+    fd_out = stdout_to_nul();
+    opt.file_spec = "*";
+    opt.quiet = 1;
+    opt.evry_cache_ttl = 0;
+
+    mem_peak();
+    t[0] = bench_time();
+    for (i = 0; i < started; i++)
+        found[0] += do_check_evry_ept (smartlist_get(hosts, i));
+    t[0] = bench_time() - t[0];
+    peak[0] = mem_peak();
+
+    t[1] = bench_time();
+    found[1] = do_check_evry_ept_hosts (hosts);
+    t[1] = bench_time() - t[1];
+    peak[1] = mem_peak();
+
+    opt.file_spec = save_spec;
+    opt.quiet = save_quiet;
+    opt.evry_cache_ttl = save_ttl;
+    if (fd_out >= 0)
+       stdout_restore (fd_out);
+
+    C_printf ("%s~0 %d results from %d hosts.\n"
+              "        one at a time: %.3f sec (%.0f results/s), peak memory: %u kB.\n"
+              "        together:      %.3f sec (%.0f results/s), peak memory: %u kB (%.1f times faster).\n\n",
+              (found[0] == started * num && found[1] == started * num) ? "~2  OK  " : "~5  FAIL",
+              found[1], started,
+              t[0], found[0] / t[0], (unsigned) (peak[0] / 1024),
+              t[1], found[1] / t[1], (unsigned) (peak[1] / 1024), t[0] / t[1]);
+  }
+  else
+    C_printf ("~5  FAIL~0 cannot start the stand-in ETP-servers.\n\n");
+
+  for (i = 0; i < started; i++)
+      ETP_mock_stop (mock[i], NULL);
+  smartlist_free_all (hosts);
+}
+
+/**
+ * Compare 10 file-specs queried with:
+ *  \li one ETP session per file-spec. As for 10 runs of envtool.
+ *  \li one session with `opt.evry_specs` and `opt.use_pipelining == 0`.
+ *  \li one session with `opt.evry_specs` and `opt.use_pipelining == 1`.
+ *
+ * The `ETP_mock` server has a 50 msec round trip time and 10.000 files.
+ * Each file-spec `"file-*N.*"` matches 1.000 of them.
+ */
+static void test_ETP_session_bench (void)
+{
+  const int    num = 1000;
+  const int    num_specs = 10;
+  ETP_mock    *mock;
+  smartlist_t *specs = smartlist_new();
+  char        *save_spec = opt.file_spec;
+  int          save_quiet = opt.quiet;
+  int          save_pipelining = opt.use_pipelining;
+  UINT         save_ttl = opt.evry_cache_ttl;
+  int          i, fd_out, found [3] = { 0, 0, 0 };
+  double       t [3];
+  size_t       peak [3];
+  char         host [50], spec [20];
+
+  C_printf ("~3%s():~0\n", __FUNCTION__);
+
+  mock = ETP_mock_bench_start (num_specs * num, 50, false, host, sizeof(host));
+  if (!mock)
+  {
+    C_printf ("~5  FAIL~0 cannot start the stand-in ETP-server.\n\n");
+    smartlist_free (specs);
+    return;
+  }
+
+  for (i = 1; i < num_specs; i++)
+  {
+    snprintf (spec, sizeof(spec), "file-*%d.*", i);
+    smartlist_add_strdup (specs, spec);
+  }
+
+  fd_out = stdout_to_nul();
+  opt.quiet = 1;
+  opt.use_pipelining = 0;
+  opt.evry_cache_ttl = 0;
+
+  mem_peak();
+  t[0] = bench_time();
+  for (i = 0; i < num_specs; i++)
+  {
+    opt.file_spec = (i == 0) ? "file-*0.*" : smartlist_get (specs, i-1);
+    found[0] += do_check_evry_ept (host);
+  }
+  t[0] = bench_time() - t[0];
+  peak[0] = mem_peak();
+
+  opt.file_spec  = "file-*0.*";
+  opt.evry_specs = specs;
+  for (i = 1; i < 3; i++)
+  {
+    opt.use_pipelining = (i == 2);
+    t[i] = bench_time();
+    found[i] = do_check_evry_ept (host);
+    t[i] = bench_time() - t[i];
+    peak[i] = mem_peak();
+  }
+
+  opt.evry_specs = NULL;
+  opt.file_spec = save_spec;
+  opt.quiet = save_quiet;
+  opt.use_pipelining = save_pipelining;
+  opt.evry_cache_ttl = save_ttl;
+  if (fd_out >= 0)
+     stdout_restore (fd_out);
+  ETP_mock_stop (mock, NULL);
+  smartlist_free_all (specs);
+
+  C_printf ("%s~0 %d results for %d file-specs.\n"
+            "        a session per file-spec:  %.3f sec (%.0f results/s), peak memory: %u kB.\n"
+            "        one session:              %.3f sec (%.0f results/s), peak memory: %u kB.\n"
+            "        one session pipelined:    %.3f sec (%.0f results/s), peak memory: %u kB.\n\n",
+            (found[0] == num_specs * num && found[1] == found[0] && found[2] == found[0]) ? "~2  OK  " : "~5  FAIL",
+            found[2], num_specs,
+            t[0], found[0] / t[0], (unsigned) (peak[0] / 1024),
+            t[1], found[1] / t[1], (unsigned) (peak[1] / 1024),
+            t[2], found[2] / t[2], (unsigned) (peak[2] / 1024));
+}
+
 /**
  * A simple test for ETP searches
  */
@@ -829,6 +2931,9 @@ static int test_python_funcs (void)
  */
 int do_tests (void)
 {
+  if (cache_test_writer())   /* A child started by 'cache_test_multi()' */
+     return (0);
+
   if (opt.do_evry && opt.evry_host)
   {
     test_ETP_host();
@@ -846,6 +2951,19 @@ int do_tests (void)
 
   test_searchpath();
   test_fnmatch();
+  test_fnmatch_compiled();
+  test_smartlist_uniq();
+  test_smartlist_arena();
+  test_smartlist_sort();
+  test_smartlist_read_file();
+  test_grep_buffer();
+  test_grep_regex();
+  test_grep_multi();
+  test_inflate();
+  test_json_writer();
+  test_report_json_truncated();
+  test_ETP_mock();
+  test_ETP_cache();
   test_misc();
   test_PE_wintrust();
   test_slashify();
@@ -856,6 +2974,23 @@ int do_tests (void)
   test_AppxReparsePoints();
   cache_test();
 
+  /* Run the benchmarks on `envtool -tt`
+   */
+  if (opt.do_tests >= 2)
+  {
+    test_shadow_find();
+    test_fnmatch_bench();
+    test_smartlist_uniq_bench();
+    test_smartlist_lines_bench();
+    test_grep_bench();
+    test_grep_regex_bench();
+    test_grep_multi_bench();
+    test_report_json_bench();
+    test_ETP_recv_bench();
+    test_ETP_hosts_bench();
+    test_ETP_session_bench();
+  }
+
   if (opt.under_appveyor || opt.under_github)
      test_AppVeyor_GitHub();
 
@@ -308,7 +308,7 @@ static bool  is_x64_supported (const VCPKG_plat_list p_list);
 static bool  is_windows_supported (const VCPKG_plat_list p_list);
 static bool  is_uwp_supported (const VCPKG_plat_list p_list);
 static bool  is_static_supported (const VCPKG_plat_list p_list);
-static int   compare_port_node (const void **_a, const void **_b);
+static const char *port_node_key (const void *_a);
 static int   compare_package (const void **_a, const void **_b);
 static void *find_available_package (const char *pkg_name);
 static void *find_installed_package (int *index_p, const char *pkg_name, const char *arch);
@@ -1153,12 +1153,13 @@ static void get_port_info_from_disk (const char *port_dir, int ports_index)
  */
 static int get_ports_list_from_cache (void)
 {
-  port_node *node;
-  int  i;
+  cache_getf_desc *desc = cache_getf_compile ("%s,%d,%d,%s,%s,%s");
+  port_node       *node;
+  int              i;
 
   for (i = 0;; i++)
   {
-    char format [100], *package, *version, *homepage, *description;
+    char key [100], *package, *version, *homepage, *description;
     int  have_CONTROL, have_JSON, rc;
 
     /*
@@ -1173,8 +1174,8 @@ static int get_ports_list_from_cache (void)
      *
      *
      */
-    snprintf (format, sizeof(format), "port_node_%d = %%s,%%d,%%d,%%s,%%s,%%s", i);
-    rc = cache_getf (SECTION_VCPKG, format, &package, &have_CONTROL, &have_JSON, &version, &homepage, &description);
+    snprintf (key, sizeof(key), "port_node_%d", i);
+    rc = cache_getf_run (desc, SECTION_VCPKG, key, &package, &have_CONTROL, &have_JSON, &version, &homepage, &description);
     TRACE (2, "port_node_%d from cache, rc: %d: (%s\\%s):\n"
                "     package: '%s', have_CONTROL: %d, have_JSON: %d, version: '%s', homepage: '%s', description: '%s'.\n",
             i, rc, vcpkg_root, package, package, have_CONTROL, have_JSON, version, homepage, description);
@@ -1191,7 +1192,8 @@ static int get_ports_list_from_cache (void)
     _strlcpy (node->homepage, homepage, sizeof(node->homepage));
     smartlist_add (ports_list, node);
   }
-  smartlist_sort (ports_list, compare_port_node);
+  cache_getf_free (desc);
+  smartlist_sort_on_key (ports_list, port_node_key, true, opt.jobs);
   return (i);
 }
 
@@ -1903,14 +1905,13 @@ static int compare_package (const void **_a, const void **_b)
 }
 
 /**
- * Compare 2 `port_node *` records on name.
+ * Return the name of a `port_node *` record as it's sort-key.
  */
-static int compare_port_node (const void **_a, const void **_b)
+static const char *port_node_key (const void *_a)
 {
-  const port_node *a = *_a;
-  const port_node *b = *_b;
+  const port_node *a = _a;
 
-  return stricmp (a->package, b->package);
+  return (a->package);
 }
 
 /**
@@ -2325,16 +2326,17 @@ static int get_packages_dirs_from_cache (smartlist_t **packages_dirs)
  */
 static int get_installed_packages_from_cache (void)
 {
-  int i;
+  cache_getf_desc *desc = cache_getf_compile ("%s,%d,%s,%s,%s,%s,%s,%s");
+  int              i;
 
   for (i = 0;; i++)
   {
     vcpkg_package *package;
-    char  format [100], *pkg_name, *version, *status, *arch, *ABI, *write_time, *dependencies;
+    char  key [100], *pkg_name, *version, *status, *arch, *ABI, *write_time, *dependencies;
     int   rc, installed;
 
-    snprintf (format, sizeof(format), "installed_package_%d = %%s,%%d,%%s,%%s,%%s,%%s,%%s,%%s", i);
-    rc = cache_getf (SECTION_VCPKG, format, &pkg_name, &installed, &version, &status, &arch, &ABI, &write_time, &dependencies);
+    snprintf (key, sizeof(key), "installed_package_%d", i);
+    rc = cache_getf_run (desc, SECTION_VCPKG, key, &pkg_name, &installed, &version, &status, &arch, &ABI, &write_time, &dependencies);
     if (rc != 8)
        break;
 
@@ -2363,6 +2365,7 @@ static int get_installed_packages_from_cache (void)
     get_installed_info (package);
     smartlist_add (installed_packages, package);
   }
+  cache_getf_free (desc);
   return smartlist_len (installed_packages);
 }
 
@@ -2371,16 +2374,17 @@ static int get_installed_packages_from_cache (void)
  */
 static int get_available_packages_from_cache (void)
 {
-  int i;
+  cache_getf_desc *desc = cache_getf_compile ("%s,%d,%s,%s,%s,%s");
+  int              i;
 
   for (i = 0;; i++)
   {
     vcpkg_package *package;
-    char  format [100], *pkg_name, *version, *status, *arch, *dependencies;
+    char  key [100], *pkg_name, *version, *status, *arch, *dependencies;
     int   rc, installed;
 
-    snprintf (format, sizeof(format), "available_package_%d = %%s,%%d,%%s,%%s,%%s,%%s", i);
-    rc = cache_getf (SECTION_VCPKG, format, &pkg_name, &installed, &version, &status, &arch, &dependencies);
+    snprintf (key, sizeof(key), "available_package_%d", i);
+    rc = cache_getf_run (desc, SECTION_VCPKG, key, &pkg_name, &installed, &version, &status, &arch, &dependencies);
 
     if (rc != 6)
        break;
@@ -2402,6 +2406,7 @@ static int get_available_packages_from_cache (void)
 
     smartlist_add (available_packages, package);
   }
+  cache_getf_free (desc);
   smartlist_sort (available_packages, compare_package);
   return smartlist_len (available_packages);
 }